@@ -0,0 +1,502 @@
+// Micro-benchmarks for the codec kernels (quantization, zfp transform, shuffle, bit plane coding,
+// CDF5/3 lifting, grid copying). Every kernel runs on a synthetic ocean-like field and reports
+// ns/value and GB/s. The idx2-bench-avx2 target builds the same file with -Didx2_Avx2 so the SIMD
+// code paths can be compared against the scalar ones.
+//
+// Usage: idx2-bench [--dims 128 128 128] [--reps 5] [--bit-planes 20] [--filter zfp]
+// (configure with -DCMAKE_BUILD_TYPE=Release, the numbers are meaningless without optimizations)
+#define idx2_Implementation
+#include "idx2.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+
+struct bench_config
+{
+  idx2::v3i Dims3 = idx2::v3i(128);
+  int NReps = 5;
+  int NBitPlanes = 20; // number of bit planes coded per block (a typical value for accuracy 1e-3)
+  idx2::cstr Filter = nullptr; // only run the kernels whose names contain this string
+};
+
+
+/* Data shared by all kernels: the input field, gathered into 4x4x4 blocks, and the intermediate
+results of each stage of the block pipeline (quantize -> zfp -> shuffle -> bit plane coding) */
+struct bench_data
+{
+  idx2::volume Field; // float64
+  idx2::i64 NBlocks = 0;
+  idx2::array<idx2::f64> Floats; // NBlocks * 64
+  idx2::array<idx2::i64> Ints;   // quantized
+  idx2::array<idx2::i64> Coeffs; // after the forward zfp transform
+  idx2::array<idx2::u64> UInts;  // after the forward shuffle
+  idx2::array<idx2::i16> EMaxes;
+  idx2::bitstream Stream; // all the coded bit planes
+};
+
+
+/* Results are accumulated here so that the compiler cannot drop the work */
+static volatile idx2::u64 Sink_ = 0;
+
+
+/* Smooth gyres + a thermocline-like decay with depth + small-scale eddies + noise. The field is
+smooth at large scales and noisy at small scales, like a real ocean temperature field. */
+static void
+GenerateOceanField(const idx2::v3i& Dims3, idx2::volume* Vol)
+{
+  using namespace idx2;
+  *Vol = volume(Dims3, dtype::float64);
+  pcg32 Pcg(1234);
+  const f64 TwoPi = 2 * 3.14159265358979323846;
+  v3i P3;
+  idx2_BeginFor3 (P3, v3i(0), Dims3, v3i(1))
+  {
+    f64 X = f64(P3.X) / Dims3.X, Y = f64(P3.Y) / Dims3.Y, Z = f64(P3.Z) / Dims3.Z;
+    f64 Thermocline = 20 * exp(-4 * Z);
+    f64 Gyres = 2 * sin(TwoPi * X) * cos(TwoPi * 0.5 * Y);
+    f64 Eddies = 0.5 * sin(TwoPi * 7 * (X + Y) + 3 * Z) * cos(TwoPi * 5 * (X - Y));
+    f64 Noise = 0.05 * (NextDouble(&Pcg) - 0.5);
+    Vol->At<f64>(P3) = Thermocline + Gyres + Eddies + Noise;
+  }
+  idx2_EndFor3;
+}
+
+
+static void
+Init(bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  GenerateOceanField(Cfg.Dims3, &D->Field);
+  v3i NBlocks3 = Cfg.Dims3 / 4;
+  D->NBlocks = Prod<i64>(NBlocks3);
+  Init(&D->Floats, D->NBlocks * 64);
+  Init(&D->Ints, D->NBlocks * 64);
+  Init(&D->Coeffs, D->NBlocks * 64);
+  Init(&D->UInts, D->NBlocks * 64);
+  Init(&D->EMaxes, D->NBlocks);
+  /* gather the blocks */
+  i64 J = 0;
+  v3i B3, S3;
+  idx2_BeginFor3 (B3, v3i(0), NBlocks3, v3i(1))
+  {
+    idx2_BeginFor3 (S3, v3i(0), v3i(4), v3i(1))
+    {
+      D->Floats[J++] = D->Field.At<f64>(B3 * 4 + S3);
+    }
+    idx2_EndFor3;
+  }
+  idx2_EndFor3;
+  /* run the encoding pipeline once to produce the inputs of the later stages */
+  const int Prec = 64 - 1 - 3;
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    idx2::buffer_t<f64> BufFloats(&D->Floats[B * 64], 64);
+    idx2::buffer_t<i64> BufInts(&D->Ints[B * 64], 64);
+    D->EMaxes[B] = (i16)QuantizeF64(Prec, BufFloats, &BufInts);
+    memcpy(&D->Coeffs[B * 64], &D->Ints[B * 64], 64 * sizeof(i64));
+    ForwardZfp(&D->Coeffs[B * 64], 3);
+    ForwardShuffle(&D->Coeffs[B * 64], &D->UInts[B * 64], 3);
+  }
+  /* the worst case is 2 bits per value per bit plane */
+  InitWrite(&D->Stream, D->NBlocks * 64 * Cfg.NBitPlanes * 2 / 8 + 64);
+}
+
+
+static idx2::i64 BenchEncode(bench_data* D, const bench_config& Cfg);
+
+
+static void
+Dealloc(bench_data* D)
+{
+  idx2::Dealloc(&D->Field);
+  idx2::Dealloc(&D->Floats);
+  idx2::Dealloc(&D->Ints);
+  idx2::Dealloc(&D->Coeffs);
+  idx2::Dealloc(&D->UInts);
+  idx2::Dealloc(&D->EMaxes);
+  idx2::Dealloc(&D->Stream);
+}
+
+
+/* Each kernel runs once per call and returns the number of nanoseconds spent in the timed part
+(the setup, e.g. restoring the input of an in-place transform, is not timed) */
+using kernel_func = idx2::i64 (*)(bench_data* D, const bench_config& Cfg);
+
+
+struct kernel
+{
+  idx2::cstr Name;
+  kernel_func Func;
+  idx2::i64 (*NValues)(const bench_data& D, const bench_config& Cfg);
+  int BytesPerValue; // bytes read + written per value
+};
+
+
+static idx2::i64
+NBlockValues(const bench_data& D, const bench_config&)
+{
+  return D.NBlocks * 64;
+}
+
+
+static idx2::i64
+NBrickValues(const bench_data&, const bench_config& Cfg)
+{
+  using namespace idx2;
+  return Prod<i64>(Cfg.Dims3 / 32) * 33 * 33 * 33;
+}
+
+
+static idx2::i64
+NFieldValues(const bench_data&, const bench_config& Cfg)
+{
+  return idx2::Prod<idx2::i64>(Cfg.Dims3);
+}
+
+
+/* ---------------------- quantization ----------------------*/
+template <bool IsF64> static idx2::i64
+BenchQuantize(bench_data* D, const bench_config&)
+{
+  using namespace idx2;
+  const int Prec = 64 - 1 - 3;
+  array<i64> Ints;
+  Init(&Ints, D->NBlocks * 64);
+  idx2_CleanUp(Dealloc(&Ints));
+  timer Timer;
+  StartTimer(&Timer);
+  i64 Sum = 0;
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    idx2::buffer_t<f64> BufFloats(&D->Floats[B * 64], 64);
+    idx2::buffer_t<i64> BufInts(&Ints[B * 64], 64);
+    Sum += IsF64 ? QuantizeF64(Prec, BufFloats, &BufInts) : QuantizeF32(Prec, BufFloats, &BufInts);
+  }
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += Sum;
+  return Elapsed;
+}
+
+
+static idx2::i64
+BenchDequantize(bench_data* D, const bench_config&)
+{
+  using namespace idx2;
+  const int Prec = 64 - 1 - 3;
+  array<f64> Out;
+  Init(&Out, D->NBlocks * 64);
+  idx2_CleanUp(Dealloc(&Out));
+  timer Timer;
+  StartTimer(&Timer);
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    idx2::buffer_t<i64> BufInts(&D->Ints[B * 64], 64);
+    idx2::buffer_t<f64> BufFloats(&Out[B * 64], 64);
+    Dequantize(D->EMaxes[B], Prec, BufInts, &BufFloats);
+  }
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += (u64)Out[Size(Out) / 2];
+  return Elapsed;
+}
+
+
+/* ---------------------- zfp transform ----------------------*/
+template <bool IsForward> static idx2::i64
+BenchZfp(bench_data* D, const bench_config&)
+{
+  using namespace idx2;
+  array<i64> Work;
+  Init(&Work, D->NBlocks * 64);
+  idx2_CleanUp(Dealloc(&Work));
+  const array<i64>& Input = IsForward ? D->Ints : D->Coeffs;
+  memcpy(Work.Buffer.Data, Input.Buffer.Data, Size(Work) * sizeof(i64));
+  timer Timer;
+  StartTimer(&Timer);
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    if (IsForward)
+      ForwardZfp(&Work[B * 64], 3);
+    else
+      InverseZfp(&Work[B * 64], 3);
+  }
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += Work[Size(Work) / 2];
+  return Elapsed;
+}
+
+
+/* ---------------------- shuffle ----------------------*/
+template <bool IsForward> static idx2::i64
+BenchShuffle(bench_data* D, const bench_config&)
+{
+  using namespace idx2;
+  array<i64> Ints;
+  array<u64> UInts;
+  Init(&Ints, D->NBlocks * 64);
+  Init(&UInts, D->NBlocks * 64);
+  idx2_CleanUp(Dealloc(&Ints); Dealloc(&UInts));
+  timer Timer;
+  StartTimer(&Timer);
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    if (IsForward)
+      ForwardShuffle(&D->Coeffs[B * 64], &UInts[B * 64], 3);
+    else
+      InverseShuffle(&D->UInts[B * 64], &Ints[B * 64], 3);
+  }
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += IsForward ? UInts[Size(UInts) / 2] : Ints[Size(Ints) / 2];
+  return Elapsed;
+}
+
+
+/* ---------------------- bit plane coding ----------------------*/
+/* Encode the top Cfg.NBitPlanes bit planes of every block, the same way EncodeSubband does */
+static idx2::i64
+BenchEncode(bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  Rewind(&D->Stream);
+  timer Timer;
+  StartTimer(&Timer);
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    i8 N = 0;
+    u64* Block = &D->UInts[B * 64];
+    idx2_InclusiveForBackward (int, Bp, 63, 64 - Cfg.NBitPlanes)
+      Encode(Block, 64, Bp, N, &D->Stream);
+  }
+  Flush(&D->Stream);
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += Size(D->Stream);
+  return Elapsed;
+}
+
+
+/* Decode one bit plane at a time (the path DecodeSubband takes for the first 8 bit planes, which
+has an AVX2 implementation) */
+static idx2::i64
+BenchDecode(bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  array<u64> UInts;
+  Init(&UInts, D->NBlocks * 64, u64(0));
+  idx2_CleanUp(Dealloc(&UInts));
+  bitstream Bs;
+  InitRead(&Bs, D->Stream.Stream);
+  timer Timer;
+  StartTimer(&Timer);
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    i8 N = 0;
+    u64* Block = &UInts[B * 64];
+    idx2_InclusiveForBackward (int, Bp, 63, 64 - Cfg.NBitPlanes)
+      Decode(Block, 64, Bp, N, &Bs);
+  }
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += UInts[Size(UInts) / 2];
+  return Elapsed;
+}
+
+
+/* Decode the bit planes without transposing them, then transpose all of them at once (the path
+DecodeSubband takes after the first 8 bit planes) */
+static idx2::i64
+BenchDecodeTranspose(bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  array<u64> UInts;
+  Init(&UInts, D->NBlocks * 64, u64(0));
+  idx2_CleanUp(Dealloc(&UInts));
+  bitstream Bs;
+  InitRead(&Bs, D->Stream.Stream);
+  timer Timer;
+  StartTimer(&Timer);
+  idx2_For (i64, B, 0, D->NBlocks)
+  {
+    i8 N = 0;
+    u64* Block = &UInts[B * 64];
+    idx2_InclusiveForBackward (int, Bp, 63, 64 - Cfg.NBitPlanes)
+      DecodeTest(&Block[63 - Bp], 64, N, &Bs);
+    TransposeRecursive(Block, Cfg.NBitPlanes);
+  }
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += UInts[Size(UInts) / 2];
+  return Elapsed;
+}
+
+
+/* Only the transpose step of the above */
+static idx2::i64
+BenchTranspose(bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  array<u64> UInts;
+  Init(&UInts, D->NBlocks * 64);
+  idx2_CleanUp(Dealloc(&UInts));
+  memcpy(UInts.Buffer.Data, D->UInts.Buffer.Data, Size(UInts) * sizeof(u64));
+  timer Timer;
+  StartTimer(&Timer);
+  idx2_For (i64, B, 0, D->NBlocks)
+    TransposeRecursive(&UInts[B * 64], Cfg.NBitPlanes);
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += UInts[Size(UInts) / 2];
+  return Elapsed;
+}
+
+
+/* ---------------------- CDF5/3 lifting ----------------------*/
+/* One lifting step along one axis on every (32+1)^3 brick of the field, like the per-brick
+transform in the encoder/decoder */
+template <int Axis, bool IsForward> static idx2::i64
+BenchLift(bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  v3i M3(33);
+  volume BrickVol(M3, dtype::float64);
+  idx2_CleanUp(Dealloc(&BrickVol));
+  v3i NBricks3 = Cfg.Dims3 / 32;
+  i64 Elapsed = 0;
+  v3i B3;
+  idx2_BeginFor3 (B3, v3i(0), NBricks3, v3i(1))
+  {
+    v3i To3 = Min(B3 * 32 + M3, Cfg.Dims3);
+    grid SGrid(B3 * 32, To3 - B3 * 32);
+    CopyGridGrid<f64, f64>(SGrid, D->Field, grid(v3i(0), Dims(SGrid)), &BrickVol);
+    timer Timer;
+    StartTimer(&Timer);
+    if (IsForward)
+    {
+      if (Axis == 0)
+        FLiftCdf53X<f64>(grid(M3), M3, lift_option::Normal, &BrickVol);
+      else if (Axis == 1)
+        FLiftCdf53Y<f64>(grid(M3), M3, lift_option::Normal, &BrickVol);
+      else
+        FLiftCdf53Z<f64>(grid(M3), M3, lift_option::Normal, &BrickVol);
+    }
+    else
+    {
+      if (Axis == 0)
+        ILiftCdf53X<f64>(grid(M3), M3, lift_option::Normal, &BrickVol);
+      else if (Axis == 1)
+        ILiftCdf53Y<f64>(grid(M3), M3, lift_option::Normal, &BrickVol);
+      else
+        ILiftCdf53Z<f64>(grid(M3), M3, lift_option::Normal, &BrickVol);
+    }
+    Elapsed += ElapsedTime(&Timer);
+  }
+  idx2_EndFor3;
+  Sink_ += (u64)BrickVol.At<f64>(v3i(16));
+  return Elapsed;
+}
+
+
+/* ---------------------- grid copying ----------------------*/
+/* Copy the whole field to a float32 volume (what the decoder does when it writes a brick to the
+output buffer) */
+template <int Strd> static idx2::i64
+BenchCopyGridGrid(bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  v3i Dims3 = (Cfg.Dims3 + Strd - 1) / Strd;
+  volume OutVol(Dims3, dtype::float32);
+  idx2_CleanUp(Dealloc(&OutVol));
+  timer Timer;
+  StartTimer(&Timer);
+  CopyGridGrid<f64, f32>(grid(v3i(0), Dims3, v3i(Strd)), D->Field, grid(Dims3), &OutVol);
+  i64 Elapsed = ElapsedTime(&Timer);
+  Sink_ += (u64)OutVol.At<f32>(Dims3 / 2);
+  return Elapsed;
+}
+
+
+static idx2::i64
+NStridedFieldValues(const bench_data&, const bench_config& Cfg)
+{
+  return idx2::Prod<idx2::i64>((Cfg.Dims3 + 1) / 2);
+}
+
+
+/* Kernels run in the order of the encoding pipeline, then the decoding pipeline */
+static const kernel Kernels[] = {
+  { "quantize-f64", BenchQuantize<true>, NBlockValues, 16 },
+  { "quantize-f32", BenchQuantize<false>, NBlockValues, 16 },
+  { "forward-zfp", BenchZfp<true>, NBlockValues, 16 },
+  { "forward-shuffle", BenchShuffle<true>, NBlockValues, 16 },
+  { "encode-bitplanes", BenchEncode, NBlockValues, 8 },
+  { "decode-bitplanes", BenchDecode, NBlockValues, 8 },
+  { "decode-bitplanes-transpose", BenchDecodeTranspose, NBlockValues, 8 },
+  { "transpose-recursive", BenchTranspose, NBlockValues, 16 },
+  { "inverse-shuffle", BenchShuffle<false>, NBlockValues, 16 },
+  { "inverse-zfp", BenchZfp<false>, NBlockValues, 16 },
+  { "dequantize", BenchDequantize, NBlockValues, 16 },
+  { "forward-lift-cdf53-x", BenchLift<0, true>, NBrickValues, 16 },
+  { "forward-lift-cdf53-y", BenchLift<1, true>, NBrickValues, 16 },
+  { "forward-lift-cdf53-z", BenchLift<2, true>, NBrickValues, 16 },
+  { "inverse-lift-cdf53-x", BenchLift<0, false>, NBrickValues, 16 },
+  { "inverse-lift-cdf53-y", BenchLift<1, false>, NBrickValues, 16 },
+  { "inverse-lift-cdf53-z", BenchLift<2, false>, NBrickValues, 16 },
+  { "copy-grid-grid-f64-f32", BenchCopyGridGrid<1>, NFieldValues, 12 },
+  { "copy-grid-grid-f64-f32-strided", BenchCopyGridGrid<2>, NStridedFieldValues, 12 },
+};
+
+
+static void
+RunKernel(const kernel& K, bench_data* D, const bench_config& Cfg)
+{
+  using namespace idx2;
+  K.Func(D, Cfg); // warm up
+  i64 Best = traits<i64>::Max;
+  idx2_For (int, R, 0, Cfg.NReps)
+    Best = Min(Best, K.Func(D, Cfg));
+  i64 NValues = K.NValues(*D, Cfg);
+  f64 NsPerValue = f64(Best) / NValues;
+  f64 GBPerSec = f64(NValues) * K.BytesPerValue / Max(Best, i64(1));
+  printf("%-32s %12.3f %12.3f\n", K.Name, NsPerValue, GBPerSec);
+}
+
+
+int
+main(int Argc, const char** Argv)
+{
+  using namespace idx2;
+  bench_config Cfg;
+  OptVal(Argc, Argv, "--dims", &Cfg.Dims3);
+  OptVal(Argc, Argv, "--reps", &Cfg.NReps);
+  OptVal(Argc, Argv, "--bit-planes", &Cfg.NBitPlanes);
+  OptVal(Argc, Argv, "--filter", &Cfg.Filter);
+  if (!(Cfg.Dims3 % 32 == v3i(0)) || Cfg.Dims3 < v3i(32))
+  {
+    fprintf(stderr, "--dims must be positive multiples of 32\n");
+    return 1;
+  }
+  Cfg.NBitPlanes = Min(Max(Cfg.NBitPlanes, 1), 64);
+  Cfg.NReps = Max(Cfg.NReps, 1);
+
+#if defined(idx2_Avx2) && defined(__AVX2__)
+  cstr Isa = "avx2";
+#else
+  cstr Isa = "scalar";
+#endif
+  printf("field %d x %d x %d (float64), %d bit planes, best of %d runs, %s kernels\n",
+         Cfg.Dims3.X,
+         Cfg.Dims3.Y,
+         Cfg.Dims3.Z,
+         Cfg.NBitPlanes,
+         Cfg.NReps,
+         Isa);
+  bench_data D;
+  Init(&D, Cfg);
+  idx2_CleanUp(Dealloc(&D));
+  BenchEncode(&D, Cfg); // the decoding kernels need the coded bit planes
+  printf("%-32s %12s %12s\n", "kernel", "ns/value", "GB/s");
+  for (const kernel& K : Kernels)
+  {
+    if (Cfg.Filter && !strstr(K.Name, Cfg.Filter))
+      continue;
+    RunKernel(K, &D, Cfg);
+  }
+
+  return 0;
+}
@@ -0,0 +1,411 @@
+// Layout advisor. Replays a recorded query trace (see SetQueryTrace in idx2-query.hpp) on a sample volume encoded
+// with candidate layouts: brick dimensions, bricks per chunk, chunks per file and the grouping of levels, sub-levels
+// and bit planes into chunks. Every query of the trace goes through the decoder itself, whose statistics give the
+// bytes read, the files opened, the chunks read and the decode work of each layout. These are combined into an
+// estimated time (--mb-per-sec, --open-ms and --seek-ms describe the file system), or, with --bench, replaced by the
+// measured time of the replay with a cold page cache. The parameters are tuned one at a time, starting from the
+// layout of convert_llc.py (32^3 bricks, 512 bricks per chunk, 4096 chunks per file), until no single change
+// helps, and the best layout is printed as the options of the encoder.
+//
+// Usage: idx2-layout --trace trace.txt --sample llc2160/u-face-2-depth-0-time-0-1024.idx2 (or a raw float32
+//                    volume: --sample face.raw --dims 2160 2160 1024)
+//                    [--trace-dims 2160 2160 1024] (the dims of the traced files, if the sample is smaller)
+//                    [--levels 4] [--accuracy 1e-7] [--work-dir ./idx2-layout] [--passes 2]
+//                    [--mb-per-sec 500] [--open-ms 1] [--seek-ms 0.1] [--bench] [--json layout.json]
+// The queries of the trace are mapped onto the sample (scaled by --trace-dims, then cropped to the sample), so the
+// sample should have the shape of the traced files. Each candidate is encoded into its own directory of --work-dir.
+// (configure with -DCMAKE_BUILD_TYPE=Release)
+#define idx2_Implementation
+#include "idx2-query.hpp"
+#include <filesystem>
+#include <map>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+struct layout_config
+{
+  idx2::cstr TraceFile = nullptr;
+  idx2::cstr Sample = nullptr;
+  idx2::v3i SampleDims3 = idx2::v3i(0); // of a raw sample
+  idx2::v3i TraceDims3 = idx2::v3i(0); // (0, 0, 0) means the dims of the sample
+  std::string WorkDir = "./idx2-layout";
+  int NLevels = 4;
+  double Accuracy = 1e-7;
+  int NPasses = 2;
+  double MBPerSec = 500; // the cost model (see GetCost)
+  double OpenMs = 1;
+  double SeekMs = 0.1;
+  bool Bench = false;
+  idx2::cstr JsonFile = nullptr;
+};
+
+
+/* The parameters of the encoder that determine how the bit planes of the bricks are laid out in files */
+struct layout
+{
+  idx2::v3i BrickDims3 = idx2::v3i(32);
+  int BricksPerChunk = 512;
+  int ChunksPerFile = 4096;
+  bool GroupLevels = false;
+  bool GroupSubLevels = true;
+  bool GroupBitPlanes = true;
+};
+
+
+/* The candidates of each parameter (BrickDims3 includes shapes for time series and for horizontal slices) */
+static const idx2::v3i BrickDimsCandidates[] = {
+  idx2::v3i(16, 16, 16), idx2::v3i(32, 32, 32), idx2::v3i(64, 64, 64),
+  idx2::v3i(64, 64, 16), idx2::v3i(16, 16, 64), idx2::v3i(32, 32, 8)
+};
+static const int BricksPerChunkCandidates[] = { 64, 512, 4096 };
+static const int ChunksPerFileCandidates[] = { 256, 4096 };
+
+
+struct layout_result
+{
+  layout Layout;
+  std::string ErrMsg; // empty if the layout could be encoded and replayed
+  idx2::decode_stats Stats; // summed over the queries of the trace
+  idx2::i64 EncodedBytes = 0;
+  double ModelSeconds = 0;
+  double BenchSeconds = -1; // -1 means not measured
+};
+
+
+static std::string
+ToString(const layout& L)
+{
+  char Str[128];
+  snprintf(Str, sizeof(Str), "%dx%dx%d %d %d %c%c%c", L.BrickDims3.X, L.BrickDims3.Y, L.BrickDims3.Z,
+           L.BricksPerChunk, L.ChunksPerFile, L.GroupLevels ? 'L' : '-', L.GroupSubLevels ? 'S' : '-', L.GroupBitPlanes ? 'B' : '-');
+  return Str;
+}
+
+
+/* What the replay of the trace costs under the model (or as measured) */
+static double
+GetCost(const layout_result& R)
+{
+  return R.BenchSeconds >= 0 ? R.BenchSeconds : R.ModelSeconds;
+}
+
+
+/* Map an extent of a traced file to the sample */
+static idx2::extent
+MapToSample(const layout_config& Config, const idx2::v3i& SampleDims3, const idx2::extent& Ext)
+{
+  if (idx2::Dims(Ext) == idx2::v3i(0))
+    return idx2::extent(SampleDims3); // the whole file
+  idx2::v3i From3 = idx2::From(Ext), Dims3 = idx2::Dims(Ext);
+  for (int D = 0; D < 3; ++D) {
+    if (Config.TraceDims3[D] > 0) {
+      From3[D] = int(idx2::i64(From3[D]) * SampleDims3[D] / Config.TraceDims3[D]);
+      Dims3[D] = idx2::Max(int(idx2::i64(Dims3[D]) * SampleDims3[D] / Config.TraceDims3[D]), 1);
+    }
+    From3[D] = idx2::Min(From3[D], SampleDims3[D] - 1);
+    Dims3[D] = idx2::Min(Dims3[D], SampleDims3[D] - From3[D]);
+  }
+  return idx2::extent(From3, Dims3);
+}
+
+
+/* Evict the encoded sample from the OS page cache so that the replay reads from disk */
+static bool
+DropFromPageCache(const std::string& Dir)
+{
+#if defined(__linux__)
+  for (const auto& Entry : std::filesystem::recursive_directory_iterator(Dir)) {
+    if (!Entry.is_regular_file())
+      continue;
+    int Fd = open(Entry.path().c_str(), O_RDONLY);
+    if (Fd < 0)
+      continue;
+    fdatasync(Fd); // dirty pages cannot be dropped
+    posix_fadvise(Fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(Fd);
+  }
+  return true;
+#else
+  (void)Dir;
+  return false;
+#endif
+}
+
+
+static idx2::error<idx2::idx2_err_code>
+EncodeSample(const layout_config& Config, const layout& L, const idx2::volume& Vol, const std::string& Dir)
+{
+  using namespace idx2;
+  idx2_file Idx2;
+  idx2_CleanUp(Dealloc(&Idx2));
+  params P;
+  snprintf(P.Meta.Name, sizeof(P.Meta.Name), "%s", "layout");
+  snprintf(P.Meta.Field, sizeof(P.Meta.Field), "%s", "sample");
+  P.OutDir = Dir.c_str();
+  SetName(&Idx2, P.Meta.Name);
+  SetField(&Idx2, P.Meta.Field);
+  SetVersion(&Idx2, v2i(1, 0));
+  SetDimensions(&Idx2, Dims(Vol));
+  SetDataType(&Idx2, dtype::float32);
+  SetBrickSize(&Idx2, L.BrickDims3);
+  SetNumIterations(&Idx2, (i8)Config.NLevels);
+  SetAccuracy(&Idx2, Config.Accuracy);
+  SetBricksPerChunk(&Idx2, L.BricksPerChunk);
+  SetChunksPerFile(&Idx2, L.ChunksPerFile);
+  SetGroupLevels(&Idx2, L.GroupLevels);
+  SetGroupSubLevels(&Idx2, L.GroupSubLevels);
+  SetGroupBitPlanes(&Idx2, L.GroupBitPlanes);
+  SetDir(&Idx2, Dir.c_str());
+  idx2_PropagateIfError(Finalize(&Idx2, P));
+  brick_copier Copier(&Vol);
+  idx2_PropagateIfError(Encode(&Idx2, P, Copier));
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+
+/* Decode every query of the trace from the sample encoded in Dir, return the wall time */
+static idx2::error<idx2::idx2_err_code>
+ReplayTrace(const layout_config& Config,
+            const std::vector<std::vector<input>>& Trace,
+            const idx2::v3i& SampleDims3,
+            const std::string& Dir,
+            idx2::decode_stats* Stats,
+            double* Seconds)
+{
+  idx2::timer Timer;
+  idx2::StartTimer(&Timer);
+  for (const std::vector<input>& Query : Trace) {
+    for (const input& Traced : Query) {
+      input In = Traced;
+      In.InFile = Dir + "/layout/sample.idx2";
+      In.Extent = MapToSample(Config, SampleDims3, Traced.Extent);
+      In.TargetRmse = In.TargetPsnr = In.TargetMaxError = 0; // the sample has no rate-distortion curves
+      output Output;
+      idx2::decode_stats S;
+      auto Result = DecodeOneFile(Dir, In, &Output, &S);
+      if (!Result)
+        return Error(Result);
+      idx2::Add(Stats, S);
+    }
+  }
+  *Seconds = idx2::Seconds(idx2::ElapsedTime(&Timer));
+  return idx2_Error(idx2::idx2_err_code::NoError);
+}
+
+
+static layout_result
+Evaluate(const layout_config& Config, const std::vector<std::vector<input>>& Trace, const idx2::volume& Vol, const layout& L, int Index)
+{
+  layout_result R;
+  R.Layout = L;
+  std::string Dir = Config.WorkDir + "/" + std::to_string(Index);
+  std::error_code Ec;
+  std::filesystem::remove_all(Dir, Ec);
+  std::filesystem::create_directories(Dir, Ec);
+  auto Encoded = EncodeSample(Config, L, Vol, Dir);
+  if (!Encoded) {
+    R.ErrMsg = idx2::ToString(Encoded);
+    return R;
+  }
+  for (const auto& Entry : std::filesystem::recursive_directory_iterator(Dir)) {
+    if (Entry.is_regular_file())
+      R.EncodedBytes += Entry.file_size();
+  }
+
+  /* the decode work is measured with a warm page cache, the io is then modeled from the statistics */
+  double Seconds = 0;
+  auto Replayed = ReplayTrace(Config, Trace, idx2::Dims(Vol), Dir, &R.Stats, &Seconds);
+  if (!Replayed) {
+    R.ErrMsg = idx2::ToString(Replayed);
+    return R;
+  }
+  const idx2::decode_stats& S = R.Stats;
+  idx2::i64 BytesRead = S.BytesRdos + S.BytesExps + S.BytesIndex + S.BytesData;
+  R.ModelSeconds = BytesRead / (Config.MBPerSec * 1e6) + S.NFilesOpened * Config.OpenMs * 1e-3 +
+                   S.NChunksMissed * Config.SeekMs * 1e-3 + idx2::Seconds(S.TotalTime - S.IOTime);
+  if (Config.Bench && DropFromPageCache(Dir)) {
+    idx2::decode_stats Ignored;
+    if (ReplayTrace(Config, Trace, idx2::Dims(Vol), Dir, &Ignored, &Seconds))
+      R.BenchSeconds = Seconds;
+  }
+  return R;
+}
+
+
+static void
+PrintResult(const layout_result& R, bool Best)
+{
+  const idx2::decode_stats& S = R.Stats;
+  if (!R.ErrMsg.empty()) {
+    std::string Msg = R.ErrMsg.substr(0, R.ErrMsg.find('\n'));
+    printf("  %-22s cannot be used: %s\n", ToString(R.Layout).c_str(), Msg.c_str());
+    return;
+  }
+  idx2::i64 BytesRead = S.BytesRdos + S.BytesExps + S.BytesIndex + S.BytesData;
+  char Bench[32] = "-";
+  if (R.BenchSeconds >= 0)
+    snprintf(Bench, sizeof(Bench), "%.1f", R.BenchSeconds * 1e3);
+  printf("%c %-22s %10.2f %8lld %9lld %9lld %10.1f %10.1f %10s %9.2f\n", Best ? '*' : ' ', ToString(R.Layout).c_str(),
+         BytesRead / 1e6, (long long)S.NFilesOpened, (long long)S.NChunksMissed, (long long)S.NBricksDecoded,
+         idx2::Milliseconds(S.TotalTime - S.IOTime), R.ModelSeconds * 1e3, Bench, R.EncodedBytes / 1e6);
+}
+
+
+int
+main(int Argc, const char** Argv)
+{
+  using namespace idx2;
+  layout_config Config;
+  if (!OptVal(Argc, Argv, "--trace", &Config.TraceFile) || !OptVal(Argc, Argv, "--sample", &Config.Sample)) {
+    fprintf(stderr, "Usage: idx2-layout --trace trace.txt --sample file.idx2 (or file.raw --dims x y z) [options, see idx2-layout.cpp]\n");
+    return 1;
+  }
+  OptVal(Argc, Argv, "--dims", &Config.SampleDims3);
+  OptVal(Argc, Argv, "--trace-dims", &Config.TraceDims3);
+  cstr WorkDir = nullptr;
+  if (OptVal(Argc, Argv, "--work-dir", &WorkDir))
+    Config.WorkDir = WorkDir;
+  OptVal(Argc, Argv, "--levels", &Config.NLevels);
+  OptVal(Argc, Argv, "--accuracy", &Config.Accuracy);
+  OptVal(Argc, Argv, "--passes", &Config.NPasses);
+  OptVal(Argc, Argv, "--mb-per-sec", &Config.MBPerSec);
+  OptVal(Argc, Argv, "--open-ms", &Config.OpenMs);
+  OptVal(Argc, Argv, "--seek-ms", &Config.SeekMs);
+  OptVal(Argc, Argv, "--json", &Config.JsonFile);
+  Config.Bench = OptExists(Argc, Argv, "--bench");
+
+  std::vector<std::vector<input>> Trace;
+  auto Result = ReadQueryTrace(Config.TraceFile, &Trace);
+  if (!Result) {
+    fprintf(stderr, "%s\n", ToString(Result));
+    return 1;
+  }
+  size_t NInputs = 0;
+  for (const auto& Query : Trace)
+    NInputs += Query.size();
+
+  /* the sample, either decoded from an .idx2 file or read from a raw file */
+  volume Vol;
+  output Decoded;
+  idx2_CleanUp(if (!Decoded.OutBuffer) Dealloc(&Vol));
+  std::string Sample = Config.Sample;
+  if (Sample.size() > 5 && Sample.compare(Sample.size() - 5, 5, ".idx2") == 0) {
+    input In;
+    In.InFile = Sample;
+    In.Accuracy = 0;
+    std::string InDir = std::filesystem::path(Sample).parent_path().parent_path().string();
+    auto Dims3 = DecodeOneFile(InDir.empty() ? "." : InDir, In, &Decoded);
+    if (!Dims3) {
+      fprintf(stderr, "%s\n", ToString(Error(Dims3)));
+      return 1;
+    }
+    if (Decoded.DataType != dtype::float32) {
+      fprintf(stderr, "only float32 samples are supported\n");
+      return 1;
+    }
+    Vol = volume(Decoded.OutBuffer, Value(Dims3), dtype::float32);
+  } else {
+    auto Read = ReadVolume(Config.Sample, Config.SampleDims3, dtype::float32, &Vol);
+    if (!Read) {
+      fprintf(stderr, "cannot read %s (a raw sample needs --dims): %s\n", Config.Sample, ToString(Read));
+      return 1;
+    }
+  }
+  v3i SampleDims3 = Dims(Vol);
+  printf("trace: %d queries, %d decodes; sample: %d x %d x %d\n", int(Trace.size()), int(NInputs), SampleDims3.X, SampleDims3.Y, SampleDims3.Z);
+  printf("  %-22s %10s %8s %9s %9s %10s %10s %10s %9s\n", "brick bpc cpf group", "MB read", "files", "chunks", "bricks",
+         "decode ms", "model ms", "bench ms", "size MB");
+
+  /* tune one parameter at a time, keeping the best value of each */
+  std::map<std::string, layout_result> Results;
+  auto Get = [&](const layout& L) -> const layout_result& {
+    std::string Key = ToString(L);
+    auto It = Results.find(Key);
+    if (It == Results.end()) {
+      It = Results.emplace(Key, Evaluate(Config, Trace, Vol, L, int(Results.size()))).first;
+      PrintResult(It->second, false);
+    }
+    return It->second;
+  };
+  layout Best;
+  if (!Get(Best).ErrMsg.empty()) {
+    fprintf(stderr, "the default layout cannot encode the sample\n");
+    return 1;
+  }
+  for (int Pass = 0; Pass < Config.NPasses; ++Pass) {
+    layout Start = Best;
+    auto Try = [&](const layout& L) {
+      const layout_result& R = Get(L);
+      if (R.ErrMsg.empty() && GetCost(R) < GetCost(Get(Best)))
+        Best = L;
+    };
+    for (const v3i& B3 : BrickDimsCandidates) {
+      layout L = Best;
+      L.BrickDims3 = B3;
+      Try(L);
+    }
+    for (int N : BricksPerChunkCandidates) {
+      layout L = Best;
+      L.BricksPerChunk = N;
+      Try(L);
+    }
+    for (int N : ChunksPerFileCandidates) {
+      layout L = Best;
+      L.ChunksPerFile = N;
+      Try(L);
+    }
+    for (int G = 0; G < 3; ++G) {
+      layout L = Best;
+      bool& Group = G == 0 ? L.GroupLevels : G == 1 ? L.GroupSubLevels : L.GroupBitPlanes;
+      Group = !Group;
+      Try(L);
+    }
+    if (ToString(Best) == ToString(Start))
+      break;
+  }
+
+  /* all the layouts that were tried, best first */
+  std::vector<const layout_result*> Sorted;
+  for (const auto& KV : Results) {
+    if (KV.second.ErrMsg.empty())
+      Sorted.push_back(&KV.second);
+  }
+  std::sort(Sorted.begin(), Sorted.end(), [](const layout_result* R1, const layout_result* R2) { return GetCost(*R1) < GetCost(*R2); });
+  printf("\nranking:\n");
+  for (const layout_result* R : Sorted)
+    PrintResult(*R, R == Sorted.front());
+  const layout& L = Sorted.front()->Layout;
+  double Speedup = GetCost(Get(layout())) / GetCost(*Sorted.front());
+  printf("\nbest layout (%.2fx the default): --brick_size %d %d %d --bricks_per_tile %d --tiles_per_file %d\n", Speedup,
+         L.BrickDims3.X, L.BrickDims3.Y, L.BrickDims3.Z, L.BricksPerChunk, L.ChunksPerFile);
+  printf("  (group-levels %s) (group-sub-levels %s) (group-bit-planes %s)\n", L.GroupLevels ? "true" : "false",
+         L.GroupSubLevels ? "true" : "false", L.GroupBitPlanes ? "true" : "false");
+
+  if (Config.JsonFile) {
+    FILE* Fp = fopen(Config.JsonFile, "w");
+    if (!Fp) {
+      fprintf(stderr, "cannot write %s\n", Config.JsonFile);
+      return 1;
+    }
+    fprintf(Fp, "[\n");
+    for (int I = 0; I < Sorted.size(); ++I) {
+      const layout_result& R = *Sorted[I];
+      const layout& RL = R.Layout;
+      fprintf(Fp, "{\"brick_dims\": [%d, %d, %d], \"bricks_per_chunk\": %d, \"chunks_per_file\": %d, "
+                  "\"group_levels\": %s, \"group_sub_levels\": %s, \"group_bit_planes\": %s, "
+                  "\"model_sec\": %f, \"bench_sec\": %f, \"encoded_bytes\": %lld, \"stats\": ",
+              RL.BrickDims3.X, RL.BrickDims3.Y, RL.BrickDims3.Z, RL.BricksPerChunk, RL.ChunksPerFile,
+              RL.GroupLevels ? "true" : "false", RL.GroupSubLevels ? "true" : "false", RL.GroupBitPlanes ? "true" : "false",
+              R.ModelSeconds, R.BenchSeconds, (long long)R.EncodedBytes);
+      printer Pr(Fp);
+      PrintJson(&Pr, R.Stats);
+      fprintf(Fp, "}%s\n", I + 1 < Sorted.size() ? "," : "");
+    }
+    fprintf(Fp, "]\n");
+    fclose(Fp);
+  }
+  return 0;
+}
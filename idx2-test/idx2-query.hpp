@@ -0,0 +1,1619 @@
+﻿// The query layer for the LLC datasets (one .idx2 file per face, depth and group of time steps).
+// Like idx2.hpp, define idx2_Implementation before including this file in exactly one source file.
+#pragma once
+
+#include "idx2.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+* Data description:
+* Each file contains the data for one face, on one depth, and for 32 time steps (or 1024 time steps on NAS)
+* The file path will be of the form "llc2160/u-face-3-depth-51-time-0-1024.idx2" (dataset name = llc2160, field name = u, face 3, depth 51, time steps [0..1024]
+* In particular, each .idx2 dataset stores a single face (indexed from 0 to 4), for a single depth, and for 1024 time steps.
+* The grid size for each .idx2 dataset is thus 2160(x) * 6480(y) * 1024(t) (for faces 0, 1), 2160(x) * 2160(y) * 1024(t) (for face 2), and 6480(x) * 2160(y) * 1024(t) (for faces 3, 4)
+* Note that we do not rotate or flip any face from their original form.
+*/
+
+
+struct input
+{
+  std::string InFile; // e.g., "llc2160/u-face-3-depth-51-time-0-1024.idx2" (ALWAYS include the parent dir, not just the name of the .idx2 file)
+  idx2::extent Extent; // "crop" the output to a region in the [x, y, t] space, leave as default to get whole volume
+  idx2::v3i Downsampling3 = idx2::v3i(0);
+  double Accuracy;
+  double TargetRmse = 0; // if > 0 (or TargetPsnr > 0), decode the fewest bytes whose estimated error meets the target
+  double TargetPsnr = 0; // (the file must be encoded with params::RdCurves, Accuracy is then ignored)
+  double TargetMaxError = 0; // if > 0, same but no sample is off by more than this (a guaranteed bound, takes precedence)
+  idx2::co_located_chunks* CoLocatedChunks = nullptr; // if not null, shared by the queries of co-located fields (see idx2::params::CoLocatedChunks)
+};
+
+
+struct output
+{
+  idx2::grid OutGrid; // the logical grid of the output buffer (to get the dimensions of the grid, call idx2::v3i Dims3 = Dims(*OutGrid))
+  idx2::buffer OutBuffer; // the output data buffer, if the buffer is preallocated, we will reuse that buffer
+  idx2::dtype DataType; // float32, float64 etc
+  double RmseEstimate = -1; // the estimated root-mean-square error when decoding to a target (-1 otherwise)
+  double MaxErrorBound = -1; // the bound on the error of every sample when decoding to TargetMaxError (-1 otherwise)
+  virtual ~output()
+  {
+    if (OutBuffer)
+      idx2::DeallocBuf(&OutBuffer);
+  }
+};
+
+
+/* Where an output of ExecuteQuery comes from */
+struct output_metadata
+{
+  int Face;
+  int Depth;
+  int Time;
+};
+
+
+/*
+* When accessing the data, we can provide three sets of parameters:
+*   - the downsampling factor (in x/y/t),
+*   - the accuracy (an error value, with 0 meaning no error), and
+*   - the spatial-temporal extent to query data from.
+* The downsampling factor is given by a vector of three integers (idx2::v3i).
+* Downsampling factor (0, 0, 0) means return everything at full resolution.
+* Downsampling factor (0, 1, 2) means x is full resolution, y is half resolution, and t (time) is quarter resolution.
+* Accuracy is a floating-point number to indicate the desired root-mean-square error (0 means near-lossless).
+* The downsampling factor also affects the accuracy, but the Accuracy parameter is to be interpreted as if there is no downsampling.
+* The Extent parameter (of type idx2::extent) determines where in the [x, y, t] space we want to query from.
+* For example, to query face 0 at time step 500, we can set the extent to be from [0, 0, 500] to [2159, 6479, 500].
+* This can be done by using the idx2::extent constructor idx2::extent(idx2::v3i(0, 0, 500), idx2::v3i(2160, 6480, 1)).
+* If a default idx2::extent is given, it is understood that the full volume is requested (e.g., from [0, 0, 0] to [2159, 6479, 1023] for face 0).
+*
+* There are two parameters, OutGrid (of type idx2::grid) and OutBuf (of type idx2::buffer).
+* To see what they mean, consider the scenarios below:
+*
+* 1) In the first scenario, we have a 2D 7x5 grid.
+* The extent we are asking for is from [1, 1] to [4, 3].
+* The OutGrid will be a sub-grid of samples, from [1, 1] to [4, 3], with strides [1, 1], for a total of 4x3 samples.
+* We use @ to denote the samples inside OutGrid (that will be returned to the user).
+* The OutBuf will be a linear buffer of 4x3=12 floating-point numbers, storing the sample values in the OutGrid.
+*
+*     +    +    +    +    +    +    +
+*
+*     +    @----@----@----@    +    +
+*          |              |
+*     +    @    @    @    @    +    +
+*          |              |
+*     +    @----@----@----@    +    +
+*
+*     +    +    +    +    +    +    +
+*
+* 2) In the second scenario, we still have the same 7x5 grid.
+* The extent we are asking for is still from [1, 1] to [4, 3], as above.
+* But now we are using a downsampling factor of (1, 0), meaning we now only get every other sample in X.
+* Below we show the downsampled grid according to downsampling factor (1, 0).
+* Note that the (coarse) samples that fall inside the queried extent do not "cover" all of this extent.
+*
+*     +         +         +         +
+*
+*     +    -----+---------+         +
+*          |              |
+*     +    |    +         +         +
+*          |              |
+*     +    -----+---------+         +
+*
+*     +         +         +         +
+*
+* Therefore, we enlarge the extent so that it "snaps" to the downsampled grid (see below).
+* As a result, the OutGrid is now from [0, 1] to [4, 3], with strides [2, 1], for a total of 3x3 samples (see the @ samples below).
+* The OutBuf will be a linear buffer of 3x3=9 floating-point numbers, storing the sample values in the OutGrid.
+*
+*     +    +    +    +    +    +    +
+*
+*     @----+----@----+----@    +    +
+*     |                   |
+*     @    +    @    +    @    +    +
+*     |                   |
+*     @----+----@----+----@    +    +
+*
+*     +    +    +    +    +    +    +
+*
+* 3) In the second scenario, we still have the same 7x5 grid.
+* The extent we are asking for is now from [1, 0] to [1, 4] (i.e., a "slicing" operation along X)
+* We are stil using a downsampling factor of (1, 0), meaning we now only get every other sample in X.
+* In this case, our query extent "falls between" the samples of the downsampled grid.
+*
+*     +    +    +    +    +    +    +
+*          |
+*     +    +    +    +    +    +    +
+*          |
+*     +    +    +    +    +    +    +
+*          |
+*     +    +    +    +    +    +    +
+*          |
+*     +    +    +    +    +    +    +
+*
+* As before, we enlarge the requested extent so that it "snaps" to the downsampled grid.
+*
+*     @---------@         +         +
+*     |         |
+*     @         @         +         +
+*     |         |
+*     @         @         +         +
+*     |         |
+*     @         @         +         +
+*     |         |
+*     @---------@         +         +
+*
+* The dimensions of OutGrid will be 2x5, and OutBuf will contain 10 samples.
+* Note that even though the user asks for a 1x5 slice, we are returning a 2x5 sub-grid.
+* To get the slice that they want, the user then can choose to do either:
+*   - Pick one of the two returned slices
+*   - Interpolate between the two returned slices
+*/
+void
+CollapseByInterpolation(idx2::volume* Vol, idx2::dimension D, double T);
+
+void
+CollapseSlices(const idx2::extent& Extent, output* Output);
+
+idx2::expected<idx2::v3i, idx2::idx2_err_code>
+DecodeOneFile(const std::string& InDir, // e.g., "/nobackupp19/vpascucc/converted_files" (an absolute or relative path that leads to the parent dir of the .idx2 file, can also simply be ".")
+              const input& Input, // see struct input above
+              output* Output,
+              idx2::decode_stats* Stats = nullptr, // if not null, receives the decode statistics
+              bool (*OnBrick)(void*) = nullptr, // see idx2::params::OnBrick
+              void* OnBrickData = nullptr)
+{
+  assert(Output != nullptr);
+
+  // First, we initialize the parameters
+  idx2::params P;
+  P.InputFile = Input.InFile.c_str();
+  P.InDir = InDir.c_str();
+  idx2::idx2_file Idx2;
+  idx2_CleanUp(Dealloc(&Idx2)); // clean up Idx2 automatically
+  P.DownsamplingFactor3 = Input.Downsampling3;
+  idx2_PropagateIfError(Init(&Idx2, P));
+
+  // Next, we compute the output grid
+  //Idx2.Accuracy = Accuracy;
+  P.DecodeAccuracy = Input.Accuracy;
+  if (idx2::Dims(Input.Extent) == idx2::v3i(0))
+    P.DecodeExtent = idx2::extent(Idx2.Dims3); // get the whole volume
+  else
+    P.DecodeExtent = Input.Extent;
+  Output->OutGrid = idx2::GetOutputGrid(Idx2, P);
+
+  // If there is an error target, select the bit planes to decode from the rate-distortion curves of the file
+  idx2::rd_curves Curves;
+  idx2::rd_truncation Truncation;
+  idx2_CleanUp(Dealloc(&Curves); Dealloc(&Truncation));
+  if (Input.TargetRmse > 0 || Input.TargetPsnr > 0 || Input.TargetMaxError > 0) {
+    std::string FileName = Input.InFile.c_str(); // InFile may be padded with zeros
+    size_t Dot = FileName.rfind(".idx2");
+    idx2_ReturnErrorIf(Dot == std::string::npos, idx2::idx2_err_code::FileNotFound, "%s is not an .idx2 file\n", FileName.c_str());
+    FileName.replace(Dot, std::string::npos, ".rd");
+    idx2_PropagateIfError(idx2::ReadRdCurves(FileName.c_str(), &Curves));
+    double TargetRmse = Input.TargetRmse > 0 ? Input.TargetRmse : idx2::traits<double>::Max;
+    if (Input.TargetPsnr > 0)
+      TargetRmse = idx2::Min(TargetRmse, (Idx2.ValueRange.Max - Idx2.ValueRange.Min) / pow(10.0, Input.TargetPsnr / 20));
+    if (Input.TargetMaxError > 0) {
+      idx2_PropagateIfError(idx2::SelectMaxErrorTruncation(Idx2, &Curves, P.DecodeExtent, Input.TargetMaxError, &Truncation));
+    } else {
+      idx2_PropagateIfError(idx2::SelectTruncation(Idx2, &Curves, P.DecodeExtent, TargetRmse, &Truncation));
+    }
+    P.DecodeAccuracy = 0;
+    P.Truncation = &Truncation;
+    Output->RmseEstimate = Truncation.Rmse;
+    Output->MaxErrorBound = Truncation.MaxError;
+  }
+
+  // If the output buffer is uninitialized, we allocate it
+  idx2::i64 MinBufSize = idx2::SizeOf(Idx2.DType) * idx2::Prod<idx2::i64>(idx2::Dims(Output->OutGrid));
+  if (!Output->OutBuffer && idx2::Dims(Output->OutGrid) > 0)
+    idx2::AllocBuf(&Output->OutBuffer, MinBufSize);
+  // If the output buffer is preallocated by the user, we check if it is too small
+  idx2_ReturnErrorIf(Output->OutBuffer.Bytes < MinBufSize, idx2::idx2_err_code::SizeTooSmall, "Output buffer is too small\n");
+
+  // Finally, we decode and return the queried data
+  P.OnBrick = OnBrick;
+  P.OnBrickData = OnBrickData;
+  P.CoLocatedChunks = Input.CoLocatedChunks;
+  idx2_PropagateIfError(idx2::Decode(&Idx2, P, &Output->OutBuffer, Stats)); // the output is stored in OutBuffer
+  Output->DataType = Idx2.DType;
+
+  // If the query is a slice but we return 2 slices, collapse them by linear interpolation
+  CollapseSlices(P.DecodeExtent, Output);
+
+  return Idx2.Dims3; // make sure to check for return error at call site
+}
+
+
+/* For every dimension where Extent is a slice (of size 1) but the output has 2 samples, replace
+the 2 samples by their linear interpolation at the position of the slice. This is done in place, so the
+output buffer (which may belong to the caller) is kept, with its first samples holding the result. */
+void
+CollapseSlices(const idx2::extent& Extent, output* Output)
+{
+  idx2::volume Vol(Output->OutBuffer, idx2::Dims(Output->OutGrid), Output->DataType);
+  idx2::v3i From3 = idx2::From(Output->OutGrid);
+  idx2::v3i Dims3 = idx2::Dims(Output->OutGrid);
+  for (int D = 2; D >= 0; --D) {
+    if (idx2::Dims(Extent)[D] == 1 && Dims3[D] == 2) {
+      double T = double(idx2::Frst(Extent)[D] - idx2::Frst(Output->OutGrid)[D]) / (idx2::Last(Output->OutGrid)[D] - idx2::Frst(Output->OutGrid)[D]);
+      idx2_Assert(T >= 0 && T <= 1);
+      CollapseByInterpolation(&Vol, idx2::dimension(D), T);
+      From3[D] = idx2::From(Extent)[D];
+      Dims3[D] = 1;
+    }
+  }
+  idx2::SetFrom(&Output->OutGrid, From3);
+  idx2::SetDims(&Output->OutGrid, Dims3);
+}
+
+
+template <typename t> static void
+CollapseByInterpolation(idx2::volume* Vol, idx2::dimension D, double T)
+{
+  idx2::extent E = idx2::extent(*Vol);
+  idx2::extent E1 = idx2::Slab(E, D, 1);
+  idx2::extent E2 = idx2::Slab(E, D, -1);
+  idx2_Assert(idx2::Dims(E1) == idx2::Dims(E2));
+  idx2::volume OutVol(Vol->Buffer, idx2::Dims(E1), Vol->Type); // aliases Vol
+
+  // Loop through the volume with E1 and E2, in the order of the output samples: each one is written
+  // at or before the positions of the two samples it is interpolated from, once these have been read
+  idx2::v3i D3 = idx2::Dims(E1);
+  for (idx2::v3i P = idx2::v3i(0); P.Z < D3.Z; ++P.Z) {
+    for (P.Y = 0; P.Y < D3.Y; ++P.Y) {
+      for (P.X = 0; P.X < D3.X; ++P.X) {
+        double V1 = Vol->At<t>(E1, P);
+        double V2 = Vol->At<t>(E2, P);
+        double V = V1 * (1 - T) + V2 * T; // T is the distance from the first sample
+        OutVol.At<t>(P) = t(V);
+      }
+    }
+  }
+  Vol->Dims = OutVol.Dims;
+}
+
+
+/* "Collapse" a dimension of a volume (from 2 to 1) by linear interpolation, in place */
+void
+CollapseByInterpolation(idx2::volume* Vol, idx2::dimension D, double T)
+{
+  idx2_Assert(T >= 0 && T <= 1);
+  idx2_Assert(idx2::Dims(*Vol)[D] == 2);
+  if (Vol->Type == idx2::dtype::float64)
+    CollapseByInterpolation<idx2::f64>(Vol, D, T);
+  else
+    CollapseByInterpolation<idx2::f32>(Vol, D, T);
+}
+
+idx2::grid
+GetGrid(const idx2::v3i& Dims3, const idx2::v3i& DownsamplingFactor3, const idx2::extent& Ext)
+{
+  auto CroppedExt = Crop(Ext, idx2::extent(Dims3));
+  idx2::v3i Strd3(1); // start with stride (1, 1, 1)
+  idx2_For(int, D, 0, 3)
+    Strd3[D] <<= DownsamplingFactor3[D];
+
+  idx2::v3i First3 = idx2::From(CroppedExt);
+  idx2::v3i Last3 = Last(CroppedExt);
+  Last3 = ((Last3 + Strd3 - 1) / Strd3) * Strd3; // move last to the right
+  First3 = (First3 / Strd3) * Strd3; // move first to the left
+
+  return idx2::grid(First3, (Last3 - First3) / Strd3 + 1, Strd3);
+}
+
+idx2::error<idx2::idx2_err_code>
+GetOutputGrid(const idx2::v3i& Dims3, // e.g., "/nobackupp19/vpascucc/converted_files" (an absolute or relative path that leads to the parent dir of the .idx2 file, can also simply be ".")
+              const input& Input, // see struct input above
+              idx2::grid* OutGrid)
+{
+  assert(OutGrid != nullptr);
+  if (idx2::Dims(Input.Extent) == idx2::v3i(0))
+    *OutGrid = GetGrid(Dims3, Input.Downsampling3, idx2::extent(Dims3));
+  else
+    *OutGrid = GetGrid(Dims3, Input.Downsampling3, Input.Extent);
+
+  return idx2_Error(idx2::idx2_err_code::NoError); // make sure to check for return error at call site
+}
+
+
+/* Read the region of Input from the preview of its file (written by the encoder when params::PreviewLevel >= 0),
+in one read. Only the extent of Input matters: the preview has a fixed resolution (stride 2^level in X and Y, the
+samples are averages over their cells) and is not compressed. The output grid is in the coordinates of the file. */
+idx2::error<idx2::idx2_err_code>
+ReadPreview(const input& Input, output* Output)
+{
+  std::string FileName = Input.InFile.c_str(); // InFile may be padded with zeros
+  size_t Dot = FileName.rfind(".idx2");
+  idx2_ReturnErrorIf(Dot == std::string::npos, idx2::idx2_err_code::FileNotFound, "%s is not an .idx2 file\n", FileName.c_str());
+  FileName.replace(Dot, std::string::npos, ".preview");
+
+  idx2::v3i From3 = idx2::From(Input.Extent), Dims3 = idx2::Dims(Input.Extent);
+  idx2::v3i PreviewDims3;
+  int Level = 0;
+  idx2::buffer Slice;
+  idx2_CleanUp(idx2::DeallocBuf(&Slice));
+  idx2_PropagateIfError(idx2::ReadPreviewSlice(FileName.c_str(), From3.Z, &PreviewDims3, &Level, &Slice));
+
+  /* the preview samples that cover the extent (the whole slice if the extent is empty) */
+  idx2::v3i First3(0, 0, From3.Z), Last3(PreviewDims3.X - 1, PreviewDims3.Y - 1, From3.Z);
+  if (Dims3 != idx2::v3i(0)) {
+    First3.X = idx2::Min(From3.X >> Level, PreviewDims3.X - 1);
+    First3.Y = idx2::Min(From3.Y >> Level, PreviewDims3.Y - 1);
+    Last3.X = idx2::Min((From3.X + Dims3.X - 1) >> Level, PreviewDims3.X - 1);
+    Last3.Y = idx2::Min((From3.Y + Dims3.Y - 1) >> Level, PreviewDims3.Y - 1);
+  }
+  idx2::v3i OutDims3(Last3.X - First3.X + 1, Last3.Y - First3.Y + 1, 1);
+  Output->OutGrid = idx2::grid(idx2::v3i(First3.X << Level, First3.Y << Level, From3.Z), OutDims3, idx2::v3i(1 << Level, 1 << Level, 1));
+  Output->DataType = idx2::dtype::float32;
+  idx2::i64 MinBufSize = sizeof(float) * idx2::Prod<idx2::i64>(OutDims3);
+  if (!Output->OutBuffer)
+    idx2::AllocBuf(&Output->OutBuffer, MinBufSize);
+  idx2_ReturnErrorIf(Output->OutBuffer.Bytes < MinBufSize, idx2::idx2_err_code::SizeTooSmall, "Output buffer is too small\n");
+  for (int Y = 0; Y < OutDims3.Y; ++Y) {
+    const float* Row = (const float*)Slice.Data + idx2::i64(First3.Y + Y) * PreviewDims3.X + First3.X;
+    memcpy((float*)Output->OutBuffer.Data + idx2::i64(Y) * OutDims3.X, Row, sizeof(float) * OutDims3.X);
+  }
+  return idx2_Error(idx2::idx2_err_code::NoError);
+}
+
+
+/* A cache of decoded file regions, shared by all the queries of the process.
+The key is the input of DecodeOneFile (directory, file, extent, downsampling and accuracy).
+It is disabled (MaxBytes = 0) unless SetQueryCacheSize is called, e.g., by a long-running server. */
+struct query_cache_entry
+{
+  idx2::grid OutGrid;
+  idx2::dtype DataType;
+  double RmseEstimate;
+  double MaxErrorBound;
+  idx2::v3i Dims3; // of the whole file
+  idx2::buffer Buffer;
+  std::list<std::string>::iterator Lru;
+};
+
+
+struct query_cache
+{
+  std::mutex Mutex;
+  idx2::i64 MaxBytes = 0;
+  idx2::i64 Bytes = 0;
+  idx2::i64 NHits = 0;
+  idx2::i64 NMisses = 0;
+  std::list<std::string> Lru; // the most recently used key first
+  std::unordered_map<std::string, query_cache_entry> Entries;
+};
+
+
+query_cache&
+GetQueryCache()
+{
+  static query_cache Cache;
+  return Cache;
+}
+
+
+static void
+EvictQueryCache(query_cache* Cache, idx2::i64 MaxBytes)
+{
+  while (Cache->Bytes > MaxBytes && !Cache->Lru.empty()) {
+    auto It = Cache->Entries.find(Cache->Lru.back());
+    Cache->Bytes -= It->second.Buffer.Bytes;
+    idx2::DeallocBuf(&It->second.Buffer);
+    Cache->Entries.erase(It);
+    Cache->Lru.pop_back();
+  }
+}
+
+
+void
+SetQueryCacheSize(idx2::i64 MaxBytes)
+{
+  query_cache& Cache = GetQueryCache();
+  std::lock_guard<std::mutex> Lock(Cache.Mutex);
+  Cache.MaxBytes = MaxBytes;
+  EvictQueryCache(&Cache, MaxBytes);
+}
+
+
+static std::string
+GetQueryCacheKey(const std::string& InDir, const input& Input)
+{
+  char Key[192];
+  idx2::v3i F3 = idx2::From(Input.Extent), D3 = idx2::Dims(Input.Extent), S3 = Input.Downsampling3;
+  snprintf(Key, sizeof(Key), "|%d %d %d|%d %d %d|%d %d %d|%.17g|%.17g %.17g %.17g", F3.X, F3.Y, F3.Z, D3.X, D3.Y, D3.Z, S3.X, S3.Y, S3.Z,
+           Input.Accuracy, Input.TargetRmse, Input.TargetPsnr, Input.TargetMaxError);
+  return InDir + "|" + Input.InFile.c_str() + Key; // InFile may be padded with zeros
+}
+
+
+/* DecodeOneFile, through the query cache */
+idx2::expected<idx2::v3i, idx2::idx2_err_code>
+DecodeOneFileCached(const std::string& InDir,
+                    const input& Input,
+                    output* Output,
+                    idx2::decode_stats* Stats,
+                    bool (*OnBrick)(void*) = nullptr,
+                    void* OnBrickData = nullptr)
+{
+  query_cache& Cache = GetQueryCache();
+  std::string Key;
+  {
+    std::lock_guard<std::mutex> Lock(Cache.Mutex);
+    if (Cache.MaxBytes > 0) {
+      Key = GetQueryCacheKey(InDir, Input);
+      auto It = Cache.Entries.find(Key);
+      if (It != Cache.Entries.end()) {
+        ++Cache.NHits;
+        query_cache_entry& E = It->second;
+        Cache.Lru.splice(Cache.Lru.begin(), Cache.Lru, E.Lru);
+        if (!Output->OutBuffer)
+          idx2::AllocBuf(&Output->OutBuffer, E.Buffer.Bytes);
+        idx2_ReturnErrorIf(Output->OutBuffer.Bytes < E.Buffer.Bytes, idx2::idx2_err_code::SizeTooSmall, "Output buffer is too small\n");
+        memcpy(Output->OutBuffer.Data, E.Buffer.Data, E.Buffer.Bytes);
+        Output->OutGrid = E.OutGrid;
+        Output->DataType = E.DataType;
+        Output->RmseEstimate = E.RmseEstimate;
+        Output->MaxErrorBound = E.MaxErrorBound;
+        return E.Dims3;
+      }
+      ++Cache.NMisses;
+    }
+  }
+  if (Key.empty()) // the cache is disabled (do not hold the lock while decoding)
+    return DecodeOneFile(InDir, Input, Output, Stats, OnBrick, OnBrickData);
+
+  /* decode without holding the lock, two tasks may then decode the same region (the second one is dropped) */
+  auto Result = DecodeOneFile(InDir, Input, Output, Stats, OnBrick, OnBrickData);
+  if (!Result)
+    return Result;
+  idx2::i64 Bytes = idx2::SizeOf(Output->DataType) * idx2::Prod<idx2::i64>(idx2::Dims(Output->OutGrid));
+  std::lock_guard<std::mutex> Lock(Cache.Mutex);
+  if (Bytes > Cache.MaxBytes || Cache.Entries.count(Key) > 0)
+    return Result;
+  EvictQueryCache(&Cache, Cache.MaxBytes - Bytes);
+  query_cache_entry E;
+  E.OutGrid = Output->OutGrid;
+  E.DataType = Output->DataType;
+  E.RmseEstimate = Output->RmseEstimate;
+  E.MaxErrorBound = Output->MaxErrorBound;
+  E.Dims3 = Value(Result);
+  idx2::AllocBuf(&E.Buffer, Bytes);
+  memcpy(E.Buffer.Data, Output->OutBuffer.Data, Bytes);
+  Cache.Lru.push_front(Key);
+  E.Lru = Cache.Lru.begin();
+  Cache.Entries[Key] = E;
+  Cache.Bytes += Bytes;
+  return Result;
+}
+
+
+idx2::error<idx2::idx2_err_code>
+RunQueryTask(const std::string& InDir,
+             const std::vector<std::pair<input, int>>& SortedInputs,
+             int Begin,
+             int I,
+             std::vector<output>* Outputs,
+             idx2::decode_stats* Stats,
+             bool (*OnBrick)(void*) = nullptr,
+             void* OnBrickData = nullptr)
+{
+  /* construct input and output for a single query */
+  idx2::extent Extent = SortedInputs[Begin].first.Extent;
+  for (int J = Begin; J < I; ++J) {
+    Extent = idx2::BoundingBox(Extent, SortedInputs[J].first.Extent); // accumulate extent
+  }
+  input Input;
+  Input.InFile = SortedInputs[Begin].first.InFile;
+  Input.Extent = Extent;
+  Input.Accuracy = SortedInputs[Begin].first.Accuracy;
+  Input.TargetRmse = SortedInputs[Begin].first.TargetRmse;
+  Input.TargetPsnr = SortedInputs[Begin].first.TargetPsnr;
+  Input.TargetMaxError = SortedInputs[Begin].first.TargetMaxError;
+  Input.Downsampling3 = SortedInputs[Begin].first.Downsampling3;
+  /* if the output belongs to a single query, decode directly into it (reusing its buffer if preallocated) */
+  const bool Single = I - Begin == 1;
+  output Output;
+  auto Result = DecodeOneFileCached(InDir, Input, Single ? &(*Outputs)[SortedInputs[Begin].second] : &Output, Stats,
+                                    OnBrick, OnBrickData);
+  if (!Result)
+    return Error(Result);
+  if (Single)
+    return idx2_Error(idx2::err_code::NoError);
+  idx2::v3i Dims3 = Value(Result);
+
+  /* now distribute the output, at the resolution that was decoded (Init caps the downsampling at the levels of the file) */
+  idx2::v3i DecodedStrd3 = idx2::Strd(Output.OutGrid);
+  idx2::v3i DecodedDs3(idx2::Log2Floor(DecodedStrd3.X), idx2::Log2Floor(DecodedStrd3.Y), idx2::Log2Floor(DecodedStrd3.Z));
+  for (int J = Begin; J < I; ++J) {
+    output& OutputJ = (*Outputs)[SortedInputs[J].second];
+    input InputJ = SortedInputs[J].first;
+    InputJ.Downsampling3 = DecodedDs3;
+    GetOutputGrid(Dims3, InputJ, &(OutputJ.OutGrid));
+    OutputJ.DataType = Output.DataType;
+    OutputJ.RmseEstimate = Output.RmseEstimate;
+    OutputJ.MaxErrorBound = Output.MaxErrorBound;
+    /* the decoded output may have already collapsed a slice that this query shares */
+    idx2::v3i From3 = idx2::From(OutputJ.OutGrid), Dims3J = idx2::Dims(OutputJ.OutGrid);
+    for (int D = 0; D < 3; ++D) {
+      if (idx2::Dims(Output.OutGrid)[D] == 1 && Dims3J[D] == 2) {
+        From3[D] = idx2::From(Output.OutGrid)[D];
+        Dims3J[D] = 1;
+      }
+    }
+    idx2::SetFrom(&OutputJ.OutGrid, From3);
+    idx2::SetDims(&OutputJ.OutGrid, Dims3J);
+
+    idx2::i64 MinBufSize = idx2::SizeOf(Output.DataType) * idx2::Prod<idx2::i64>(idx2::Dims(OutputJ.OutGrid));
+    if (!OutputJ.OutBuffer && idx2::Dims(OutputJ.OutGrid) > 0)
+      idx2::AllocBuf(&OutputJ.OutBuffer, MinBufSize);
+    // If the output buffer is preallocated by the user, we check if it is too small
+    // TODO: just automatically reallocate if necessary
+    idx2_ReturnErrorIf(OutputJ.OutBuffer.Bytes < MinBufSize, idx2::err_code::SizeTooSmall, "Output buffer is too small\n");
+
+    idx2::extent FromE = idx2::Relative(OutputJ.OutGrid, Output.OutGrid);
+    idx2::volume FromV = idx2::volume(Output.OutBuffer, idx2::Dims(Output.OutGrid), Output.DataType);
+    idx2::extent ToE   = idx2::extent(idx2::Dims(OutputJ.OutGrid));
+    idx2::volume ToV   = idx2::volume(OutputJ.OutBuffer, idx2::Dims(ToE), OutputJ.DataType);
+    if (Output.DataType == idx2::dtype::float32)
+      idx2::CopyExtentExtent<idx2::f32, idx2::f32>(FromE, FromV, ToE, &ToV);
+    else
+      idx2::CopyExtentExtent<idx2::f64, idx2::f64>(FromE, FromV, ToE, &ToV);
+    CollapseSlices(SortedInputs[J].first.Extent, &OutputJ);
+  }
+
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* Interactive tasks always run before batch tasks, and a batch task that is decoding runs the interactive tasks that
+arrive in the meantime before it moves on to its next brick (see RunInteractiveTasks) */
+enum class query_priority
+{
+  Interactive, // e.g., a user waiting for a slice on the screen
+  Batch // e.g., the extraction of every depth of a region
+};
+
+
+/* A task of the query pool. Within a priority class, the tasks are served by weighted fair queuing among their
+queries (flows): a task finishes (in virtual time) Cost / Weight after the later of the current virtual time and
+the finish of the previous task of its query, and the task that finishes first runs first. A query that submits
+many tasks then does not delay the other queries of its class by more than one task each. */
+struct query_task
+{
+  std::function<void()> Run;
+  const void* Flow = nullptr; // the query
+  double Length = 0; // Cost / Weight
+  double Finish = 0; // virtual finish time
+  idx2::u64 Seq = 0; // ties go to the oldest task
+
+  bool operator>(const query_task& Other) const
+  {
+    return Finish != Other.Finish ? Finish > Other.Finish : Seq > Other.Seq;
+  }
+};
+
+
+struct query_task_queue
+{
+  std::priority_queue<query_task, std::vector<query_task>, std::greater<query_task>> Tasks;
+  double VirtualTime = 0; // the finish time of the last task that started
+  std::unordered_map<const void*, double> LastFinish; // of the last queued task of every query with queued tasks
+};
+
+
+/* A fixed set of worker threads shared by all the queries (synchronous or not) */
+struct query_pool
+{
+  std::mutex Mutex;
+  std::condition_variable HasTask;
+  query_task_queue Queues[2]; // indexed by query_priority
+  std::atomic<int> NumInteractive = 0; // queued interactive tasks, read without the lock by RunInteractiveTasks
+  idx2::u64 NextSeq = 0;
+  std::vector<std::thread> Workers;
+  bool Stop = false;
+
+  query_pool(int NumWorkers)
+  {
+    for (int I = 0; I < NumWorkers; ++I) {
+      Workers.emplace_back([this]() {
+        while (true) {
+          std::function<void()> Task;
+          {
+            std::unique_lock<std::mutex> Lock(Mutex);
+            HasTask.wait(Lock, [this]() { return Stop || !Queues[0].Tasks.empty() || !Queues[1].Tasks.empty(); });
+            if (Stop)
+              return;
+            Task = PopTask(Queues[0].Tasks.empty() ? query_priority::Batch : query_priority::Interactive);
+          }
+          Task();
+        }
+      });
+    }
+  }
+
+  /* Call with the lock held */
+  std::function<void()> PopTask(query_priority Priority)
+  {
+    query_task_queue& Queue = Queues[int(Priority)];
+    query_task Task = Queue.Tasks.top();
+    Queue.Tasks.pop();
+    Queue.VirtualTime = Task.Finish;
+    if (Queue.Tasks.empty())
+      Queue.LastFinish.clear();
+    if (Priority == query_priority::Interactive)
+      --NumInteractive;
+    return std::move(Task.Run);
+  }
+
+  ~query_pool()
+  {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Stop = true;
+    }
+    HasTask.notify_all();
+    for (auto& W : Workers)
+      W.join();
+  }
+};
+
+
+query_pool&
+GetQueryPool()
+{
+  static query_pool Pool(idx2::Max(int(std::thread::hardware_concurrency()), 1));
+  return Pool;
+}
+
+
+/* Queue a task of the query Flow (any pointer that identifies it). Cost is what the task takes from the share of its
+query (e.g., the number of samples it decodes) and Weight the share, relative to the other queries of its class. */
+void
+PushTask(query_pool* Pool,
+         std::function<void()> Task,
+         query_priority Priority = query_priority::Interactive,
+         const void* Flow = nullptr,
+         double Cost = 1,
+         double Weight = 1)
+{
+  {
+    std::lock_guard<std::mutex> Lock(Pool->Mutex);
+    query_task_queue& Queue = Pool->Queues[int(Priority)];
+    double& LastFinish = Queue.LastFinish[Flow];
+    query_task T;
+    T.Run = std::move(Task);
+    T.Flow = Flow;
+    T.Length = Cost / idx2::Max(Weight, 1e-9);
+    T.Finish = idx2::Max(Queue.VirtualTime, LastFinish) + T.Length;
+    T.Seq = Pool->NextSeq++;
+    LastFinish = T.Finish;
+    Queue.Tasks.push(std::move(T));
+    if (Priority == query_priority::Interactive)
+      ++Pool->NumInteractive;
+  }
+  Pool->HasTask.notify_one();
+}
+
+
+/* Move the queued batch tasks of the query Flow to the interactive class, e.g., when a user starts to wait for a query
+that was submitted ahead of time. They are queued as if they were pushed now, in the same order. */
+void
+PromoteTasks(query_pool* Pool, const void* Flow)
+{
+  {
+    std::lock_guard<std::mutex> Lock(Pool->Mutex);
+    query_task_queue& Batch = Pool->Queues[int(query_priority::Batch)];
+    query_task_queue& Interactive = Pool->Queues[int(query_priority::Interactive)];
+    std::vector<query_task> Others;
+    while (!Batch.Tasks.empty()) {
+      query_task T = Batch.Tasks.top();
+      Batch.Tasks.pop();
+      if (T.Flow != Flow) {
+        Others.push_back(std::move(T));
+        continue;
+      }
+      double& LastFinish = Interactive.LastFinish[Flow];
+      T.Finish = idx2::Max(Interactive.VirtualTime, LastFinish) + T.Length;
+      LastFinish = T.Finish;
+      Interactive.Tasks.push(std::move(T));
+      ++Pool->NumInteractive;
+    }
+    for (query_task& T : Others)
+      Batch.Tasks.push(std::move(T));
+    Batch.LastFinish.erase(Flow);
+  }
+  Pool->HasTask.notify_all();
+}
+
+
+/* Run the queued interactive tasks on the calling thread, e.g., from a batch task between two bricks. This is how
+batch work is preempted: the interactive tasks do not wait for a worker to finish a whole file. */
+void
+RunInteractiveTasks(query_pool* Pool)
+{
+  while (Pool->NumInteractive > 0) {
+    std::function<void()> Task;
+    {
+      std::lock_guard<std::mutex> Lock(Pool->Mutex);
+      if (Pool->Queues[int(query_priority::Interactive)].Tasks.empty())
+        return;
+      Task = Pool->PopTask(query_priority::Interactive);
+    }
+    Task();
+  }
+}
+
+
+/* The trace of the queries of this process (see SetQueryTrace) */
+struct query_trace
+{
+  std::mutex Mutex;
+  FILE* Fp = nullptr;
+};
+
+
+static query_trace&
+GetQueryTrace()
+{
+  static query_trace Trace;
+  return Trace;
+}
+
+
+/* Append the inputs of every query of this process to FileName (nullptr stops the recording), one query per block:
+*   idx2-inputs 2
+*   in-dir <length> <string>
+*   input <length> <file> <from x y t> <dims x y t> <downsampling x y t> <accuracy> <target rmse> <target psnr> <target max error> (repeated)
+*   end
+* which is also the idx2-inputs request of idx2-remote.hpp. The trace can then be replayed, e.g., by idx2-layout.
+* Version 1 traces (without the target max error) can still be read. */
+idx2::error<idx2::idx2_err_code>
+SetQueryTrace(const char* FileName)
+{
+  query_trace& Trace = GetQueryTrace();
+  std::lock_guard<std::mutex> Lock(Trace.Mutex);
+  if (Trace.Fp)
+    fclose(Trace.Fp);
+  Trace.Fp = FileName ? fopen(FileName, "a") : nullptr;
+  idx2_ReturnErrorIf(FileName && !Trace.Fp, idx2::idx2_err_code::FileCreateFailed, "%s\n", FileName);
+  return idx2_Error(idx2::idx2_err_code::NoError);
+}
+
+
+static void
+TraceQuery(const std::string& InDir, const std::vector<input>& Inputs)
+{
+  query_trace& Trace = GetQueryTrace();
+  std::lock_guard<std::mutex> Lock(Trace.Mutex);
+  if (!Trace.Fp)
+    return;
+  fprintf(Trace.Fp, "idx2-inputs 2\nin-dir %zu %s\n", InDir.size(), InDir.c_str());
+  for (const input& In : Inputs) {
+    idx2::v3i F3 = idx2::From(In.Extent), D3 = idx2::Dims(In.Extent), S3 = In.Downsampling3;
+    std::string File = In.InFile.c_str(); // InFile may be padded with zeros
+    fprintf(Trace.Fp, "input %zu %s %d %d %d %d %d %d %d %d %d %.17g %.17g %.17g %.17g\n", File.size(), File.c_str(),
+            F3.X, F3.Y, F3.Z, D3.X, D3.Y, D3.Z, S3.X, S3.Y, S3.Z, In.Accuracy, In.TargetRmse, In.TargetPsnr, In.TargetMaxError);
+  }
+  fprintf(Trace.Fp, "end\n");
+  fflush(Trace.Fp);
+}
+
+
+/* Read a trace written by SetQueryTrace, the inputs of one query per element of Queries */
+idx2::error<idx2::idx2_err_code>
+ReadQueryTrace(const char* FileName, std::vector<std::vector<input>>* Queries)
+{
+  idx2::buffer Buf;
+  idx2_CleanUp(idx2::DeallocBuf(&Buf));
+  idx2_ReturnErrorIf(!idx2::ReadFile(FileName, &Buf), idx2::idx2_err_code::FileReadFailed, "%s\n", FileName);
+  std::istringstream Is(std::string((const char*)Buf.Data, Buf.Bytes));
+  auto ReadString = [&Is](std::string* Str) {
+    size_t Size = 0;
+    if (!(Is >> Size) || Is.get() != ' ')
+      return false;
+    Str->resize(Size);
+    return bool(Is.read(Str->data(), Size));
+  };
+  std::string Key, InDir;
+  int Version = 0;
+  while (Is >> Key) {
+    bool Ok = Key == "idx2-inputs" && (Is >> Version) && (Version == 1 || Version == 2);
+    Queries->emplace_back();
+    while (Ok && (Is >> Key) && Key != "end") {
+      if (Key == "in-dir") {
+        Ok = ReadString(&InDir);
+      } else if (Key == "input") {
+        input In;
+        idx2::v3i F3, D3;
+        idx2::v3i& S3 = In.Downsampling3;
+        Ok = ReadString(&In.InFile) &&
+             (Is >> F3.X >> F3.Y >> F3.Z >> D3.X >> D3.Y >> D3.Z >> S3.X >> S3.Y >> S3.Z >> In.Accuracy >> In.TargetRmse >> In.TargetPsnr) &&
+             (Version == 1 || (Is >> In.TargetMaxError));
+        In.Extent = idx2::extent(F3, D3);
+        Queries->back().push_back(In);
+      } else {
+        Ok = false;
+      }
+    }
+    idx2_ReturnErrorIf(!Ok || Key != "end", idx2::idx2_err_code::ParseFailed, "Cannot parse query %d of %s\n", int(Queries->size()), FileName);
+  }
+  return idx2_Error(idx2::idx2_err_code::NoError);
+}
+
+
+/* The state of a query running on the query pool, shared by the caller and the tasks of the query.
+Progress is called (on a worker thread) after each file is decoded, with the number of files done and the total.
+OnDone is called once (on a worker thread) when all the files are done, before Wait returns. */
+struct query_handle
+{
+  std::string InDir;
+  std::vector<input> Inputs;
+  std::vector<output> Outputs;
+  std::vector<output_metadata> OutputsMetadata; // only filled by SubmitQuery
+  std::vector<idx2::decode_stats> TaskStats; // one slot per task
+  std::function<void(int, int)> Progress;
+  std::function<void(query_handle*)> OnDone;
+  std::atomic<query_priority> Priority = query_priority::Interactive; // read by the tasks, see PromoteTasks
+  double Weight = 1; // the share of the query among the queries of its priority (see query_task)
+
+  idx2::timer Timer;
+  double Seconds = 0; // from StartQuery to the end of the query
+  int NumTasks = 0; // one task per file
+  std::atomic<int> NumDecoded = 0;
+  std::atomic<int> NumFinished = 0;
+  std::atomic<bool> Cancelled = false;
+
+  std::mutex Mutex;
+  std::condition_variable Finished;
+  bool Done = false;
+  idx2::idx2_err_code ErrCode = idx2::idx2_err_code::NoError; // of the first failed task (an idx2::error cannot cross threads)
+  std::string ErrMsg;
+};
+
+
+/* Tasks that have not started yet are skipped and the running ones stop at their next brick, the query then
+finishes with the Cancelled error */
+void
+Cancel(query_handle* Handle)
+{
+  Handle->Cancelled = true;
+}
+
+
+bool
+IsDone(query_handle* Handle)
+{
+  std::lock_guard<std::mutex> Lock(Handle->Mutex);
+  return Handle->Done;
+}
+
+
+idx2::error<idx2::idx2_err_code>
+Wait(query_handle* Handle)
+{
+  std::unique_lock<std::mutex> Lock(Handle->Mutex);
+  Handle->Finished.wait(Lock, [Handle]() { return Handle->Done; });
+  if (Handle->ErrCode != idx2::idx2_err_code::NoError)
+    return idx2_Error(Handle->ErrCode, "%s", Handle->ErrMsg.c_str());
+  return idx2_Error(idx2::idx2_err_code::NoError);
+}
+
+
+static void
+FinishQuery(query_handle* Handle)
+{
+  if (Handle->Cancelled && Handle->ErrCode == idx2::idx2_err_code::NoError)
+    Handle->ErrCode = idx2::idx2_err_code::Cancelled;
+  Handle->Seconds = idx2::Seconds(idx2::ElapsedTime(&Handle->Timer));
+  if (Handle->OnDone)
+    Handle->OnDone(Handle);
+  {
+    std::lock_guard<std::mutex> Lock(Handle->Mutex);
+    Handle->Done = true;
+  }
+  Handle->Finished.notify_all();
+}
+
+
+/* Called by the decoder of a task of the query Data before each brick: a batch task first runs the interactive tasks
+that are waiting */
+static bool
+OnQueryBrick(void* Data)
+{
+  query_handle* Handle = (query_handle*)Data;
+  if (Handle->Priority == query_priority::Batch)
+    RunInteractiveTasks(&GetQueryPool());
+  return !Handle->Cancelled;
+}
+
+
+/* Decode Handle->Inputs into Handle->Outputs on the query pool (one task per file and resolution) and return immediately */
+void
+StartQuery(const std::shared_ptr<query_handle>& Handle)
+{
+  idx2_Assert(Handle->Inputs.size() == Handle->Outputs.size());
+  idx2::StartTimer(&Handle->Timer);
+  TraceQuery(Handle->InDir, Handle->Inputs);
+
+  /* duplicate the file names so that we can sort them (but remember the original order for the outputs) */
+  const std::vector<input>& Inputs = Handle->Inputs;
+  auto SortedInputs = std::make_shared<std::vector<std::pair<input, int>>>(Inputs.size());
+  for (int I = 0; I < Inputs.size(); ++I) {
+    (*SortedInputs)[I] = std::make_pair(Inputs[I], I);
+  }
+  /* inputs of the same file are decoded together if they also share a resolution (e.g., not two viewports) */
+  auto Key = [](const input& In) {
+    const idx2::v3i& Ds3 = In.Downsampling3;
+    return std::tie(In.InFile, Ds3.X, Ds3.Y, Ds3.Z, In.Accuracy, In.TargetRmse, In.TargetPsnr, In.TargetMaxError);
+  };
+  std::sort(SortedInputs->begin(), SortedInputs->end(), [&Key](const auto& P1, const auto& P2) {
+    return Key(P1.first) < Key(P2.first);
+  });
+
+  std::vector<std::pair<int, int>> Ranges; // [Begin, End) ranges of SortedInputs that share a file and a resolution
+  int Begin = 0;
+  for (int I = 1; I <= SortedInputs->size(); ++I) {
+    if (I < SortedInputs->size() && Key((*SortedInputs)[I].first) == Key((*SortedInputs)[I - 1].first)) {
+      continue;
+    }
+    Ranges.push_back(std::make_pair(Begin, I));
+    Begin = I;
+  }
+  Handle->NumTasks = Ranges.size();
+  Handle->TaskStats.resize(Ranges.size());
+  if (Ranges.empty()) {
+    FinishQuery(Handle.get());
+    return;
+  }
+
+  query_pool& Pool = GetQueryPool();
+  for (int T = 0; T < Ranges.size(); ++T) {
+    /* the cost of a task is the number of samples it decodes, a proxy for the bytes of the chunks it reads */
+    double Cost = 0;
+    for (int I = Ranges[T].first; I < Ranges[T].second; ++I) {
+      const input& In = (*SortedInputs)[I].first;
+      idx2::v3i Ds3 = idx2::Max(In.Downsampling3, idx2::v3i(0));
+      idx2::i64 NSamples = idx2::Prod<idx2::i64>(idx2::Dims(In.Extent));
+      if (NSamples == 0) // the whole file, whose size is not known yet: count it as a large one
+        NSamples = idx2::i64(1) << 30;
+      Cost += double(NSamples) / (1 << (Ds3.X + Ds3.Y + Ds3.Z));
+    }
+    auto Task = [Handle, SortedInputs, T, Range = Ranges[T]]() {
+      if (!Handle->Cancelled) {
+        auto Result = RunQueryTask(Handle->InDir, *SortedInputs, Range.first, Range.second, &Handle->Outputs, &Handle->TaskStats[T],
+                                   OnQueryBrick, Handle.get());
+        if (!Result) {
+          std::lock_guard<std::mutex> Lock(Handle->Mutex);
+          if (Handle->ErrCode == idx2::idx2_err_code::NoError) {
+            Handle->ErrCode = Result.Code;
+            Handle->ErrMsg = idx2::ToString(Result);
+          }
+        }
+        /* report before counting the task as finished, so that OnDone comes after every Progress */
+        if (Handle->Progress)
+          Handle->Progress(++Handle->NumDecoded, Handle->NumTasks);
+      }
+      if (++Handle->NumFinished == Handle->NumTasks)
+        FinishQuery(Handle.get());
+    };
+    PushTask(&Pool, std::move(Task), Handle->Priority, Handle.get(), idx2::Max(Cost, 1.0), Handle->Weight);
+  }
+}
+
+
+/* Get potentially multiple faces at multiple depths */
+// how about this compared to caching the idx2 struct?
+idx2::error<idx2::idx2_err_code>
+DecodeMultipleFiles(const std::string& InDir,
+                    const std::vector<input>& Inputs,
+                    std::vector<output>* Outputs,
+                    idx2::decode_stats* Stats = nullptr, // if not null, receives the sum over all files
+                    query_priority Priority = query_priority::Interactive)
+{
+  idx2_Assert(!Inputs.empty(), "Input cannot be empty\n");
+  idx2_Assert(Inputs.size() == Outputs->size());
+
+  auto Handle = std::make_shared<query_handle>();
+  Handle->InDir = InDir;
+  Handle->Inputs = Inputs;
+  Handle->Priority = Priority;
+  std::swap(Handle->Outputs, *Outputs); // keep the buffers that the caller may have preallocated
+  StartQuery(Handle);
+  auto Result = Wait(Handle.get());
+  std::swap(Handle->Outputs, *Outputs);
+
+  if (Stats) {
+    for (const auto& S : Handle->TaskStats)
+      idx2::Add(Stats, S);
+  }
+
+  return Result;
+}
+
+
+/* [Begin, End) range (End is exclusive, hence the open bracket) */
+struct range
+{
+  int Begin = 0;
+  int End = 0;
+};
+
+
+/* Specify a face range as well as X and Y ranges within the faces. Useful for vertical slicing, for instance. */
+struct spatial_range
+{
+  int Face;
+  range XRange;
+  range YRange;
+  idx2::v3i Downsampling3 = idx2::v3i(-1); // in the coordinates of the face, (-1, -1, -1) means QueryInfo.Downsampling3
+  double Accuracy = 0; // 0 means QueryInfo.Accuracy
+};
+
+
+/* The coarsest level (stride 2^Level) at which Samples samples still give at least one sample per pixel.
+The decoder caps the level at the levels of the file (see idx2::Init). */
+int
+GetViewportLevel(int Samples, int Pixels)
+{
+  idx2_Assert(Pixels > 0);
+  int Level = 0;
+  while (Level < 30 && ((Samples - 1) >> (Level + 1)) + 1 >= Pixels)
+    ++Level;
+  return Level;
+}
+
+
+/* The relative order of Time/Face/Depth in the output buffer */
+enum class order
+{
+  DepthFaceTime, // Time varies fastest, then Face, then Depth
+  DepthTimeFace,
+  FaceTimeDepth,
+  FaceDepthTime,
+  TimeDepthFace,
+  TimeFaceDepth
+};
+
+
+enum class slice_type
+{
+  AlongX, AlongY, RotatedAlongX, RotatedAlongY
+};
+
+
+struct query_info
+{
+  /* Parameters, needs to be changed if the default values below do not apply */
+  std::string NameFormat = "llc2160/u-face-%d-depth-%d-time-%d-%d.idx2"; // TODO: create an API to change this
+  std::string InDir = "/nobackupp19/vpascucc/converted_files"; // contain the relative/absolute path to the NameFormat above // TODO: create an API to change this
+  int TimeGroup = 1024; // every 1024 time steps are grouped into one .idx2 file
+
+  /* The following needs to be initialized before a query_info can be used */
+  std::vector<spatial_range> SpatialRanges;
+  range TimeRange;
+  range DepthRange;
+  order Order = order::DepthFaceTime; // TODO: create an API to control this
+
+  idx2::v3i Downsampling3 = idx2::v3i(0);
+  double Accuracy = 0.01;
+  double TargetRmse = 0; // see input::TargetRmse
+  double TargetPsnr = 0;
+  double TargetMaxError = 0; // see input::TargetMaxError
+  query_priority Priority = query_priority::Interactive;
+
+  virtual const int N() const = 0;
+  virtual const int NumFaces() const = 0;
+  virtual const idx2::v3i* FaceDims3() const = 0; // get the dimensions of the faces
+
+
+  virtual void SetNameFormat(const std::string& NameFormat)
+  {
+    this->NameFormat = NameFormat;
+  }
+
+
+  virtual void SetInputDirectory(const std::string& InDir)
+  {
+    this->InDir = InDir;
+  }
+
+
+  virtual void SetTimeGroup(int TimeGroup)
+  {
+    this->TimeGroup = TimeGroup;
+  }
+
+
+  virtual void SetTimeRange(int TimeBegin, int TimeEnd)
+  {
+    TimeRange.Begin = TimeBegin;
+    TimeRange.End = TimeEnd;
+  }
+
+
+  virtual void SetDepthRange(int DepthBegin, int DepthEnd)
+  {
+    DepthRange.Begin = DepthBegin;
+    DepthRange.End = DepthEnd;
+  }
+
+
+  virtual void SetOrder(order Order)
+  {
+    this->Order = Order;
+  }
+
+  virtual void SetDownsamplingFactor(int DownsamplingX, int DownsamplingY, int DownsamplingTime)
+  {
+    this->Downsampling3 = idx2::v3i(DownsamplingX, DownsamplingY, DownsamplingTime);
+  }
+
+
+  virtual void SetAccuracy(double Accuracy)
+  {
+    this->Accuracy = Accuracy;
+  }
+
+
+  /* Batch queries (e.g., long extractions) only decode when no interactive query is waiting */
+  virtual void SetPriority(query_priority Priority)
+  {
+    this->Priority = Priority;
+  }
+
+
+  /* Decode the fewest bytes whose estimated root-mean-square error is at most TargetRmse (0 means use the accuracy
+  instead). This needs the .rd files that the encoder writes with params::RdCurves. */
+  virtual void SetTargetRmse(double TargetRmse)
+  {
+    this->TargetRmse = TargetRmse;
+  }
+
+
+  /* Same as SetTargetRmse, with the error as a peak signal-to-noise ratio (in dB) over the value range of each file */
+  virtual void SetTargetPsnr(double TargetPsnr)
+  {
+    this->TargetPsnr = TargetPsnr;
+  }
+
+
+  /* Decode the fewest bytes (as far as a greedy search finds) so that no sample is off by more than TargetMaxError,
+  which is guaranteed rather than estimated (see output::MaxErrorBound). This also needs the .rd files. */
+  virtual void SetTargetMaxError(double TargetMaxError)
+  {
+    this->TargetMaxError = TargetMaxError;
+  }
+
+
+  virtual void AddSpatialRange(int Face, int XBegin, int XEnd, int YBegin, int YEnd)
+  {
+    SpatialRanges.push_back(spatial_range{ Face, range{XBegin, XEnd}, range{YBegin, YEnd} });
+  }
+
+
+  /* Add a region of a face shown in a Width x Height pixel rectangle of the screen. The downsampling of the region
+  is the coarsest that still has one sample per pixel, so the output has about the size of the rectangle. Width and
+  Height are in the orientation of the screen (the faces after 2 are rotated, like for SetDownsamplingFactor).
+  PixelAccuracy is the error that does not change the color of a pixel, e.g., (VMax - VMin) / 256 for an 8-bit
+  colormap (0 means the accuracy of the query). Returns false (and adds nothing) if the rectangle has no pixels. */
+  virtual bool AddViewport(int Face, int XBegin, int XEnd, int YBegin, int YEnd, int Width, int Height, double PixelAccuracy = 0)
+  {
+    if (Width <= 0 || Height <= 0) {
+      printf("Viewport: %d x %d pixels is invalid\n", Width, Height);
+      return false;
+    }
+    if (Face > 2)
+      idx2::Swap(&Width, &Height);
+    spatial_range R{ Face, range{XBegin, XEnd}, range{YBegin, YEnd} };
+    R.Downsampling3 = idx2::v3i(GetViewportLevel(XEnd - XBegin, Width), GetViewportLevel(YEnd - YBegin, Height), 0);
+    R.Accuracy = PixelAccuracy;
+    SpatialRanges.push_back(R);
+    return true;
+  }
+
+
+  virtual void AddFace(int Face)
+  {
+    const idx2::v3i& D3 = FaceDims3()[Face];
+    SpatialRanges.push_back(spatial_range{ Face, range{0, D3.X}, range{0, D3.Y}});
+  }
+
+
+  virtual void AddFaceSlice(int Face, slice_type SliceType, int Position)
+  {
+    const idx2::v3i& D3 = FaceDims3()[Face];
+    if (SliceType == slice_type::AlongX)
+      SpatialRanges.push_back(spatial_range{ Face, range{0, D3.X}, range{Position, Position + 1}});
+    else if (SliceType == slice_type::AlongY)
+      SpatialRanges.push_back(spatial_range{ Face, range{Position, Position + 1}, range{0, D3.Y}});
+    else if (SliceType == slice_type::RotatedAlongX)
+      AddFaceSlice(Face, slice_type::AlongY, D3.X - Position);
+    else if (SliceType == slice_type::RotatedAlongY)
+      AddFaceSlice(Face, slice_type::AlongX, Position);
+  }
+
+
+  virtual bool Verify() const
+  {
+    for (const auto& R : SpatialRanges) {
+      if (R.XRange.Begin >= R.XRange.End) {
+        printf("X range: [%d %d) is invalid\n", R.XRange.Begin, R.XRange.End);
+        return false;
+      }
+      if (R.YRange.Begin >= R.YRange.End) {
+        printf("Y range: [%d %d) is invalid\n", R.YRange.Begin, R.YRange.End);
+        return false;
+      }
+    }
+
+    if (TimeRange.Begin >= TimeRange.End) {
+      printf("Time range: [%d %d) is invalid\n", TimeRange.Begin, TimeRange.End);
+      return false;
+    }
+
+    if (DepthRange.Begin >= DepthRange.End) {
+      printf("Depth range: [%d %d) is invalid\n", DepthRange.Begin, DepthRange.End);
+      return false;
+    }
+
+    return true;
+  }
+};
+
+
+struct llc_2160_query_info : public query_info
+{
+  virtual const int N() const override
+  {
+    return 2160; // TODO: allow the user to change thid
+  }
+
+
+  virtual const int NumFaces() const override
+  {
+    return 5;
+  }
+
+
+  virtual const idx2::v3i* FaceDims3() const override
+  {
+    static constexpr int N = 2160; // TODO: allow the user to change this
+    static constexpr idx2::v3i FaceDims3[5] = { idx2::v3i(N, 3 * N, 1),
+                                                idx2::v3i(N, 3 * N, 1),
+                                                idx2::v3i(N,     N, 1),
+                                                idx2::v3i(3 * N, N, 1),
+                                                idx2::v3i(3 * N, N, 1) };
+    return FaceDims3;
+  }
+
+
+  virtual bool Verify() const override
+  {
+    // TODO: write this (verify theat x and y are withiin the range)
+    return true;
+  }
+
+
+  int SkipCapFace(int F) const
+  {
+    if (F > 2)
+      return F + 1;
+    return F;
+  }
+};
+
+
+idx2::v3i GetStrides(int NumFaces, int NumDepths, int NumTimes, order Order)
+{
+  int FaceStride = 1, DepthStride = 1, TimeStride = 1;
+  switch (Order) {
+  case order::DepthFaceTime:
+    TimeStride = 1; FaceStride = NumTimes; DepthStride = NumFaces * NumTimes;
+    break;
+  case order::DepthTimeFace:
+    FaceStride = 1; TimeStride = NumFaces; DepthStride = NumTimes * NumFaces;
+    break;
+  case order::FaceDepthTime:
+    TimeStride = 1; DepthStride = NumTimes; FaceStride = NumDepths * NumTimes;
+    break;
+  case order::FaceTimeDepth:
+    DepthStride = 1; TimeStride = NumDepths; FaceStride = NumTimes * NumDepths;
+    break;
+  case order::TimeDepthFace:
+    FaceStride = 1; DepthStride = NumFaces; TimeStride = NumDepths * NumFaces;
+    break;
+  case order::TimeFaceDepth:
+    DepthStride = 1; FaceStride = NumDepths; TimeStride = NumFaces * NumDepths;
+    break;
+  default:
+    idx2_Assert(false);
+  }
+
+  return idx2::v3i(FaceStride, DepthStride, TimeStride);
+}
+
+
+/* Expand a query into one input per (face, depth, time), in the order given by QueryInfo.Order.
+TimeRange replaces QueryInfo.TimeRange (e.g., to get one frame of an animation). */
+void
+GetQueryInputs(const query_info& QueryInfo,
+               const range& TimeRange,
+               std::vector<input>* Inputs,
+               std::vector<output_metadata>* OutputsMetadata)
+{
+  const int NumDepths = QueryInfo.DepthRange.End - QueryInfo.DepthRange.Begin;
+  const int NumTimes = TimeRange.End - TimeRange.Begin;
+  const int NumFaces = QueryInfo.SpatialRanges.size();
+  Inputs->resize(NumDepths * NumFaces * NumTimes);
+  OutputsMetadata->resize(Inputs->size());
+  idx2::v3i Strides3 = GetStrides(NumFaces, NumDepths, NumTimes, QueryInfo.Order);
+  int FaceStride = Strides3.X;
+  int DepthStride = Strides3.Y;
+  int TimeStride = Strides3.Z;
+  for (int D = 0; D + QueryInfo.DepthRange.Begin < QueryInfo.DepthRange.End; ++D) {
+    int Depth = QueryInfo.DepthRange.Begin + D;
+    for (int F = 0; F < QueryInfo.SpatialRanges.size(); ++F) {
+      for (int T = 0; T + TimeRange.Begin < TimeRange.End; ++T) {
+        int Time = TimeRange.Begin + T;
+        int Index = T * TimeStride + F * FaceStride + D * DepthStride;
+        input& CurrentInput = (*Inputs)[Index];
+        const spatial_range& R = QueryInfo.SpatialRanges[F];
+        CurrentInput.Extent = idx2::extent(idx2::v3i(R.XRange.Begin, R.YRange.Begin, Time), idx2::v3i(R.XRange.End - R.XRange.Begin, R.YRange.End - R.YRange.Begin, 1));
+        int TimeBegin = Time / QueryInfo.TimeGroup;
+        int TimeEnd = TimeBegin + QueryInfo.TimeGroup;
+        int NameBytes = snprintf(nullptr, 0, QueryInfo.NameFormat.c_str(), R.Face, Depth, TimeBegin, TimeEnd);
+        CurrentInput.InFile.resize(NameBytes > 0 ? NameBytes + 1 : 1);
+        snprintf(CurrentInput.InFile.data(), CurrentInput.InFile.size(), QueryInfo.NameFormat.c_str(), R.Face, Depth, TimeBegin, TimeEnd);
+        CurrentInput.Accuracy = R.Accuracy > 0 ? R.Accuracy : QueryInfo.Accuracy;
+        CurrentInput.TargetRmse = QueryInfo.TargetRmse;
+        CurrentInput.TargetPsnr = QueryInfo.TargetPsnr;
+        CurrentInput.TargetMaxError = QueryInfo.TargetMaxError;
+        CurrentInput.Downsampling3 = QueryInfo.Downsampling3;
+        if (R.Downsampling3.X >= 0) {
+          CurrentInput.Downsampling3 = R.Downsampling3;
+        } else if (R.Face > 2) {
+          idx2::Swap(&CurrentInput.Downsampling3.X, &CurrentInput.Downsampling3.Y);
+        }
+
+        (*OutputsMetadata)[Index].Depth = Depth;
+        (*OutputsMetadata)[Index].Time = Time;
+        (*OutputsMetadata)[Index].Face = R.Face;
+      }
+    }
+  }
+}
+
+
+idx2::error<idx2::idx2_err_code>
+ExecuteQuery(const query_info& QueryInfo,
+             std::vector<output>* Outputs,
+             std::vector<output_metadata>* OutputsMetadata,
+             idx2::decode_stats* Stats = nullptr) // if not null, receives the decode statistics of the query
+{
+  idx2_ReturnErrorIf(!QueryInfo.Verify(), idx2::err_code::DimensionMismatched);
+  std::vector<input> Inputs;
+  GetQueryInputs(QueryInfo, QueryInfo.TimeRange, &Inputs, OutputsMetadata);
+  Outputs->resize(Inputs.size());
+  idx2_PropagateIfError(DecodeMultipleFiles(QueryInfo.InDir, Inputs, Outputs, Stats, QueryInfo.Priority));
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* The previews of the outputs of a query (see ReadPreview), e.g., to paint them while SubmitQuery decodes the
+full-quality outputs. The files are read in order, each in a single read. */
+idx2::error<idx2::idx2_err_code>
+GetQueryPreviews(const query_info& QueryInfo,
+                 std::vector<output>* Outputs,
+                 std::vector<output_metadata>* OutputsMetadata)
+{
+  idx2_ReturnErrorIf(!QueryInfo.Verify(), idx2::err_code::DimensionMismatched);
+  std::vector<input> Inputs;
+  GetQueryInputs(QueryInfo, QueryInfo.TimeRange, &Inputs, OutputsMetadata);
+  Outputs->resize(Inputs.size());
+  for (int I = 0; I < Inputs.size(); ++I)
+    idx2_PropagateIfError(ReadPreview(Inputs[I], &(*Outputs)[I]));
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* Same as ExecuteQuery, but returns as soon as the query is queued on the query pool.
+The results are in Handle->Outputs and Handle->OutputsMetadata once Wait(Handle) returns (or in OnDone). */
+std::shared_ptr<query_handle>
+SubmitQuery(const query_info& QueryInfo,
+            std::function<void(int, int)> Progress = nullptr,
+            std::function<void(query_handle*)> OnDone = nullptr)
+{
+  auto Handle = std::make_shared<query_handle>();
+  Handle->InDir = QueryInfo.InDir;
+  Handle->Progress = std::move(Progress);
+  Handle->OnDone = std::move(OnDone);
+  Handle->Priority = QueryInfo.Priority;
+  if (!QueryInfo.Verify()) {
+    Handle->ErrCode = idx2::idx2_err_code::DimensionMismatched;
+    FinishQuery(Handle.get());
+    return Handle;
+  }
+  GetQueryInputs(QueryInfo, QueryInfo.TimeRange, &Handle->Inputs, &Handle->OutputsMetadata);
+  Handle->Outputs.resize(Handle->Inputs.size());
+  StartQuery(Handle);
+  return Handle;
+}
+
+
+/* One time step (all the faces and depths of a query) of an animation */
+struct animation_frame
+{
+  int Time = 0;
+  bool Measured = false; // whether its decode time has been taken into account
+  std::shared_ptr<query_handle> Handle; // the frame is in Handle->Outputs once Wait(Handle) returns
+};
+
+
+/* Playback of a query through time.
+GetFrame(Time) returns the frame at Time and decodes the NumPrefetch frames after it (in Direction) in the background,
+as batch queries so that they do not slow down the frame being waited for (a prefetched frame is promoted to the
+priority of the query once GetFrame waits for it).
+NumPrefetch adapts to how long a frame takes to decode compared to how often GetFrame is called.
+When the user scrubs, the frames that fall outside of the prefetch window are cancelled, and their output buffers
+are reused for the next frames. */
+struct animation
+{
+  const query_info* QueryInfo = nullptr; // everything but the time range (must outlive the animation)
+  range TimeRange; // the time steps that can be prefetched
+  int Direction = 1; // 1 to play forward, -1 to play backward
+  int MaxPrefetch = 8;
+  int NumPrefetch = 1;
+
+  std::vector<animation_frame> Frames; // the frames in the prefetch window (decoded or not)
+  std::vector<std::shared_ptr<query_handle>> Retired; // cancelled frames whose tasks may still be running
+  std::vector<std::vector<output>> FreeOutputs; // the outputs of retired frames, to decode new frames into
+  idx2::timer FrameTimer;
+  bool Started = false;
+  double FrameSeconds = 0; // moving average of the time between two GetFrame calls
+  double DecodeSeconds = 0; // moving average of the time to decode one frame (with its files decoded in parallel)
+
+  virtual ~animation()
+  {
+    for (auto& F : Frames) // the handles live until their tasks finish
+      Cancel(F.Handle.get());
+  }
+};
+
+
+static bool
+InPrefetchWindow(const animation& Anim, int Current, int Time)
+{
+  int Offset = (Time - Current) * Anim.Direction;
+  return Offset >= 0 && Offset <= Anim.NumPrefetch;
+}
+
+
+static void
+SubmitFrame(animation* Anim, int Time, query_priority Priority)
+{
+  auto Handle = std::make_shared<query_handle>();
+  Handle->InDir = Anim->QueryInfo->InDir;
+  Handle->Priority = Priority;
+  GetQueryInputs(*Anim->QueryInfo, range{ Time, Time + 1 }, &Handle->Inputs, &Handle->OutputsMetadata);
+  /* output cannot be copied safely, so only reuse outputs that need no resizing */
+  while (!Anim->FreeOutputs.empty()) {
+    std::vector<output> Outputs = std::move(Anim->FreeOutputs.back());
+    Anim->FreeOutputs.pop_back();
+    if (Outputs.size() == Handle->Inputs.size()) {
+      std::swap(Handle->Outputs, Outputs);
+      break;
+    }
+  }
+  Handle->Outputs.resize(Handle->Inputs.size());
+  StartQuery(Handle);
+  Anim->Frames.push_back(animation_frame{ Time, false, Handle });
+}
+
+
+/* Move the outputs of the retired frames that have finished to the free list */
+static void
+RecycleFrames(animation* Anim)
+{
+  for (int I = 0; I < Anim->Retired.size();) {
+    if (IsDone(Anim->Retired[I].get())) {
+      if (Anim->FreeOutputs.size() <= Anim->MaxPrefetch)
+        Anim->FreeOutputs.push_back(std::move(Anim->Retired[I]->Outputs));
+      Anim->Retired.erase(Anim->Retired.begin() + I);
+    } else {
+      ++I;
+    }
+  }
+}
+
+
+/* Returns the frame at Time in Outputs, and prefetches the frames after it.
+The outputs are valid until the next call (the caller may take their buffers, they will then not be reused). */
+idx2::error<idx2::idx2_err_code>
+GetFrame(animation* Anim,
+         int Time,
+         std::vector<output>** Outputs,
+         const std::vector<output_metadata>** OutputsMetadata = nullptr)
+{
+  idx2_Assert(Anim->QueryInfo != nullptr);
+  idx2_ReturnErrorIf(!Anim->QueryInfo->Verify(), idx2::err_code::DimensionMismatched);
+
+  /* measure how often the frames are asked for */
+  if (Anim->Started) {
+    double Seconds = idx2::Seconds(idx2::ResetTimer(&Anim->FrameTimer));
+    Anim->FrameSeconds = Anim->FrameSeconds == 0 ? Seconds : 0.8 * Anim->FrameSeconds + 0.2 * Seconds;
+  } else {
+    idx2::StartTimer(&Anim->FrameTimer);
+    Anim->Started = true;
+  }
+
+  /* drop the stale frames (including the previous one, unless the animation is paused) */
+  for (int I = 0; I < Anim->Frames.size();) {
+    if (!InPrefetchWindow(*Anim, Time, Anim->Frames[I].Time)) {
+      Cancel(Anim->Frames[I].Handle.get());
+      Anim->Retired.push_back(Anim->Frames[I].Handle);
+      Anim->Frames.erase(Anim->Frames.begin() + I);
+    } else {
+      ++I;
+    }
+  }
+  RecycleFrames(Anim);
+
+  /* submit the frame if it was not prefetched, then the frames after it, so that they decode while we wait */
+  auto Frame = std::find_if(Anim->Frames.begin(), Anim->Frames.end(), [Time](const auto& F) { return F.Time == Time; });
+  if (Frame == Anim->Frames.end())
+    SubmitFrame(Anim, Time, Anim->QueryInfo->Priority);
+  for (int K = 1; K <= Anim->NumPrefetch; ++K) {
+    int T = Time + K * Anim->Direction;
+    if (T < Anim->TimeRange.Begin || T >= Anim->TimeRange.End)
+      break;
+    auto It = std::find_if(Anim->Frames.begin(), Anim->Frames.end(), [T](const auto& F) { return F.Time == T; });
+    if (It == Anim->Frames.end())
+      SubmitFrame(Anim, T, query_priority::Batch);
+  }
+
+  Frame = std::find_if(Anim->Frames.begin(), Anim->Frames.end(), [Time](const auto& F) { return F.Time == Time; });
+  query_handle* Handle = Frame->Handle.get();
+  if (Handle->Priority != Anim->QueryInfo->Priority) { // a prefetched frame (whose running tasks stop yielding)
+    Handle->Priority = Anim->QueryInfo->Priority;
+    PromoteTasks(&GetQueryPool(), Handle);
+  }
+  idx2_PropagateIfError(Wait(Handle));
+
+  /* prefetch enough frames to hide the time it takes to decode one */
+  if (!Frame->Measured) {
+    Frame->Measured = true;
+    idx2::i64 Nanosecs = 0;
+    for (const auto& S : Handle->TaskStats)
+      Nanosecs += S.TotalTime;
+    double Seconds = idx2::Seconds(Nanosecs) / idx2::Max(idx2::Min(int(GetQueryPool().Workers.size()), Handle->NumTasks), 1);
+    Anim->DecodeSeconds = Anim->DecodeSeconds == 0 ? Seconds : 0.8 * Anim->DecodeSeconds + 0.2 * Seconds;
+  }
+  if (Anim->FrameSeconds > 0)
+    Anim->NumPrefetch = idx2::Min(idx2::Max(int(std::ceil(Anim->DecodeSeconds / Anim->FrameSeconds)) + 1, 1), Anim->MaxPrefetch);
+
+  *Outputs = &Handle->Outputs;
+  if (OutputsMetadata)
+    *OutputsMetadata = &Handle->OutputsMetadata;
+  return idx2_Error(idx2::err_code::NoError);
+}
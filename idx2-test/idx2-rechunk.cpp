@@ -0,0 +1,991 @@
+// Re-chunking tool. Moves an encoded file to another layout (bricks per chunk, chunks per file, files per directory
+// and the grouping of levels, sub-levels and bit planes into files) without decoding it. The payload of a brick on
+// one bit plane of one sub-level (what WriteChunk appends to the chunk after the brick sizes) and the exponents of the
+// blocks of a brick do not depend on the layout, so they are copied byte for byte into the chunks of the new layout;
+// only the chunk headers (brick deltas and sizes), the chunk indexes at the end of the files and the zstd frames of
+// the exponent chunks are rebuilt. Nothing is entropy decoded or re-encoded, so this runs at the speed of the disk.
+// The chunk indexes of the source files are read first, then the output files are written in parallel on the query
+// pool, one task per group of output files that share source chunks, so that every source chunk is read once; a
+// task writes its chunks one at a time, and keeps a source chunk in memory only until its last brick is copied.
+// The truncation points of the quality levels (TruncationPoints/*.rdo) and the rate-distortion curves (.rd) are
+// measured per chunk and cannot be carried over: the output has neither (re-encode with --quality-levels or
+// --rd-curves to get them for the new layout). The tables of constant bricks at the end of the exponent chunks (see
+// params::ConstantBricks) are split among the chunks of the new layout, with the bricks renumbered. The preview
+// sidecar does not depend on the layout and is copied. The input can be a field co-located with others (see CoLocate): only the
+// chunks of this field are copied, and the output is not co-located.
+//
+// The output can also be a subset of the input, still without decoding anything:
+//   - a region (--first/--last, inclusive, in samples) keeps only the bricks that intersect it; the region is rounded
+//     out to the bricks of the coarsest level (so that every brick of the subset is the same brick as in the input,
+//     with the same neighbors in the same parent), and becomes the domain of the output (the bricks are renumbered);
+//   - a downsampling factor (--downsampling, as in the decoder) drops the levels and the sub-levels that a decode at
+//     that factor does not read; the output records the factor, and refuses to be decoded at a finer one;
+//   - an accuracy (--accuracy) drops the bit planes that a decode at that accuracy does not read, and becomes the
+//     accuracy of the output.
+// A decode of the subset (at a downsampling factor and an accuracy at least those given) is identical to the same
+// decode of the input restricted to the region. The preview covers the whole domain, so a region drops it.
+//
+// Usage: idx2-rechunk --input llc2160/u-face-2-depth-0-time-0-1024.idx2 --out-dir ./rechunked
+//                     [--in-dir .] (the directory that contains llc2160/, by default the parent of its directory)
+//                     [--bricks-per-chunk 64] [--chunks-per-file 256] [--files-per-dir 512]
+//                     [--group-levels true|false] [--group-sub-levels true|false] [--group-bit-planes true|false]
+//                     [--first 0 0 0] [--last 1023 1023 89] [--downsampling 1 1 0] [--accuracy 0.001]
+// The options left out keep the value of the input. The output is <out-dir>/llc2160/u-face-2-depth-0-time-0-1024.idx2
+// (the options printed by idx2-layout can be given as they are).
+#define idx2_Implementation
+#include "idx2-query.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <map>
+
+
+struct rechunk_config
+{
+  idx2::cstr Input = nullptr;
+  std::string InDir; // empty means the parent of the directory of Input
+  std::string OutDir;
+  int BricksPerChunk = 0; // 0 means the value of the input
+  int ChunksPerFile = 0;
+  int FilesPerDir = 0;
+  idx2::cstr GroupLevels = nullptr; // "true" or "false" (nullptr means the value of the input)
+  idx2::cstr GroupSubLevels = nullptr;
+  idx2::cstr GroupBitPlanes = nullptr;
+  idx2::v3i First3 = idx2::v3i(0); // the region to keep, in samples
+  idx2::v3i Last3 = idx2::v3i(-1); // (-1 means the last sample of the domain)
+  idx2::v3i Downsampling3 = idx2::v3i(-1); // (-1 means the one the input is stored for)
+  idx2::f64 Accuracy = 0; // 0 means the accuracy of the input
+};
+
+
+/* A chunk of a source file of brick data: the bricks of one chunk on one bit plane of one sub-level */
+struct source_chunk
+{
+  idx2::u64 Address = 0; // see GetChunkAddress
+  int File = 0; // in rechunk_job::SourceFiles
+  idx2::i64 Offset = 0;
+  idx2::i64 Size = 0;
+};
+
+
+/* The bricks of a source chunk that go to the output chunk of the bricks [BrickBegin, BrickEnd) of the output */
+struct chunk_piece
+{
+  int Chunk = 0; // in rechunk_job::SourceChunks
+  idx2::u64 BrickBegin = 0, BrickEnd = 0; // output bricks
+};
+
+
+struct output_file
+{
+  std::string Name;
+  std::vector<chunk_piece> Pieces;
+};
+
+
+/* A chunk of a source file of exponents. There is one for every chunk of every sub-level of a level, and it holds
+the exponents of all the bricks of the chunk (those inside the domain), in the order of the bricks. */
+struct exponent_chunk
+{
+  int File = -1; // in rechunk_job::SourceFiles (-1 if the file does not exist)
+  idx2::i64 Offset = 0;
+  idx2::i64 Size = 0;
+  int BrickBegin = 0, BrickEnd = 0; // in rechunk_job::Bricks[Level]
+};
+
+
+struct exponent_file
+{
+  std::string Name;
+  int Level = 0, SubLevel = 0;
+  int BrickBegin = 0, BrickEnd = 0; // in rechunk_job::OutputBricks[Level]
+};
+
+
+struct rechunk_job
+{
+  const idx2::idx2_file* In = nullptr;
+  const idx2::idx2_file* Out = nullptr;
+  idx2::v3i First3 = idx2::v3i(0); // the first sample of the output in the input
+  idx2::i16 MinBitPlane = idx2::traits<idx2::i16>::Min; // the bit planes below are not copied
+  std::vector<std::vector<idx2::u64>> Bricks; // per level, the bricks inside the domain in increasing order
+  std::vector<std::vector<std::pair<idx2::u64, idx2::u64>>> BrickMaps; // per level, (brick, output brick) of the bricks of the output, by brick
+  std::vector<std::vector<std::pair<idx2::u64, int>>> OutputBricks; // per level, (output brick, position in Bricks), by output brick
+  std::vector<std::string> SourceFiles;
+  std::vector<source_chunk> SourceChunks;
+  std::vector<std::vector<exponent_chunk>> ExponentChunks; // [Level * NSubLevels + SubLevel]
+  std::vector<std::vector<int>> ExponentChunksOfFile; // [source file] -> chunks of ExponentChunks[Level * NSubLevels + SubLevel]
+  std::vector<int> ExponentKeyOfFile; // [source file] -> Level * NSubLevels + SubLevel (-1 for files of brick data)
+  std::vector<output_file> OutputFiles;
+  std::vector<std::vector<int>> OutputGroups; // output files that share source chunks (written by the same task)
+  std::vector<exponent_file> ExponentFiles;
+  std::atomic<idx2::i64> BytesRead = 0;
+  std::atomic<idx2::i64> BytesWritten = 0;
+  std::atomic<idx2::i64> NChunksWritten = 0;
+};
+
+
+/* A source chunk split into the payloads of its bricks (see DecompressChunk) */
+struct parsed_chunk
+{
+  std::vector<idx2::byte> Bytes;
+  std::vector<idx2::u64> Bricks;
+  std::vector<idx2::i64> Offsets; // of the payloads in Bytes (one more than Bricks)
+  std::vector<std::pair<idx2::u64, int>> OutputBricks; // (output brick, position in Bricks) of those in the output, by output brick
+};
+
+
+/* The source chunks read by WriteOutputFiles, each kept until its last piece is written */
+struct source_chunk_cache
+{
+  std::map<int, int> NPiecesLeft;
+  std::map<int, parsed_chunk> Parsed;
+};
+
+
+/* The chunk that WriteOutputFile is assembling (its bricks come in any order) */
+struct output_chunk
+{
+  idx2::u64 Address = 0;
+  std::vector<idx2::u64> Bricks;
+  std::vector<idx2::i64> BrickSizes;
+  std::vector<idx2::i64> BrickOffsets; // in Payloads
+  std::vector<idx2::byte> Payloads;
+};
+
+
+/* Run Task(0), ..., Task(N - 1) on the query pool, return false (after printing the first error) if one fails */
+template <typename task> static bool
+RunOnPool(int N, const task& Task)
+{
+  using namespace idx2;
+  std::mutex Mutex;
+  std::condition_variable Finished;
+  int NumPending = N;
+  idx2_err_code ErrCode = idx2_err_code::NoError; // of the first failed task (an idx2::error cannot cross threads)
+  std::string ErrMsg;
+  for (int I = 0; I < N; ++I) {
+    PushTask(&GetQueryPool(), [&, I]() {
+      error<idx2_err_code> Result = Task(I);
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (!Result && ErrCode == idx2_err_code::NoError) {
+        ErrCode = Result.Code;
+        ErrMsg = ToString(Result);
+      }
+      if (--NumPending == 0)
+        Finished.notify_all();
+    });
+  }
+  std::unique_lock<std::mutex> Lock(Mutex);
+  Finished.wait(Lock, [&NumPending]() { return NumPending == 0; });
+  if (ErrCode != idx2_err_code::NoError)
+    fprintf(stderr, "%s\n", ErrMsg.c_str());
+  return ErrCode == idx2_err_code::NoError;
+}
+
+
+static idx2::i16
+BitPlaneFromAddress(idx2::u64 Address)
+{
+  return idx2::i16(idx2::i16((Address & 0xFFF) << 4) >> 4); // sign extend the 12 bits of GetChunkAddress
+}
+
+
+/* Read the chunk index at the end of a file of brick data (see FlushChunks), of which a co-located file (see
+CoLocate) holds the sizes of the chunks of all the fields at each address (the chunk of a field that has none is
+empty) */
+static idx2::error<idx2::idx2_err_code>
+ReadChunkIndex(rechunk_job* Job, int File, std::vector<source_chunk>* Chunks)
+{
+  using namespace idx2;
+  cstr FileName = Job->SourceFiles[File].c_str();
+  idx2_RAII(FILE*, Fp = fopen(FileName, "rb"), , if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2_err_code::FileNotFound, "%s", FileName);
+  idx2_FSeek(Fp, 0, SEEK_END);
+  i64 FileSize = idx2_FTell(Fp);
+  int NChunks = 0;
+  int ChunkAddrsSz = 0;
+  int ChunkSizesSz = 0;
+  idx2_ReturnErrorIf(FileSize < 3 * (i64)sizeof(int), idx2_err_code::ParseFailed, "%s", FileName);
+  ReadBackwardPOD(Fp, &NChunks);
+  ReadBackwardPOD(Fp, &ChunkAddrsSz);
+  idx2_ReturnErrorIf(NChunks <= 0 || ChunkAddrsSz <= 0 || ChunkAddrsSz > FileSize, idx2_err_code::ParseFailed, "%s", FileName);
+  idx2_RAII(buffer, CpresChunkAddrs, AllocBuf(&CpresChunkAddrs, ChunkAddrsSz), DeallocBuf(&CpresChunkAddrs));
+  ReadBackwardBuffer(Fp, &CpresChunkAddrs, ChunkAddrsSz);
+  idx2_RAII(bitstream, ChunkAddrsStream, );
+  DecompressBufZstd(CpresChunkAddrs, &ChunkAddrsStream);
+  ReadBackwardPOD(Fp, &ChunkSizesSz);
+  idx2_ReturnErrorIf(ChunkSizesSz <= 0 || ChunkSizesSz > FileSize, idx2_err_code::ParseFailed, "%s", FileName);
+  idx2_RAII(bitstream, ChunkSzsStream, InitWrite(&ChunkSzsStream, ChunkSizesSz));
+  ReadBackwardBuffer(Fp, &ChunkSzsStream.Stream, ChunkSizesSz);
+  InitRead(&ChunkSzsStream, ChunkSzsStream.Stream);
+  Job->BytesRead += 3 * sizeof(int) + ChunkAddrsSz + ChunkSizesSz;
+
+  int NFields = Job->In->CoLocated[0] ? Job->In->NCoLocatedFields : 1;
+  int Field = Job->In->CoLocated[0] ? Job->In->CoLocatedField : 0;
+  i64 Offset = 0;
+  for (int I = 0; I < NChunks; ++I) {
+    source_chunk Chunk;
+    Chunk.Address = ((const u64*)ChunkAddrsStream.Stream.Data)[I];
+    Chunk.File = File;
+    for (int F = 0; F < NFields; ++F) {
+      i64 Size = ReadVarByte(&ChunkSzsStream);
+      if (F == Field) {
+        Chunk.Offset = Offset;
+        Chunk.Size = Size;
+      }
+      Offset += Size;
+    }
+    if (Chunk.Size > 0)
+      Chunks->push_back(Chunk);
+  }
+  idx2_ReturnErrorIf(Size(ChunkSzsStream) != ChunkSizesSz, idx2_err_code::ParseFailed, "%s", FileName);
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+
+/* Read the chunk sizes at the end of a file of exponents (see FlushChunkExponents) */
+static idx2::error<idx2::idx2_err_code>
+ReadExponentIndex(rechunk_job* Job, int File)
+{
+  using namespace idx2;
+  cstr FileName = Job->SourceFiles[File].c_str();
+  std::vector<exponent_chunk>& Chunks = Job->ExponentChunks[Job->ExponentKeyOfFile[File]];
+  const std::vector<int>& ChunksOfFile = Job->ExponentChunksOfFile[File];
+  idx2_RAII(FILE*, Fp = fopen(FileName, "rb"), , if (Fp) fclose(Fp));
+  if (!Fp) { // the sub-level has no exponents (e.g., it is coded in the next level)
+    for (int C : ChunksOfFile)
+      Chunks[C].File = -1;
+    return idx2_Error(idx2_err_code::NoError);
+  }
+  idx2_FSeek(Fp, 0, SEEK_END);
+  i64 FileSize = idx2_FTell(Fp);
+  int S = 0; // total bytes of the encoded chunk sizes
+  idx2_ReturnErrorIf(FileSize < (i64)sizeof(int), idx2_err_code::ParseFailed, "%s", FileName);
+  ReadBackwardPOD(Fp, &S);
+  idx2_ReturnErrorIf(S <= 0 || S > FileSize, idx2_err_code::ParseFailed, "%s", FileName);
+  idx2_RAII(bitstream, ChunkEMaxSzsStream, InitWrite(&ChunkEMaxSzsStream, S));
+  ReadBackwardBuffer(Fp, &ChunkEMaxSzsStream.Stream, S);
+  InitRead(&ChunkEMaxSzsStream, ChunkEMaxSzsStream.Stream);
+  Job->BytesRead += sizeof(int) + S;
+  i64 Offset = 0;
+  size_t I = 0;
+  for (; Size(ChunkEMaxSzsStream) < S && I < ChunksOfFile.size(); ++I) {
+    exponent_chunk& Chunk = Chunks[ChunksOfFile[I]];
+    Chunk.File = File;
+    Chunk.Offset = Offset;
+    Chunk.Size = ReadVarByte(&ChunkEMaxSzsStream);
+    Offset += Chunk.Size;
+  }
+  idx2_ReturnErrorIf(I != ChunksOfFile.size() || Size(ChunkEMaxSzsStream) != S,
+                     idx2_err_code::ParseFailed,
+                     "%s does not have one chunk of exponents per chunk of bricks",
+                     FileName);
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+
+/* The output brick of a brick of a level, or false if the brick is not in the output */
+static bool
+OutputBrick(const rechunk_job& Job, int Level, idx2::u64 Brick, idx2::u64* Output)
+{
+  const auto& BrickMap = Job.BrickMaps[Level];
+  auto It = std::lower_bound(BrickMap.begin(), BrickMap.end(), std::make_pair(Brick, idx2::u64(0)));
+  if (It == BrickMap.end() || It->first != Brick)
+    return false;
+  *Output = It->second;
+  return true;
+}
+
+
+/* Read a source chunk and split it into the payloads of its bricks */
+static idx2::error<idx2::idx2_err_code>
+ReadSourceChunk(rechunk_job* Job, int Chunk, parsed_chunk* Parsed)
+{
+  using namespace idx2;
+  const source_chunk& C = Job->SourceChunks[Chunk];
+  cstr FileName = Job->SourceFiles[C.File].c_str();
+  idx2_RAII(FILE*, Fp = fopen(FileName, "rb"), , if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2_err_code::FileNotFound, "%s", FileName);
+  idx2_ReturnErrorIf(C.Size <= 0, idx2_err_code::ParseFailed, "%s", FileName);
+  Parsed->Bytes.assign(C.Size + sizeof(u64), 0); // the bit reader reads a word at a time
+  idx2_FSeek(Fp, C.Offset, SEEK_SET);
+  idx2_ReturnErrorIf(fread(Parsed->Bytes.data(), C.Size, 1, Fp) != 1, idx2_err_code::FileReadFailed, "%s", FileName);
+  Job->BytesRead += C.Size;
+
+  bitstream ChunkStream;
+  InitRead(&ChunkStream, buffer{ Parsed->Bytes.data(), C.Size });
+  int NBricks = (int)ReadVarByte(&ChunkStream);
+  idx2_ReturnErrorIf(NBricks <= 0, idx2_err_code::ParseFailed, "%s", FileName);
+  Parsed->Bricks.resize(NBricks);
+  Parsed->Offsets.resize(NBricks + 1);
+  u64 Brick = Parsed->Bricks[0] = ReadVarByte(&ChunkStream);
+  for (int I = 1; I < NBricks; ++I)
+    Parsed->Bricks[I] = Brick += ReadUnary(&ChunkStream) + 1;
+  SeekToNextByte(&ChunkStream);
+  for (int I = 0; I < NBricks; ++I)
+    Parsed->Offsets[I + 1] = ReadVarByte(&ChunkStream);
+  Parsed->Offsets[0] = Size(ChunkStream);
+  for (int I = 0; I < NBricks; ++I)
+    Parsed->Offsets[I + 1] += Parsed->Offsets[I];
+  idx2_ReturnErrorIf(Parsed->Offsets[NBricks] > C.Size, idx2_err_code::ParseFailed, "%s", FileName);
+
+  /* the bricks must be those of the chunk */
+  i8 Level = (C.Address >> 60) & 0xF;
+  u64 ChunkInLevel = (C.Address >> 18) & 0x3FFFFFFFFFFull;
+  int Shift = Log2Ceil(Job->In->BricksPerChunks[Level]);
+  idx2_ReturnErrorIf((Parsed->Bricks.front() >> Shift) != ChunkInLevel || (Parsed->Bricks.back() >> Shift) != ChunkInLevel,
+                     idx2_err_code::ParseFailed,
+                     "%s: the bricks of a chunk do not match its address",
+                     FileName);
+  Parsed->OutputBricks.clear();
+  for (int I = 0; I < NBricks; ++I) {
+    u64 Output = 0;
+    if (OutputBrick(*Job, Level, Parsed->Bricks[I], &Output))
+      Parsed->OutputBricks.emplace_back(Output, I);
+  }
+  std::sort(Parsed->OutputBricks.begin(), Parsed->OutputBricks.end());
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+
+/* Serialize a chunk the way WriteChunk does: number of bricks, brick deltas, brick sizes, then the payloads */
+static void
+SerializeChunk(const output_chunk& Chunk, idx2::bitstream* ChunkStream)
+{
+  using namespace idx2;
+  i64 NBricks = (i64)Chunk.Bricks.size();
+  std::vector<i64> Order(NBricks); // of the bricks, in increasing order
+  for (i64 I = 0; I < NBricks; ++I)
+    Order[I] = I;
+  std::sort(Order.begin(), Order.end(), [&Chunk](i64 A, i64 B) { return Chunk.Bricks[A] < Chunk.Bricks[B]; });
+  u64 BrickFirst = Chunk.Bricks[Order.front()], BrickLast = Chunk.Bricks[Order.back()];
+  Rewind(ChunkStream);
+  GrowToAccomodate(ChunkStream, (BrickLast - BrickFirst + 8) / 8 + 20 * NBricks + (i64)Chunk.Payloads.size() + 64);
+  WriteVarByte(ChunkStream, NBricks);
+  WriteVarByte(ChunkStream, BrickFirst);
+  for (i64 I = 1; I < NBricks; ++I)
+    WriteUnary(ChunkStream, u32(Chunk.Bricks[Order[I]] - Chunk.Bricks[Order[I - 1]] - 1));
+  FlushAndMoveToNextByte(ChunkStream);
+  for (i64 I : Order)
+    WriteVarByte(ChunkStream, Chunk.BrickSizes[I]);
+  for (i64 I : Order)
+    WriteBuffer(ChunkStream, buffer{ (byte*)Chunk.Payloads.data() + Chunk.BrickOffsets[I], Chunk.BrickSizes[I] });
+  Flush(ChunkStream);
+}
+
+
+/* Write one file of brick data of the output layout: its chunks, then the chunk index (see FlushChunks) */
+static idx2::error<idx2::idx2_err_code>
+WriteOutputFile(rechunk_job* Job, output_file* File, source_chunk_cache* Cache)
+{
+  using namespace idx2;
+  const idx2_file& Out = *Job->Out;
+  /* output chunk by output chunk (so the pieces of a chunk are consecutive), highest bit plane first, like the encoder */
+  auto Key = [Job, &Out](const chunk_piece& P) {
+    u64 Address = Job->SourceChunks[P.Chunk].Address;
+    i8 Level = (Address >> 60) & 0xF;
+    i8 SubLevel = (Address >> 12) & 0x3F;
+    return std::make_tuple(Level, P.BrickBegin >> Log2Ceil(Out.BricksPerChunks[Level]), SubLevel, -BitPlaneFromAddress(Address), P.BrickBegin);
+  };
+  std::sort(File->Pieces.begin(), File->Pieces.end(), [&Key](const chunk_piece& A, const chunk_piece& B) { return Key(A) < Key(B); });
+
+  FILE* Fp = nullptr; // created with the first chunk (the pieces may have no bricks at all)
+  idx2_CleanUp(if (Fp) fclose(Fp));
+  output_chunk Chunk;
+  idx2_RAII(bitstream, ChunkStream, InitWrite(&ChunkStream, 1 << 16));
+  idx2_RAII(bitstream, ChunkSizes, InitWrite(&ChunkSizes, 128));
+  array<u64> ChunkAddrs;
+  idx2_CleanUp(Dealloc(&ChunkAddrs));
+  auto WriteOutputChunk = [&]() {
+    SerializeChunk(Chunk, &ChunkStream);
+    if (!Fp) {
+      CreateFullDir(GetDirName(File->Name.c_str()));
+      Fp = fopen(File->Name.c_str(), "wb");
+      if (!Fp)
+        return false;
+    }
+    WriteBuffer(Fp, ToBuffer(ChunkStream));
+    GrowToAccomodate(&ChunkSizes, 4);
+    WriteVarByte(&ChunkSizes, Size(ChunkStream));
+    PushBack(&ChunkAddrs, Chunk.Address);
+    Job->BytesWritten += Size(ChunkStream);
+    ++Job->NChunksWritten;
+    Chunk.Bricks.clear();
+    Chunk.BrickSizes.clear();
+    Chunk.BrickOffsets.clear();
+    Chunk.Payloads.clear();
+    return true;
+  };
+
+  for (const chunk_piece& P : File->Pieces) {
+    auto ParsedIt = Cache->Parsed.find(P.Chunk);
+    if (ParsedIt == Cache->Parsed.end()) {
+      ParsedIt = Cache->Parsed.emplace(P.Chunk, parsed_chunk()).first;
+      idx2_PropagateIfError(ReadSourceChunk(Job, P.Chunk, &ParsedIt->second));
+    }
+    const parsed_chunk& Source = ParsedIt->second;
+    u64 Address = Job->SourceChunks[P.Chunk].Address;
+    i8 Level = (Address >> 60) & 0xF;
+    i8 SubLevel = (Address >> 12) & 0x3F;
+    i16 BitPlane = BitPlaneFromAddress(Address);
+    auto Begin = std::lower_bound(Source.OutputBricks.begin(), Source.OutputBricks.end(), std::make_pair(P.BrickBegin, 0));
+    auto End = std::lower_bound(Begin, Source.OutputBricks.end(), std::make_pair(P.BrickEnd, 0));
+    if (Begin != End) {
+      u64 ChunkAddress = GetChunkAddress(Out, Begin->first, Level, SubLevel, BitPlane);
+      if (!Chunk.Bricks.empty() && ChunkAddress != Chunk.Address)
+        idx2_ReturnErrorIf(!WriteOutputChunk(), idx2_err_code::FileCreateFailed, "%s", File->Name.c_str());
+      Chunk.Address = ChunkAddress;
+      for (auto It = Begin; It != End; ++It) {
+        int I = It->second;
+        Chunk.Bricks.push_back(It->first);
+        Chunk.BrickSizes.push_back(Source.Offsets[I + 1] - Source.Offsets[I]);
+        Chunk.BrickOffsets.push_back((i64)Chunk.Payloads.size());
+        Chunk.Payloads.insert(Chunk.Payloads.end(), Source.Bytes.begin() + Source.Offsets[I], Source.Bytes.begin() + Source.Offsets[I + 1]);
+      }
+    }
+    if (--Cache->NPiecesLeft[P.Chunk] == 0)
+      Cache->Parsed.erase(ParsedIt);
+  }
+  if (!Chunk.Bricks.empty())
+    idx2_ReturnErrorIf(!WriteOutputChunk(), idx2_err_code::FileCreateFailed, "%s", File->Name.c_str());
+  if (!Fp)
+    return idx2_Error(idx2_err_code::NoError);
+
+  /* the chunk index: chunk sizes, then the compressed chunk addresses, then the number of chunks */
+  Flush(&ChunkSizes);
+  WriteBuffer(Fp, ToBuffer(ChunkSizes));
+  WritePOD(Fp, (int)Size(ChunkSizes));
+  idx2_RAII(bitstream, CpresChunkAddrs, );
+  CompressBufZstd(ToBuffer(ChunkAddrs), &CpresChunkAddrs);
+  WriteBuffer(Fp, ToBuffer(CpresChunkAddrs));
+  WritePOD(Fp, (int)Size(CpresChunkAddrs));
+  WritePOD(Fp, (int)Size(ChunkAddrs));
+  Job->BytesWritten += Size(ChunkSizes) + Size(CpresChunkAddrs) + 3 * sizeof(int);
+  idx2_ReturnErrorIf(ferror(Fp), idx2_err_code::FileCreateFailed, "%s", File->Name.c_str());
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+
+/* Write a group of output files, reading each of their source chunks once */
+static idx2::error<idx2::idx2_err_code>
+WriteOutputFiles(rechunk_job* Job, const std::vector<int>& Files)
+{
+  source_chunk_cache Cache;
+  for (int F : Files) {
+    for (const chunk_piece& P : Job->OutputFiles[F].Pieces)
+      ++Cache.NPiecesLeft[P.Chunk];
+  }
+  for (int F : Files)
+    idx2_PropagateIfError(WriteOutputFile(Job, &Job->OutputFiles[F], &Cache));
+  return idx2_Error(idx2::idx2_err_code::NoError);
+}
+
+
+/* Read a source chunk of exponents, return the bytes of the exponents of one of its bricks. The table of constant
+bricks at the end of the chunk, if any (see WriteChunkExponents), goes to ConstantBricks as (brick in chunk, value). */
+static idx2::expected<idx2::i64, idx2::idx2_err_code>
+ReadExponentChunk(rechunk_job* Job,
+                  const exponent_chunk& Source,
+                  bool HasConstantBricks,
+                  std::vector<idx2::byte>* Exps,
+                  std::vector<std::pair<int, idx2::f64>>* ConstantBricks)
+{
+  using namespace idx2;
+  Exps->clear();
+  ConstantBricks->clear();
+  if (Source.Size == 0)
+    return i64(0);
+  cstr SourceName = Job->SourceFiles[Source.File].c_str();
+  idx2_RAII(FILE*, SourceFp = fopen(SourceName, "rb"), , if (SourceFp) fclose(SourceFp));
+  idx2_ReturnErrorIf(!SourceFp, idx2_err_code::FileNotFound, "%s", SourceName);
+  std::vector<byte> CompressedChunk(Source.Size);
+  idx2_FSeek(SourceFp, Source.Offset, SEEK_SET);
+  idx2_ReturnErrorIf(fread(CompressedChunk.data(), Source.Size, 1, SourceFp) != 1, idx2_err_code::FileReadFailed, "%s", SourceName);
+  Job->BytesRead += Source.Size;
+  i64 DecompressedSize = (i64)ZSTD_getFrameContentSize(CompressedChunk.data(), Source.Size);
+  idx2_ReturnErrorIf(DecompressedSize < 0 || (HasConstantBricks && DecompressedSize < 4),
+                     idx2_err_code::ParseFailed,
+                     "%s: the exponents of a chunk cannot be decompressed",
+                     SourceName);
+  idx2_RAII(bitstream, BrickEMaxesStream, );
+  DecompressBufZstd(buffer{ CompressedChunk.data(), Source.Size }, &BrickEMaxesStream);
+  if (HasConstantBricks) {
+    u32 NConstantBricks = 0;
+    memcpy(&NConstantBricks, BrickEMaxesStream.Stream.Data + DecompressedSize - 4, sizeof(NConstantBricks));
+    DecompressedSize -= 4 + 10 * i64(NConstantBricks);
+    idx2_ReturnErrorIf(DecompressedSize < 0, idx2_err_code::ParseFailed, "%s: the table of constant bricks of a chunk is truncated", SourceName);
+    const byte* Entry = BrickEMaxesStream.Stream.Data + DecompressedSize;
+    for (u32 I = 0; I < NConstantBricks; ++I, Entry += 10) {
+      u16 BrickInChunk = 0;
+      f64 Value = 0;
+      memcpy(&BrickInChunk, Entry, sizeof(BrickInChunk));
+      memcpy(&Value, Entry + 2, sizeof(Value));
+      ConstantBricks->emplace_back(BrickInChunk, Value);
+    }
+  }
+  int NBricks = Source.BrickEnd - Source.BrickBegin;
+  idx2_ReturnErrorIf(DecompressedSize < 0 || DecompressedSize % NBricks != 0,
+                     idx2_err_code::ParseFailed,
+                     "%s: the exponents of a chunk do not split into its bricks",
+                     SourceName);
+  Exps->assign(BrickEMaxesStream.Stream.Data, BrickEMaxesStream.Stream.Data + DecompressedSize);
+  return DecompressedSize / NBricks;
+}
+
+
+/* Write one file of exponents of the output layout (see WriteChunkExponents and FlushChunkExponents) */
+static idx2::error<idx2::idx2_err_code>
+WriteExponentFile(rechunk_job* Job, const exponent_file& File)
+{
+  using namespace idx2;
+  const idx2_file& Out = *Job->Out;
+  const std::vector<std::pair<u64, int>>& Bricks = Job->OutputBricks[File.Level];
+  const std::vector<exponent_chunk>& Chunks = Job->ExponentChunks[File.Level * Size(Job->In->Subbands) + File.SubLevel];
+  /* the source chunk of a brick (a position in Job->Bricks[Level]) */
+  auto ChunkOf = [&Chunks](int B) {
+    return int(std::upper_bound(Chunks.begin(), Chunks.end(), B, [](int B, const exponent_chunk& C) { return B < C.BrickEnd; }) - Chunks.begin());
+  };
+  std::map<int, int> NBricksLeft; // source chunk -> bricks of the file still to copy from it
+  for (int B = File.BrickBegin; B < File.BrickEnd; ++B)
+    ++NBricksLeft[ChunkOf(Bricks[B].second)];
+  int NMissing = 0;
+  for (const auto& ChunkBricks : NBricksLeft) {
+    idx2_Assert(ChunkBricks.first < (int)Chunks.size());
+    NMissing += Chunks[ChunkBricks.first].File < 0;
+  }
+  if (NMissing == (int)NBricksLeft.size())
+    return idx2_Error(idx2_err_code::NoError);
+  idx2_ReturnErrorIf(NMissing > 0, idx2_err_code::FileNotFound, "some exponents of %s", File.Name.c_str());
+
+  idx2_OpenMaybeExistingFile(Fp, File.Name.c_str(), "wb");
+  idx2_RAII(bitstream, ChunkEMaxesStream, ); // of an output chunk, compressed
+  idx2_RAII(bitstream, ChunkEMaxSzs, InitWrite(&ChunkEMaxSzs, 128));
+  struct source_exps
+  {
+    i64 BrickBytes = 0;
+    std::vector<byte> Exps;
+    std::vector<std::pair<int, f64>> ConstantBricks; // (brick in chunk, value), by brick
+  };
+  std::map<int, source_exps> SourceExps; // source chunk -> its exponents
+  std::vector<byte> OutputChunk;
+  bool HasConstantBricks = Job->In->ConstantBricks && File.Level == 0 && File.SubLevel == 0;
+  std::vector<std::pair<u16, f64>> OutputConstantBricks; // of the output chunk (its bricks come in order)
+  int ChunkShift = Log2Ceil(Out.BricksPerChunks[File.Level]);
+  u64 OutputChunkInLevel = Bricks[File.BrickBegin].first >> ChunkShift;
+  auto WriteOutputChunk = [&]() {
+    if (HasConstantBricks) { // the layout of WriteChunkExponents (a little-endian bit stream)
+      for (const auto& Cb : OutputConstantBricks) {
+        const byte* Entry = (const byte*)&Cb.first;
+        OutputChunk.insert(OutputChunk.end(), Entry, Entry + sizeof(u16));
+        Entry = (const byte*)&Cb.second;
+        OutputChunk.insert(OutputChunk.end(), Entry, Entry + sizeof(f64));
+      }
+      u32 N = (u32)OutputConstantBricks.size();
+      OutputChunk.insert(OutputChunk.end(), (const byte*)&N, (const byte*)&N + sizeof(N));
+      OutputConstantBricks.clear();
+    }
+    Rewind(&ChunkEMaxesStream);
+    CompressBufZstd(buffer{ OutputChunk.data(), (i64)OutputChunk.size() }, &ChunkEMaxesStream);
+    WriteBuffer(Fp, ToBuffer(ChunkEMaxesStream));
+    GrowToAccomodate(&ChunkEMaxSzs, 4);
+    WriteVarByte(&ChunkEMaxSzs, Size(ChunkEMaxesStream));
+    Job->BytesWritten += Size(ChunkEMaxesStream);
+    OutputChunk.clear();
+  };
+  for (int B = File.BrickBegin; B < File.BrickEnd; ++B) {
+    int C = ChunkOf(Bricks[B].second);
+    auto SourceIt = SourceExps.find(C);
+    if (SourceIt == SourceExps.end()) {
+      source_exps& Source = SourceExps[C];
+      auto BrickBytes = ReadExponentChunk(Job, Chunks[C], HasConstantBricks, &Source.Exps, &Source.ConstantBricks);
+      if (!BrickBytes)
+        return Error(BrickBytes);
+      Source.BrickBytes = Value(BrickBytes);
+      SourceIt = SourceExps.find(C);
+    }
+    u64 ChunkInLevel = Bricks[B].first >> ChunkShift;
+    if (ChunkInLevel != OutputChunkInLevel) {
+      WriteOutputChunk();
+      OutputChunkInLevel = ChunkInLevel;
+    }
+    const source_exps& Source = SourceIt->second;
+    const byte* BrickExps = Source.Exps.data() + (Bricks[B].second - Chunks[C].BrickBegin) * Source.BrickBytes;
+    OutputChunk.insert(OutputChunk.end(), BrickExps, BrickExps + Source.BrickBytes);
+    if (HasConstantBricks) {
+      int BrickInChunk = int(Job->Bricks[File.Level][Bricks[B].second] & (Job->In->BricksPerChunks[File.Level] - 1));
+      auto Cb = std::lower_bound(Source.ConstantBricks.begin(), Source.ConstantBricks.end(), std::make_pair(BrickInChunk, -traits<f64>::Max));
+      if (Cb != Source.ConstantBricks.end() && Cb->first == BrickInChunk)
+        OutputConstantBricks.emplace_back(u16(Bricks[B].first & (Out.BricksPerChunks[File.Level] - 1)), Cb->second);
+    }
+    if (--NBricksLeft[C] == 0)
+      SourceExps.erase(SourceIt);
+  }
+  WriteOutputChunk();
+  Flush(&ChunkEMaxSzs);
+  WriteBuffer(Fp, ToBuffer(ChunkEMaxSzs));
+  WritePOD(Fp, (int)Size(ChunkEMaxSzs));
+  Job->BytesWritten += Size(ChunkEMaxSzs) + sizeof(int);
+  idx2_ReturnErrorIf(ferror(Fp), idx2_err_code::FileCreateFailed, "%s", File.Name.c_str());
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+
+/* The bricks of every level that lie inside the domain (the ones the encoder writes exponents for), in order, and
+the bricks of the output (those inside the region) with their numbers in the output */
+static void
+ListBricks(rechunk_job* Job)
+{
+  using namespace idx2;
+  const idx2_file& In = *Job->In;
+  const idx2_file& Out = *Job->Out;
+  Job->Bricks.resize(In.NLevels);
+  Job->BrickMaps.resize(In.NLevels);
+  Job->OutputBricks.resize(In.NLevels);
+  for (int Level = 0; Level < In.NLevels; ++Level) {
+    std::vector<u64>& Bricks = Job->Bricks[Level];
+    const v3i& N3 = In.NBricks3s[Level];
+    Bricks.reserve(Prod<i64>(N3));
+    for (int Z = 0; Z < N3.Z; ++Z)
+      for (int Y = 0; Y < N3.Y; ++Y)
+        for (int X = 0; X < N3.X; ++X)
+          Bricks.push_back(GetLinearBrick(In, Level, v3i(X, Y, Z)));
+    std::sort(Bricks.begin(), Bricks.end());
+
+    /* the region starts on a brick of every level */
+    v3i First3 = Job->First3 / (In.BrickDims3 * Pow(In.GroupBrick3, Level));
+    const v3i& OutN3 = Out.NBricks3s[Level];
+    auto& BrickMap = Job->BrickMaps[Level];
+    BrickMap.reserve(Prod<i64>(OutN3));
+    for (int Z = 0; Z < OutN3.Z; ++Z)
+      for (int Y = 0; Y < OutN3.Y; ++Y)
+        for (int X = 0; X < OutN3.X; ++X)
+          BrickMap.emplace_back(GetLinearBrick(In, Level, First3 + v3i(X, Y, Z)), GetLinearBrick(Out, Level, v3i(X, Y, Z)));
+    std::sort(BrickMap.begin(), BrickMap.end());
+    auto& OutputBricks = Job->OutputBricks[Level];
+    OutputBricks.reserve(BrickMap.size());
+    for (const auto& Pair : BrickMap)
+      OutputBricks.emplace_back(Pair.second, int(std::lower_bound(Bricks.begin(), Bricks.end(), Pair.first) - Bricks.begin()));
+    std::sort(OutputBricks.begin(), OutputBricks.end());
+  }
+}
+
+
+/* Find the source files of exponents (in the order of their bricks) and the output files of exponents, for the
+sub-levels that the output keeps */
+static void
+PlanExponents(rechunk_job* Job)
+{
+  using namespace idx2;
+  const idx2_file& In = *Job->In;
+  const idx2_file& Out = *Job->Out;
+  int NSubLevels = (int)Size(In.Subbands);
+  Job->ExponentChunks.resize(In.NLevels * NSubLevels);
+  for (int Level = 0; Level < In.NLevels; ++Level) {
+    const std::vector<u64>& Bricks = Job->Bricks[Level];
+    const std::vector<std::pair<u64, int>>& OutputBricks = Job->OutputBricks[Level];
+    for (int SubLevel = 0; SubLevel < NSubLevels; ++SubLevel) {
+      if (!BitSet(In.DecodeSubbandMasks[Level], SubLevel))
+        continue;
+      int Key = Level * NSubLevels + SubLevel;
+      std::vector<exponent_chunk>& Chunks = Job->ExponentChunks[Key];
+      u64 LastFileId = traits<u64>::Max;
+      for (int B = 0; B < (int)Bricks.size();) {
+        int End = B + 1;
+        while (End < (int)Bricks.size() && (Bricks[End] >> Log2Ceil(In.BricksPerChunks[Level])) == (Bricks[B] >> Log2Ceil(In.BricksPerChunks[Level])))
+          ++End;
+        file_id FileId = ConstructFilePathExponents(In, Bricks[B], Level, SubLevel);
+        if (FileId.Id != LastFileId) {
+          Job->SourceFiles.emplace_back(FileId.Name.ConstPtr, FileId.Name.Size);
+          Job->ExponentChunksOfFile.emplace_back();
+          Job->ExponentKeyOfFile.push_back(Key);
+          LastFileId = FileId.Id;
+        }
+        Job->ExponentChunksOfFile.back().push_back((int)Chunks.size());
+        exponent_chunk Chunk;
+        Chunk.File = (int)Job->SourceFiles.size() - 1;
+        Chunk.BrickBegin = B;
+        Chunk.BrickEnd = End;
+        Chunks.push_back(Chunk);
+        B = End;
+      }
+      LastFileId = traits<u64>::Max;
+      for (int B = 0; B < (int)OutputBricks.size(); ++B) {
+        file_id FileId = ConstructFilePathExponents(Out, OutputBricks[B].first, Level, SubLevel);
+        if (FileId.Id != LastFileId) {
+          exponent_file File;
+          File.Name.assign(FileId.Name.ConstPtr, FileId.Name.Size);
+          File.Level = Level;
+          File.SubLevel = SubLevel;
+          File.BrickBegin = B;
+          Job->ExponentFiles.push_back(File);
+          LastFileId = FileId.Id;
+        }
+        Job->ExponentFiles.back().BrickEnd = B + 1;
+      }
+    }
+  }
+}
+
+
+/* Split the source chunks of brick data that the output keeps into pieces, one per output chunk they contribute to,
+grouped by output file (and the output files into groups that do not share source chunks) */
+static void
+PlanBrickData(rechunk_job* Job)
+{
+  using namespace idx2;
+  const idx2_file& In = *Job->In;
+  const idx2_file& Out = *Job->Out;
+  std::map<u64, int> OutputFileIndex; // file id -> position in Job->OutputFiles
+  std::vector<int> Parents; // union-find of the output files that share a source chunk
+  auto Find = [&Parents](int F) {
+    while (Parents[F] != F)
+      F = Parents[F] = Parents[Parents[F]];
+    return F;
+  };
+  auto Union = [&Parents, &Find](int A, int B) { Parents[Find(A)] = Find(B); };
+  std::vector<u64> OutputChunks; // of a source chunk
+  for (int C = 0; C < (int)Job->SourceChunks.size(); ++C) {
+    int Last = -1; // the output file of the previous piece of the chunk
+    u64 Address = Job->SourceChunks[C].Address;
+    i8 Level = (Address >> 60) & 0xF;
+    i8 SubLevel = (Address >> 12) & 0x3F;
+    i16 BitPlane = BitPlaneFromAddress(Address);
+    if (!BitSet(In.DecodeSubbandMasks[Level], SubLevel) || BitPlane < Job->MinBitPlane)
+      continue; // not in the output
+    u64 ChunkInLevel = (Address >> 18) & 0x3FFFFFFFFFFull;
+    u64 BrickBegin = ChunkInLevel << Log2Ceil(In.BricksPerChunks[Level]);
+    u64 BrickEnd = BrickBegin + In.BricksPerChunks[Level];
+    u64 OutBricksPerChunk = Out.BricksPerChunks[Level];
+    const auto& BrickMap = Job->BrickMaps[Level];
+    auto BrickIt = std::lower_bound(BrickMap.begin(), BrickMap.end(), std::make_pair(BrickBegin, u64(0)));
+    auto BrickEndIt = std::lower_bound(BrickIt, BrickMap.end(), std::make_pair(BrickEnd, u64(0)));
+    OutputChunks.clear();
+    for (; BrickIt != BrickEndIt; ++BrickIt)
+      OutputChunks.push_back(BrickIt->second / OutBricksPerChunk);
+    std::sort(OutputChunks.begin(), OutputChunks.end());
+    OutputChunks.erase(std::unique(OutputChunks.begin(), OutputChunks.end()), OutputChunks.end());
+    for (u64 OutputChunk : OutputChunks) {
+      u64 Begin = OutputChunk * OutBricksPerChunk, End = Begin + OutBricksPerChunk;
+      file_id FileId = ConstructFilePath(Out, Begin, Level, SubLevel, BitPlane);
+      auto It = OutputFileIndex.find(FileId.Id);
+      if (It == OutputFileIndex.end()) {
+        It = OutputFileIndex.emplace(FileId.Id, (int)Job->OutputFiles.size()).first;
+        Parents.push_back((int)Job->OutputFiles.size());
+        Job->OutputFiles.emplace_back();
+        Job->OutputFiles.back().Name.assign(FileId.Name.ConstPtr, FileId.Name.Size);
+      }
+      Job->OutputFiles[It->second].Pieces.push_back(chunk_piece{ C, Begin, End });
+      if (Last >= 0)
+        Union(Last, It->second);
+      Last = It->second;
+    }
+  }
+  std::map<int, int> GroupIndex; // root -> position in Job->OutputGroups
+  for (int F = 0; F < (int)Job->OutputFiles.size(); ++F) {
+    auto It = GroupIndex.emplace(Find(F), (int)Job->OutputGroups.size()).first;
+    if (It->second == (int)Job->OutputGroups.size())
+      Job->OutputGroups.emplace_back();
+    Job->OutputGroups[It->second].push_back(F);
+  }
+}
+
+
+static bool
+ParseBool(idx2::cstr Str, bool* Val)
+{
+  if (strcmp(Str, "true") == 0)
+    *Val = true;
+  else if (strcmp(Str, "false") == 0)
+    *Val = false;
+  else
+    return false;
+  return true;
+}
+
+
+int
+main(int Argc, const char** Argv)
+{
+  using namespace idx2;
+  rechunk_config Config;
+  cstr Str = nullptr;
+  if (!OptVal(Argc, Argv, "--input", &Config.Input) || !OptVal(Argc, Argv, "--out-dir", &Str)) {
+    fprintf(stderr, "Usage: idx2-rechunk --input file.idx2 --out-dir dir [--bricks-per-chunk n] [--chunks-per-file n] [other options, see idx2-rechunk.cpp]\n");
+    return 1;
+  }
+  Config.OutDir = Str;
+  Config.InDir = std::filesystem::path(Config.Input).parent_path().parent_path().string();
+  if (OptVal(Argc, Argv, "--in-dir", &Str))
+    Config.InDir = Str;
+  if (Config.InDir.empty())
+    Config.InDir = ".";
+  OptVal(Argc, Argv, "--bricks-per-chunk", &Config.BricksPerChunk);
+  OptVal(Argc, Argv, "--chunks-per-file", &Config.ChunksPerFile);
+  OptVal(Argc, Argv, "--files-per-dir", &Config.FilesPerDir);
+  OptVal(Argc, Argv, "--group-levels", &Config.GroupLevels);
+  OptVal(Argc, Argv, "--group-sub-levels", &Config.GroupSubLevels);
+  OptVal(Argc, Argv, "--group-bit-planes", &Config.GroupBitPlanes);
+  OptVal(Argc, Argv, "--first", &Config.First3);
+  OptVal(Argc, Argv, "--last", &Config.Last3);
+  OptVal(Argc, Argv, "--downsampling", &Config.Downsampling3);
+  OptVal(Argc, Argv, "--accuracy", &Config.Accuracy);
+
+  /* the input (with the sub-levels to keep), and the output with the new layout */
+  idx2_file Out;
+  idx2_CleanUp(Dealloc(&Out));
+  auto Result = ReadMetaFile(&Out, Config.Input);
+  if (!Result) {
+    fprintf(stderr, "%s\n", ToString(Result));
+    return 1;
+  }
+  Out.FastDir[0] = 0; // the output is on one tier (idx2-tier can place it on two)
+  params P;
+  P.InputFile = Config.Input;
+  P.InDir = Config.InDir.c_str();
+  P.DownsamplingFactor3 = Config.Downsampling3 >= v3i(0) ? Config.Downsampling3 : Out.MinDownsampling3;
+  idx2_file In;
+  idx2_CleanUp(Dealloc(&In));
+  Result = Init(&In, P);
+  if (!Result) {
+    fprintf(stderr, "%s\n", ToString(Result));
+    return 1;
+  }
+  v3i Last3 = Config.Last3;
+  for (int D = 0; D < 3; ++D) {
+    if (Last3[D] < 0)
+      Last3[D] = In.Dims3[D] - 1;
+  }
+  if (!(Config.First3 >= v3i(0)) || !(Last3 >= Config.First3) || !(In.Dims3 > Last3)) {
+    fprintf(stderr, "the region [%d %d %d, %d %d %d] is not inside the domain %d %d %d\n",
+            idx2_PrV3i(Config.First3), idx2_PrV3i(Last3), idx2_PrV3i(In.Dims3));
+    return 1;
+  }
+  v3i CoarsestBrick3 = In.BrickDims3 * Pow(In.GroupBrick3, In.NLevels - 1);
+  v3i First3 = (Config.First3 / CoarsestBrick3) * CoarsestBrick3;
+  Last3 = Min((Last3 / CoarsestBrick3 + 1) * CoarsestBrick3, In.Dims3) - 1;
+  bool Subset = First3 != v3i(0) || Last3 + 1 != In.Dims3;
+  SetDimensions(&Out, Last3 - First3 + 1);
+  Out.MinDownsampling3 = P.DownsamplingFactor3;
+  SetAccuracy(&Out, Max(In.Accuracy, Config.Accuracy));
+  bool GroupLevels = Out.GroupLevels, GroupSubLevels = Out.GroupSubLevels, GroupBitPlanes = Out.GroupBitPlanes;
+  if ((Config.GroupLevels && !ParseBool(Config.GroupLevels, &GroupLevels)) ||
+      (Config.GroupSubLevels && !ParseBool(Config.GroupSubLevels, &GroupSubLevels)) ||
+      (Config.GroupBitPlanes && !ParseBool(Config.GroupBitPlanes, &GroupBitPlanes))) {
+    fprintf(stderr, "the --group-* options take true or false\n");
+    return 1;
+  }
+  if (Config.BricksPerChunk > 0)
+    SetBricksPerChunk(&Out, Config.BricksPerChunk);
+  if (Config.ChunksPerFile > 0)
+    SetChunksPerFile(&Out, Config.ChunksPerFile);
+  if (Config.FilesPerDir > 0)
+    SetFilesPerDirectory(&Out, Config.FilesPerDir);
+  SetGroupLevels(&Out, GroupLevels);
+  SetGroupSubLevels(&Out, GroupSubLevels);
+  SetGroupBitPlanes(&Out, GroupBitPlanes);
+  bool HadQualityLevels = Size(Out.QualityLevelsIn) > 0;
+  Clear(&Out.QualityLevelsIn); // the truncation points are per chunk, they do not survive
+  bool WasCoLocated = Out.CoLocated[0] != 0;
+  Out.CoLocated[0] = 0; // only the chunks of this field are copied
+  Out.CoLocatedField = Out.NCoLocatedFields = 0;
+  SetDir(&Out, Config.OutDir.c_str());
+  Result = Finalize(&Out, P);
+  if (!Result) {
+    fprintf(stderr, "%s\n", ToString(Result));
+    if (Subset && Result.Code == idx2_err_code::TooManyLevels)
+      fprintf(stderr, "the region is too small for the %d levels of the input\n", In.NLevels);
+    return 1;
+  }
+  std::filesystem::path InField = std::filesystem::path(In.Dir) / In.Name / In.Field;
+  std::filesystem::path OutField = std::filesystem::path(Out.Dir) / Out.Name / Out.Field;
+  std::error_code Ec;
+  if (std::filesystem::exists(OutField) && std::filesystem::equivalent(InField, OutField, Ec)) {
+    fprintf(stderr, "the output directory must differ from the input directory\n");
+    return 1;
+  }
+  std::filesystem::remove_all(OutField, Ec); // the files are written from scratch
+  printf("%s: %d bricks per chunk, %d chunks per file, %d files per directory, group levels/sub-levels/bit planes %d%d%d\n",
+         Config.Input, In.BricksPerChunkIn, In.ChunksPerFileIn, In.FilesPerDir, In.GroupLevels, In.GroupSubLevels, In.GroupBitPlanes);
+  printf("%s: %d bricks per chunk, %d chunks per file, %d files per directory, group levels/sub-levels/bit planes %d%d%d\n",
+         (OutField.string() + ".idx2").c_str(), Out.BricksPerChunkIn, Out.ChunksPerFileIn, Out.FilesPerDir, Out.GroupLevels, Out.GroupSubLevels, Out.GroupBitPlanes);
+  if (Subset)
+    printf("region [%d %d %d, %d %d %d] of %d %d %d (rounded out to the bricks of level %d)\n",
+           idx2_PrV3i(First3), idx2_PrV3i(Last3), idx2_PrV3i(In.Dims3), In.NLevels - 1);
+  if (Out.MinDownsampling3 != v3i(0) || Out.Accuracy != In.Accuracy)
+    printf("downsampling %d %d %d and accuracy %g and above only\n", idx2_PrV3i(Out.MinDownsampling3), Out.Accuracy);
+  if (HadQualityLevels)
+    printf("note: the quality levels of the input are dropped (their truncation points are per chunk)\n");
+  if (WasCoLocated)
+    printf("note: the input is co-located with other fields in %s, the output is not\n", In.CoLocated);
+
+  timer Timer;
+  StartTimer(&Timer);
+  rechunk_job Job;
+  Job.In = &In;
+  Job.Out = &Out;
+  Job.First3 = First3;
+  if (Out.Accuracy > 0) // the decoder stops at the first bit plane that the accuracy does not need (see DecodeSubband)
+    Job.MinBitPlane = i16(idx2_BitSizeOf(u64) - 7 + Exponent(Out.Accuracy));
+  ListBricks(&Job);
+  PlanExponents(&Job);
+  int NExponentFiles = (int)Job.SourceFiles.size();
+  std::filesystem::path InData = std::filesystem::path(In.Dir) / In.Name / GetDataField(In) / "BrickData";
+  std::vector<std::filesystem::path> DataDirs = { InData };
+  if (In.FastDir[0]) // the input is on two tiers
+    DataDirs.push_back(std::filesystem::path(In.FastDir) / In.Name / In.Field / "BrickData");
+  for (const auto& DataDir : DataDirs) {
+    std::error_code DirEc;
+    for (std::filesystem::recursive_directory_iterator It(DataDir, DirEc), End; !DirEc && It != End; It.increment(DirEc)) {
+      if (It->is_regular_file() && It->path().extension() == ".bin") {
+        Job.SourceFiles.push_back(It->path().string());
+        Job.ExponentKeyOfFile.push_back(-1);
+      }
+    }
+  }
+  int NDataFiles = (int)Job.SourceFiles.size() - NExponentFiles;
+  if (NDataFiles == 0) {
+    fprintf(stderr, "no brick data in %s\n", InData.string().c_str());
+    return 1;
+  }
+
+  /* read the indexes of all the source files */
+  std::vector<std::vector<source_chunk>> ChunksOfFile(NDataFiles);
+  bool Ok = RunOnPool(NExponentFiles + NDataFiles, [&Job, &ChunksOfFile, NExponentFiles](int I) {
+    if (I < NExponentFiles)
+      return ReadExponentIndex(&Job, I);
+    return ReadChunkIndex(&Job, I, &ChunksOfFile[I - NExponentFiles]);
+  });
+  if (!Ok)
+    return 1;
+  for (const auto& Chunks : ChunksOfFile)
+    Job.SourceChunks.insert(Job.SourceChunks.end(), Chunks.begin(), Chunks.end());
+  PlanBrickData(&Job);
+  double IndexSeconds = Seconds(ElapsedTime(&Timer));
+
+  /* write the output files */
+  int NOutputFiles = (int)Job.OutputFiles.size();
+  int NOutputGroups = (int)Job.OutputGroups.size();
+  int NOutputExponentFiles = (int)Job.ExponentFiles.size();
+  Ok = RunOnPool(NOutputGroups + NOutputExponentFiles, [&Job, NOutputGroups](int I) {
+    if (I < NOutputGroups)
+      return WriteOutputFiles(&Job, Job.OutputGroups[I]);
+    return WriteExponentFile(&Job, Job.ExponentFiles[I - NOutputGroups]);
+  });
+  if (!Ok)
+    return 1;
+  snprintf(P.Meta.Name, sizeof(P.Meta.Name), "%s", Out.Name);
+  snprintf(P.Meta.Field, sizeof(P.Meta.Field), "%s", Out.Field);
+  CreateFullDir(GetDirName(OutField.string().c_str()));
+  WriteMetaFile(Out, P, (OutField.string() + ".idx2").c_str());
+  std::filesystem::path Preview = InField.string() + ".preview";
+  if (!Subset && std::filesystem::exists(Preview))
+    std::filesystem::copy_file(Preview, OutField.string() + ".preview", std::filesystem::copy_options::overwrite_existing, Ec);
+
+  double TotalSeconds = Seconds(ElapsedTime(&Timer));
+  printf("%d + %d source files (%zu chunks) -> %d + %d files (%" PRIi64 " chunks)\n",
+         NDataFiles, NExponentFiles, Job.SourceChunks.size(), NOutputFiles, NOutputExponentFiles, Job.NChunksWritten.load());
+  printf("%.1f MB read, %.1f MB written, %.3f s (%.3f s reading the indexes), %.1f MB/s\n",
+         Job.BytesRead / 1e6, Job.BytesWritten / 1e6, TotalSeconds, IndexSeconds,
+         (Job.BytesRead + Job.BytesWritten) / 1e6 / Max(TotalSeconds, 1e-9));
+  return 0;
+}
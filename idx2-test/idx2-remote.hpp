@@ -0,0 +1,838 @@
+// A query server: clients send query_info requests over a socket, the server executes them on its query pool
+// (with the query cache enabled, so that all the clients share it) and returns the outputs. On a Unix socket the
+// outputs go in a memfd that is passed along with the reply, so the data itself never goes through the socket;
+// on a TCP socket (to reach other nodes) they follow the reply.
+// A coordinator can also split a query across several servers by file (ExecuteDistributedQuery).
+// Linux only (memfd_create, SCM_RIGHTS). Like idx2-query.hpp, include it in exactly one source file.
+#pragma once
+
+#include "idx2-query.hpp"
+#include <netdb.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+/*
+* An address is either the path of a Unix socket (it contains a '/') or <host>:<port> for TCP.
+* The server reads its files under a root directory: in-dir and the file names (name-format, input) must be
+* relative paths without "..". A request is at most MaxRequestBytes, and expands to at most MaxQueryInputs files.
+* Request (text, one item per line), either a query:
+*   idx2-query 1
+*   name-format <length> <string>
+*   in-dir <length> <string>
+*   time-group <n>
+*   time-range <begin> <end>
+*   depth-range <begin> <end>
+*   order <n>
+*   downsampling <x> <y> <t>
+*   accuracy <a>
+*   target <rmse> <psnr> (optional, see query_info::SetTargetRmse)
+*   target-max-error <e> (optional, see query_info::SetTargetMaxError)
+*   priority <n> (optional, 0 = interactive, 1 = batch, see query_priority)
+*   face-dims <num faces> (<x> <y> <z>)...
+*   spatial-range <face> <x begin> <x end> <y begin> <y end> (repeated)
+*   range-resolution <downsampling x y t> <accuracy> (optional, applies to the spatial range before it)
+*   end
+* or the inputs of DecodeMultipleFiles (sent by ExecuteDistributedQuery):
+*   idx2-inputs 2
+*   in-dir <length> <string>
+*   priority <n> (optional)
+*   input <length> <file> <from x y t> <dims x y t> <downsampling x y t> <accuracy> <target rmse> <target psnr> <target max error> (repeated)
+*   end
+* Reply: "error <message>" or
+*   ok <num outputs> <bytes>
+*   output <face> <depth> <time> <from x y t> <dims x y t> <strides x y t> <dtype> <offset> <bytes> <rmse estimate> <max error bound> (repeated)
+*   end
+* (face, depth and time are 0 in the reply to idx2-inputs, whose outputs are in the order of the inputs).
+* On a Unix socket, the memfd holding the outputs (at the given offsets) comes with the first message of the reply,
+* on a TCP socket the <bytes> bytes of the outputs follow "end\n".
+*/
+
+
+/* What a server accepts from a client (a larger request is dropped, a larger query gets an error) */
+static constexpr size_t MaxRequestBytes = size_t(16) << 20;
+static constexpr idx2::i64 MaxQueryInputs = 1 << 16; // depth x time x face (or the inputs of an idx2-inputs request)
+
+
+/* A query_info whose faces are given by the client */
+struct remote_query_info : public query_info
+{
+  std::vector<idx2::v3i> FaceDims3_;
+
+  virtual const int N() const override
+  {
+    return FaceDims3_.empty() ? 0 : FaceDims3_[0].X;
+  }
+
+
+  virtual const int NumFaces() const override
+  {
+    return int(FaceDims3_.size());
+  }
+
+
+  virtual const idx2::v3i* FaceDims3() const override
+  {
+    return FaceDims3_.data();
+  }
+};
+
+
+/* An output of a remote query, whose buffer points into the memory of the remote_result */
+struct remote_output
+{
+  idx2::grid OutGrid;
+  idx2::buffer OutBuffer; // not owned
+  idx2::dtype DataType;
+  double RmseEstimate = -1; // see output::RmseEstimate
+  double MaxErrorBound = -1; // see output::MaxErrorBound
+  output_metadata Metadata;
+};
+
+
+struct remote_result
+{
+  std::vector<remote_output> Outputs;
+  void* Mapping = nullptr; // the shared memory (Unix socket)
+  size_t MappingBytes = 0;
+  std::string Data; // or the outputs that follow the reply (TCP socket)
+
+  remote_result() = default;
+  remote_result(const remote_result&) = delete;
+  remote_result& operator=(const remote_result&) = delete;
+  virtual ~remote_result()
+  {
+    if (Mapping)
+      munmap(Mapping, MappingBytes);
+  }
+};
+
+
+static void
+WriteString(std::ostringstream& Os, const char* Key, const std::string& Str)
+{
+  Os << Key << " " << Str.size() << " " << Str << "\n";
+}
+
+
+static bool
+ReadString(std::istringstream& Is, std::string* Str)
+{
+  size_t Size = 0;
+  if (!(Is >> Size) || Is.get() != ' ')
+    return false;
+  Str->resize(Size);
+  return bool(Is.read(Str->data(), Size));
+}
+
+
+static bool
+ReadPriority(std::istringstream& Is, query_priority* Priority)
+{
+  int P = 0;
+  if (!(Is >> P) || P < 0 || P > int(query_priority::Batch))
+    return false;
+  *Priority = query_priority(P);
+  return true;
+}
+
+
+/* A name format from a client must be literal text with exactly four %d (face, depth, time begin, time end),
+as it goes to snprintf */
+static bool
+IsSafeNameFormat(const std::string& Format)
+{
+  int NumInts = 0;
+  for (size_t I = 0; I < Format.size(); ++I) {
+    if (Format[I] == '\0')
+      return false;
+    if (Format[I] != '%')
+      continue;
+    if (I + 1 == Format.size() || Format[I + 1] != 'd')
+      return false;
+    ++NumInts;
+    ++I;
+  }
+  return NumInts == 4;
+}
+
+
+/* Join a path from a client to the root of the server, the path must be relative and must not go up (..) */
+static bool
+ResolveUnderRoot(const std::string& Root, const std::string& Path, std::string* Resolved)
+{
+  std::string P = Path.c_str(); // Path may be padded with zeros
+  if (P.empty() || P[0] == '/' || P.find('\0') != std::string::npos)
+    return false;
+  for (size_t Begin = 0; Begin <= P.size();) {
+    size_t End = P.find('/', Begin);
+    if (End == std::string::npos)
+      End = P.size();
+    if (P.compare(Begin, End - Begin, "..") == 0)
+      return false;
+    Begin = End + 1;
+  }
+  *Resolved = Root + "/" + P;
+  return true;
+}
+
+
+std::string
+SerializeQuery(const query_info& QueryInfo)
+{
+  std::ostringstream Os;
+  Os.precision(17);
+  Os << "idx2-query 1\n";
+  WriteString(Os, "name-format", QueryInfo.NameFormat);
+  WriteString(Os, "in-dir", QueryInfo.InDir);
+  Os << "time-group " << QueryInfo.TimeGroup << "\n";
+  Os << "time-range " << QueryInfo.TimeRange.Begin << " " << QueryInfo.TimeRange.End << "\n";
+  Os << "depth-range " << QueryInfo.DepthRange.Begin << " " << QueryInfo.DepthRange.End << "\n";
+  Os << "order " << int(QueryInfo.Order) << "\n";
+  const idx2::v3i& Ds3 = QueryInfo.Downsampling3;
+  Os << "downsampling " << Ds3.X << " " << Ds3.Y << " " << Ds3.Z << "\n";
+  Os << "accuracy " << QueryInfo.Accuracy << "\n";
+  if (QueryInfo.TargetRmse > 0 || QueryInfo.TargetPsnr > 0)
+    Os << "target " << QueryInfo.TargetRmse << " " << QueryInfo.TargetPsnr << "\n";
+  if (QueryInfo.TargetMaxError > 0)
+    Os << "target-max-error " << QueryInfo.TargetMaxError << "\n";
+  if (QueryInfo.Priority != query_priority::Interactive)
+    Os << "priority " << int(QueryInfo.Priority) << "\n";
+  Os << "face-dims " << QueryInfo.NumFaces();
+  for (int F = 0; F < QueryInfo.NumFaces(); ++F) {
+    const idx2::v3i& D3 = QueryInfo.FaceDims3()[F];
+    Os << " " << D3.X << " " << D3.Y << " " << D3.Z;
+  }
+  Os << "\n";
+  for (const spatial_range& R : QueryInfo.SpatialRanges) {
+    Os << "spatial-range " << R.Face << " " << R.XRange.Begin << " " << R.XRange.End << " " << R.YRange.Begin << " " << R.YRange.End << "\n";
+    if (R.Downsampling3.X >= 0 || R.Accuracy > 0) // e.g., a viewport
+      Os << "range-resolution " << R.Downsampling3.X << " " << R.Downsampling3.Y << " " << R.Downsampling3.Z << " " << R.Accuracy << "\n";
+  }
+  Os << "end\n";
+  return Os.str();
+}
+
+
+idx2::error<idx2::idx2_err_code>
+DeserializeQuery(const std::string& Request, remote_query_info* QueryInfo)
+{
+  std::istringstream Is(Request);
+  std::string Key;
+  int Version = 0;
+  idx2_ReturnErrorIf(!(Is >> Key >> Version) || Key != "idx2-query" || Version != 1, idx2::err_code::ParseFailed, "Not an idx2 query\n");
+  while (Is >> Key) {
+    bool Ok = true;
+    if (Key == "name-format") {
+      Ok = ReadString(Is, &QueryInfo->NameFormat) && IsSafeNameFormat(QueryInfo->NameFormat);
+    } else if (Key == "in-dir") {
+      Ok = ReadString(Is, &QueryInfo->InDir);
+    } else if (Key == "time-group") {
+      Ok = bool(Is >> QueryInfo->TimeGroup);
+    } else if (Key == "time-range") {
+      Ok = bool(Is >> QueryInfo->TimeRange.Begin >> QueryInfo->TimeRange.End);
+    } else if (Key == "depth-range") {
+      Ok = bool(Is >> QueryInfo->DepthRange.Begin >> QueryInfo->DepthRange.End);
+    } else if (Key == "order") {
+      int Order = 0;
+      Ok = (Is >> Order) && Order >= 0 && Order <= int(order::TimeFaceDepth);
+      QueryInfo->Order = order(Order);
+    } else if (Key == "downsampling") {
+      idx2::v3i& Ds3 = QueryInfo->Downsampling3;
+      Ok = bool(Is >> Ds3.X >> Ds3.Y >> Ds3.Z);
+    } else if (Key == "accuracy") {
+      Ok = bool(Is >> QueryInfo->Accuracy);
+    } else if (Key == "target") {
+      Ok = bool(Is >> QueryInfo->TargetRmse >> QueryInfo->TargetPsnr);
+    } else if (Key == "target-max-error") {
+      Ok = bool(Is >> QueryInfo->TargetMaxError);
+    } else if (Key == "priority") {
+      Ok = ReadPriority(Is, &QueryInfo->Priority);
+    } else if (Key == "face-dims") {
+      int NumFaces = 0;
+      Ok = (Is >> NumFaces) && NumFaces >= 0 && NumFaces <= 16;
+      QueryInfo->FaceDims3_.resize(Ok ? NumFaces : 0);
+      for (idx2::v3i& D3 : QueryInfo->FaceDims3_)
+        Ok = Ok && (Is >> D3.X >> D3.Y >> D3.Z);
+    } else if (Key == "spatial-range") {
+      spatial_range R;
+      Ok = bool(Is >> R.Face >> R.XRange.Begin >> R.XRange.End >> R.YRange.Begin >> R.YRange.End);
+      QueryInfo->SpatialRanges.push_back(R);
+    } else if (Key == "range-resolution") { // of the last spatial range
+      Ok = !QueryInfo->SpatialRanges.empty();
+      if (Ok) {
+        spatial_range& R = QueryInfo->SpatialRanges.back();
+        Ok = bool(Is >> R.Downsampling3.X >> R.Downsampling3.Y >> R.Downsampling3.Z >> R.Accuracy);
+      }
+    } else if (Key == "end") {
+      return idx2_Error(idx2::err_code::NoError);
+    } else {
+      Ok = false;
+    }
+    idx2_ReturnErrorIf(!Ok, idx2::err_code::ParseFailed, "Cannot parse %s\n", Key.c_str());
+  }
+  return idx2_Error(idx2::err_code::ParseFailed, "The query does not end\n");
+}
+
+
+std::string
+SerializeInputs(const std::string& InDir, const std::vector<input>& Inputs, query_priority Priority = query_priority::Interactive)
+{
+  std::ostringstream Os;
+  Os.precision(17);
+  Os << "idx2-inputs 2\n";
+  WriteString(Os, "in-dir", InDir);
+  if (Priority != query_priority::Interactive)
+    Os << "priority " << int(Priority) << "\n";
+  for (const input& In : Inputs) {
+    idx2::v3i F3 = idx2::From(In.Extent), D3 = idx2::Dims(In.Extent), S3 = In.Downsampling3;
+    std::string File = In.InFile.c_str(); // InFile may be padded with zeros
+    Os << "input " << File.size() << " " << File << " " << F3.X << " " << F3.Y << " " << F3.Z << " " << D3.X << " " << D3.Y << " " << D3.Z << " "
+       << S3.X << " " << S3.Y << " " << S3.Z << " " << In.Accuracy << " " << In.TargetRmse << " " << In.TargetPsnr << " " << In.TargetMaxError << "\n";
+  }
+  Os << "end\n";
+  return Os.str();
+}
+
+
+idx2::error<idx2::idx2_err_code>
+DeserializeInputs(const std::string& Request, std::string* InDir, std::vector<input>* Inputs, query_priority* Priority)
+{
+  std::istringstream Is(Request);
+  std::string Key;
+  int Version = 0;
+  idx2_ReturnErrorIf(!(Is >> Key >> Version) || Key != "idx2-inputs" || (Version != 1 && Version != 2), idx2::err_code::ParseFailed, "Not a list of idx2 inputs\n");
+  while (Is >> Key) {
+    bool Ok = true;
+    if (Key == "in-dir") {
+      Ok = ReadString(Is, InDir);
+    } else if (Key == "priority") {
+      Ok = ReadPriority(Is, Priority);
+    } else if (Key == "input") {
+      input In;
+      idx2::v3i F3, D3;
+      idx2::v3i& S3 = In.Downsampling3;
+      Ok = ReadString(Is, &In.InFile) && (Is >> F3.X >> F3.Y >> F3.Z >> D3.X >> D3.Y >> D3.Z >> S3.X >> S3.Y >> S3.Z >> In.Accuracy >> In.TargetRmse >> In.TargetPsnr) &&
+           (Version == 1 || (Is >> In.TargetMaxError));
+      In.Extent = idx2::extent(F3, D3);
+      Ok = Ok && idx2::i64(Inputs->size()) < MaxQueryInputs;
+      Inputs->push_back(In);
+    } else if (Key == "end") {
+      return idx2_Error(idx2::err_code::NoError);
+    } else {
+      Ok = false;
+    }
+    idx2_ReturnErrorIf(!Ok, idx2::err_code::ParseFailed, "Cannot parse %s\n", Key.c_str());
+  }
+  return idx2_Error(idx2::err_code::ParseFailed, "The inputs do not end\n");
+}
+
+
+static bool
+WriteAll(int Socket, const char* Data, size_t Bytes)
+{
+  while (Bytes > 0) {
+    ssize_t N = send(Socket, Data, Bytes, MSG_NOSIGNAL); // a client that went away must not kill the server
+    if (N <= 0)
+      return false;
+    Data += N;
+    Bytes -= N;
+  }
+  return true;
+}
+
+
+/* Send Str, with Fd (if not -1) attached to the first message */
+static bool
+SendWithFd(int Socket, const std::string& Str, int Fd)
+{
+  if (Fd < 0)
+    return WriteAll(Socket, Str.data(), Str.size());
+  iovec Iov{ (void*)Str.data(), Str.size() };
+  char Control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr Msg{};
+  Msg.msg_iov = &Iov;
+  Msg.msg_iovlen = 1;
+  Msg.msg_control = Control;
+  Msg.msg_controllen = sizeof(Control);
+  cmsghdr* Cmsg = CMSG_FIRSTHDR(&Msg);
+  Cmsg->cmsg_level = SOL_SOCKET;
+  Cmsg->cmsg_type = SCM_RIGHTS;
+  Cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(Cmsg), &Fd, sizeof(int));
+  ssize_t N = sendmsg(Socket, &Msg, MSG_NOSIGNAL);
+  if (N <= 0)
+    return false;
+  return WriteAll(Socket, Str.data() + N, Str.size() - N);
+}
+
+
+/* Read until the peer shuts down its side, keeping the file descriptor that comes along (if any).
+Fails if more than MaxBytes arrive. */
+static bool
+ReceiveWithFd(int Socket, std::string* Str, int* Fd, size_t MaxBytes = SIZE_MAX)
+{
+  *Fd = -1;
+  char Buf[1 << 16];
+  while (true) {
+    iovec Iov{ Buf, sizeof(Buf) };
+    char Control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr Msg{};
+    Msg.msg_iov = &Iov;
+    Msg.msg_iovlen = 1;
+    Msg.msg_control = Control;
+    Msg.msg_controllen = sizeof(Control);
+    ssize_t N = recvmsg(Socket, &Msg, MSG_CMSG_CLOEXEC);
+    if (N < 0)
+      return false;
+    for (cmsghdr* Cmsg = CMSG_FIRSTHDR(&Msg); Cmsg; Cmsg = CMSG_NXTHDR(&Msg, Cmsg)) {
+      if (Cmsg->cmsg_level == SOL_SOCKET && Cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(Fd, CMSG_DATA(Cmsg), sizeof(int));
+    }
+    if (N == 0)
+      return true;
+    if (size_t(N) > MaxBytes - Str->size())
+      return false;
+    Str->append(Buf, N);
+  }
+}
+
+
+static bool
+IsUnixSocket(const std::string& Address)
+{
+  return Address.find('/') != std::string::npos;
+}
+
+
+/* Resolve a <host>:<port> address (Passive to listen on it), the result must be freed with freeaddrinfo */
+static addrinfo*
+ResolveTcpAddress(const std::string& Address, bool Passive)
+{
+  size_t Colon = Address.rfind(':');
+  if (Colon == std::string::npos || Colon + 1 == Address.size())
+    return nullptr;
+  std::string Host = Address.substr(0, Colon), Port = Address.substr(Colon + 1);
+  addrinfo Hints{};
+  Hints.ai_family = AF_UNSPEC;
+  Hints.ai_socktype = SOCK_STREAM;
+  Hints.ai_flags = Passive ? AI_PASSIVE : 0;
+  addrinfo* Addrs = nullptr;
+  if (getaddrinfo(Host.empty() ? nullptr : Host.c_str(), Port.c_str(), &Hints, &Addrs) != 0)
+    return nullptr;
+  return Addrs;
+}
+
+
+/* Connect to a Unix socket or a TCP address, returns -1 on failure */
+static int
+ConnectSocket(const std::string& Address)
+{
+  if (IsUnixSocket(Address)) {
+    sockaddr_un Addr{};
+    if (Address.size() >= sizeof(Addr.sun_path))
+      return -1;
+    Addr.sun_family = AF_UNIX;
+    memcpy(Addr.sun_path, Address.c_str(), Address.size() + 1);
+    int Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (Socket < 0)
+      return -1;
+    if (connect(Socket, (sockaddr*)&Addr, sizeof(Addr)) != 0) {
+      close(Socket);
+      return -1;
+    }
+    return Socket;
+  }
+
+  addrinfo* Addrs = ResolveTcpAddress(Address, false);
+  if (!Addrs)
+    return -1;
+  idx2_CleanUp(freeaddrinfo(Addrs));
+  for (addrinfo* A = Addrs; A; A = A->ai_next) {
+    int Socket = socket(A->ai_family, A->ai_socktype | SOCK_CLOEXEC, A->ai_protocol);
+    if (Socket < 0)
+      continue;
+    if (connect(Socket, A->ai_addr, A->ai_addrlen) == 0)
+      return Socket;
+    close(Socket);
+  }
+  return -1;
+}
+
+
+/* Bind and listen on a Unix socket or a TCP address, returns -1 on failure */
+static int
+ListenSocket(const std::string& Address)
+{
+  if (IsUnixSocket(Address)) {
+    sockaddr_un Addr{};
+    if (Address.size() >= sizeof(Addr.sun_path))
+      return -1;
+    Addr.sun_family = AF_UNIX;
+    memcpy(Addr.sun_path, Address.c_str(), Address.size() + 1);
+    int Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (Socket < 0)
+      return -1;
+    unlink(Address.c_str()); // from a previous run
+    if (bind(Socket, (sockaddr*)&Addr, sizeof(Addr)) != 0 || listen(Socket, 64) != 0) {
+      close(Socket);
+      return -1;
+    }
+    return Socket;
+  }
+
+  addrinfo* Addrs = ResolveTcpAddress(Address, true);
+  if (!Addrs)
+    return -1;
+  idx2_CleanUp(freeaddrinfo(Addrs));
+  for (addrinfo* A = Addrs; A; A = A->ai_next) {
+    int Socket = socket(A->ai_family, A->ai_socktype | SOCK_CLOEXEC, A->ai_protocol);
+    if (Socket < 0)
+      continue;
+    int One = 1;
+    setsockopt(Socket, SOL_SOCKET, SO_REUSEADDR, &One, sizeof(One));
+    if (bind(Socket, A->ai_addr, A->ai_addrlen) == 0 && listen(Socket, 64) == 0)
+      return Socket;
+    close(Socket);
+  }
+  return -1;
+}
+
+
+/* Send a request (a query or a list of inputs) to the server at Address and parse its reply into Result */
+static idx2::error<idx2::idx2_err_code>
+SendRequest(const std::string& Address, const std::string& Request, remote_result* Result)
+{
+  int Socket = ConnectSocket(Address);
+  idx2_ReturnErrorIf(Socket < 0, idx2::err_code::FileOpenFailed, "Cannot connect to %s\n", Address.c_str());
+  idx2_CleanUp(close(Socket));
+
+  idx2_ReturnErrorIf(!WriteAll(Socket, Request.data(), Request.size()), idx2::err_code::FileWriteFailed);
+  shutdown(Socket, SHUT_WR); // the server reads the request until the end
+
+  std::string Reply;
+  int Fd = -1;
+  bool Received = ReceiveWithFd(Socket, &Reply, &Fd);
+  idx2_CleanUp(if (Fd >= 0) close(Fd));
+  idx2_ReturnErrorIf(!Received, idx2::err_code::FileReadFailed);
+
+  if (Reply.compare(0, 6, "error ") == 0) {
+    std::string Msg = Reply.substr(6, Reply.find('\n') - 6);
+    return idx2_Error(idx2::err_code::UnknownError, "Server error: %s\n", Msg.c_str());
+  }
+  size_t HeaderBytes = Reply.find("\nend\n"); // the outputs may follow (TCP)
+  idx2_ReturnErrorIf(HeaderBytes == std::string::npos, idx2::err_code::ParseFailed, "The reply does not end\n");
+  HeaderBytes += 5;
+  std::istringstream Is(Reply.substr(0, HeaderBytes));
+  std::string Key;
+  size_t NumOutputs = 0, Bytes = 0;
+  idx2_ReturnErrorIf(!(Is >> Key >> NumOutputs >> Bytes) || Key != "ok", idx2::err_code::ParseFailed);
+  idx2::byte* Data = nullptr;
+  if (Bytes > 0 && Fd >= 0) {
+    Result->Mapping = mmap(nullptr, Bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, Fd, 0);
+    idx2_ReturnErrorIf(Result->Mapping == MAP_FAILED, idx2::err_code::FileReadFailed, "Cannot map the shared memory\n");
+    Result->MappingBytes = Bytes;
+    Data = (idx2::byte*)Result->Mapping;
+  } else if (Bytes > 0) {
+    idx2_ReturnErrorIf(Reply.size() - HeaderBytes != Bytes, idx2::err_code::FileReadFailed, "Truncated reply\n");
+    Result->Data = Reply.substr(HeaderBytes);
+    Data = (idx2::byte*)Result->Data.data();
+  }
+
+  Result->Outputs.resize(NumOutputs);
+  for (remote_output& O : Result->Outputs) {
+    idx2::v3i F3, D3, S3;
+    int DType = 0;
+    size_t Offset = 0, OutBytes = 0;
+    output_metadata& M = O.Metadata;
+    bool Ok = (Is >> Key >> M.Face >> M.Depth >> M.Time >> F3.X >> F3.Y >> F3.Z >> D3.X >> D3.Y >> D3.Z >> S3.X >> S3.Y >> S3.Z >> DType >> Offset >> OutBytes >> O.RmseEstimate >> O.MaxErrorBound) && Key == "output";
+    idx2_ReturnErrorIf(!Ok || Offset > Bytes || OutBytes > Bytes - Offset, idx2::err_code::ParseFailed);
+    idx2_ReturnErrorIf(DType != int(idx2::dtype::float32) && DType != int(idx2::dtype::float64), idx2::err_code::ParseFailed, "Unexpected output type %d\n", DType);
+    idx2_ReturnErrorIf(!(D3 >= idx2::v3i(0)) || OutBytes != size_t(idx2::Prod<idx2::i64>(D3)) * idx2::SizeOf(idx2::dtype(DType)),
+                       idx2::err_code::SizeMismatched, "The output has %zu bytes for %d x %d x %d samples\n", OutBytes, idx2_PrV3i(D3));
+    O.OutGrid = idx2::grid(F3, D3, S3);
+    O.DataType = idx2::dtype(DType);
+    O.OutBuffer = idx2::buffer(Data + Offset, OutBytes);
+  }
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* Execute a query on the server listening at Address, the outputs are as in ExecuteQuery */
+idx2::error<idx2::idx2_err_code>
+ExecuteRemoteQuery(const std::string& Address, const query_info& QueryInfo, remote_result* Result)
+{
+  return SendRequest(Address, SerializeQuery(QueryInfo), Result);
+}
+
+
+/* The worker that decodes File: the one with the highest hash of (file, worker), i.e., rendezvous hashing.
+A file always goes to the same worker, whose query cache then stays warm for it, and when a worker is added or
+removed only the files that it gains or loses move. */
+static int
+PickWorker(const std::vector<std::string>& Workers, const char* File)
+{
+  int Best = 0;
+  idx2::u64 BestHash = 0;
+  for (int W = 0; W < Workers.size(); ++W) {
+    idx2::u64 H = (idx2::u64(idx2::Hash(File)) << 32) | idx2::Hash(Workers[W].c_str());
+    H = (H ^ (H >> 30)) * 0xbf58476d1ce4e5b9llu; // the finalizer of splitmix64
+    H = (H ^ (H >> 27)) * 0x94d049bb133111ebllu;
+    H = H ^ (H >> 31);
+    if (W == 0 || H > BestHash) {
+      Best = W;
+      BestHash = H;
+    }
+  }
+  return Best;
+}
+
+
+/* Decode Inputs[Indices] on one worker, into the same slots of Outputs */
+static idx2::error<idx2::idx2_err_code>
+DecodeOnWorker(const std::string& Worker,
+               const std::string& InDir,
+               const std::vector<input>& Inputs,
+               const std::vector<int>& Indices,
+               query_priority Priority,
+               std::vector<output>* Outputs)
+{
+  std::vector<input> Part(Indices.size());
+  for (int I = 0; I < Indices.size(); ++I)
+    Part[I] = Inputs[Indices[I]];
+  remote_result Reply;
+  idx2_PropagateIfError(SendRequest(Worker, SerializeInputs(InDir, Part, Priority), &Reply));
+  idx2_ReturnErrorIf(Reply.Outputs.size() != Indices.size(), idx2::err_code::SizeMismatched, "Wrong number of outputs\n");
+
+  for (int I = 0; I < Indices.size(); ++I) {
+    const remote_output& R = Reply.Outputs[I];
+    output& O = (*Outputs)[Indices[I]];
+    if (!O.OutBuffer && R.OutBuffer.Bytes > 0)
+      idx2::AllocBuf(&O.OutBuffer, R.OutBuffer.Bytes);
+    idx2_ReturnErrorIf(O.OutBuffer.Bytes < R.OutBuffer.Bytes, idx2::err_code::SizeTooSmall, "Output buffer is too small\n");
+    if (R.OutBuffer.Bytes > 0)
+      memcpy(O.OutBuffer.Data, R.OutBuffer.Data, R.OutBuffer.Bytes);
+    O.OutGrid = R.OutGrid;
+    O.DataType = R.DataType;
+    O.RmseEstimate = R.RmseEstimate;
+    O.MaxErrorBound = R.MaxErrorBound;
+  }
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* Execute a query across several query servers (e.g., one per node, or several local processes), the outputs are
+as in ExecuteQuery. The query is expanded here, each file (face, depth, time group) is assigned to a worker by
+PickWorker, then every worker decodes its files in parallel with the others and its outputs are copied into Outputs
+as soon as its reply arrives. Workers are addresses as in RunQueryServer. */
+idx2::error<idx2::idx2_err_code>
+ExecuteDistributedQuery(const std::vector<std::string>& Workers,
+                        const query_info& QueryInfo,
+                        std::vector<output>* Outputs,
+                        std::vector<output_metadata>* OutputsMetadata)
+{
+  idx2_ReturnErrorIf(Workers.empty(), idx2::err_code::SizeZero, "No workers\n");
+  idx2_ReturnErrorIf(!QueryInfo.Verify(), idx2::err_code::DimensionMismatched);
+  std::vector<input> Inputs;
+  GetQueryInputs(QueryInfo, QueryInfo.TimeRange, &Inputs, OutputsMetadata);
+  Outputs->resize(Inputs.size());
+
+  std::vector<std::vector<int>> Assigned(Workers.size()); // the indices of the inputs of each worker
+  for (int I = 0; I < Inputs.size(); ++I)
+    Assigned[PickWorker(Workers, Inputs[I].InFile.c_str())].push_back(I);
+
+  /* one thread per worker, that mostly waits for the reply (an idx2::error cannot cross threads) */
+  std::vector<std::pair<idx2::idx2_err_code, std::string>> Errors(Workers.size(), std::make_pair(idx2::idx2_err_code::NoError, std::string()));
+  std::vector<std::thread> Threads;
+  for (int W = 0; W < Workers.size(); ++W) {
+    if (Assigned[W].empty())
+      continue;
+    Threads.emplace_back([&, W]() {
+      auto Result = DecodeOnWorker(Workers[W], QueryInfo.InDir, Inputs, Assigned[W], QueryInfo.Priority, Outputs);
+      if (!Result)
+        Errors[W] = std::make_pair(Result.Code, Workers[W] + ": " + idx2::ToString(Result));
+    });
+  }
+  for (auto& T : Threads)
+    T.join();
+
+  for (const auto& E : Errors) {
+    if (E.first != idx2::idx2_err_code::NoError)
+      return idx2_Error(E.first, "%s", E.second.c_str());
+  }
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* The bytes of the samples of an output (its buffer may be larger, e.g., after CollapseSlices) */
+static size_t
+GetOutputBytes(const output& O)
+{
+  if (!O.OutBuffer)
+    return 0;
+  size_t Bytes = size_t(idx2::Prod<idx2::i64>(idx2::Dims(O.OutGrid))) * idx2::SizeOf(O.DataType);
+  idx2_Assert(Bytes <= size_t(O.OutBuffer.Bytes));
+  return Bytes;
+}
+
+
+/* Send the outputs of a request, through a memfd on a Unix socket or after the reply on a TCP socket */
+static void
+SendOutputs(int Socket, const std::vector<output>& Outputs, const std::vector<output_metadata>& OutputsMetadata)
+{
+  sockaddr_storage Addr{};
+  socklen_t AddrBytes = sizeof(Addr);
+  bool Local = getsockname(Socket, (sockaddr*)&Addr, &AddrBytes) == 0 && Addr.ss_family == AF_UNIX;
+
+  std::ostringstream Os;
+  Os.precision(17);
+  size_t Bytes = 0;
+  for (const output& O : Outputs)
+    Bytes += GetOutputBytes(O);
+  Os << "ok " << Outputs.size() << " " << Bytes << "\n";
+  size_t Offset = 0;
+  for (int I = 0; I < Outputs.size(); ++I) {
+    const output& O = Outputs[I];
+    const output_metadata& M = OutputsMetadata[I];
+    idx2::v3i F3 = idx2::From(O.OutGrid), D3 = idx2::Dims(O.OutGrid), S3 = idx2::Strd(O.OutGrid);
+    Os << "output " << M.Face << " " << M.Depth << " " << M.Time << " " << F3.X << " " << F3.Y << " " << F3.Z << " "
+       << D3.X << " " << D3.Y << " " << D3.Z << " " << S3.X << " " << S3.Y << " " << S3.Z << " "
+       << int(O.DataType) << " " << Offset << " " << GetOutputBytes(O) << " " << O.RmseEstimate << " " << O.MaxErrorBound << "\n";
+    Offset += GetOutputBytes(O);
+  }
+  Os << "end\n";
+
+  std::string Header = Os.str();
+  if (!Local) { // the outputs follow the reply
+    if (!WriteAll(Socket, Header.data(), Header.size()))
+      return;
+    for (const output& O : Outputs) {
+      if (!WriteAll(Socket, (const char*)O.OutBuffer.Data, GetOutputBytes(O)))
+        return;
+    }
+    return;
+  }
+
+  /* copy the outputs into a memfd, that the client maps */
+  auto SendError = [Socket](const char* Msg) { SendWithFd(Socket, std::string("error ") + Msg + "\n", -1); };
+  int MemFd = -1;
+  idx2_CleanUp(if (MemFd >= 0) close(MemFd));
+  if (Bytes > 0) {
+    MemFd = memfd_create("idx2-query", MFD_CLOEXEC);
+    if (MemFd < 0 || ftruncate(MemFd, Bytes) != 0)
+      return SendError("Cannot create the shared memory");
+    idx2::byte* Mapping = (idx2::byte*)mmap(nullptr, Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, MemFd, 0);
+    if (Mapping == MAP_FAILED)
+      return SendError("Cannot map the shared memory");
+    Offset = 0;
+    for (const output& O : Outputs) {
+      if (GetOutputBytes(O) > 0)
+        memcpy(Mapping + Offset, O.OutBuffer.Data, GetOutputBytes(O));
+      Offset += GetOutputBytes(O);
+    }
+    munmap(Mapping, Bytes);
+  }
+  SendWithFd(Socket, Header, MemFd);
+}
+
+
+/* Confine the files of a request to Root: InDir and the names of the input files become paths under Root */
+static bool
+ResolveInputs(const std::string& Root, std::string* InDir, std::vector<input>* Inputs)
+{
+  if (!ResolveUnderRoot(Root, *InDir, InDir))
+    return false;
+  for (input& In : *Inputs) {
+    if (!ResolveUnderRoot(Root, In.InFile, &In.InFile))
+      return false;
+  }
+  return true;
+}
+
+
+/* Execute one request (a query or a list of inputs) on the files under Root and send the reply */
+static void
+ServeQuery(int Socket, const std::string& Root)
+{
+  idx2_CleanUp(close(Socket));
+  std::string Request;
+  int Fd = -1;
+  bool Received = ReceiveWithFd(Socket, &Request, &Fd, MaxRequestBytes);
+  if (Fd >= 0)
+    close(Fd);
+  if (!Received)
+    return;
+
+  auto SendError = [Socket](const char* Msg) { SendWithFd(Socket, std::string("error ") + Msg + "\n", -1); };
+  std::string InDir;
+  std::vector<input> Inputs;
+  query_priority Priority = query_priority::Interactive;
+  std::vector<output_metadata> OutputsMetadata;
+  if (Request.compare(0, 12, "idx2-inputs ") == 0) {
+    auto Ok = DeserializeInputs(Request, &InDir, &Inputs, &Priority);
+    if (!Ok)
+      return SendError(idx2::ToString(Ok));
+    OutputsMetadata.resize(Inputs.size());
+  } else {
+    remote_query_info QueryInfo;
+    auto Ok = DeserializeQuery(Request, &QueryInfo);
+    if (!Ok)
+      return SendError(idx2::ToString(Ok));
+    if (!QueryInfo.Verify() || QueryInfo.TimeGroup <= 0)
+      return SendError("Invalid query");
+    idx2::i64 NumInputs = (idx2::i64(QueryInfo.DepthRange.End) - QueryInfo.DepthRange.Begin) *
+                          (idx2::i64(QueryInfo.TimeRange.End) - QueryInfo.TimeRange.Begin) * idx2::i64(QueryInfo.SpatialRanges.size());
+    if (NumInputs > MaxQueryInputs)
+      return SendError("Too many files in the query");
+    GetQueryInputs(QueryInfo, QueryInfo.TimeRange, &Inputs, &OutputsMetadata);
+    InDir = QueryInfo.InDir;
+    Priority = QueryInfo.Priority;
+  }
+  if (!ResolveInputs(Root, &InDir, &Inputs))
+    return SendError("Paths must be relative to the root of the server");
+
+  std::vector<output> Outputs(Inputs.size());
+  if (!Inputs.empty()) {
+    auto Ok = DecodeMultipleFiles(InDir, Inputs, &Outputs, nullptr, Priority);
+    if (!Ok)
+      return SendError(idx2::ToString(Ok));
+  }
+  SendOutputs(Socket, Outputs, OutputsMetadata);
+}
+
+
+/* Serve queries on Address (a Unix socket path or <host>:<port>) until the process is killed, each connection
+on its own thread. The decoding happens on the query pool, which all the connections share. The clients name
+their files relative to Root, and at most MaxConnections of them are served at once (the others get an error). */
+idx2::error<idx2::idx2_err_code>
+RunQueryServer(const std::string& Address, const std::string& Root, int MaxConnections = 64)
+{
+  idx2_ReturnErrorIf(Root.empty(), idx2::err_code::SizeZero, "No root directory\n");
+  int Socket = ListenSocket(Address);
+  idx2_ReturnErrorIf(Socket < 0, idx2::err_code::FileCreateFailed, "Cannot listen on %s\n", Address.c_str());
+  idx2_CleanUp(close(Socket));
+
+  auto NumConnections = std::make_shared<std::atomic<int>>(0);
+  while (true) {
+    int Client = accept4(Socket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (Client < 0)
+      continue;
+    if (NumConnections->fetch_add(1) >= MaxConnections) {
+      --*NumConnections;
+      SendWithFd(Client, "error Too many connections\n", -1);
+      close(Client);
+      continue;
+    }
+    timeval Timeout{ 60, 0 }; // a client that stalls must not hold its connection forever
+    setsockopt(Client, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+    setsockopt(Client, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+    std::thread([Client, Root, NumConnections]() {
+      ServeQuery(Client, Root);
+      --*NumConnections;
+    }).detach();
+  }
+  return idx2_Error(idx2::err_code::NoError);
+}
@@ -0,0 +1,49 @@
+// A query daemon for the analysts of a node: serves query_info requests (see idx2-remote.hpp) over a Unix
+// socket, with one query pool and one query cache shared by all the clients, and returns the outputs
+// through shared memory. Given <host>:<port> instead of a path, it listens on TCP, e.g., to be one of the
+// workers of ExecuteDistributedQuery on another node.
+//
+// Usage: idx2-server --root /data (the clients can only read the files under it, named relative to it)
+//                    [--socket /tmp/idx2-server.sock | --socket 0.0.0.0:7420] [--cache-mb 4096]
+//                    [--max-connections 64] (the clients served at once, the others get an error)
+//                    [--record trace.txt] (append every query to a trace, e.g., for idx2-layout)
+// Clients call ExecuteRemoteQuery (C++), idx2Nasa.ExecuteRemoteQuery (Python) or idx2-workload --server,
+// coordinators call ExecuteDistributedQuery or idx2-workload --workers.
+#define idx2_Implementation
+#include "idx2-remote.hpp"
+
+
+int
+main(int Argc, const char** Argv)
+{
+  using namespace idx2;
+  cstr SocketPath = "/tmp/idx2-server.sock";
+  int CacheMB = 4096;
+  int MaxConnections = 64;
+  cstr Root = nullptr;
+  OptVal(Argc, Argv, "--socket", &SocketPath);
+  OptVal(Argc, Argv, "--cache-mb", &CacheMB);
+  OptVal(Argc, Argv, "--max-connections", &MaxConnections);
+  if (!OptVal(Argc, Argv, "--root", &Root)) {
+    fprintf(stderr, "Provide --root, the directory of the files to serve\n");
+    return 1;
+  }
+  cstr TraceFile = nullptr;
+  if (OptVal(Argc, Argv, "--record", &TraceFile)) {
+    auto Recording = SetQueryTrace(TraceFile);
+    if (!Recording) {
+      fprintf(stderr, "%s\n", ToString(Recording));
+      return 1;
+    }
+  }
+
+  SetQueryCacheSize(i64(CacheMB) << 20);
+  printf("serving queries on %s (files under %s, %d MB of cache, %d decoding threads)\n", SocketPath, Root, CacheMB, int(GetQueryPool().Workers.size()));
+  fflush(stdout);
+  auto Result = RunQueryServer(SocketPath, Root, MaxConnections);
+  if (!Result) {
+    fprintf(stderr, "%s\n", ToString(Result));
+    return 1;
+  }
+  return 0;
+}
@@ -1,871 +1,365 @@
-﻿// To use the single-file header-only library
+﻿// Python bindings for the query layer (module idx2Nasa)
+// The decoded buffers are handed to NumPy without a copy, and the GIL is released while decoding.
+// SubmitQuery/SubmitQueryAsync return (awaitable) futures of queries running on the query pool of idx2-query.hpp,
+// Animation prefetches the next time steps of a query during playback, ExecuteRemoteQuery sends a query to
+// an idx2-server and ExecuteDistributedQuery splits it across several of them (Linux). GetQueryPreviews returns
+// the low-resolution previews of a query at once, to show while SubmitQuery decodes it. QueryInfo.AddViewport
+// sizes a region to a rectangle of the screen. QueryInfo.SetTargetRmse/SetTargetPsnr decode to an error target,
+// SetTargetMaxError to a bound on the error of every sample. SetQueryTrace records the queries, e.g., to tune the
+// layout of the files with idx2-layout.
 #define idx2_Implementation
-#include "idx2.hpp"
-#include <algorithm>
-#include <array>
-#include <atomic>
-#include <cassert>
-#include <chrono>
-#include <memory>
-#include <string>
-#include <thread>
-#include <vector>
+#if defined(__linux__)
+#include "idx2-remote.hpp"
+#else
+#include "idx2-query.hpp"
+#endif
+#include <functional>
+#include <stdexcept>
+#include <tuple>
 #include <nanobind/nanobind.h>
 #include <nanobind/stl/string.h>
 #include <nanobind/stl/tuple.h>
-#include <nanobind/tensor.h>
-
-/*
-* Data description:
-* Each file contains the data for one face, on one depth, and for 32 time steps (or 1024 time steps on NAS)
-* The file path will be of the form "llc2160/u-face-3-depth-51-time-0-1024.idx2" (dataset name = llc2160, field name = u, face 3, depth 51, time steps [0..1024]
-* In particular, each .idx2 dataset stores a single face (indexed from 0 to 4), for a single depth, and for 1024 time steps.
-* The grid size for each .idx2 dataset is thus 2160(x) * 6480(y) * 1024(t) (for faces 0, 1), 2160(x) * 2160(y) * 1024(t) (for face 2), and 6480(x) * 2160(y) * 1024(t) (for faces 3, 4)
-* Note that we do not rotate or flip any face from their original form.
-*/
+#include <nanobind/stl/vector.h>
+#include <nanobind/ndarray.h>
 
+namespace nb = nanobind;
 
-struct input
-{
-  std::string InFile; // e.g., "llc2160/u-face-3-depth-51-time-0-1024.idx2" (ALWAYS include the parent dir, not just the name of the .idx2 file)
-  idx2::extent Extent; // "crop" the output to a region in the [x, y, t] space, leave as default to get whole volume
-  idx2::v3i Downsampling3;
-  double Accuracy;
-};
+using array3 = nb::ndarray<nb::numpy, nb::shape<-1, -1, -1>, nb::c_contig>;
 
 
-struct output
+/* Move the output buffer into a NumPy array of shape (T, Y, X) (i.e., X varies fastest).
+The array owns the buffer through a capsule, so there is no copy and the output is left empty. */
+static array3
+ToNumpy(output* Output)
 {
-  idx2::grid OutGrid; // the logical grid of the output buffer (to get the dimensions of the grid, call idx2::v3i Dims3 = Dims(*OutGrid))
-  idx2::buffer OutBuffer; // the output data buffer, if the buffer is preallocated, we will reuse that buffer
-  idx2::dtype DataType; // float32, float64 etc
-  virtual ~output()
-  {
-    if (OutBuffer)
-      idx2::DeallocBuf(&OutBuffer);
-  }
-};
-
-
-/*
-* When accessing the data, we can provide three sets of parameters:
-*   - the downsampling factor (in x/y/t),
-*   - the accuracy (an error value, with 0 meaning no error), and
-*   - the spatial-temporal extent to query data from.
-* The downsampling factor is given by a vector of three integers (idx2::v3i).
-* Downsampling factor (0, 0, 0) means return everything at full resolution.
-* Downsampling factor (0, 1, 2) means x is full resolution, y is half resolution, and t (time) is quarter resolution.
-* Accuracy is a floating-point number to indicate the desired root-mean-square error (0 means near-lossless).
-* The downsampling factor also affects the accuracy, but the Accuracy parameter is to be interpreted as if there is no downsampling.
-* The Extent parameter (of type idx2::extent) determines where in the [x, y, t] space we want to query from.
-* For example, to query face 0 at time step 500, we can set the extent to be from [0, 0, 500] to [2159, 6479, 500].
-* This can be done by using the idx2::extent constructor idx2::extent(idx2::v3i(0, 0, 500), idx2::v3i(2160, 6480, 1)).
-* If a default idx2::extent is given, it is understood that the full volume is requested (e.g., from [0, 0, 0] to [2159, 6479, 1023] for face 0).
-*
-* There are two parameters, OutGrid (of type idx2::grid) and OutBuf (of type idx2::buffer).
-* To see what they mean, consider the scenarios below:
-*
-* 1) In the first scenario, we have a 2D 7x5 grid.
-* The extent we are asking for is from [1, 1] to [4, 3].
-* The OutGrid will be a sub-grid of samples, from [1, 1] to [4, 3], with strides [1, 1], for a total of 4x3 samples.
-* We use @ to denote the samples inside OutGrid (that will be returned to the user).
-* The OutBuf will be a linear buffer of 4x3=12 floating-point numbers, storing the sample values in the OutGrid.
-*
-*     +    +    +    +    +    +    +
-*
-*     +    @----@----@----@    +    +
-*          |              |
-*     +    @    @    @    @    +    +
-*          |              |
-*     +    @----@----@----@    +    +
-*
-*     +    +    +    +    +    +    +
-*
-* 2) In the second scenario, we still have the same 7x5 grid.
-* The extent we are asking for is still from [1, 1] to [4, 3], as above.
-* But now we are using a downsampling factor of (1, 0), meaning we now only get every other sample in X.
-* Below we show the downsampled grid according to downsampling factor (1, 0).
-* Note that the (coarse) samples that fall inside the queried extent do not "cover" all of this extent.
-*
-*     +         +         +         +
-*
-*     +    -----+---------+         +
-*          |              |
-*     +    |    +         +         +
-*          |              |
-*     +    -----+---------+         +
-*
-*     +         +         +         +
-*
-* Therefore, we enlarge the extent so that it "snaps" to the downsampled grid (see below).
-* As a result, the OutGrid is now from [0, 1] to [4, 3], with strides [2, 1], for a total of 3x3 samples (see the @ samples below).
-* The OutBuf will be a linear buffer of 3x3=9 floating-point numbers, storing the sample values in the OutGrid.
-*
-*     +    +    +    +    +    +    +
-*
-*     @----+----@----+----@    +    +
-*     |                   |
-*     @    +    @    +    @    +    +
-*     |                   |
-*     @----+----@----+----@    +    +
-*
-*     +    +    +    +    +    +    +
-*
-* 3) In the second scenario, we still have the same 7x5 grid.
-* The extent we are asking for is now from [1, 0] to [1, 4] (i.e., a "slicing" operation along X)
-* We are stil using a downsampling factor of (1, 0), meaning we now only get every other sample in X.
-* In this case, our query extent "falls between" the samples of the downsampled grid.
-*
-*     +    +    +    +    +    +    +
-*          |
-*     +    +    +    +    +    +    +
-*          |
-*     +    +    +    +    +    +    +
-*          |
-*     +    +    +    +    +    +    +
-*          |
-*     +    +    +    +    +    +    +
-*
-* As before, we enlarge the requested extent so that it "snaps" to the downsampled grid.
-*
-*     @---------@         +         +
-*     |         |
-*     @         @         +         +
-*     |         |
-*     @         @         +         +
-*     |         |
-*     @         @         +         +
-*     |         |
-*     @---------@         +         +
-*
-* The dimensions of OutGrid will be 2x5, and OutBuf will contain 10 samples.
-* Note that even though the user asks for a 1x5 slice, we are returning a 2x5 sub-grid.
-* To get the slice that they want, the user then can choose to do either:
-*   - Pick one of the two returned slices
-*   - Interpolate between the two returned slices
-*/
-idx2::volume
-CollapseByInterpolation(const idx2::volume& Vol, idx2::dimension D, double T);
-
-std::atomic<int> NumThreads = 0;
-const auto MaxThreads = std::thread::hardware_concurrency();
-std::vector<std::thread> Workers;
-
-idx2::error<idx2::idx2_err_code>
-DecodeOneFile(const std::string& InDir, // e.g., "/nobackupp19/vpascucc/converted_files" (an absolute or relative path that leads to the parent dir of the .idx2 file, can also simply be ".")
-              const input& Input, // see struct input above
-              output* Output)
-{
-  assert(Output != nullptr);
-
-  // First, we initialize the parameters
-  idx2::params P;
-  P.InputFile = Input.InFile.c_str();
-  P.InDir = InDir.c_str();
-  idx2::idx2_file Idx2;
-  idx2_CleanUp(Dealloc(&Idx2)); // clean up Idx2 automatically
-  idx2_PropagateIfError(Init(&Idx2, P));
-
-  // Next, we compute the output grid
-  //P.DownsamplingFactor3 = Downsampling3;
-  Idx2.DownsamplingFactor3 = Input.Downsampling3; // TODO: this should be in P instead
-  //Idx2.Accuracy = Accuracy;
-  P.DecodeAccuracy = Input.Accuracy;
-  if (idx2::Dims(Input.Extent) == idx2::v3i(0))
-    P.DecodeExtent = idx2::extent(Idx2.Dims3); // get the whole volume
-  else
-    P.DecodeExtent = Input.Extent;
-  Output->OutGrid = idx2::GetOutputGrid(Idx2, P);
-
-  // If the output buffer is uninitialized, we allocate it
-  idx2::i64 MinBufSize = idx2::SizeOf(Idx2.DType) * idx2::Prod<idx2::i64>(idx2::Dims(Output->OutGrid));
-  if (!Output->OutBuffer && idx2::Dims(Output->OutGrid) > 0)
-    idx2::AllocBuf(&Output->OutBuffer, MinBufSize);
-  // If the output buffer is preallocated by the user, we check if it is too small
-  idx2_ReturnErrorIf(Output->OutBuffer.Bytes < MinBufSize, idx2::err_code::SizeTooSmall, "Output buffer is too small\n");
-
-  // Finally, we decode and return the queried data
-  idx2_PropagateIfError(idx2::Decode(&Idx2, P, &Output->OutBuffer)); // the output is stored in OutBuffer
-  Output->DataType = Idx2.DType;
-
-  // If the query is a slice but we return 2 slices, collapse them by linear interpolation
-  idx2::volume Vol(Output->OutBuffer, idx2::Dims(Output->OutGrid), Output->DataType);
-  idx2::grid OutGrid = Output->OutGrid;
-  idx2::v3i From3 = idx2::From(Output->OutGrid);
-  idx2::v3i Dims3 = idx2::Dims(Output->OutGrid);
-  for (int D = 2; D >= 0; --D) {
-    if (idx2::Dims(P.DecodeExtent)[D] == 1 && idx2::Dims(Output->OutGrid)[D] == 2) {
-      double T = double(idx2::Frst(P.DecodeExtent)[D] - idx2::Frst(Output->OutGrid)[D]) / (idx2::Last(Output->OutGrid)[D] - idx2::Frst(Output->OutGrid)[D]);
-      idx2_Assert(T >= 0 && T <= 1);
-      Vol = CollapseByInterpolation(Vol, idx2::dimension(D), T);
-      From3[D] = idx2::From(P.DecodeExtent)[D];
-      Dims3[D] = 1;
-    }
-  }
-  idx2::SetFrom(&Output->OutGrid, From3);
-  idx2::SetDims(&Output->OutGrid, Dims3);
-  Output->OutBuffer = Vol.Buffer;
+  idx2::buffer* Buf = new idx2::buffer(Output->OutBuffer);
+  Output->OutBuffer = idx2::buffer(); // the capsule owns the memory from now on
+  nb::capsule Owner(Buf, [](void* P) noexcept {
+    idx2::buffer* B = (idx2::buffer*)P;
+    idx2::DeallocBuf(B);
+    delete B;
+  });
 
-  return idx2_Error(idx2::idx2_err_code::NoError); // make sure to check for return error at call site
+  idx2::v3i D3 = idx2::Dims(Output->OutGrid);
+  size_t Shape[3] = { size_t(D3.Z), size_t(D3.Y), size_t(D3.X) };
+  if (Output->DataType == idx2::dtype::float64)
+    return array3(Buf->Data, 3, Shape, Owner, nullptr, nb::dtype<double>());
+  return array3(Buf->Data, 3, Shape, Owner, nullptr, nb::dtype<float>());
 }
 
 
-/* "Collapse" a dimension of a volume (from 2 to 1) by linear interpolation */
-idx2::volume
-CollapseByInterpolation(const idx2::volume& Vol, idx2::dimension D, double T)
+/* The grid of an output as ((from x, y, t), (dims x, y, t), (stride x, y, t)) */
+static std::tuple<std::tuple<int, int, int>, std::tuple<int, int, int>, std::tuple<int, int, int>>
+ToTuple(const idx2::grid& Grid)
 {
-  idx2_Assert(T >= 0 && T <= 1);
-  idx2_Assert(idx2::Dims(Vol)[D] == 2);
-
-  idx2::extent E = idx2::extent(Vol);
-  idx2::extent E1 = idx2::Slab(E, D, 1);
-  idx2::extent E2 = idx2::Slab(E, D, -1);
-  idx2_Assert(idx2::Dims(E1) == idx2::Dims(E2));
-  idx2::volume OutVol(idx2::Dims(E1), Vol.Type);
-
-  // Loop through the volume with E1 and E2
-  idx2::v3i D3 = idx2::Dims(E1);
-  for (idx2::v3i P = idx2::v3i(0); P.Z < D3.Z; ++P.Z) {
-    for (P.Y = 0; P.Y < D3.Y; ++P.Y) {
-      for (P.X = 0; P.X < D3.X; ++P.X) {
-        double V1 = Vol.At<idx2::float32>(E1, P); // TODO: not general
-        double V2 = Vol.At<idx2::float32>(E2, P);
-        double V = V1 * T + V2 * (1 - T);
-        OutVol.At<idx2::float32>(P) = V;
-      }
-    }
-  }
-
-  return OutVol;
+  idx2::v3i F3 = idx2::From(Grid), D3 = idx2::Dims(Grid), S3 = idx2::Strd(Grid);
+  return std::make_tuple(std::make_tuple(F3.X, F3.Y, F3.Z),
+                         std::make_tuple(D3.X, D3.Y, D3.Z),
+                         std::make_tuple(S3.X, S3.Y, S3.Z));
 }
 
 
-idx2::error<idx2::idx2_err_code>
-GetOutputGrid(const std::string& InDir, // e.g., "/nobackupp19/vpascucc/converted_files" (an absolute or relative path that leads to the parent dir of the .idx2 file, can also simply be ".")
-              const input& Input, // see struct input above
-              idx2::grid* OutGrid)
+/* A list of (array, face, depth, time), one per (face, depth, time) in the order given by the query */
+static nb::list
+ToList(std::vector<output>* Outputs, const std::vector<output_metadata>& OutputsMetadata)
 {
-  assert(OutGrid != nullptr);
-
-  // First, we initialize the parameters
-  idx2::params P;
-  P.InputFile = Input.InFile.c_str();
-  P.InDir = InDir.c_str();
-  idx2::idx2_file Idx2;
-  idx2_CleanUp(Dealloc(&Idx2)); // clean up Idx2 automatically
-  idx2_PropagateIfError(Init(&Idx2, P));
-
-  // Next, we compute the output grid
-  P.DownsamplingFactor3 = Input.Downsampling3;
-  if (idx2::Dims(Input.Extent) == idx2::v3i(0))
-    P.DecodeExtent = idx2::extent(Idx2.Dims3); // get the whole volume
-  else
-    P.DecodeExtent = Input.Extent;
-  *OutGrid = idx2::GetOutputGrid(Idx2, P);
-
-  return idx2_Error(idx2::idx2_err_code::NoError); // make sure to check for return error at call site
+  nb::list List;
+  for (size_t I = 0; I < Outputs->size(); ++I) {
+    const output_metadata& M = OutputsMetadata[I];
+    List.append(nb::make_tuple(ToNumpy(&(*Outputs)[I]), M.Face, M.Depth, M.Time));
+  }
+  return List;
 }
 
 
-idx2::error<idx2::idx2_err_code>
-RunQueryTask(const std::string& InDir,
-             const std::vector<std::pair<input, int>>& SortedInputs,
-             int Begin,
-             int I,
-             std::vector<output>* Outputs)
+/* Returns the list of ToList */
+static nb::list
+PyExecuteQuery(const query_info& QueryInfo)
 {
-  /* construct input and output for a single query */
-  idx2::extent Extent = SortedInputs[Begin].first.Extent;
-  for (int J = Begin; J < I; ++J) {
-    Extent = idx2::BoundingBox(Extent, SortedInputs[J].first.Extent); // accumulate extent
-  }
-  input Input;
-  Input.InFile = SortedInputs[Begin].first.InFile;
-  Input.Extent = Extent;
-  Input.Accuracy = SortedInputs[Begin].first.Accuracy;
-  Input.Downsampling3 = SortedInputs[Begin].first.Downsampling3;
-  output Output;
-  idx2::timer Timer;
-  idx2::StartTimer(&Timer);
-  idx2_PropagateIfError(DecodeOneFile(InDir, Input, &Output));
-  auto Seconds = idx2::Seconds(idx2::ElapsedTime(&Timer));
-  printf("**** Reading file %s\n", Input.InFile.data());
-  printf("**** Time taken to decode one file = %f s\n", Seconds);
-
-  /* now distribute the output */
-  for (int J = Begin; J < I; ++J) {
-    output& OutputJ = (*Outputs)[SortedInputs[J].second];
-    GetOutputGrid(InDir, SortedInputs[J].first, &(OutputJ.OutGrid));
-    OutputJ.DataType = Output.DataType;
-
-    idx2::i64 MinBufSize = idx2::SizeOf(Output.DataType) * idx2::Prod<idx2::i64>(idx2::Dims(OutputJ.OutGrid));
-    if (!OutputJ.OutBuffer && idx2::Dims(OutputJ.OutGrid) > 0)
-      idx2::AllocBuf(&OutputJ.OutBuffer, MinBufSize);
-    // If the output buffer is preallocated by the user, we check if it is too small
-    // TODO: just automatically reallocate if necessary
-    idx2_ReturnErrorIf(OutputJ.OutBuffer.Bytes < MinBufSize, idx2::err_code::SizeTooSmall, "Output buffer is too small\n");
-
-    idx2::extent FromE = idx2::Relative(Output.OutGrid, Output.OutGrid);
-    idx2::volume FromV = idx2::volume(Output.OutBuffer, idx2::Dims(FromE), Output.DataType);
-    idx2::extent ToE   = idx2::Relative(OutputJ.OutGrid, Output.OutGrid);
-    idx2::volume ToV   = idx2::volume(OutputJ.OutBuffer, idx2::Dims(ToE), OutputJ.DataType);
-    idx2::CopyExtentExtent<float, float>(FromE, FromV, ToE, &ToV); // TODO: hard-coding the types
+  std::vector<output> Outputs;
+  std::vector<output_metadata> OutputsMetadata;
+  idx2::error<idx2::idx2_err_code> Result;
+  {
+    nb::gil_scoped_release Release; // other Python threads can run (and query) while we decode
+    Result = ExecuteQuery(QueryInfo, &Outputs, &OutputsMetadata);
   }
+  if (!Result)
+    throw std::runtime_error(idx2::ToString(Result));
 
-  -- NumThreads;
-  printf("done task\n");
-}
-
-
-void DummyTask()
-{
-  --NumThreads;
+  return ToList(&Outputs, OutputsMetadata);
 }
 
 
-/* Get potentially multiple faces at multiple depths */
-// TODO: we can use multiple threads, one for each file
-// TODO: think about error handling (what if the input file does not exist)
-// how about this compared to caching the idx2 struct?
-idx2::error<idx2::idx2_err_code>
-DecodeMultipleFiles(const std::string& InDir,
-                    const std::vector<input>& Inputs,
-                    std::vector<output>* Outputs)
+/* Same as ExecuteQuery, but from the low-resolution previews written by the encoder (see GetQueryPreviews) */
+static nb::list
+PyGetQueryPreviews(const query_info& QueryInfo)
 {
-  using namespace std::chrono_literals;
-  idx2_Assert(!Inputs.empty(), "Input cannot be empty\n");
-  idx2_Assert(Inputs.size() == Outputs->size());
-
-  /* duplicate the file names so that we can sort them (but remember the original order for the outputs) */
-  std::vector<std::pair<input, int>> SortedInputs(Inputs.size());
-  for (int I = 0; I < Inputs.size(); ++I) {
-    SortedInputs[I] = std::make_pair(Inputs[I], I);
-  }
-  std::sort(SortedInputs.begin(), SortedInputs.end(), [](const auto& P1, const auto& P2) {
-    return P1.first.InFile < P2.first.InFile;
-  });
-
-  int Begin = 0;
-  for (int I = 1; I <= SortedInputs.size(); ++I) {
-    if (I < SortedInputs.size() && SortedInputs[I].first.InFile == SortedInputs[I - 1].first.InFile) {
-      continue;
-    }
-    while (NumThreads >= MaxThreads) {
-      std::this_thread::sleep_for(100ms);
-    }
-    ++NumThreads;
-    std::thread (RunQueryTask, InDir, SortedInputs, Begin, I, Outputs).detach();
-    //std::thread (DummyTask).detach();
-
-    Begin = I;
-  }
-
-  while (NumThreads > 0) {
-    std::this_thread::sleep_for(100ms);
+  std::vector<output> Outputs;
+  std::vector<output_metadata> OutputsMetadata;
+  idx2::error<idx2::idx2_err_code> Result;
+  {
+    nb::gil_scoped_release Release;
+    Result = GetQueryPreviews(QueryInfo, &Outputs, &OutputsMetadata);
   }
+  if (!Result)
+    throw std::runtime_error(idx2::ToString(Result));
 
-  return idx2_Error(idx2::idx2_err_code::NoError);
+  return ToList(&Outputs, OutputsMetadata);
 }
 
 
-/* [Begin, End) range (End is exclusive, hence the open bracket) */
-struct range
+/* Decode a region of one .idx2 file, returns (array, grid) where grid is as in ToTuple.
+A region with zero dims (the default) means the whole volume. */
+static nb::tuple
+PyDecodeOneFile(const std::string& InDir,
+                const std::string& InFile,
+                std::tuple<int, int, int> From,
+                std::tuple<int, int, int> Dims,
+                std::tuple<int, int, int> Downsampling,
+                double Accuracy)
 {
-  int Begin = 0;
-  int End = 0;
-};
+  input Input;
+  Input.InFile = InFile;
+  Input.Extent = idx2::extent(idx2::v3i(std::get<0>(From), std::get<1>(From), std::get<2>(From)),
+                              idx2::v3i(std::get<0>(Dims), std::get<1>(Dims), std::get<2>(Dims)));
+  Input.Downsampling3 = idx2::v3i(std::get<0>(Downsampling), std::get<1>(Downsampling), std::get<2>(Downsampling));
+  Input.Accuracy = Accuracy;
 
+  output Output;
+  idx2::expected<idx2::v3i, idx2::idx2_err_code> Result;
+  {
+    nb::gil_scoped_release Release;
+    Result = DecodeOneFile(InDir, Input, &Output);
+  }
+  if (!Result)
+    throw std::runtime_error(idx2::ToString(idx2::Error(Result)));
 
-/* Specify a face range as well as X and Y ranges within the faces. Useful for vertical slicing, for instance. */
-struct spatial_range
-{
-  int Face;
-  range XRange;
-  range YRange;
-};
+  auto Grid = ToTuple(Output.OutGrid);
+  return nb::make_tuple(ToNumpy(&Output), Grid);
+}
 
 
-/* The relative order of Time/Face/Depth in the output buffer */
-enum class order
+/* The Python objects of a submitted query, only touched (and freed) while holding the GIL */
+struct py_query
 {
-  DepthFaceTime, // Time varies fastest, then Face, then Depth
-  DepthTimeFace,
-  FaceTimeDepth,
-  FaceDepthTime,
-  TimeDepthFace,
-  TimeFaceDepth
+  nb::object Future;
+  nb::object Progress;
 };
 
 
-enum class slice_type
+static void
+PrintPythonError(nb::python_error& E)
 {
-  AlongX, AlongY, RotatedAlongX, RotatedAlongY
-};
+  E.restore();
+  PyErr_Print();
+}
 
 
-struct query_info
+/* Run a query on the query pool (shared by all the queries), returns a concurrent.futures.Future of the list of ToList.
+Progress (if not None) is called from a worker thread with (files done, total files).
+Cancelling the future skips the files that are not yet being decoded and stops the others at their next brick. */
+static nb::object
+PySubmitQuery(const query_info& QueryInfo, nb::object Progress)
 {
-  /* Parameters, needs to be changed if the default values below do not apply */
-  std::string NameFormat = "llc2160/u-face-%d-depth-%d-time-%d-%d.idx2"; // TODO: create an API to change this
-  std::string InDir = "/nobackupp19/vpascucc/converted_files"; // contain the relative/absolute path to the NameFormat above // TODO: create an API to change this
-  int TimeGroup = 1024; // every 1024 time steps are grouped into one .idx2 file
-
-  /* The following needs to be initialized before a query_info can be used */
-  std::vector<spatial_range> SpatialRanges;
-  range TimeRange;
-  range DepthRange;
-  order Order = order::DepthFaceTime; // TODO: create an API to control this
-
-  idx2::v3i Downsampling3;
-  double Accuracy = 0.01;
-
-  virtual const int N() const = 0;
-  virtual const int NumFaces() const = 0;
-  virtual const idx2::v3i* FaceDims3() const = 0; // get the dimensions of the faces
-
-
-  virtual void SetNameFormat(const std::string& NameFormat)
-  {
-    this->NameFormat = NameFormat;
-  }
-
-
-  virtual void SetInputDirectory(const std::string& InDir)
-  {
-    this->InDir = InDir;
-  }
-
-
-  virtual void SetTimeGroup(int TimeGroup)
-  {
-    this->TimeGroup = TimeGroup;
-  }
-
-
-  virtual void SetTimeRange(int TimeBegin, int TimeEnd)
-  {
-    TimeRange.Begin = TimeBegin;
-    TimeRange.End = TimeEnd;
-  }
-
-
-  virtual void SetDepthRange(int DepthBegin, int DepthEnd)
-  {
-    DepthRange.Begin = DepthBegin;
-    DepthRange.End = DepthEnd;
-  }
-
-
-  virtual void SetOrder(order Order)
-  {
-    this->Order = Order;
-  }
-
-  virtual void SetDownsamplingFactor(int DownsamplingX, int DownsamplingY, int DownsamplingTime)
-  {
-    this->Downsampling3 = idx2::v3i(DownsamplingX, DownsamplingY, DownsamplingTime);
-  }
-
-
-  virtual void SetAccuracy(double Accuracy)
-  {
-    this->Accuracy = Accuracy;
-  }
-
-
-  virtual void AddSpatialRange(int Face, int XBegin, int XEnd, int YBegin, int YEnd)
-  {
-    SpatialRanges.push_back(spatial_range{ Face, range{XBegin, XEnd}, range{YBegin, YEnd} });
-  }
-
-
-  virtual void AddFace(int Face)
-  {
-    const idx2::v3i& D3 = FaceDims3()[Face];
-    SpatialRanges.push_back(spatial_range{ Face, range{0, D3.X}, range{0, D3.Y}});
-  }
-
-
-  virtual void AddFaceSlice(int Face, slice_type SliceType, int Position)
-  {
-    const idx2::v3i& D3 = FaceDims3()[Face];
-    if (SliceType == slice_type::AlongX)
-      SpatialRanges.push_back(spatial_range{ Face, range{0, D3.X}, range{Position, Position + 1}});
-    else if (SliceType == slice_type::AlongY)
-      SpatialRanges.push_back(spatial_range{ Face, range{Position, Position + 1}, range{0, D3.Y}});
-    else if (SliceType == slice_type::RotatedAlongX)
-      AddFaceSlice(Face, slice_type::AlongY, D3.X - Position);
-    else if (SliceType == slice_type::RotatedAlongY)
-      AddFaceSlice(Face, slice_type::AlongX, Position);
-  }
-
-
-  virtual bool Verify() const
-  {
-    for (const auto& R : SpatialRanges) {
-      if (R.XRange.Begin >= R.XRange.End) {
-        printf("X range: [%d %d) is invalid\n", R.XRange.Begin, R.XRange.End);
-        return false;
+  nb::object Future = nb::module_::import_("concurrent.futures").attr("Future")();
+  py_query* Py = new py_query{ Future, Progress };
+
+  std::function<void(int, int)> OnProgress;
+  if (!Progress.is_none()) {
+    OnProgress = [Py](int Done, int Total) {
+      nb::gil_scoped_acquire Acquire;
+      try {
+        Py->Progress(Done, Total);
+      } catch (nb::python_error& E) {
+        PrintPythonError(E);
       }
-      if (R.YRange.Begin >= R.YRange.End) {
-        printf("Y range: [%d %d) is invalid\n", R.YRange.Begin, R.YRange.End);
-        return false;
+    };
+  }
+  auto OnDone = [Py](query_handle* Handle) {
+    nb::gil_scoped_acquire Acquire;
+    try {
+      if (!nb::cast<bool>(Py->Future.attr("cancelled")())) {
+        if (Handle->ErrCode != idx2::idx2_err_code::NoError) {
+          idx2::stref Code = idx2::ToString(Handle->ErrCode);
+          std::string Msg = Handle->ErrMsg.empty() ? std::string(Code.Ptr, Code.Size) : Handle->ErrMsg;
+          Py->Future.attr("set_exception")(nb::handle(PyExc_RuntimeError)(Msg));
+        } else {
+          Py->Future.attr("set_result")(ToList(&Handle->Outputs, Handle->OutputsMetadata));
+        }
       }
+    } catch (nb::python_error& E) {
+      PrintPythonError(E);
     }
-
-    if (TimeRange.Begin >= TimeRange.End) {
-      printf("Time range: [%d %d) is invalid\n", TimeRange.Begin, TimeRange.End);
-      return false;
-    }
-
-    if (DepthRange.Begin >= DepthRange.End) {
-      printf("Depth range: [%d %d) is invalid\n", DepthRange.Begin, DepthRange.End);
-      return false;
-    }
-
-    return true;
-  }
-};
-
-
-struct llc_2160_query_info : public query_info
-{
-  virtual const int N() const override
-  {
-    return 2160; // TODO: allow the user to change thid
-  }
-
-
-  virtual const int NumFaces() const override
-  {
-    return 5;
-  }
-
-
-  virtual const idx2::v3i* FaceDims3() const override
-  {
-    static constexpr int N = 2160; // TODO: allow the user to change this
-    static constexpr idx2::v3i FaceDims3[5] = { idx2::v3i(N, 3 * N, 1),
-                                                idx2::v3i(N, 3 * N, 1),
-                                                idx2::v3i(N,     N, 1),
-                                                idx2::v3i(3 * N, N, 1),
-                                                idx2::v3i(3 * N, N, 1) };
-    return FaceDims3;
-  }
-
-
-  virtual bool Verify() const override
-  {
-    // TODO: write this (verify theat x and y are withiin the range)
-    return true;
-  }
-
-
-  int SkipCapFace(int F) const
-  {
-    if (F > 2)
-      return F + 1;
-    return F;
-  }
-};
+    delete Py;
+  };
+
+  /* the workers need the GIL to call back, so none of them can finish before we return */
+  std::shared_ptr<query_handle> Handle = SubmitQuery(QueryInfo, OnProgress, OnDone);
+  Future.attr("add_done_callback")(nb::cpp_function([Handle](nb::handle F) {
+    if (nb::cast<bool>(F.attr("cancelled")()))
+      Cancel(Handle.get());
+  }));
+  return Future;
+}
 
 
-struct output_metadata
+/* The asyncio version of PySubmitQuery (to be called from a coroutine), Progress is still called from a worker thread */
+static nb::object
+PySubmitQueryAsync(const query_info& QueryInfo, nb::object Progress)
 {
-  int Face;
-  int Depth;
-  int Time;
-};
+  return nb::module_::import_("asyncio").attr("wrap_future")(PySubmitQuery(QueryInfo, Progress));
+}
 
 
-idx2::v3i GetStrides(int NumFaces, int NumDepths, int NumTimes, order Order)
+/* Returns the frame at Time as in ToList (the arrays take the buffers of the frame) */
+static nb::list
+PyGetFrame(animation* Anim, int Time)
 {
-  int FaceStride = 1, DepthStride = 1, TimeStride = 1;
-  switch (Order) {
-  case order::DepthFaceTime:
-    TimeStride = 1; FaceStride = NumTimes; DepthStride = NumFaces * NumTimes;
-    break;
-  case order::DepthTimeFace:
-    FaceStride = 1; TimeStride = NumFaces; DepthStride = NumTimes * NumFaces;
-    break;
-  case order::FaceDepthTime:
-    TimeStride = 1; DepthStride = NumTimes; FaceStride = NumDepths * NumTimes;
-    break;
-  case order::FaceTimeDepth:
-    DepthStride = 1; TimeStride = NumDepths; FaceStride = NumTimes * NumDepths;
-    break;
-  case order::TimeDepthFace:
-    FaceStride = 1; DepthStride = NumFaces; TimeStride = NumDepths * NumFaces;
-    break;
-  case order::TimeFaceDepth:
-    DepthStride = 1; FaceStride = NumDepths; TimeStride = NumFaces * NumDepths;
-    break;
-  default:
-    idx2_Assert(false);
+  std::vector<output>* Outputs = nullptr;
+  const std::vector<output_metadata>* OutputsMetadata = nullptr;
+  idx2::error<idx2::idx2_err_code> Result;
+  {
+    nb::gil_scoped_release Release;
+    Result = GetFrame(Anim, Time, &Outputs, &OutputsMetadata);
   }
+  if (!Result)
+    throw std::runtime_error(idx2::ToString(Result));
 
-  return idx2::v3i(FaceStride, DepthStride, TimeStride);
+  return ToList(Outputs, *OutputsMetadata);
 }
 
-
-idx2::error<idx2::idx2_err_code>
-ExecuteQuery(const query_info& QueryInfo,
-             std::vector<output>* Outputs,
-             std::vector<output_metadata>* OutputsMetadata)
+/* Append every query of this process to a trace (an empty FileName stops the recording), see SetQueryTrace */
+static void
+PySetQueryTrace(const std::string& FileName)
 {
-  idx2_ReturnErrorIf(!QueryInfo.Verify(), idx2::err_code::DimensionMismatched);
-  const int NumDepths = QueryInfo.DepthRange.End - QueryInfo.DepthRange.Begin;
-  const int NumTimes = QueryInfo.TimeRange.End - QueryInfo.TimeRange.Begin;
-  const int NumFaces = QueryInfo.SpatialRanges.size();
-  std::vector<input> Inputs(NumDepths * NumFaces * NumTimes);
-  Outputs->resize(Inputs.size());
-  OutputsMetadata->resize(Inputs.size());
-  idx2::v3i Strides3 = GetStrides(NumFaces, NumDepths, NumTimes, QueryInfo.Order);
-  int FaceStride = Strides3.X;
-  int DepthStride = Strides3.Y;
-  int TimeStride = Strides3.Z;
-  for (int D = 0; D + QueryInfo.DepthRange.Begin < QueryInfo.DepthRange.End; ++D) {
-    int Depth = QueryInfo.DepthRange.Begin + D;
-    for (int F = 0; F < QueryInfo.SpatialRanges.size(); ++F) {
-      for (int T = 0; T+ QueryInfo.TimeRange.Begin < QueryInfo.TimeRange.End; ++T) {
-        int Time = QueryInfo.TimeRange.Begin + T;
-        int Index = T * TimeStride + F * FaceStride + D * DepthStride;
-        input& CurrentInput = Inputs[Index];
-        const spatial_range& R = QueryInfo.SpatialRanges[F];
-        CurrentInput.Extent = idx2::extent(idx2::v3i(R.XRange.Begin, R.YRange.Begin, Time), idx2::v3i(R.XRange.End - R.XRange.Begin, R.YRange.End - R.YRange.Begin, 1));
-        int TimeBegin = Time / QueryInfo.TimeGroup;
-        int TimeEnd = TimeBegin + QueryInfo.TimeGroup;
-        CurrentInput.InFile.resize(256);
-        sprintf(CurrentInput.InFile.data(), QueryInfo.NameFormat.data(), R.Face, Depth, TimeBegin, TimeEnd);
-        CurrentInput.Accuracy = QueryInfo.Accuracy;
-        CurrentInput.Downsampling3 = QueryInfo.Downsampling3;
-        if (R.Face > 2) {
-          idx2::Swap(&CurrentInput.Downsampling3.X, &CurrentInput.Downsampling3.Y);
-        }
-
-        (*OutputsMetadata)[Index].Depth = Depth;
-        (*OutputsMetadata)[Index].Time = Time;
-        (*OutputsMetadata)[Index].Face = R.Face;
-      }
-    }
-  }
-  idx2_PropagateIfError(DecodeMultipleFiles(QueryInfo.InDir, Inputs, Outputs));
-  return idx2_Error(idx2::err_code::NoError);
+  auto Result = SetQueryTrace(FileName.empty() ? nullptr : FileName.c_str());
+  if (!Result)
+    throw std::runtime_error(idx2::ToString(Result));
 }
 
-
-/* Do vertical slicing */
-idx2::error<idx2::idx2_err_code>
-VerticalSlicingExample()
+#if defined(__linux__)
+/* Execute the query on an idx2-server, returns a list as in ToList.
+The arrays are views into the shared memory of the reply, which lives as long as any of them. */
+static nb::list
+PyExecuteRemoteQuery(const std::string& SocketPath, const query_info& QueryInfo)
 {
-  // TODO: either interpolate or snap the slice to one
-
-  /* We first slice faces 0, 1, 3, 4 along X axis, at Y = 3000, for time step 16 */
-  llc_2160_query_info QueryInfo;
-  //QueryInfo.SetNameFormat("llc2160/u-face-%d-depth-%d-time-%d-%d.idx2");
-  //QueryInfo.SetInputDirectory("/nobackupp19/vpascucc/converted_files");
-  QueryInfo.SetNameFormat("D:/Datasets/nasa/llc_2160_32/llc2160/u-face-%d-depth-%d-time-%d-%d.idx2");
-  QueryInfo.SetInputDirectory("D:/Datasets/nasa/llc_2160_32");
-  QueryInfo.SetTimeGroup(32);
-  QueryInfo.SetDepthRange(0, 90);
-  QueryInfo.SetTimeRange(16, 17);
-  QueryInfo.SetOrder(order::TimeDepthFace);
-  QueryInfo.SetDownsamplingFactor(0, 2, 2);
-  QueryInfo.SetAccuracy(0.01);
-
-  std::vector<output> Outputs;
-  std::vector<output_metadata> OutputsMetadata;
-
-  { /* We first do vertical slicing at time = 16 and at Y = 3000 that will cut across the four lat-lon faces
-    * +--------+ +--------+ +--------+ +--------+
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * --------------------------------------------->
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * +--------+ +--------+ +--------+ +--------+
-    */
-    std::array<int, 4> Faces = { 0, 1}; // all the "lat-lon" faces
-    int SlicePosition = 3000;
-    for (int F = 0; F < Faces.size(); ++F) {
-      if (Faces[F] < 2)
-        QueryInfo.AddFaceSlice(Faces[F], slice_type::AlongX, SlicePosition);
-      else if (Faces[F] > 2) // for faces 3 and 4, we need to "rotate" the slice
-        QueryInfo.AddFaceSlice(Faces[F], slice_type::RotatedAlongX, SlicePosition);
-    }
-    auto ResultOk = ExecuteQuery(QueryInfo, &Outputs, &OutputsMetadata);
-    if (!ResultOk) {
-      fprintf(stderr, "%s\n", ToString(ResultOk));                                                   \
-      return ResultOk;
-    }
-
-    /* write the output buffers to files (note that faces 3 and 4 are rotated) */
-    for (int I = 0; I < Outputs.size(); ++I) {
-      char FileName[256];
-      sprintf(FileName, "face-%d-depth-%d", OutputsMetadata[I].Face, OutputsMetadata[I].Depth);
-      idx2::WriteBuffer(FileName, Outputs[I].OutBuffer);
-    }
+  auto Result = std::make_shared<remote_result>();
+  idx2::error<idx2::idx2_err_code> Ok;
+  {
+    nb::gil_scoped_release Release;
+    Ok = ExecuteRemoteQuery(SocketPath, QueryInfo, Result.get());
   }
-
-  /* Deallocate the output memory */
-  Outputs.clear();
-  OutputsMetadata.clear();
-
- // { /* Now we do vertical slicing across 32 time steps, at X = 1000 on face 3 only
- //   * +--------+ +--------+ +---|----+ +--------+
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * +--------+ +--------+ +---|----+ +--------+
-	//*/
- //   QueryInfo.SetTimeRange(0, 32);
- //   std::array<int, 4> Faces = { 3 }; // all the "lat-lon" faces
- //   int SlicePosition = 1000;
- //   for (int F = 0; F < Faces.size(); ++F) {
- //     if (Faces[F] < 2)
- //       QueryInfo.AddFaceSlice(Faces[F], slice_type::AlongY, SlicePosition);
- //     else if (Faces[F] > 2) // for faces 3 and 4, we need to "rotate" the slice
- //       QueryInfo.AddFaceSlice(Faces[F], slice_type::RotatedAlongY, SlicePosition);
- //   }
- //   auto Result = ExecuteQuery(QueryInfo, &Outputs, &OutputsMetadata);
- //   if (!Result) {
- //     fprintf(stderr, "%s\n", ToString(Result));
- //     return Result;
- //   }
- // }
-
-  return idx2_Error(idx2::err_code::NoError);
+  if (!Ok)
+    throw std::runtime_error(idx2::ToString(Ok));
+
+  nb::list List;
+  for (remote_output& O : Result->Outputs) {
+    nb::capsule Owner(new std::shared_ptr<remote_result>(Result), [](void* P) noexcept {
+      delete (std::shared_ptr<remote_result>*)P;
+    });
+    idx2::v3i D3 = idx2::Dims(O.OutGrid);
+    size_t Shape[3] = { size_t(D3.Z), size_t(D3.Y), size_t(D3.X) };
+    if (O.OutBuffer.Bytes != idx2::Prod<idx2::i64>(D3) * idx2::SizeOf(O.DataType)) // SendRequest checks it too
+      throw std::runtime_error("The size of an output does not match its dimensions");
+    auto DType = O.DataType == idx2::dtype::float64 ? nb::dtype<double>() : nb::dtype<float>();
+    array3 Array(O.OutBuffer.Data, 3, Shape, Owner, nullptr, DType);
+    List.append(nb::make_tuple(Array, O.Metadata.Face, O.Metadata.Depth, O.Metadata.Time));
+  }
+  return List;
 }
 
 
-/* Do vertical slicing */
-idx2::error<idx2::idx2_err_code>
-VerticalSlicingExample2()
+/* Same as ExecuteQuery, split across the query servers at Workers (see ExecuteDistributedQuery) */
+static nb::list
+PyExecuteDistributedQuery(const std::vector<std::string>& Workers, const query_info& QueryInfo)
 {
-  // TODO: either interpolate or snap the slice to one
-
-  /* We first slice faces 0, 1, 3, 4 along X axis, at Y = 3000, for time step 16 */
-  llc_2160_query_info QueryInfo;
-  //QueryInfo.SetNameFormat("/nobackupp19/vpascucc/converted_files/nasa-encoding-framework/llc2160/u-face-%d-depth-%d-time-%d-%d.idx2");
-  //QueryInfo.SetInputDirectory("/nobackupp19/vpascucc/converted_files/nasa-encoding-framework/");
-  QueryInfo.SetNameFormat("D:/Datasets/nasa/llc_2160_32/llc2160/u-face-%d-depth-%d-time-%d-%d.idx2");
-  QueryInfo.SetInputDirectory("D:/Datasets/nasa/llc_2160_32");
-  QueryInfo.SetTimeGroup(1024);
-  QueryInfo.SetDepthRange(0, 2);
-  QueryInfo.SetTimeRange(16, 17);
-  QueryInfo.SetOrder(order::TimeDepthFace);
-  QueryInfo.SetDownsamplingFactor(0, 2, 2);
-  QueryInfo.SetAccuracy(0.01);
-
   std::vector<output> Outputs;
   std::vector<output_metadata> OutputsMetadata;
-
-  { /* We first do vertical slicing at time = 16 and at Y = 3000 that will cut across the four lat-lon faces
-    * +--------+ +--------+ +--------+ +--------+
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * --------------------------------------------->
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * |        | |        | |        | |        |
-    * +--------+ +--------+ +--------+ +--------+
-    */
-    /*std::array<int, 1> Faces = { 0 };//, 1, 3, 4 }; // all the "lat-lon" faces
-    int SlicePosition = 3000;
-    for (int F = 0; F < Faces.size(); ++F) {
-      if (Faces[F] < 2)
-        QueryInfo.AddFaceSlice(Faces[F], slice_type::AlongX, SlicePosition);
-      else if (Faces[F] > 2) // for faces 3 and 4, we need to "rotate" the slice
-        QueryInfo.AddFaceSlice(Faces[F], slice_type::RotatedAlongX, SlicePosition);
-	}
-
-    auto ResultOk = ExecuteQuery(QueryInfo, &Outputs, &OutputsMetadata);
-    if (!ResultOk) {
-      fprintf(stderr, "%s\n", ToString(ResultOk));
-      return ResultOk;
-      }
-
-    /* write the output buffers to files (note that faces 3 and 4 are rotated) */
-    /*for (int I = 0; I < Outputs.size(); ++I) {
-      char FileName[256];
-      sprintf(FileName, "face-%d-depth-%d", OutputsMetadata[I].Face, OutputsMetadata[I].Depth);
-      idx2::WriteBuffer(FileName, Outputs[I].OutBuffer);
-      }*/
-    }
-
-  /* Deallocate the output memory */
-  /*Outputs.clear();
-    OutputsMetadata.clear();*/
-
-  { /* Now we do vertical slicing across 32 time steps, at X = 1000 on face 3 only
- //   * +--------+ +--------+ +---|----+ +--------+
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * |        | |        | |   |    | |        |
- //   * +--------+ +--------+ +---|----+ +--------+
-	//*/
-    QueryInfo.SetTimeRange(0, 32);
-    std::array<int, 1> Faces = { 0 }; // all the "lat-lon" faces
-    int SlicePosition = 1000;
-    for (int F = 0; F < Faces.size(); ++F) {
-      if (Faces[F] < 2)
-        QueryInfo.AddFaceSlice(Faces[F], slice_type::AlongY, SlicePosition);
-      else if (Faces[F] > 2) // for faces 3 and 4, we need to "rotate" the slice
-        QueryInfo.AddFaceSlice(Faces[F], slice_type::RotatedAlongY, SlicePosition);
-    }
-    auto Result = ExecuteQuery(QueryInfo, &Outputs, &OutputsMetadata);
-    if (!Result) {
-      fprintf(stderr, "%s\n", ToString(Result));
-      return Result;
-      }
+  idx2::error<idx2::idx2_err_code> Result;
+  {
+    nb::gil_scoped_release Release;
+    Result = ExecuteDistributedQuery(Workers, QueryInfo, &Outputs, &OutputsMetadata);
   }
+  if (!Result)
+    throw std::runtime_error(idx2::ToString(Result));
 
-  return idx2_Error(idx2::err_code::NoError);
-}
-
-namespace nb = nanobind;
-
-nb::tensor<nb::numpy, float, nb::shape<nb::any, nb::any, nb::any>>
-VerticalSlice()
-{
-
-  size_t Shape[3] = { (size_t)1, (size_t)1, (size_t)1 };
-  printf("hello world\n");
-  return nb::tensor<nb::numpy, float, nb::shape<nb::any, nb::any, nb::any>>(nullptr, 3, Shape);
+  return ToList(&Outputs, OutputsMetadata);
 }
+#endif
 
 NB_MODULE(idx2Nasa, M)
 {
-  M.def("VerticalSlice", VerticalSlice);
+  nb::enum_<order>(M, "Order")
+    .value("DepthFaceTime", order::DepthFaceTime)
+    .value("DepthTimeFace", order::DepthTimeFace)
+    .value("FaceTimeDepth", order::FaceTimeDepth)
+    .value("FaceDepthTime", order::FaceDepthTime)
+    .value("TimeDepthFace", order::TimeDepthFace)
+    .value("TimeFaceDepth", order::TimeFaceDepth);
+
+  nb::enum_<query_priority>(M, "QueryPriority")
+    .value("Interactive", query_priority::Interactive)
+    .value("Batch", query_priority::Batch);
+
+  nb::enum_<slice_type>(M, "SliceType")
+    .value("AlongX", slice_type::AlongX)
+    .value("AlongY", slice_type::AlongY)
+    .value("RotatedAlongX", slice_type::RotatedAlongX)
+    .value("RotatedAlongY", slice_type::RotatedAlongY);
+
+  nb::class_<query_info>(M, "QueryInfo")
+    .def("SetNameFormat", &query_info::SetNameFormat)
+    .def("SetInputDirectory", &query_info::SetInputDirectory)
+    .def("SetTimeGroup", &query_info::SetTimeGroup)
+    .def("SetTimeRange", &query_info::SetTimeRange)
+    .def("SetDepthRange", &query_info::SetDepthRange)
+    .def("SetOrder", &query_info::SetOrder)
+    .def("SetDownsamplingFactor", &query_info::SetDownsamplingFactor)
+    .def("SetAccuracy", &query_info::SetAccuracy)
+    .def("SetPriority", &query_info::SetPriority)
+    .def("SetTargetRmse", &query_info::SetTargetRmse)
+    .def("SetTargetPsnr", &query_info::SetTargetPsnr)
+    .def("SetTargetMaxError", &query_info::SetTargetMaxError)
+    .def("AddSpatialRange", &query_info::AddSpatialRange)
+    .def("AddViewport",
+         [](query_info& Q, int Face, int XBegin, int XEnd, int YBegin, int YEnd, int Width, int Height, double PixelAccuracy) {
+           if (!Q.AddViewport(Face, XBegin, XEnd, YBegin, YEnd, Width, Height, PixelAccuracy))
+             throw std::invalid_argument("The viewport must have a positive width and height"); // a ValueError
+         },
+         nb::arg("Face"), nb::arg("XBegin"), nb::arg("XEnd"), nb::arg("YBegin"), nb::arg("YEnd"),
+         nb::arg("Width"), nb::arg("Height"), nb::arg("PixelAccuracy") = 0.0)
+    .def("AddFace", &query_info::AddFace)
+    .def("AddFaceSlice", &query_info::AddFaceSlice)
+    .def("Verify", &query_info::Verify);
+
+  nb::class_<llc_2160_query_info, query_info>(M, "LLC2160QueryInfo")
+    .def(nb::init<>());
+
+  nb::class_<animation>(M, "Animation")
+    .def("__init__", [](animation* Anim, const query_info& QueryInfo, int TimeBegin, int TimeEnd, int Direction, int MaxPrefetch) {
+      new (Anim) animation();
+      Anim->QueryInfo = &QueryInfo;
+      Anim->TimeRange = range{ TimeBegin, TimeEnd };
+      Anim->Direction = Direction;
+      Anim->MaxPrefetch = MaxPrefetch;
+    }, nb::arg("QueryInfo"), nb::arg("TimeBegin"), nb::arg("TimeEnd"), nb::arg("Direction") = 1, nb::arg("MaxPrefetch") = 8,
+       nb::keep_alive<1, 2>()) // the animation refers to the query info
+    .def_rw("Direction", &animation::Direction)
+    .def_rw("MaxPrefetch", &animation::MaxPrefetch)
+    .def_ro("NumPrefetch", &animation::NumPrefetch)
+    .def("GetFrame", &PyGetFrame, nb::arg("Time"));
+
+  M.def("ExecuteQuery", &PyExecuteQuery, nb::arg("QueryInfo"));
+  M.def("GetQueryPreviews", &PyGetQueryPreviews, nb::arg("QueryInfo"));
+  M.def("SubmitQuery", &PySubmitQuery, nb::arg("QueryInfo"), nb::arg("Progress") = nb::none());
+  M.def("SubmitQueryAsync", &PySubmitQueryAsync, nb::arg("QueryInfo"), nb::arg("Progress") = nb::none());
+  M.def("SetQueryTrace", &PySetQueryTrace, nb::arg("FileName"));
+#if defined(__linux__)
+  M.def("ExecuteRemoteQuery", &PyExecuteRemoteQuery, nb::arg("SocketPath"), nb::arg("QueryInfo"));
+  M.def("ExecuteDistributedQuery", &PyExecuteDistributedQuery, nb::arg("Workers"), nb::arg("QueryInfo"));
+#endif
+  M.def("DecodeOneFile", &PyDecodeOneFile,
+        nb::arg("InDir"), nb::arg("InFile"),
+        nb::arg("From") = std::make_tuple(0, 0, 0), nb::arg("Dims") = std::make_tuple(0, 0, 0),
+        nb::arg("Downsampling") = std::make_tuple(0, 0, 0), nb::arg("Accuracy") = 0.0);
 }
-
-int main()
-{
-  VerticalSlicingExample();
-  // vertical slicing across time
-  // get five faces across time at a certain depth
-  // get five faces across depths at a certain time
-  // get five faces across multiple depths and time
-
-	return 0;
-}
-
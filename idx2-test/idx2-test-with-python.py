@@ -0,0 +1,94 @@
+# Smoke test of the Python bindings (module idx2Nasa, see idx2-test-with-python.cpp).
+# Encodes a small synthetic dataset with idx2-workload, then checks that the decoded arrays own the buffers of the
+# decoder (no copy) and that several Python threads can decode at the same time.
+#
+# Usage: python idx2-test-with-python.py <path to idx2-workload> <scratch dir>
+# (with the directory of the idx2Nasa module on PYTHONPATH, ctest sets it up)
+import gc
+import math
+import os
+import subprocess
+import sys
+import threading
+
+import numpy as np
+import idx2Nasa
+
+N = 64  # the faces 0 and 1 are N x 3N
+NTimes = 64
+
+
+def Encode(Workload, Dir):
+  subprocess.run([Workload, "--dir", Dir, "--n", str(N), "--depths", "1", "--times", str(NTimes), "--levels", "1",
+                  "--reps", "1", "--cache", "warm", "--frames", "1", "--mix", "vertical-slice", "--reencode"],
+                 check=True, stdout=subprocess.DEVNULL)
+  return os.path.join(Dir, "llc%d" % N, "u-face-%d-depth-0-time-0-%d.idx2")
+
+
+# The field of GenerateFace in idx2-workload.cpp at depth 0, without the noise, as (time, y, x)
+def Reference(Face):
+  T, Y, X = np.meshgrid(np.arange(NTimes) / NTimes, np.arange(3 * N) / (3 * N), np.arange(N) / N, indexing="ij")
+  TwoPi = 2 * math.pi
+  Gyres = 5 * np.sin(TwoPi * (X + 0.2 * Face)) * np.cos(TwoPi * 0.5 * Y)
+  Eddies = np.sin(TwoPi * 9 * (X + 0.05 * T)) * np.sin(TwoPi * 7 * (Y - 0.03 * T))
+  return Gyres + Eddies
+
+
+def CheckZeroCopy(Dir, FileFormat):
+  Array, Grid = idx2Nasa.DecodeOneFile(Dir, FileFormat % (0, NTimes))
+  assert Grid[1] == (N, 3 * N, NTimes), Grid
+  assert Array.shape == (NTimes, 3 * N, N) and Array.dtype == np.float32, (Array.shape, Array.dtype)
+  assert Array.flags.c_contiguous
+  # the array is a view of the output buffer of the decoder, kept alive by its base object
+  assert not Array.flags.owndata and Array.base is not None
+  Error = np.abs(Array - Reference(0)).max()
+  assert Error < 0.02, Error  # the noise is within +-0.01
+  # a view of the array keeps the buffer alive once the array itself is gone
+  View = Array[1:, :, :]
+  del Array
+  gc.collect()
+  assert np.abs(View - Reference(0)[1:, :, :]).max() < 0.02
+
+
+def CheckParallelDecode(Dir, FileFormat):
+  Expected = [idx2Nasa.DecodeOneFile(Dir, FileFormat % (F, NTimes))[0] for F in (0, 1)]
+  NThreads = 8
+  Results = [None] * NThreads
+  Errors = []
+  Start = threading.Barrier(NThreads)
+
+  def Run(I):
+    try:
+      Start.wait()
+      for _ in range(4):
+        Results[I] = idx2Nasa.DecodeOneFile(Dir, FileFormat % (I % 2, NTimes))[0]
+    except Exception as E:  # reported by the main thread
+      Errors.append(E)
+
+  Threads = [threading.Thread(target=Run, args=(I,)) for I in range(NThreads)]
+  for T in Threads:
+    T.start()
+  for T in Threads:
+    T.join()
+  assert not Errors, Errors
+  for I, R in enumerate(Results):
+    assert np.array_equal(R, Expected[I % 2]), "thread %d decoded a different array" % I
+  # every decode has its own buffer
+  Addresses = set(R.__array_interface__["data"][0] for R in Results)
+  assert len(Addresses) == NThreads
+
+
+def Main():
+  if len(sys.argv) != 3:
+    print("Usage: python %s <path to idx2-workload> <scratch dir>" % sys.argv[0])
+    return 1
+  Dir = sys.argv[2]
+  FileFormat = Encode(sys.argv[1], Dir)
+  CheckZeroCopy(Dir, FileFormat)
+  CheckParallelDecode(Dir, FileFormat)
+  print("ok")
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(Main())
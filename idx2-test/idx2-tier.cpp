@@ -0,0 +1,94 @@
+// Tiering tool. Places the files of an encoded field on two storage tiers: the brick data of the coarsest levels and
+// of the top bit planes, and the exponents and the truncation points that every decode reads, on a fast tier (e.g.,
+// an NVMe drive), and the rest on a capacity tier (the directory of the input, e.g., a disk array or a parallel file
+// system). A coarse or low-precision query then reads only from the fast tier, and a full-precision query reads the
+// rest from the capacity tier. Levels can only be placed on their own tier if they are not grouped into the same files
+// (they are not by default), and bit planes if they are not grouped either (re-chunk with --group-bit-planes false
+// first, see idx2-rechunk). The files are moved (renamed when the tiers share a file system), not rewritten, and the
+// metadata records the placement, so that the decoder finds every file on its tier (see GetTierDir); the fast-tier
+// directory can be overridden when decoding (see params::FastDir), e.g. when it is mounted elsewhere on the compute
+// nodes. The encoder can also place the files itself (params::FastDir, FastLevels and FastBitPlanes).
+// Do not run this while the field is being queried: a query could open a file while it is being moved.
+//
+// Usage: idx2-tier --input llc2160/u-face-2-depth-0-time-0-1024.idx2 --fast-dir /nvme/idx2
+//                  [--in-dir .] (the capacity tier, that contains llc2160/, by default the parent of its directory)
+//                  [--fast-levels 1] (the number of coarsest levels on the fast tier)
+//                  [--fast-bit-planes 4] (the number of top bit planes on the fast tier)
+// --fast-dir none moves everything back to the capacity tier.
+#define idx2_Implementation
+#include "idx2.hpp"
+#include <filesystem>
+#include <string>
+
+
+/* The number of files and bytes under a directory */
+static void
+CountFiles(const std::filesystem::path& Dir, idx2::i64* NFiles, idx2::i64* NBytes)
+{
+  *NFiles = *NBytes = 0;
+  std::error_code Ec;
+  for (std::filesystem::recursive_directory_iterator It(Dir, Ec), End; !Ec && It != End; It.increment(Ec)) {
+    if (It->is_regular_file()) {
+      ++*NFiles;
+      *NBytes += (idx2::i64)It->file_size();
+    }
+  }
+}
+
+
+int
+main(int Argc, const char** Argv)
+{
+  using namespace idx2;
+  cstr Input = nullptr;
+  cstr FastDir = nullptr;
+  if (!OptVal(Argc, Argv, "--input", &Input) || !OptVal(Argc, Argv, "--fast-dir", &FastDir)) {
+    fprintf(stderr, "Usage: idx2-tier --input file.idx2 --fast-dir dir|none [--in-dir dir] [--fast-levels n] [--fast-bit-planes n]\n");
+    return 1;
+  }
+  std::string InDir = std::filesystem::path(Input).parent_path().parent_path().string();
+  cstr Str = nullptr;
+  if (OptVal(Argc, Argv, "--in-dir", &Str))
+    InDir = Str;
+  if (InDir.empty())
+    InDir = ".";
+  int FastLevels = 0, FastBitPlanes = 0;
+  OptVal(Argc, Argv, "--fast-levels", &FastLevels);
+  OptVal(Argc, Argv, "--fast-bit-planes", &FastBitPlanes);
+  if (strcmp(FastDir, "none") == 0)
+    FastDir = nullptr;
+
+  idx2_file Idx2;
+  idx2_CleanUp(Dealloc(&Idx2));
+  auto Result = ReadMetaFile(&Idx2, Input);
+  if (!Result) {
+    fprintf(stderr, "%s\n", ToString(Result));
+    return 1;
+  }
+  SetDir(&Idx2, InDir.c_str());
+  if (Idx2.FastDir[0])
+    printf("%s: fast tier %s (levels from %d, bit planes from %d)\n", Input, Idx2.FastDir, Idx2.FastMinLevel, Idx2.FastMinBitPlane);
+  Result = PlaceTiers(&Idx2, FastDir, FastLevels, FastBitPlanes);
+  if (!Result) {
+    fprintf(stderr, "%s\n", ToString(Result));
+    return 1;
+  }
+  params P;
+  snprintf(P.Meta.Name, sizeof(P.Meta.Name), "%s", Idx2.Name);
+  snprintf(P.Meta.Field, sizeof(P.Meta.Field), "%s", Idx2.Field);
+  WriteMetaFile(Idx2, P, Input);
+
+  i64 NFiles = 0, NBytes = 0;
+  CountFiles(std::filesystem::path(Idx2.Dir) / Idx2.Name / Idx2.Field, &NFiles, &NBytes);
+  printf("capacity tier %s: %" PRIi64 " files, %.1f MB\n", Idx2.Dir, NFiles, NBytes / 1e6);
+  if (Idx2.FastDir[0]) {
+    CountFiles(std::filesystem::path(Idx2.FastDir) / Idx2.Name / Idx2.Field, &NFiles, &NBytes);
+    printf("fast tier %s: %" PRIi64 " files, %.1f MB", Idx2.FastDir, NFiles, NBytes / 1e6);
+    if (Idx2.FastMinLevel < Idx2.NLevels)
+      printf(", levels %d to %d", Idx2.FastMinLevel, Idx2.NLevels - 1);
+    if (Idx2.FastMinBitPlane != traits<i16>::Max)
+      printf(", bit planes from %d", Idx2.FastMinBitPlane);
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,462 @@
+// Tile pyramid generator for web maps. Renders one face of an LLC dataset (at one depth, for a range of time
+// steps) into colormapped XYZ tiles: <out>/<time>/<zoom>/<x>/<y>.png, where zoom 0 is a single tile and zoom
+// --max-zoom (by default, the zoom at which the face has its full resolution) is the last one. Each file is
+// decoded once per batch of time steps, at the downsampling factor of the last zoom (so only the wavelet levels
+// that it needs are read), and every coarser zoom is averaged down from it; a pyramid then costs about as much
+// as decoding its last zoom. The files are decoded in parallel, the time steps are tiled in parallel (all on the
+// query pool), and the zooms of a time step are written coarsest first. Rows go top to bottom, like imshow.
+//
+// Usage: idx2-tiles [--dir /nobackupp19/vpascucc/converted_files] [--name-format llc2160/u-face-%d-depth-%d-time-%d-%d.idx2]
+//                   [--n 2160] [--time-group 1024] [--face 2] [--depth 0] [--times 0 1] [--batch 8] [--out ./tiles]
+//                   [--tile-size 256] [--max-zoom 3] [--accuracy 0.01] [--colormap viridis|coolwarm|gray]
+//                   [--vmin -1 --vmax 1] (by default, the range of the first time step)
+// The tiles are stored as uncompressed PNG, run them through a PNG optimizer before serving them if size matters.
+#define idx2_Implementation
+#include "idx2-query.hpp"
+#include <filesystem>
+#include <math.h>
+
+
+struct tiles_config
+{
+  std::string Dir = "/nobackupp19/vpascucc/converted_files";
+  std::string NameFormat = "llc2160/u-face-%d-depth-%d-time-%d-%d.idx2";
+  std::string OutDir = "./tiles";
+  int N = 2160;
+  int TimeGroup = 1024;
+  int Face = 2;
+  int Depth = 0;
+  idx2::v2i Times = idx2::v2i(0, 1); // [begin, end)
+  int Batch = 8; // time steps decoded at once (they are kept in memory until they are tiled)
+  int TileSize = 256;
+  int MaxZoom = -1; // -1 means full resolution
+  double Accuracy = 0.01;
+  idx2::cstr Colormap = "viridis";
+  double VMin = 0, VMax = 0; // the range of values mapped to the colormap (VMin = VMax means not set)
+};
+
+
+/* The LLC layout of faces, for any N */
+struct tiles_query_info : public query_info
+{
+  int FaceN = 2160;
+  idx2::v3i FaceDims3_[5];
+
+  tiles_query_info(const tiles_config& Config)
+  {
+    FaceN = Config.N;
+    FaceDims3_[0] = idx2::v3i(FaceN, 3 * FaceN, 1);
+    FaceDims3_[1] = idx2::v3i(FaceN, 3 * FaceN, 1);
+    FaceDims3_[2] = idx2::v3i(FaceN, FaceN, 1);
+    FaceDims3_[3] = idx2::v3i(3 * FaceN, FaceN, 1);
+    FaceDims3_[4] = idx2::v3i(3 * FaceN, FaceN, 1);
+    SetNameFormat(Config.NameFormat);
+    SetInputDirectory(Config.Dir);
+    SetTimeGroup(Config.TimeGroup);
+    SetDepthRange(Config.Depth, Config.Depth + 1);
+    SetAccuracy(Config.Accuracy);
+    AddFace(Config.Face);
+  }
+
+
+  virtual const int N() const override
+  {
+    return FaceN;
+  }
+
+
+  virtual const int NumFaces() const override
+  {
+    return 5;
+  }
+
+
+  virtual const idx2::v3i* FaceDims3() const override
+  {
+    return FaceDims3_;
+  }
+};
+
+
+/* ---------------------- colormaps ----------------------*/
+struct colormap
+{
+  idx2::cstr Name;
+  idx2::u8 Stops[9][3]; // evenly spaced over [0, 1]
+};
+
+
+static const colormap Colormaps[] = {
+  { "viridis", { { 68, 1, 84 }, { 71, 44, 122 }, { 59, 81, 139 }, { 44, 113, 142 }, { 33, 144, 141 },
+                 { 39, 173, 129 }, { 92, 200, 99 }, { 170, 220, 50 }, { 253, 231, 37 } } },
+  { "coolwarm", { { 59, 76, 192 }, { 98, 130, 234 }, { 141, 176, 254 }, { 184, 208, 249 }, { 221, 221, 221 },
+                  { 245, 196, 173 }, { 244, 154, 123 }, { 222, 96, 77 }, { 180, 4, 38 } } },
+  { "gray", { { 0, 0, 0 }, { 32, 32, 32 }, { 64, 64, 64 }, { 96, 96, 96 }, { 128, 128, 128 },
+              { 159, 159, 159 }, { 191, 191, 191 }, { 223, 223, 223 }, { 255, 255, 255 } } },
+};
+
+
+static const colormap*
+GetColormap(idx2::cstr Name)
+{
+  for (const colormap& C : Colormaps) {
+    if (strcmp(C.Name, Name) == 0)
+      return &C;
+  }
+  return nullptr;
+}
+
+
+/* Write the RGBA color of V (transparent if V is not finite) */
+static void
+ApplyColormap(const colormap& C, double VMin, double VMax, float V, idx2::u8* Rgba)
+{
+  if (!std::isfinite(V)) {
+    Rgba[0] = Rgba[1] = Rgba[2] = Rgba[3] = 0;
+    return;
+  }
+  double T = idx2::Min(idx2::Max((V - VMin) / (VMax - VMin), 0.0), 1.0) * 8;
+  int I = idx2::Min(int(T), 7);
+  double F = T - I;
+  for (int K = 0; K < 3; ++K)
+    Rgba[K] = idx2::u8(C.Stops[I][K] + F * (C.Stops[I + 1][K] - C.Stops[I][K]) + 0.5);
+  Rgba[3] = 255;
+}
+
+
+/* ---------------------- PNG ----------------------*/
+static idx2::u32
+Crc32(const idx2::u8* Data, size_t Bytes, idx2::u32 Crc = 0)
+{
+  static idx2::u32 Table[256] = {};
+  static std::once_flag Once;
+  std::call_once(Once, []() {
+    for (idx2::u32 I = 0; I < 256; ++I) {
+      idx2::u32 C = I;
+      for (int K = 0; K < 8; ++K)
+        C = (C & 1) ? 0xEDB88320u ^ (C >> 1) : C >> 1;
+      Table[I] = C;
+    }
+  });
+  Crc = ~Crc;
+  for (size_t I = 0; I < Bytes; ++I)
+    Crc = Table[(Crc ^ Data[I]) & 0xFF] ^ (Crc >> 8);
+  return ~Crc;
+}
+
+
+static void
+PutU32(std::vector<idx2::u8>* Out, idx2::u32 V) // big endian, as everywhere in PNG
+{
+  for (int S = 24; S >= 0; S -= 8)
+    Out->push_back(idx2::u8(V >> S));
+}
+
+
+static void
+PutChunk(std::vector<idx2::u8>* Out, const char* Type, const std::vector<idx2::u8>& Data)
+{
+  PutU32(Out, idx2::u32(Data.size()));
+  size_t Begin = Out->size();
+  Out->insert(Out->end(), Type, Type + 4);
+  Out->insert(Out->end(), Data.begin(), Data.end());
+  PutU32(Out, Crc32(Out->data() + Begin, Out->size() - Begin));
+}
+
+
+/* Encode an RGBA image as a PNG whose zlib stream only has stored (uncompressed) blocks */
+static std::vector<idx2::u8>
+EncodePng(const idx2::u8* Rgba, int Width, int Height)
+{
+  std::vector<idx2::u8> Raw; // each row is preceded by its filter type (0 = none)
+  Raw.reserve(size_t(Width * 4 + 1) * Height);
+  for (int Y = 0; Y < Height; ++Y) {
+    Raw.push_back(0);
+    Raw.insert(Raw.end(), Rgba + size_t(Y) * Width * 4, Rgba + size_t(Y + 1) * Width * 4);
+  }
+
+  std::vector<idx2::u8> Zlib = { 0x78, 0x01 };
+  idx2::u32 A = 1, B = 0; // Adler-32
+  for (size_t Begin = 0; Begin < Raw.size(); Begin += 65535) {
+    size_t Len = idx2::Min(Raw.size() - Begin, size_t(65535));
+    Zlib.push_back(Begin + Len == Raw.size() ? 1 : 0); // final block?
+    Zlib.push_back(idx2::u8(Len));
+    Zlib.push_back(idx2::u8(Len >> 8));
+    Zlib.push_back(idx2::u8(~Len));
+    Zlib.push_back(idx2::u8(~Len >> 8));
+    Zlib.insert(Zlib.end(), Raw.begin() + Begin, Raw.begin() + Begin + Len);
+    for (size_t I = Begin; I < Begin + Len; ++I) {
+      A = (A + Raw[I]) % 65521;
+      B = (B + A) % 65521;
+    }
+  }
+  PutU32(&Zlib, (B << 16) | A);
+
+  std::vector<idx2::u8> Png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  std::vector<idx2::u8> Header;
+  PutU32(&Header, Width);
+  PutU32(&Header, Height);
+  Header.insert(Header.end(), { 8, 6, 0, 0, 0 }); // 8 bits per channel, RGBA, no interlacing
+  PutChunk(&Png, "IHDR", Header);
+  PutChunk(&Png, "IDAT", Zlib);
+  PutChunk(&Png, "IEND", {});
+  return Png;
+}
+
+
+/* ---------------------- pyramid ----------------------*/
+/* A face at one zoom, row major */
+struct tile_image
+{
+  int Width = 0;
+  int Height = 0;
+  std::vector<float> Values;
+};
+
+
+/* Average 2 x 2 blocks of samples (ignoring the samples that are not finite) */
+static tile_image
+Halve(const tile_image& Image)
+{
+  tile_image Half;
+  Half.Width = (Image.Width + 1) / 2;
+  Half.Height = (Image.Height + 1) / 2;
+  Half.Values.resize(size_t(Half.Width) * Half.Height);
+  for (int Y = 0; Y < Half.Height; ++Y) {
+    for (int X = 0; X < Half.Width; ++X) {
+      double Sum = 0;
+      int Count = 0;
+      for (int Y2 = 2 * Y; Y2 < idx2::Min(2 * Y + 2, Image.Height); ++Y2) {
+        for (int X2 = 2 * X; X2 < idx2::Min(2 * X + 2, Image.Width); ++X2) {
+          float V = Image.Values[size_t(Y2) * Image.Width + X2];
+          if (std::isfinite(V)) {
+            Sum += V;
+            ++Count;
+          }
+        }
+      }
+      Half.Values[size_t(Y) * Half.Width + X] = Count > 0 ? float(Sum / Count) : NAN;
+    }
+  }
+  return Half;
+}
+
+
+/* Convert a decoded face (downsampled by 2^Level in x and y) to an image */
+static tile_image
+ToImage(const idx2::v3i& Face3, int Level, const output& Output)
+{
+  /* the decoded grid may end with a sample past the face, keep ceil(dims / 2^Level) samples */
+  tile_image Image;
+  idx2::v3i D3 = idx2::Dims(Output.OutGrid);
+  Image.Width = idx2::Min(D3.X, (Face3.X + (1 << Level) - 1) >> Level);
+  Image.Height = idx2::Min(D3.Y, (Face3.Y + (1 << Level) - 1) >> Level);
+  Image.Values.resize(size_t(Image.Width) * Image.Height);
+  for (int Y = 0; Y < Image.Height; ++Y) {
+    for (int X = 0; X < Image.Width; ++X) {
+      size_t From = size_t(Y) * D3.X + X;
+      Image.Values[size_t(Y) * Image.Width + X] = Output.DataType == idx2::dtype::float64
+                                                  ? float(((const double*)Output.OutBuffer.Data)[From])
+                                                  : ((const float*)Output.OutBuffer.Data)[From];
+    }
+  }
+  return Image;
+}
+
+
+/* Cut an image into tiles and write them to <OutDir>/<Time>/<Zoom>/<x>/<y>.png */
+static idx2::error<idx2::idx2_err_code>
+WriteTiles(const tiles_config& Config, const colormap& Colormap, const tile_image& Image, int Time, int Zoom, int* NTiles)
+{
+  const int T = Config.TileSize;
+  std::vector<idx2::u8> Rgba(size_t(T) * T * 4);
+  for (int TileX = 0; TileX * T < Image.Width; ++TileX) {
+    std::string Dir = Config.OutDir + "/" + std::to_string(Time) + "/" + std::to_string(Zoom) + "/" + std::to_string(TileX);
+    std::error_code Ec;
+    std::filesystem::create_directories(Dir, Ec);
+    idx2_ReturnErrorIf(Ec, idx2::err_code::FileCreateFailed, "Cannot create %s\n", Dir.c_str());
+    for (int TileY = 0; TileY * T < Image.Height; ++TileY) {
+      for (int Y = 0; Y < T; ++Y) {
+        for (int X = 0; X < T; ++X) {
+          int ImageX = TileX * T + X, ImageY = TileY * T + Y;
+          float V = ImageX < Image.Width && ImageY < Image.Height ? Image.Values[size_t(ImageY) * Image.Width + ImageX] : NAN;
+          ApplyColormap(Colormap, Config.VMin, Config.VMax, V, &Rgba[(size_t(Y) * T + X) * 4]);
+        }
+      }
+      std::vector<idx2::u8> Png = EncodePng(Rgba.data(), T, T);
+      std::string File = Dir + "/" + std::to_string(TileY) + ".png";
+      FILE* Fp = fopen(File.c_str(), "wb");
+      idx2_ReturnErrorIf(!Fp, idx2::err_code::FileCreateFailed, "Cannot create %s\n", File.c_str());
+      bool Written = fwrite(Png.data(), 1, Png.size(), Fp) == Png.size();
+      fclose(Fp);
+      idx2_ReturnErrorIf(!Written, idx2::err_code::FileWriteFailed, "Cannot write %s\n", File.c_str());
+      ++*NTiles;
+    }
+  }
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* Write all the zooms of one time step, from Image (at zoom MaxZoom) down to zoom 0, coarsest first */
+static idx2::error<idx2::idx2_err_code>
+WritePyramid(const tiles_config& Config, const colormap& Colormap, tile_image Image, int Time, int MaxZoom, std::vector<int>* NTiles)
+{
+  std::vector<tile_image> Zooms(MaxZoom + 1);
+  Zooms[MaxZoom] = std::move(Image);
+  for (int Zoom = MaxZoom - 1; Zoom >= 0; --Zoom)
+    Zooms[Zoom] = Halve(Zooms[Zoom + 1]);
+  for (int Zoom = 0; Zoom <= MaxZoom; ++Zoom)
+    idx2_PropagateIfError(WriteTiles(Config, Colormap, Zooms[Zoom], Time, Zoom, &(*NTiles)[Zoom]));
+  return idx2_Error(idx2::err_code::NoError);
+}
+
+
+/* The tiling tasks on the query pool, and what they report */
+struct pyramid_job
+{
+  std::mutex Mutex;
+  std::condition_variable Finished;
+  int NumPending = 0;
+  idx2::idx2_err_code ErrCode = idx2::idx2_err_code::NoError; // of the first failed task (an idx2::error cannot cross threads)
+  std::string ErrMsg;
+  std::vector<int> NTiles; // per zoom
+};
+
+
+/* Read the number of wavelet levels of a file */
+static idx2::expected<int, idx2::idx2_err_code>
+GetNumLevels(const std::string& InDir, const std::string& InFile)
+{
+  idx2::params P;
+  P.InputFile = InFile.c_str();
+  P.InDir = InDir.c_str();
+  idx2::idx2_file Idx2;
+  idx2_CleanUp(Dealloc(&Idx2));
+  idx2_PropagateIfError(Init(&Idx2, P));
+  return int(Idx2.NLevels);
+}
+
+
+int
+main(int Argc, const char** Argv)
+{
+  using namespace idx2;
+  tiles_config Config;
+  cstr Str = nullptr;
+  if (OptVal(Argc, Argv, "--dir", &Str))
+    Config.Dir = Str;
+  if (OptVal(Argc, Argv, "--name-format", &Str))
+    Config.NameFormat = Str;
+  if (OptVal(Argc, Argv, "--out", &Str))
+    Config.OutDir = Str;
+  OptVal(Argc, Argv, "--n", &Config.N);
+  OptVal(Argc, Argv, "--time-group", &Config.TimeGroup);
+  OptVal(Argc, Argv, "--face", &Config.Face);
+  OptVal(Argc, Argv, "--depth", &Config.Depth);
+  OptVal(Argc, Argv, "--times", &Config.Times);
+  OptVal(Argc, Argv, "--batch", &Config.Batch);
+  OptVal(Argc, Argv, "--tile-size", &Config.TileSize);
+  OptVal(Argc, Argv, "--max-zoom", &Config.MaxZoom);
+  OptVal(Argc, Argv, "--accuracy", &Config.Accuracy);
+  OptVal(Argc, Argv, "--colormap", &Config.Colormap);
+  OptVal(Argc, Argv, "--vmin", &Config.VMin);
+  OptVal(Argc, Argv, "--vmax", &Config.VMax);
+  const colormap* Colormap = GetColormap(Config.Colormap);
+  if (!Colormap || Config.Face < 0 || Config.Face >= 5 || Config.Times.X >= Config.Times.Y || Config.TileSize <= 0 || Config.Batch <= 0) {
+    fprintf(stderr, "invalid colormap, face, time range, batch or tile size\n");
+    return 1;
+  }
+
+  tiles_query_info QueryInfo(Config);
+  const v3i& Face3 = QueryInfo.FaceDims3()[Config.Face];
+  int FullZoom = 0; // the zoom at which the face has its full resolution
+  while ((i64(Config.TileSize) << FullZoom) < Max(Face3.X, Face3.Y))
+    ++FullZoom;
+  const int MaxZoom = Config.MaxZoom < 0 ? FullZoom : Min(Config.MaxZoom, FullZoom);
+  std::vector<input> Inputs;
+  std::vector<output_metadata> OutputsMetadata;
+  GetQueryInputs(QueryInfo, range{ Config.Times.X, Config.Times.X + 1 }, &Inputs, &OutputsMetadata);
+  auto NLevels = GetNumLevels(QueryInfo.InDir, Inputs[0].InFile);
+  if (!NLevels) {
+    fprintf(stderr, "%s\n", ToString(Error(NLevels)));
+    return 1;
+  }
+  /* decode the last zoom straight from the wavelet levels it needs (as far as there are levels) */
+  const int Level = Min(FullZoom - MaxZoom, Value(NLevels));
+  const int NAveraged = FullZoom - MaxZoom - Level; // halvings from the decoded level to the last zoom
+  QueryInfo.SetDownsamplingFactor(Level, Level, 0);
+  printf("face %d (%d x %d), depth %d, times [%d, %d): zooms 0-%d, decoded with downsampling %d\n",
+         Config.Face, Face3.X, Face3.Y, Config.Depth, Config.Times.X, Config.Times.Y, MaxZoom, 1 << Level);
+
+  pyramid_job Job;
+  Job.NTiles.resize(MaxZoom + 1, 0);
+  timer Timer;
+  StartTimer(&Timer);
+  double DecodeSeconds = 0;
+  for (int Begin = Config.Times.X; Begin < Config.Times.Y; Begin += Config.Batch) {
+    /* the time steps of a batch that share a file are decoded together, the files in parallel */
+    int End = Min(Begin + Config.Batch, Config.Times.Y);
+    GetQueryInputs(QueryInfo, range{ Begin, End }, &Inputs, &OutputsMetadata);
+    auto Outputs = std::make_shared<std::vector<output>>(Inputs.size());
+    timer DecodeTimer;
+    StartTimer(&DecodeTimer);
+    auto Result = DecodeMultipleFiles(QueryInfo.InDir, Inputs, Outputs.get());
+    DecodeSeconds += Seconds(ElapsedTime(&DecodeTimer));
+    if (!Result) {
+      fprintf(stderr, "%s\n", ToString(Result));
+      return 1;
+    }
+    if (Config.VMin == Config.VMax) { // the range of the first time step
+      tile_image Image = ToImage(Face3, Level, (*Outputs)[0]);
+      Config.VMin = INFINITY;
+      Config.VMax = -INFINITY;
+      for (float V : Image.Values) {
+        if (std::isfinite(V)) {
+          Config.VMin = Min(Config.VMin, double(V));
+          Config.VMax = Max(Config.VMax, double(V));
+        }
+      }
+      if (!(Config.VMin < Config.VMax))
+        Config.VMax = Config.VMin + 1;
+      printf("value range [%g, %g]\n", Config.VMin, Config.VMax);
+    }
+
+    /* one tiling task per time step (the next batch is decoded meanwhile) */
+    {
+      std::lock_guard<std::mutex> Lock(Job.Mutex);
+      Job.NumPending += End - Begin;
+    }
+    for (int I = 0; I < Inputs.size(); ++I) {
+      PushTask(&GetQueryPool(), [&, Outputs, I, Time = OutputsMetadata[I].Time]() {
+        tile_image Image = ToImage(Face3, Level, (*Outputs)[I]);
+        for (int K = 0; K < NAveraged; ++K)
+          Image = Halve(Image);
+        std::vector<int> NTiles(MaxZoom + 1, 0);
+        auto Result = WritePyramid(Config, *Colormap, std::move(Image), Time, MaxZoom, &NTiles);
+        std::lock_guard<std::mutex> Lock(Job.Mutex);
+        if (!Result && Job.ErrCode == idx2_err_code::NoError) {
+          Job.ErrCode = Result.Code;
+          Job.ErrMsg = ToString(Result);
+        }
+        for (int Zoom = 0; Zoom <= MaxZoom; ++Zoom)
+          Job.NTiles[Zoom] += NTiles[Zoom];
+        if (--Job.NumPending == 0)
+          Job.Finished.notify_all();
+      });
+    }
+  }
+  {
+    std::unique_lock<std::mutex> Lock(Job.Mutex);
+    Job.Finished.wait(Lock, [&Job]() { return Job.NumPending == 0; });
+  }
+  if (Job.ErrCode != idx2_err_code::NoError) {
+    fprintf(stderr, "%s\n", Job.ErrMsg.c_str());
+    return 1;
+  }
+
+  printf("zoom  downsampling  tiles\n");
+  for (int Zoom = 0; Zoom <= MaxZoom; ++Zoom)
+    printf("%4d  %12d  %5d\n", Zoom, 1 << (FullZoom - Zoom), Job.NTiles[Zoom]);
+  printf("%.3f s in total, %.3f s decoding\n", Seconds(ElapsedTime(&Timer)), DecodeSeconds);
+  return 0;
+}
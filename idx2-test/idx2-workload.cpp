@@ -0,0 +1,530 @@
+// End-to-end workload benchmark. Encodes a synthetic dataset shaped like LLC2160 (five faces of
+// N x 3N, N x N and 3N x N samples, a few depths, one group of time steps) and replays the query
+// patterns of the demo notebooks through ExecuteQuery, at several accuracies and downsampling
+// factors, with a cold or a warm page cache. For each configuration it reports latency
+// percentiles, throughput and bytes read, so that runs before and after a change can be compared.
+//
+// Usage: idx2-workload [--dir ./llc-synthetic] [--n 256] [--depths 4] [--times 32] [--reps 3]
+//                      [--mix vertical-slice] [--accuracy 0.01] [--downsampling 1 1 0]
+//                      [--cache cold|warm|both] [--frames 8] [--json results.json] [--reencode]
+//                      [--preview-level 4] (also write 1/16 resolution previews, see ReadPreview)
+//                      [--rd-curves] [--target-rmse 0.01] (decode to an error target, see input::TargetRmse)
+//                      [--target-max-error 0.05] (decode to a bound on the error, see input::TargetMaxError)
+//                      [--trace trace.json] (needs -DIDX2_TRACE=ON)
+//                      [--record queries.txt] (append the queries to a trace for idx2-layout)
+//                      [--server /tmp/idx2-server.sock] (run the queries through idx2-server, Linux only)
+//                      [--workers /tmp/w0.sock,/tmp/w1.sock] (split the queries across several idx2-server, Linux only)
+//                      (the servers read --dir under their --root, so --dir must then be a relative path)
+// (configure with -DCMAKE_BUILD_TYPE=Release)
+#define idx2_Implementation
+#include "idx2-query.hpp"
+#include <filesystem>
+#include <math.h>
+#if defined(__linux__)
+#include "idx2-remote.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+struct workload_config
+{
+  std::string Dir = "./llc-synthetic";
+  int N = 256; // the "2160" of the synthetic dataset
+  int NDepths = 4;
+  int NTimes = 32; // all time steps go to a single time group
+  int NLevels = 2; // the LLC datasets use 4, but the synthetic faces are too small for that
+  int NReps = 3;
+  int NFrames = 8; // number of time steps the animation goes through
+  int PreviewLevel = -1; // if >= 0, the encoder also writes previews 2^PreviewLevel times smaller in x and y
+  bool RdCurves = false; // if true, the encoder also writes the rate-distortion curves (needed by TargetRmse)
+  double TargetRmse = 0; // if > 0, the queries decode to this error instead of the accuracy
+  double TargetMaxError = 0; // if > 0, the queries decode to this bound on the error of every sample
+  idx2::cstr Mix = nullptr; // only run the mixes whose names contain this string
+  idx2::cstr Cache = "both";
+  idx2::cstr JsonFile = nullptr;
+  idx2::cstr TraceFile = nullptr;
+  idx2::cstr RecordFile = nullptr; // see SetQueryTrace
+  idx2::cstr Server = nullptr; // the socket of an idx2-server to send the queries to
+  std::vector<std::string> Workers; // or the addresses of the idx2-server to split the queries across
+  bool Reencode = false;
+  std::vector<double> Accuracies = { 0.1, 0.01, 0.001 };
+  std::vector<idx2::v3i> Downsamplings = { idx2::v3i(0, 0, 0), idx2::v3i(1, 1, 0), idx2::v3i(2, 2, 0) };
+};
+
+
+/* Same as llc_2160_query_info, but for a synthetic dataset of any size */
+struct llc_synthetic_query_info : public query_info
+{
+  int FaceN = 2160;
+  idx2::v3i FaceDims3_[5];
+
+  llc_synthetic_query_info(const workload_config& Config)
+  {
+    FaceN = Config.N;
+    FaceDims3_[0] = idx2::v3i(FaceN, 3 * FaceN, 1);
+    FaceDims3_[1] = idx2::v3i(FaceN, 3 * FaceN, 1);
+    FaceDims3_[2] = idx2::v3i(FaceN, FaceN, 1);
+    FaceDims3_[3] = idx2::v3i(3 * FaceN, FaceN, 1);
+    FaceDims3_[4] = idx2::v3i(3 * FaceN, FaceN, 1);
+    SetNameFormat(Config.Dir + "/llc" + std::to_string(FaceN) + "/u-face-%d-depth-%d-time-%d-%d.idx2");
+    SetInputDirectory(Config.Dir);
+    SetTimeGroup(Config.NTimes);
+  }
+
+
+  virtual const int N() const override
+  {
+    return FaceN;
+  }
+
+
+  virtual const int NumFaces() const override
+  {
+    return 5;
+  }
+
+
+  virtual const idx2::v3i* FaceDims3() const override
+  {
+    return FaceDims3_;
+  }
+};
+
+
+/* ---------------------- dataset ----------------------*/
+/* Large-scale gyres that differ per face, a decay with depth, eddies drifting over time, and noise */
+static void
+GenerateFace(const idx2::v3i& Dims3, int Face, int Depth, idx2::volume* Vol)
+{
+  using namespace idx2;
+  Resize(Vol, Dims3, dtype::float32);
+  pcg32 Pcg(Face * 1000 + Depth);
+  const f64 TwoPi = 2 * 3.14159265358979323846;
+  f64 DepthScale = exp(-0.3 * Depth);
+  v3i P3;
+  idx2_BeginFor3 (P3, v3i(0), Dims3, v3i(1))
+  {
+    f64 X = f64(P3.X) / Dims3.X, Y = f64(P3.Y) / Dims3.Y, T = f64(P3.Z) / Dims3.Z;
+    f64 Gyres = 5 * sin(TwoPi * (X + 0.2 * Face)) * cos(TwoPi * 0.5 * Y);
+    f64 Eddies = sin(TwoPi * 9 * (X + 0.05 * T)) * sin(TwoPi * 7 * (Y - 0.03 * T));
+    f64 Noise = 0.02 * (NextDouble(&Pcg) - 0.5);
+    Vol->At<f32>(P3) = f32(DepthScale * (Gyres + Eddies) + Noise);
+  }
+  idx2_EndFor3;
+}
+
+
+static idx2::error<idx2::idx2_err_code>
+EncodeFace(const workload_config& Config, const llc_synthetic_query_info& Info, int Face, int Depth)
+{
+  using namespace idx2;
+  char Name[32], Field[32];
+  snprintf(Name, sizeof(Name), "llc%d", Config.N);
+  snprintf(Field, sizeof(Field), "u-face-%d-depth-%d-time-%d-%d", Face, Depth, 0, Config.NTimes);
+  std::string FileName = Config.Dir + "/" + Name + "/" + Field + ".idx2";
+  std::string PreviewName = Config.Dir + "/" + Name + "/" + Field + ".preview";
+  std::string RdName = Config.Dir + "/" + Name + "/" + Field + ".rd";
+  bool HasPreview = Config.PreviewLevel < 0 || std::filesystem::exists(PreviewName);
+  bool HasRdCurves = !Config.RdCurves || std::filesystem::exists(RdName);
+  if (!Config.Reencode && std::filesystem::exists(FileName) && HasPreview && HasRdCurves)
+    return idx2_Error(idx2_err_code::NoError);
+
+  v3i Dims3 = Info.FaceDims3()[Face];
+  Dims3.Z = Config.NTimes;
+  volume Vol;
+  idx2_CleanUp(Dealloc(&Vol));
+  GenerateFace(Dims3, Face, Depth, &Vol);
+
+  idx2_file Idx2;
+  idx2_CleanUp(Dealloc(&Idx2));
+  params P;
+  snprintf(P.Meta.Name, sizeof(P.Meta.Name), "%s", Name);
+  snprintf(P.Meta.Field, sizeof(P.Meta.Field), "%s", Field);
+  P.OutDir = Config.Dir.c_str();
+  P.PreviewLevel = Config.PreviewLevel;
+  P.RdCurves = Config.RdCurves;
+  SetName(&Idx2, Name);
+  SetField(&Idx2, Field);
+  SetVersion(&Idx2, v2i(1, 0));
+  SetDimensions(&Idx2, Dims3);
+  SetDataType(&Idx2, dtype::float32);
+  SetBrickSize(&Idx2, v3i(32));
+  SetNumIterations(&Idx2, (i8)Config.NLevels);
+  SetAccuracy(&Idx2, 1e-7); // same as the conversion scripts
+  SetDir(&Idx2, Config.Dir.c_str());
+  idx2_PropagateIfError(Finalize(&Idx2, P));
+  brick_copier Copier(&Vol);
+  idx2_PropagateIfError(Encode(&Idx2, P, Copier));
+
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+
+/* Evict the dataset from the OS page cache so that the next query reads from disk */
+static bool
+DropFromPageCache(const std::string& Dir)
+{
+#if defined(__linux__)
+  for (const auto& Entry : std::filesystem::recursive_directory_iterator(Dir)) {
+    if (!Entry.is_regular_file())
+      continue;
+    int Fd = open(Entry.path().c_str(), O_RDONLY);
+    if (Fd < 0)
+      continue;
+    fdatasync(Fd); // dirty pages cannot be dropped
+    posix_fadvise(Fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(Fd);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+/* ---------------------- query mixes ----------------------*/
+/* A mix is a sequence of queries, each executed (and timed) with one call to ExecuteQuery. The
+mixes follow the demo notebooks. */
+using build_queries_func = void (*)(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries);
+
+
+struct query_mix
+{
+  idx2::cstr Name;
+  build_queries_func Build;
+};
+
+
+static const std::array<int, 4> LatLonFaces = { 0, 1, 3, 4 };
+
+
+static void
+BuildSingleFace(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries)
+{
+  llc_synthetic_query_info Q(Config);
+  Q.SetDepthRange(0, 1);
+  Q.SetTimeRange(0, 1);
+  Q.AddFace(0);
+  Queries->push_back(Q);
+}
+
+
+static void
+BuildFourFacesThroughTime(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries)
+{
+  llc_synthetic_query_info Q(Config);
+  Q.SetDepthRange(0, 1);
+  Q.SetTimeRange(0, Config.NTimes);
+  for (int F : LatLonFaces)
+    Q.AddFace(F);
+  Queries->push_back(Q);
+}
+
+
+static void
+BuildFourFacesThroughDepths(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries)
+{
+  llc_synthetic_query_info Q(Config);
+  Q.SetDepthRange(0, Config.NDepths);
+  Q.SetTimeRange(0, 1);
+  for (int F : LatLonFaces)
+    Q.AddFace(F);
+  Queries->push_back(Q);
+}
+
+
+/* Same as VerticalSlicingExample, with the slice position scaled to the dataset size */
+static void
+BuildVerticalSlice(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries)
+{
+  llc_synthetic_query_info Q(Config);
+  Q.SetDepthRange(0, Config.NDepths);
+  Q.SetTimeRange(Config.NTimes / 2, Config.NTimes / 2 + 1);
+  Q.SetOrder(order::TimeDepthFace);
+  int SlicePosition = Config.N * 3000 / 2160;
+  for (int F : LatLonFaces) {
+    if (F < 2)
+      Q.AddFaceSlice(F, slice_type::AlongX, SlicePosition);
+    else
+      Q.AddFaceSlice(F, slice_type::RotatedAlongX, SlicePosition);
+  }
+  Queries->push_back(Q);
+}
+
+
+static void
+BuildRegionOfInterest(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries)
+{
+  llc_synthetic_query_info Q(Config);
+  Q.SetDepthRange(0, 1);
+  Q.SetTimeRange(0, Config.NTimes);
+  Q.AddSpatialRange(1, Config.N / 4, Config.N / 2, Config.N, Config.N + Config.N / 2);
+  Queries->push_back(Q);
+}
+
+
+/* One query per frame, each getting the four lat-lon faces at one time step */
+static void
+BuildAnimation(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries)
+{
+  int NFrames = std::min(Config.NFrames, Config.NTimes);
+  for (int T = 0; T < NFrames; ++T) {
+    llc_synthetic_query_info Q(Config);
+    Q.SetDepthRange(0, 1);
+    Q.SetTimeRange(T, T + 1);
+    for (int F : LatLonFaces)
+      Q.AddFace(F);
+    Queries->push_back(Q);
+  }
+}
+
+
+/* The notebook averages a region of one face over all the time steps */
+static void
+BuildAverageOverTime(const workload_config& Config, std::vector<llc_synthetic_query_info>* Queries)
+{
+  llc_synthetic_query_info Q(Config);
+  Q.SetDepthRange(0, 1);
+  Q.SetTimeRange(0, Config.NTimes);
+  Q.AddSpatialRange(0, 0, Config.N, Config.N, 2 * Config.N);
+  Queries->push_back(Q);
+}
+
+
+static const query_mix QueryMixes[] = {
+  { "single-face", BuildSingleFace },
+  { "four-faces-through-time", BuildFourFacesThroughTime },
+  { "four-faces-through-depths", BuildFourFacesThroughDepths },
+  { "vertical-slice", BuildVerticalSlice },
+  { "region-of-interest", BuildRegionOfInterest },
+  { "animation", BuildAnimation },
+  { "average-over-time", BuildAverageOverTime },
+};
+
+
+/* ---------------------- running ----------------------*/
+struct run_result
+{
+  std::vector<double> LatenciesMs; // one per query
+  idx2::i64 NValues = 0; // output samples
+  idx2::decode_stats Stats;
+};
+
+
+static idx2::error<idx2::idx2_err_code>
+RunQueries(const std::vector<llc_synthetic_query_info>& Queries, const workload_config& Config, bool Cold, run_result* Result)
+{
+  for (const auto& Q : Queries) {
+    if (Cold)
+      DropFromPageCache(Config.Dir);
+#if defined(__linux__)
+    if (Config.Server) { // the decode statistics stay on the server
+      remote_result Remote;
+      idx2::timer Timer;
+      idx2::StartTimer(&Timer);
+      idx2_PropagateIfError(ExecuteRemoteQuery(Config.Server, Q, &Remote));
+      Result->LatenciesMs.push_back(idx2::ElapsedTime(&Timer) / 1e6);
+      for (const auto& O : Remote.Outputs)
+        Result->NValues += idx2::Prod<idx2::i64>(idx2::Dims(O.OutGrid));
+      continue;
+    }
+    if (!Config.Workers.empty()) { // same on the workers
+      std::vector<output> Outputs;
+      std::vector<output_metadata> OutputsMetadata;
+      idx2::timer Timer;
+      idx2::StartTimer(&Timer);
+      idx2_PropagateIfError(ExecuteDistributedQuery(Config.Workers, Q, &Outputs, &OutputsMetadata));
+      Result->LatenciesMs.push_back(idx2::ElapsedTime(&Timer) / 1e6);
+      for (const auto& O : Outputs)
+        Result->NValues += idx2::Prod<idx2::i64>(idx2::Dims(O.OutGrid));
+      continue;
+    }
+#endif
+    std::vector<output> Outputs;
+    std::vector<output_metadata> OutputsMetadata;
+    idx2::decode_stats Stats;
+    idx2::timer Timer;
+    idx2::StartTimer(&Timer);
+    idx2_PropagateIfError(ExecuteQuery(Q, &Outputs, &OutputsMetadata, &Stats));
+    Result->LatenciesMs.push_back(idx2::ElapsedTime(&Timer) / 1e6);
+    for (const auto& O : Outputs)
+      Result->NValues += idx2::Prod<idx2::i64>(idx2::Dims(O.OutGrid));
+    idx2::Add(&Result->Stats, Stats);
+  }
+
+  return idx2_Error(idx2::idx2_err_code::NoError);
+}
+
+
+/* Nearest-rank percentile of sorted values */
+static double
+Percentile(const std::vector<double>& Sorted, double P)
+{
+  if (Sorted.empty())
+    return 0;
+  size_t Rank = (size_t)ceil(P / 100 * Sorted.size());
+  return Sorted[std::min(std::max(Rank, size_t(1)), Sorted.size()) - 1];
+}
+
+
+static void
+Report(const query_mix& Mix, bool Cold, double Accuracy, const idx2::v3i& Ds3, run_result* Result, FILE* JsonFp)
+{
+  std::vector<double>& L = Result->LatenciesMs;
+  std::sort(L.begin(), L.end());
+  double TotalSec = 0;
+  for (double Ms : L)
+    TotalSec += Ms / 1000;
+  const idx2::decode_stats& S = Result->Stats;
+  idx2::i64 BytesRead = S.BytesRdos + S.BytesExps + S.BytesIndex + S.BytesData;
+  double QueriesPerSec = L.size() / std::max(TotalSec, 1e-9);
+  double MValuesPerSec = Result->NValues / 1e6 / std::max(TotalSec, 1e-9);
+  double MBRead = BytesRead / 1e6 / std::max<size_t>(L.size(), 1);
+  printf("%-26s %-4s %7g %d,%d,%d %9.2f %9.2f %9.2f %9.2f %9.2f %11.2f %10.3f\n",
+         Mix.Name, Cold ? "cold" : "warm", Accuracy, Ds3.X, Ds3.Y, Ds3.Z,
+         Percentile(L, 50), Percentile(L, 90), Percentile(L, 99), L.back(),
+         QueriesPerSec, MValuesPerSec, MBRead);
+  if (JsonFp) {
+    fprintf(JsonFp,
+            "{\"mix\": \"%s\", \"cache\": \"%s\", \"accuracy\": %g, \"downsampling\": [%d, %d, %d], "
+            "\"queries\": %d, \"p50_ms\": %f, \"p90_ms\": %f, \"p99_ms\": %f, \"max_ms\": %f, "
+            "\"queries_per_sec\": %f, \"values_per_sec\": %f, \"bytes_read\": %lld, \"stats\": ",
+            Mix.Name, Cold ? "cold" : "warm", Accuracy, Ds3.X, Ds3.Y, Ds3.Z,
+            (int)L.size(), Percentile(L, 50), Percentile(L, 90), Percentile(L, 99), L.back(),
+            QueriesPerSec, MValuesPerSec * 1e6, (long long)BytesRead);
+    idx2::printer Pr(JsonFp);
+    idx2::PrintJson(&Pr, S);
+    fprintf(JsonFp, "}\n");
+  }
+}
+
+
+int
+main(int Argc, const char** Argv)
+{
+  using namespace idx2;
+  workload_config Config;
+  cstr Dir = nullptr;
+  if (OptVal(Argc, Argv, "--dir", &Dir))
+    Config.Dir = Dir;
+  OptVal(Argc, Argv, "--n", &Config.N);
+  OptVal(Argc, Argv, "--depths", &Config.NDepths);
+  OptVal(Argc, Argv, "--times", &Config.NTimes);
+  OptVal(Argc, Argv, "--levels", &Config.NLevels);
+  OptVal(Argc, Argv, "--reps", &Config.NReps);
+  if (Config.NReps < 1) {
+    fprintf(stderr, "--reps must be at least 1\n");
+    return 1;
+  }
+  OptVal(Argc, Argv, "--frames", &Config.NFrames);
+  OptVal(Argc, Argv, "--preview-level", &Config.PreviewLevel);
+  Config.RdCurves = OptExists(Argc, Argv, "--rd-curves");
+  cstr TargetRmseStr = nullptr;
+  if (OptVal(Argc, Argv, "--target-rmse", &TargetRmseStr))
+    Config.TargetRmse = atof(TargetRmseStr);
+  cstr TargetMaxErrorStr = nullptr;
+  if (OptVal(Argc, Argv, "--target-max-error", &TargetMaxErrorStr))
+    Config.TargetMaxError = atof(TargetMaxErrorStr);
+  OptVal(Argc, Argv, "--mix", &Config.Mix);
+  OptVal(Argc, Argv, "--cache", &Config.Cache);
+  OptVal(Argc, Argv, "--json", &Config.JsonFile);
+  OptVal(Argc, Argv, "--trace", &Config.TraceFile);
+  OptVal(Argc, Argv, "--record", &Config.RecordFile);
+  OptVal(Argc, Argv, "--server", &Config.Server);
+  cstr WorkersStr = nullptr;
+  if (OptVal(Argc, Argv, "--workers", &WorkersStr)) {
+    std::string Str = WorkersStr;
+    for (size_t Begin = 0, End = 0; Begin < Str.size(); Begin = End + 1) {
+      End = std::min(Str.find(',', Begin), Str.size());
+      Config.Workers.push_back(Str.substr(Begin, End - Begin));
+    }
+  }
+  Config.Reencode = OptExists(Argc, Argv, "--reencode");
+  cstr AccuracyStr = nullptr;
+  if (OptVal(Argc, Argv, "--accuracy", &AccuracyStr))
+    Config.Accuracies = { atof(AccuracyStr) };
+  v3i Ds3;
+  if (OptVal(Argc, Argv, "--downsampling", &Ds3))
+    Config.Downsamplings = { Ds3 };
+  std::vector<bool> CacheModes;
+  if (strcmp(Config.Cache, "cold") == 0 || strcmp(Config.Cache, "both") == 0)
+    CacheModes.push_back(true);
+  if (strcmp(Config.Cache, "warm") == 0 || strcmp(Config.Cache, "both") == 0)
+    CacheModes.push_back(false);
+#if !defined(__linux__)
+  if (!CacheModes.empty() && CacheModes[0]) {
+    fprintf(stderr, "cold cache runs are only supported on Linux, skipping them\n");
+    CacheModes.erase(CacheModes.begin());
+  }
+#endif
+
+  /* encode the dataset (files that already exist are reused) */
+  llc_synthetic_query_info Info(Config);
+  printf("dataset: llc%d in %s, %d depths, %d time steps\n", Config.N, Config.Dir.c_str(), Config.NDepths, Config.NTimes);
+  for (int F = 0; F < Info.NumFaces(); ++F) {
+    for (int D = 0; D < Config.NDepths; ++D) {
+      auto Result = EncodeFace(Config, Info, F, D);
+      if (!Result) {
+        fprintf(stderr, "encoding face %d depth %d failed: %s\n", F, D, ToString(Result));
+        return 1;
+      }
+    }
+  }
+
+  if (Config.RecordFile) {
+    auto Recording = SetQueryTrace(Config.RecordFile);
+    if (!Recording) {
+      fprintf(stderr, "%s\n", ToString(Recording));
+      return 1;
+    }
+  }
+
+  FILE* JsonFp = Config.JsonFile ? fopen(Config.JsonFile, "w") : nullptr;
+  idx2_CleanUp(if (JsonFp) fclose(JsonFp));
+  printf("%-26s %-4s %7s %-5s %9s %9s %9s %9s %9s %11s %10s\n",
+         "mix", "cache", "acc", "ds", "p50 ms", "p90 ms", "p99 ms", "max ms", "queries/s", "Mvalues/s", "MB/query");
+  for (const query_mix& Mix : QueryMixes) {
+    if (Config.Mix && !strstr(Mix.Name, Config.Mix))
+      continue;
+    for (bool Cold : CacheModes) {
+      for (double Accuracy : Config.Accuracies) {
+        for (const v3i& Ds : Config.Downsamplings) {
+          std::vector<llc_synthetic_query_info> Queries;
+          Mix.Build(Config, &Queries);
+          for (auto& Q : Queries) {
+            Q.SetAccuracy(Accuracy);
+            Q.SetTargetRmse(Config.TargetRmse);
+            Q.SetTargetMaxError(Config.TargetMaxError);
+            Q.SetDownsamplingFactor(Ds.X, Ds.Y, Ds.Z);
+          }
+          run_result Result;
+          if (!Cold) { // warm up the page cache
+            run_result Ignored;
+            RunQueries(Queries, Config, false, &Ignored);
+          }
+          for (int R = 0; R < Config.NReps; ++R) {
+            auto Ok = RunQueries(Queries, Config, Cold, &Result);
+            if (!Ok) {
+              fprintf(stderr, "%s: %s\n", Mix.Name, ToString(Ok));
+              return 1;
+            }
+          }
+          Report(Mix, Cold, Accuracy, Ds, &Result, JsonFp);
+        }
+      }
+    }
+  }
+
+  if (Config.TraceFile) {
+#if defined(idx2_Trace)
+    auto Ok = DumpTrace(Config.TraceFile);
+    if (!Ok)
+      fprintf(stderr, "%s\n", ToString(Ok));
+#else
+    fprintf(stderr, "--trace needs a build with idx2_Trace defined (-DIDX2_TRACE=ON)\n");
+#endif
+  }
+
+  return 0;
+}
@@ -4610,6 +4610,7 @@ stref GetDirName(const stref& Path);
 bool CreateFullDir(const stref& Path);
 bool DirExists(const stref& Path);
 void RemoveDir(cstr path);
+bool MovePath(cstr From, cstr To);
 
 } // namespace idx2
 
@@ -6432,7 +6433,7 @@ namespace idx2
 
 struct mutex
 {
-  pthread_mutex_t Mx;
+  pthread_mutex_t Mx = PTHREAD_MUTEX_INITIALIZER;
 };
 
 struct lock
@@ -6994,6 +6995,98 @@ Seconds(i64 Nanosecs)
 
 } // namespace idx2
 
+/*
+Scoped trace events, written in the Chrome trace event format (load the dump in chrome://tracing
+or ui.perfetto.dev). Tracing is compiled in only when idx2_Trace is defined; otherwise
+idx2_TraceScope expands to nothing.
+Each thread records into its own ring buffer (the oldest events are overwritten once it is full),
+so recording an event takes no lock.
+*/
+#if defined(idx2_Trace)
+
+namespace idx2
+{
+
+struct trace_event
+{
+  cstr Name = nullptr; // only the pointer is stored, so this must be a string literal
+  i64 Begin = 0;       // nanoseconds since the start of the process
+  i64 Duration = 0;    // nanoseconds
+};
+
+struct trace_buffer
+{
+  static constexpr int Capacity = 1 << 16; // power of two
+  trace_event Events[Capacity];
+  i64 NEvents = 0; // number of events recorded so far, can be larger than Capacity
+  int ThreadId = 0;
+  bool InUse = false; // once its thread exits, a buffer (and its events) is taken over by a new thread
+  trace_buffer* Next = nullptr;
+};
+
+/* All the trace buffers, one per thread that is recording or has recorded events */
+struct trace_registry
+{
+  mutex Mutex;
+  timer Epoch;
+  trace_buffer* Head = nullptr;
+  int NBuffers = 0;
+  trace_registry();
+};
+
+/* Record the time between construction and destruction as one event */
+struct trace_scope
+{
+  cstr Name = nullptr;
+  i64 Begin = 0;
+  trace_scope(cstr NameIn);
+  ~trace_scope();
+};
+
+/* Return the ring buffer of the calling thread */
+trace_buffer*
+GetTraceBuffer();
+
+/* Write the recorded events as Chrome trace JSON. Call this when no thread is recording. */
+void
+PrintTrace(printer* Pr);
+
+error<>
+DumpTrace(cstr FileName);
+
+/* Discard the recorded events */
+void
+ResetTrace();
+
+extern trace_registry TraceRegistry_;
+
+idx2_Inline
+trace_scope::trace_scope(cstr NameIn)
+  : Name(NameIn)
+  , Begin(ElapsedTime(&TraceRegistry_.Epoch))
+{
+}
+
+idx2_Inline trace_scope::~trace_scope()
+{
+  i64 End = ElapsedTime(&TraceRegistry_.Epoch);
+  trace_buffer* Buf = GetTraceBuffer();
+  trace_event& Event = Buf->Events[Buf->NEvents++ & (trace_buffer::Capacity - 1)];
+  Event.Name = Name;
+  Event.Begin = Begin;
+  Event.Duration = End - Begin;
+}
+
+} // namespace idx2
+
+#define idx2_TraceScope(Name) idx2::trace_scope idx2_Cat(__TraceScope__, __LINE__)(Name)
+
+#else
+
+#define idx2_TraceScope(Name)
+
+#endif
+
 namespace idx2
 {
 
@@ -8025,7 +8118,7 @@ CopyExtentExtentMinMax(const extent& SGrid, const volume& SVol, const extent& DG
     f64 V = (f64)SrcPtr[Row(SrcDims3, S3)];
     DstPtr[Row(DstDims3, D3)] = (dtype)V;
     MinMax.Min = Min(MinMax.Min, V);
-    MinMax.Max = Max(MinMax.Min, V);
+    MinMax.Max = Max(MinMax.Max, V);
   }
   idx2_EndFor3;
 
@@ -8035,6 +8128,7 @@ CopyExtentExtentMinMax(const extent& SGrid, const volume& SVol, const extent& DG
 template <typename stype, typename dtype> void
 CopyExtentGrid(const extent& SGrid, const volume& SVol, const grid& DGrid, volume* DVol)
 {
+  idx2_TraceScope("CopyExtentGrid");
   idx2_Assert(Dims(SGrid) == Dims(DGrid));
   idx2_Assert(Dims(SGrid) <= Dims(SVol));
   idx2_Assert(Dims(DGrid) <= Dims(*DVol));
@@ -8058,6 +8152,7 @@ CopyExtentGrid(const extent& SGrid, const volume& SVol, const grid& DGrid, volum
 template <typename stype, typename dtype> void
 CopyGridExtent(const grid& SGrid, const volume& SVol, const extent& DGrid, volume* DVol)
 {
+  idx2_TraceScope("CopyGridExtent");
   idx2_Assert(Dims(SGrid) == Dims(DGrid));
   idx2_Assert(Dims(SGrid) <= Dims(SVol));
   idx2_Assert(Dims(DGrid) <= Dims(*DVol));
@@ -8080,6 +8175,7 @@ CopyGridExtent(const grid& SGrid, const volume& SVol, const extent& DGrid, volum
 template <typename stype, typename dtype> void
 CopyGridGrid(const grid& SGrid, const volume& SVol, const grid& DGrid, volume* DVol)
 {
+  idx2_TraceScope("CopyGridGrid");
   idx2_Assert(Dims(SGrid) == Dims(DGrid));
   idx2_Assert(Dims(SGrid) <= Dims(SVol));
   idx2_Assert(Dims(DGrid) <= Dims(*DVol));
@@ -8285,6 +8381,10 @@ Contain(const extent& Ext, const v3i& P)
 
 } // namespace idx2
 
+/* The wavelet kernels of the multi-resolution transform (see the kernel traits cdf53_kernel, haar_kernel and
+cdf97_kernel) */
+idx2_Enum(wavelet, u8, Cdf53, Haar, Cdf97);
+
 namespace idx2
 {
 
@@ -8347,10 +8447,19 @@ struct transform_details
   u64 TformOrder;
   int StackSize;
   int NPasses;
+  wavelet Wavelet = wavelet::Cdf53;
 };
 
 void
-ComputeTransformDetails(transform_details* Td, const v3i& Dims3, int NLevels, u64 TformOrder);
+ComputeTransformDetails(transform_details* Td,
+                        const v3i& Dims3,
+                        int NLevels,
+                        u64 TformOrder,
+                        wavelet Wavelet = wavelet::Cdf53);
+
+/* The norms of the scaling and wavelet functions of a kernel (as GetCdf53NormsFast), computed once */
+const wav_basis_norms_static<16>&
+GetWaveletNorms(wavelet Wavelet);
 
 /* Normal lifting which uses mirroring at the boundary */
 template <typename t> void
@@ -8466,20 +8575,21 @@ InverseCdf53(const v3i& Dims3,
              u64 TformOrder,
              volume* Vol,
              bool Normalize = false);
+/* The transform of a brick, with the kernel of Td (the lifting is specialized for the kernel, see ForwardLift) */
 void
-ForwardCdf53(const v3i& M3,
-             int Iter,
-             const array<subband>& Subbands,
-             const transform_details& Td,
-             volume* Vol,
-             bool Normalize = false);
+ForwardWavelet(const v3i& M3,
+               int Iter,
+               const array<subband>& Subbands,
+               const transform_details& Td,
+               volume* Vol,
+               bool Normalize = false);
 void
-InverseCdf53(const v3i& M3,
-             int Iter,
-             const array<subband>& Subbands,
-             const transform_details& Td,
-             volume* Vol,
-             bool Normalize = false);
+InverseWavelet(const v3i& M3,
+               int Iter,
+               const array<subband>& Subbands,
+               const transform_details& Td,
+               volume* Vol,
+               bool Normalize = false);
 void
 ForwardCdf53Old(volume* Vol, int NLevels);
 
@@ -9042,6 +9152,187 @@ idx2_FLiftCdf53(Z, Y, X)   // X forward lifting
   idx2_ILiftCdf53Const(Z, X, Y) // Y inverse lifting
   idx2_ILiftCdf53Const(Y, X, Z) // Z inverse lifting
 
+/*
+The wavelet kernels, as traits whose ForwardLine and InverseLine lift one line of N samples (N odd, the coarse
+samples at the even positions) whose consecutive samples are S apart, so that ForwardLift and InverseLift are
+specialized for a kernel with no dispatch in their loops. The lines of the bricks always have 2^L+1 samples at every
+level; the partial bricks are extrapolated with CDF 5/3 (see ExtrapolateCdf53) whatever the kernel. Each kernel
+keeps the low-pass coefficients of a constant line equal to the constant and the high-pass ones zero.
+*/
+
+/* CDF 5/3, lifted by FLiftCdf53X (and Y, Z) and ILiftCdf53X (and Y, Z), which also extrapolate even lines */
+struct cdf53_kernel
+{
+  static constexpr wavelet Type = wavelet::Cdf53;
+};
+
+/* Haar, the cheapest (two operations per pair of samples), lossless on integers */
+struct haar_kernel
+{
+  static constexpr wavelet Type = wavelet::Haar;
+
+  template <typename t> static void
+  ForwardLine(t* idx2_Restrict F, i64 S, int N)
+  {
+    for (int I = 1; I < N; I += 2)
+    {
+      F[I * S] -= F[(I - 1) * S];
+      F[(I - 1) * S] += F[I * S] / 2;
+    }
+  }
+
+  template <typename t> static void
+  InverseLine(t* idx2_Restrict F, i64 S, int N)
+  {
+    for (int I = 1; I < N; I += 2)
+    {
+      F[(I - 1) * S] -= F[I * S] / 2;
+      F[I * S] += F[(I - 1) * S];
+    }
+  }
+};
+
+/* CDF 9/7 (the JPEG 2000 lifting steps), whose four vanishing moments suit smooth fields */
+struct cdf97_kernel
+{
+  static constexpr wavelet Type = wavelet::Cdf97;
+  static constexpr f64 Alpha = -1.586134342059924;
+  static constexpr f64 Beta = -0.052980118572961;
+  static constexpr f64 Gamma = 0.882911075530934;
+  static constexpr f64 Delta = 0.443506852043971;
+  static constexpr f64 Scale = 1 / (1 + 2 * Beta * (1 + 2 * Alpha)); // so that a constant stays the same
+
+  template <typename t> static void
+  Predict(t* idx2_Restrict F, i64 S, int N, f64 W)
+  {
+    for (int I = 1; I < N; I += 2)
+      F[I * S] += t(W * (F[(I - 1) * S] + F[(I + 1) * S]));
+  }
+
+  template <typename t> static void
+  Update(t* idx2_Restrict F, i64 S, int N, f64 W)
+  {
+    /* the odd samples past the ends are extrapolated (quadratically if the line is long enough), so that smooth lines
+    do not get large high-pass coefficients at the brick boundaries as with a symmetric extension */
+    const i64 L = (N - 1) * S;
+    if (N >= 7)
+    {
+      F[0] += t(W * (4 * F[S] - 3 * F[3 * S] + F[5 * S]));
+      F[L] += t(W * (4 * F[L - S] - 3 * F[L - 3 * S] + F[L - 5 * S]));
+    }
+    else if (N >= 5)
+    {
+      F[0] += t(W * (3 * F[S] - F[3 * S]));
+      F[L] += t(W * (3 * F[L - S] - F[L - 3 * S]));
+    }
+    else
+    {
+      F[0] += t(2 * W * F[S]);
+      F[L] += t(2 * W * F[L - S]);
+    }
+    for (int I = 2; I + 1 < N; I += 2)
+      F[I * S] += t(W * (F[(I - 1) * S] + F[(I + 1) * S]));
+  }
+
+  template <typename t> static void
+  ForwardLine(t* idx2_Restrict F, i64 S, int N)
+  {
+    Predict(F, S, N, Alpha);
+    Update(F, S, N, Beta);
+    Predict(F, S, N, Gamma);
+    Update(F, S, N, Delta);
+    for (int I = 0; I < N; I += 2)
+      F[I * S] = t(F[I * S] * Scale);
+  }
+
+  template <typename t> static void
+  InverseLine(t* idx2_Restrict F, i64 S, int N)
+  {
+    for (int I = 0; I < N; I += 2)
+      F[I * S] = t(F[I * S] / Scale);
+    Update(F, S, N, -Delta);
+    Predict(F, S, N, -Gamma);
+    Update(F, S, N, -Beta);
+    Predict(F, S, N, -Alpha);
+  }
+};
+
+/* Lift the lines along Axis of Grid (inside the first M3 samples of Vol, so Grid ends before M3) with a kernel */
+template <typename kernel, bool Forward, typename t> void
+LiftLines(const grid& Grid, const v3i& M3, int Axis, volume* Vol)
+{
+  v3i P = From(Grid), D = Dims(Grid), S = Strd(Grid), N = Dims(*Vol);
+  if (D[Axis] == 1)
+    return;
+  idx2_Assert(IsOdd(D[Axis]) && D[Axis] >= 3);
+  idx2_Assert(P[Axis] + S[Axis] * (D[Axis] - 1) < M3[Axis]);
+  (void)M3;
+  const i64 Strides[3] = { 1, i64(N.X), i64(N.X) * N.Y };
+  const int A1 = Axis == 0 ? 1 : 0, A2 = Axis == 2 ? 1 : 2;
+  t* F = (t*)Vol->Buffer.Data;
+  for (int J = 0; J < D[A2]; ++J)
+  {
+    for (int I = 0; I < D[A1]; ++I)
+    {
+      i64 Start = P[Axis] * Strides[Axis] + (P[A1] + I * S[A1]) * Strides[A1] + (P[A2] + J * S[A2]) * Strides[A2];
+      if constexpr (Forward)
+        kernel::ForwardLine(F + Start, S[Axis] * Strides[Axis], D[Axis]);
+      else
+        kernel::InverseLine(F + Start, S[Axis] * Strides[Axis], D[Axis]);
+    }
+  }
+}
+
+template <typename kernel, typename t> void
+ForwardLift(const grid& Grid, const v3i& M3, int Axis, volume* Vol)
+{
+  if constexpr (kernel::Type == wavelet::Cdf53)
+  {
+    if (Axis == 0)
+      FLiftCdf53X<t>(Grid, M3, lift_option::Normal, Vol);
+    else if (Axis == 1)
+      FLiftCdf53Y<t>(Grid, M3, lift_option::Normal, Vol);
+    else
+      FLiftCdf53Z<t>(Grid, M3, lift_option::Normal, Vol);
+  }
+  else
+  {
+    LiftLines<kernel, true, t>(Grid, M3, Axis, Vol);
+  }
+}
+
+template <typename kernel, typename t> void
+InverseLift(const grid& Grid, const v3i& M3, int Axis, volume* Vol)
+{
+  if constexpr (kernel::Type == wavelet::Cdf53)
+  {
+    if (Axis == 0)
+      ILiftCdf53X<t>(Grid, M3, lift_option::Normal, Vol);
+    else if (Axis == 1)
+      ILiftCdf53Y<t>(Grid, M3, lift_option::Normal, Vol);
+    else
+      ILiftCdf53Z<t>(Grid, M3, lift_option::Normal, Vol);
+  }
+  else
+  {
+    LiftLines<kernel, false, t>(Grid, M3, Axis, Vol);
+  }
+}
+
+/* Call Func(kernel()) with the kernel trait of Wavelet (this is the only dispatch on the kernel) */
+template <typename func> void
+DispatchOnWavelet(wavelet Wavelet, const func& Func)
+{
+  if (Wavelet == wavelet::Cdf53)
+    Func(cdf53_kernel());
+  else if (Wavelet == wavelet::Haar)
+    Func(haar_kernel());
+  else if (Wavelet == wavelet::Cdf97)
+    Func(cdf97_kernel());
+  else
+    idx2_Abort("unknown wavelet %d\n", int(Wavelet));
+}
+
 // idx2_FLiftExtCdf53(Z, Y, X) // X forward lifting
 // idx2_FLiftExtCdf53(Z, X, Y) // Y forward lifting
 // idx2_FLiftExtCdf53(Y, X, Z) // Z forward lifting
@@ -9098,7 +9389,9 @@ idx2_Enum(idx2_err_code,
           ChunkNotFound,
           BrickNotFound,
           FileNotFound,
-          UnsupportedScheme);
+          UnsupportedScheme,
+          Cancelled,
+          DownsamplingTooLow);
 
 idx2_Enum(func_level, u8, Subband, Sum, Max);
 
@@ -9113,6 +9406,10 @@ struct file_id
   u64 Id = 0;
 };
 
+struct rd_truncation;
+
+struct co_located_chunks;
+
 struct params
 {
   volume NasaMask;
@@ -9156,6 +9453,34 @@ struct params
   v3<i64> Strides3 = v3<i64>(0);
   i64 Offset = -1; // this can be used to specify the "depth"
   i64 NSamplesInFile = 0;
+  int PreviewLevel = -1; // if >= 0, also write a preview 2^PreviewLevel times smaller in X and Y (see preview)
+  bool RdCurves = false; // if true, also write the rate-distortion curve of every tile (see rd_curves)
+  rd_truncation* Truncation = nullptr; // decode only the bit planes it selects per tile (see SelectTruncation)
+  /* called by the decoder before each brick (e.g., to run more urgent work first), returning false stops the
+  decode with the Cancelled error */
+  bool (*OnBrick)(void* Data) = nullptr;
+  void* OnBrickData = nullptr;
+  /* the directory of the fast storage tier: the encoder places the coarsest FastLevels levels and the top
+  FastBitPlanes bit planes there (see PlaceTiers); for the decoder, it overrides the one in the metadata (e.g., when
+  the fast tier is mounted elsewhere) */
+  cstr FastDir = nullptr;
+  int FastLevels = 0;
+  int FastBitPlanes = 0;
+  /* the encoder skips the transform of the bricks of level 0 whose samples are all the same (e.g., land in the ocean
+  fields), and records their value in a table per chunk so that the decoder can fill them without reading or
+  transforming anything (their bit planes are still written, so that older decoders read them as usual) */
+  bool ConstantBricks = true;
+  /* for float32 fields, quantize the zfp blocks to 32-bit integers (which carry all the precision of the samples)
+  instead of 64-bit ones, so that the block transform and the bit plane coding work on twice as many lanes at once.
+  Off by default: this writes version 1.1 of the format, which decoders older than 1.1 cannot read (they do not fail
+  on it, they decode zeros), see HasInt32Blocks */
+  bool Int32Blocks = false;
+  /* the fields already encoded (in OutDir, with the same name and layout) that the encoder co-locates this one with
+  (see CoLocate), separated by '+', e.g., "u" when encoding v */
+  cstr CoLocate = nullptr;
+  /* for the decoder of a co-located field: the chunks of the other fields read along with those of this one, which
+  a decode of another field with the same object then takes instead of reading them (see co_located_chunks) */
+  co_located_chunks* CoLocatedChunks = nullptr;
 };
 
 struct idx2_file
@@ -9176,10 +9501,12 @@ struct idx2_file
   static constexpr int MaxLevels = 16;
   static constexpr int MaxTformPassesPerLevels = 9;
   static constexpr int MaxSpatialDepth = 4; // we have at most this number of spatial subdivisions
+  static constexpr int MaxCoLocatedFields = 8;
   char Name[32] = {};
   char Field[32] = {};
   v3i Dims3 = v3i(256);
   v3i DownsamplingFactor3 = v3i(0);
+  v3i MinDownsampling3 = v3i(0); // the data needed below this downsampling factor is not stored (a subset)
   dtype DType = dtype::__Invalid__;
   v3i BrickDims3 = v3i(32);
   v3i BrickDimsExt3 = v3i(33);
@@ -9219,6 +9546,7 @@ struct idx2_file
   stack_array<v3i, MaxLevels> ChunksPerFile3s = { { v3i(16) } };
   transform_details Td;           // used for normal transform
   transform_details TdExtrpolate; // used only for extrapolation
+  wavelet Wavelet = wavelet::Cdf53; // the kernel of the transform (see SetWavelet)
   cstr Dir = "./";
   v2d ValueRange = v2d(traits<f64>::Max, traits<f64>::Min);
   array<int> QualityLevelsIn; // [] -> bytes
@@ -9226,6 +9554,23 @@ struct idx2_file
   bool GroupLevels = false;
   bool GroupBitPlanes = true;
   bool GroupSubLevels = true;
+  /* tiered storage (see GetTierDir and PlaceTiers): if FastDir is not empty, the files of the levels from
+  FastMinLevel up (if levels are not grouped) and of the bit planes from FastMinBitPlane up (if bit planes are not
+  grouped), and all the exponents and truncation points, are under FastDir instead of Dir */
+  char FastDir[256] = {};
+  i8 FastMinLevel = MaxLevels;
+  i16 FastMinBitPlane = traits<i16>::Max;
+  /* the exponent chunks of level 0 and subband 0 end with the table of their constant bricks (see
+  params::ConstantBricks), which the decoder fills with their value instead of decoding them */
+  bool ConstantBricks = false;
+  /* the zfp blocks are quantized to 32-bit integers (see params::Int32Blocks and HasInt32Blocks) */
+  bool Int32Blocks = false;
+  /* co-located fields (see CoLocate): if CoLocated is not empty, the brick data of this field is stored with that of
+  the other fields in CoLocated (e.g., "u+v", in the order of the fields in the files), in the directory named
+  CoLocated instead of Field, where this field is the CoLocatedField-th of NCoLocatedFields */
+  char CoLocated[64] = {};
+  i8 CoLocatedField = 0;
+  i8 NCoLocatedFields = 0;
 };
 
 struct brick_volume
@@ -9254,6 +9599,21 @@ Size(const brick_volume& B)
   return Prod(Dims(B.Vol)) * SizeOf(B.Vol.Type);
 }
 
+/* Whether the zfp blocks are quantized to 32-bit integers (float32 fields encoded with params::Int32Blocks, which
+need version 1.1 of the format) rather than 64-bit ones. Either way a bit plane keeps its number (the one of the
+64-bit integers), the 32-bit integers being the top 32 bit planes. */
+idx2_Inline bool
+HasInt32Blocks(const idx2_file& Idx2)
+{
+  return Idx2.Int32Blocks && Idx2.DType == dtype::float32;
+}
+
+/* The lowest version of the format that can decode the field: 1.1 if it uses a feature that decoders older than
+1.1 would misread (they only decode version 1.0, and do not fail on 1.1: they skip every subband and return zeros),
+1.0 otherwise, so that the fields without these features stay readable by all the decoders */
+void
+SetFormatVersion(idx2_file* Idx2);
+
 void
 SetName(idx2_file* Idx2, cstr Name);
 
@@ -9275,6 +9635,11 @@ SetBrickSize(idx2_file* Idx2, const v3i& BrickDims3);
 void
 SetNumIterations(idx2_file* Idx2, i8 NIterations);
 
+/* Haar is the cheapest to compute but needs about 1.7x the bytes of CDF 5/3 (the default) on smooth fields; CDF 9/7
+costs more to compute and reaches a lower error than CDF 5/3 for about the same bytes on smooth fields */
+void
+SetWavelet(idx2_file* Idx2, wavelet Wavelet);
+
 void
 SetAccuracy(idx2_file* Idx2, f64 Accuracy);
 
@@ -9374,6 +9739,7 @@ template <typename t> struct brick_table
 struct chunk_exp_cache
 {
   bitstream BrickExpsStream;
+  array<t2<i32, f64>> ConstantBricks; // (brick in chunk, value), of level 0 and subband 0 only
 };
 
 struct chunk_rdo_cache
@@ -9404,6 +9770,10 @@ struct file_cache
 {
   array<i64> ChunkSizes;                    // TODO: 32-bit to store chunk sizes?
   hash_table<u64, chunk_cache> ChunkCaches; // [chunk address] -> chunk cache
+  /* of a co-located file (see CoLocate), instead of ChunkSizes: where the chunks of all the fields for the chunk at
+  each position start, and their sizes (NCoLocatedFields per position, 0 if the field has no such chunk) */
+  array<i64> RecordOffsets;
+  array<i64> RecordSizes;
 };
 
 struct file_cache_table
@@ -9413,6 +9783,69 @@ struct file_cache_table
   hash_table<u64, file_rdo_cache> FileRdoCaches; // [file rdo address] -> file rdo cache
 };
 
+/*
+The data that the decoder of a co-located field (see CoLocate) reads for the other fields (see
+params::CoLocatedChunks). The chunks of all the fields for the same chunk address follow each other in the files, so
+they are read in one I/O, and the chunks of the other fields wait here until a decode of their field takes them;
+the indexes of the files are kept too, so that the decodes of the other fields do not read them again. Decoding u
+then v with the same object thus reads each file and each chunk once. The decodes may run on several threads.
+At most MaxBytes of chunks wait: past that, the chunks of the other fields are not kept and their decodes read them
+again. The chunks kept are the first ones read, which the decodes of the other fields take first.
+*/
+struct co_located_chunks
+{
+  mutex Mutex; // guards all the members
+  hash_table<u64, bitstream> Chunks[idx2_file::MaxCoLocatedFields]; // [field][chunk address] -> chunk
+  hash_table<u64, buffer> Indexes;                                     // [file address] -> end of the file
+  i64 Bytes = 0; // of the chunks waiting
+  i64 MaxBytes = i64(1) << 30;
+};
+
+void
+Init(co_located_chunks* CoLocatedChunks);
+
+void
+Dealloc(co_located_chunks* CoLocatedChunks);
+
+/* Statistics of one call to Decode (or the sum of many, see decode_stats_aggregator) */
+struct decode_stats
+{
+  i64 NDecodes = 0;
+  /* bytes read, per stream type */
+  i64 BytesRdos = 0;  // rate-distortion truncation points
+  i64 BytesExps = 0;  // block exponents
+  i64 BytesIndex = 0; // chunk addresses and chunk sizes
+  i64 BytesData = 0;  // chunk payloads (the bit planes)
+  /* file and cache behavior */
+  i64 NFilesOpened = 0;
+  i64 NChunksHit = 0; // chunk requests served from the in-memory chunk cache
+  i64 NChunksMissed = 0;
+  i64 NChunksCoLocated = 0; // misses served by the read of another field (see co_located_chunks)
+  i64 NChunkExpsHit = 0;
+  i64 NChunkExpsMissed = 0;
+  /* amount of work */
+  i64 NBricksDecoded = 0;
+  i64 NConstantBricks = 0;   // filled with their value, without decoding (see idx2_file::ConstantBricks)
+  i64 NBlocksDecoded = 0;    // zfp blocks with at least one bit plane decoded
+  i64 NBitPlanesDecoded = 0; // summed over all blocks
+  i64 PeakBrickBytes = 0;    // when aggregated, the max over all decodes
+  i64 BrickBytesSaved = 0;   // bytes released by compacting parent bricks
+  /* per-stage times, in nanoseconds */
+  i64 TotalTime = 0;
+  i64 IOTime = 0;               // reading from disk
+  i64 SubbandTime = 0;          // DecodeSubband, including the io and data movement it triggers
+  i64 DataMovementTime = 0;     // scattering decoded blocks into bricks
+  i64 InverseTransformTime = 0; // inverse wavelet transform of bricks
+  i64 OutputTime = 0;           // copying finished bricks to the output
+};
+
+/* Process-wide totals of decode_stats, safe to update from multiple threads */
+struct decode_stats_aggregator
+{
+  mutex Mutex;
+  decode_stats Total;
+};
+
 struct decode_data
 {
   allocator* Alloc = nullptr;
@@ -9433,16 +9866,18 @@ struct decode_data
   bitstream ChunkSzsStream;
   //  array<t2<u64, u64>> RequestedChunks; // is cleared after each tile
   int QualityLevel = -1;
+  rd_truncation* Truncation = nullptr;
   int EffIter = 0;
   u64 LastTile = 0;
+  co_located_chunks* CoLocatedChunks = nullptr;
 
-  u64 BytesRdos_ = 0;
-  u64 DecodeIOTime_ = 0;
-  u64 BytesExps_ = 0;
-  u64 BytesData_ = 0;
-  u64 DataMovementTime_ = 0;
+  i64 BrickBytes_ = 0; // bytes currently held by brick volumes (working brick + one parent per coarser level)
+  decode_stats Stats;
 };
 
+/* ---------------------- GLOBALS ----------------------*/
+extern decode_stats_aggregator DecodeStats_; // totals of all decodes done by this process
+
 /* ---------------------- FUNCTIONS ----------------------*/
 
 error<idx2_err_code>
@@ -9552,9 +9987,33 @@ SizeBrickPool(const decode_data& D)
   return Result;
 }
 
+/* Accumulate Src into Dst (PeakBrickBytes is max-ed, everything else is summed) */
+void
+Add(decode_stats* Dst, const decode_stats& Src);
+
+void
+Add(decode_stats_aggregator* Agg, const decode_stats& Stats);
+
+/* Return a copy of the current totals */
+decode_stats
+Snapshot(decode_stats_aggregator* Agg);
+
+void
+Reset(decode_stats_aggregator* Agg);
+
+/* Print as a flat JSON object */
+void
+PrintJson(printer* Pr, const decode_stats& Stats);
+
+/* Print in the Prometheus text exposition format */
+void
+PrintPrometheus(printer* Pr, const decode_stats& Stats);
+
 // TODO: return an error code?
+/* If Stats is not null, it is filled with the statistics of this decode (the statistics are also
+always added to DecodeStats_) */
 error<idx2_err_code>
-Decode(const idx2_file& Idx2, const params& P, buffer* OutBuf = nullptr);
+Decode(const idx2_file& Idx2, const params& P, buffer* OutBuf = nullptr, decode_stats* Stats = nullptr);
 
 } // namespace idx2
 
@@ -9644,6 +10103,18 @@ struct encode_data
   array<t2<u32, channel*>> SortedChannels;
   array<rdo_chunk> ChunkRDOs; // list of chunks and their sizes, sorted by bit plane
   hash_table<u64, u32> ChunkRDOLengths;
+  /* rate-distortion curves (only if params::RdCurves) */
+  bool RdCurves = false;
+  hash_table<u64, f64> TileEnergies; // [chunk address without bit plane] -> squared error if nothing is decoded
+  hash_table<u64, f64> TileSses;     // [chunk address] -> decrease of the squared error from its bit plane
+  /* the max errors (see rd_point::MaxError) of the blocks of a tile, through the max gains of the wavelet synthesis */
+  hash_table<u64, f64> TileMaxErrors;    // [chunk address] -> of the blocks that code its bit plane, decoded down to it
+  hash_table<u64, f64> TileTopErrors;    // [chunk address] -> of the blocks whose first bit plane it is, if nothing is decoded
+  hash_table<u64, f64> TileBottomErrors; // [chunk address] -> of the blocks whose last bit plane it is, decoded down to it
+  hash_table<u64, f64> TileFloorErrors;  // [chunk address without bit plane] -> of the blocks that code no bit plane
+  /* the constant bricks of level 0 (brick, value) whose exponent chunk is not written yet (see
+  idx2_file::ConstantBricks) */
+  array<t2<u64, f64>> ConstantBricks;
 };
 
 /*
@@ -9661,8 +10132,100 @@ struct brick_copier
   Copy(const extent& ExtentGlobal, const extent& ExtentLocal, brick_volume* Brick);
 };
 
+/*
+A low-resolution copy of a volume (2^Level times smaller in X and Y, full resolution in Z), averaged brick by
+brick during encoding when params::PreviewLevel >= 0. It is written uncompressed next to the metadata file
+(<field>.preview), so that a reader can show a slice with a single read while the full decode is running.
+File layout: "idx2prv1", the dimensions (3 x i32), the level (i32), then f32 samples (X fastest, then Y, then Z).
+*/
+struct preview
+{
+  v3i Dims3 = v3i(0);
+  int Level = 0;
+  array<f64> Sums;
+  array<i32> Counts;
+};
+
 /* FUNCTIONS */
 
+void
+Init(preview* Preview, const v3i& VolumeDims3, int Level);
+
+void
+Dealloc(preview* Preview);
+
+/* Accumulate the samples of a brick (whose valid part covers ExtentGlobal in the volume) */
+void
+AddBrick(preview* Preview, const extent& ExtentGlobal, const brick_volume& Brick);
+
+error<idx2_err_code>
+WritePreviewFile(const preview& Preview, cstr FileName);
+
+/* Read slice Z of a preview file into Slice (f32), along with the dimensions and level of the preview */
+error<idx2_err_code>
+ReadPreviewSlice(cstr FileName, int Z, v3i* Dims3, int* Level, buffer* Slice);
+
+/*
+The rate-distortion curves of the tiles (a tile is a chunk of one subband, its address is that of the chunk with
+bit plane 0), written next to the metadata file (<field>.rd) when params::RdCurves is set. From the highest bit
+plane down, a point gives the bytes read to decode the tile down to its bit plane and the squared error left (over
+all the samples of the tile, through the gains of the wavelet synthesis) and the max error left (the largest error
+of a coefficient of the tile, times the largest gain of the synthesis, see SelectMaxErrorTruncation). Energy and
+MaxError are the errors of decoding nothing. File layout: "idx2rdc2", the number of tiles (i64), then per tile the
+address (u64), the energy (f64), the max error (f64), the number of points (i32) and the points (bit plane i16,
+bytes i64, squared error f64, max error f64). Files in the "idx2rdc1" layout (no max errors) can still be read.
+*/
+struct rd_point
+{
+  i16 BitPlane;
+  i64 Bytes;
+  f64 Sse;
+  f64 MaxError = -1;
+};
+
+struct rd_curve
+{
+  f64 Energy = 0;
+  f64 MaxError = -1;
+  array<rd_point> Points;
+};
+
+struct rd_curves
+{
+  hash_table<u64, rd_curve> Tiles;
+  bool HasMaxErrors = false; // false for the files written before the max errors were recorded
+};
+
+/* The bit planes to decode per tile to reach an error target, with the RMS error, the max error (a bound, only set
+by SelectMaxErrorTruncation) and the bytes they give */
+struct rd_truncation
+{
+  hash_table<u64, i16> MinBitPlanes; // [tile] -> lowest bit plane to decode (traits<i16>::Max: skip the tile)
+  f64 Rmse = 0;
+  f64 MaxError = -1;
+  i64 Bytes = 0;
+};
+
+void
+Dealloc(rd_curves* Curves);
+
+void
+Dealloc(rd_truncation* Truncation);
+
+error<idx2_err_code>
+ReadRdCurves(cstr FileName, rd_curves* Curves);
+
+/* Pick the bit planes of the tiles of Extent that give an RMS error of at most TargetRmse with the fewest bytes
+(as far as the curves tell). Set params::Truncation to the result to decode with it. */
+error<idx2_err_code>
+SelectTruncation(const idx2_file& Idx2, rd_curves* Curves, const extent& Extent, f64 TargetRmse, rd_truncation* Truncation);
+
+/* Pick the bit planes of the tiles of Extent so that no decoded sample is off by more than TargetMaxError, with as
+few bytes as this greedy search finds. Unlike the RMS error, this is a guaranteed bound (Truncation->MaxError): the
+error of a sample is at most the sum, over the levels and subbands, of the max errors of the tiles it depends on. */
+error<idx2_err_code>
+SelectMaxErrorTruncation(const idx2_file& Idx2, rd_curves* Curves, const extent& Extent, f64 TargetMaxError, rd_truncation* Truncation);
+
 void
 WriteMetaFile(const idx2_file& Idx2, cstr FileName);
 
@@ -9895,6 +10458,54 @@ struct file_traverse
   u64 Address = 0;
 };
 
+/* The root directory of the files of a level and a bit plane: the fast tier or the capacity tier (Idx2.Dir) */
+idx2_Inline cstr
+GetTierDir(const idx2_file& Idx2, i8 Level, i16 BitPlane)
+{
+  if (Idx2.FastDir[0] == 0)
+    return Idx2.Dir;
+  bool Fast = (!Idx2.GroupLevels && Level >= Idx2.FastMinLevel) ||
+              (!Idx2.GroupBitPlanes && BitPlane >= Idx2.FastMinBitPlane);
+  return Fast ? Idx2.FastDir : Idx2.Dir;
+}
+
+/* The root directory of the exponents and the truncation points, which every decode reads */
+idx2_Inline cstr
+GetTierDir(const idx2_file& Idx2)
+{
+  return Idx2.FastDir[0] ? Idx2.FastDir : Idx2.Dir;
+}
+
+/* The directory (next to the field) of the brick data: the field's own, or the one it shares with its co-located
+fields */
+idx2_Inline cstr
+GetDataField(const idx2_file& Idx2)
+{
+  return Idx2.CoLocated[0] ? Idx2.CoLocated : Idx2.Field;
+}
+
+/*
+Co-locate the brick data of NFields fields encoded with the same name and layout (in the same directory, e.g., the
+components u and v of a velocity field), so that the chunks of all the fields for the same brick and bit plane
+follow each other in the same file, in the order of Idx2s. The files are rewritten (without decoding) in the
+directory named after the fields joined by '+' (e.g., "u+v"), whose chunk index holds the sizes of the chunks of all
+the fields at each chunk address; the exponents stay with each field. A field decodes alone as before (reading only
+its own chunks), and the decoder can read the chunks of all the fields in one I/O (see co_located_chunks). Only the
+co-location fields of the Idx2s are updated: the metadata of every field must be written again.
+*/
+error<idx2_err_code>
+CoLocate(idx2_file* Idx2s, int NFields);
+
+/*
+Move the files of an encoded field between the capacity tier (Idx2->Dir) and the fast tier FastDir, so that the
+coarsest FastLevels levels (requires ungrouped levels) and the top FastBitPlanes bit planes (requires ungrouped bit
+planes) of the brick data, as well as all the exponents and truncation points, are on the fast tier, and the rest
+on the capacity tier. A null or empty FastDir moves everything back to the capacity tier. Only the placement fields
+of Idx2 are updated: the metadata must be written again for decoders to find the files.
+*/
+error<idx2_err_code>
+PlaceTiers(idx2_file* Idx2, cstr FastDir, int FastLevels, int FastBitPlanes);
+
 file_id
 ConstructFilePathRdos(const idx2_file& Idx2, u64 Brick, i8 Level);
 
@@ -10128,7 +10739,9 @@ ReadUnary(bitstream* Bs)
 
 /* Adapted from the zfp compression library */
 
-//#include <immintrin.h>
+#if defined(idx2_Avx2) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
 //#include <iostream>
 
 namespace idx2
@@ -11102,26 +11715,45 @@ Decode(t* idx2_Restrict Block, int NVals, int B, /*i64 S, */ i8& N, bitstream* i
 //      Block[I] += (t)((X >> I) & 1u) << B;
 //  }
 #if defined(idx2_Avx2) && defined(__AVX2__)
-  __m256i Minus1 = _mm256_set1_epi64x(-1);
-  __m256i Add = _mm256_set1_epi64x(t(1) << B);
-  __m256i Mask = _mm256_set_epi64x(
-    0xfffffffffffffff7ll, 0xfffffffffffffffbll, 0xfffffffffffffffdll, 0xfffffffffffffffell);
-  while (X)
-  { // the input value X is used as a mask to add the shifted 1 bits (in Add) to the 4 values in
-    // Block
-    __m256i Val = _mm256_set1_epi64x(X);
-    Val = _mm256_or_si256(Val, Mask);
-    Val = _mm256_cmpeq_epi64(Val, Minus1); // "spread" the bits of X to 4 lanes
-    // TODO: to decode more than one bit plane, we can spread the bits of 8 bit planes (or more) to
-    // 4 lanes and then add only once we can even work with 32 8-bit lanes (_epu8 unsigned char) to
-    // do bit transposing and shift the values when adding back to the results later
-    // int table[8] ALIGNED(32) = { 1, 2, 3, 4, 5, 6, 7, 8 };
-    _mm256_maskstore_epi64(
-      (long long int*)Block,
-      Val,
-      _mm256_add_epi64(_mm256_maskload_epi64((long long int*)Block, Val), Add));
-    X >>= 4;
-    Block += 4;
+  if constexpr (sizeof(t) == 4)
+  { // same as below but on 8 32-bit lanes at a time
+    __m256i Minus1 = _mm256_set1_epi32(-1);
+    __m256i Add = _mm256_set1_epi32(int(t(1) << B));
+    __m256i Mask = _mm256_set_epi32(
+      0xffffff7f, 0xffffffbf, 0xffffffdf, 0xffffffef, 0xfffffff7, 0xfffffffb, 0xfffffffd, 0xfffffffe);
+    while (X)
+    {
+      __m256i Val = _mm256_set1_epi32(int(X & 0xff));
+      Val = _mm256_or_si256(Val, Mask);
+      Val = _mm256_cmpeq_epi32(Val, Minus1); // "spread" the bits of X to 8 lanes
+      _mm256_maskstore_epi32((int*)Block, Val, _mm256_add_epi32(_mm256_maskload_epi32((int*)Block, Val), Add));
+      X >>= 8;
+      Block += 8;
+    }
+  }
+  else
+  {
+    __m256i Minus1 = _mm256_set1_epi64x(-1);
+    __m256i Add = _mm256_set1_epi64x(t(1) << B);
+    __m256i Mask = _mm256_set_epi64x(
+      0xfffffffffffffff7ll, 0xfffffffffffffffbll, 0xfffffffffffffffdll, 0xfffffffffffffffell);
+    while (X)
+    { // the input value X is used as a mask to add the shifted 1 bits (in Add) to the 4 values in
+      // Block
+      __m256i Val = _mm256_set1_epi64x(X);
+      Val = _mm256_or_si256(Val, Mask);
+      Val = _mm256_cmpeq_epi64(Val, Minus1); // "spread" the bits of X to 4 lanes
+      // TODO: to decode more than one bit plane, we can spread the bits of 8 bit planes (or more) to
+      // 4 lanes and then add only once we can even work with 32 8-bit lanes (_epu8 unsigned char) to
+      // do bit transposing and shift the values when adding back to the results later
+      // int table[8] ALIGNED(32) = { 1, 2, 3, 4, 5, 6, 7, 8 };
+      _mm256_maskstore_epi64(
+        (long long int*)Block,
+        Val,
+        _mm256_add_epi64(_mm256_maskload_epi64((long long int*)Block, Val), Add));
+      X >>= 4;
+      Block += 4;
+    }
   }
 #else
   for (int I = 0; X; ++I, X >>= 1)
@@ -12002,9 +12634,10 @@ GetOutputGrid(const idx2_file& Idx2, const params& P);
 
 /*
 Decode into a buffer.
+If Stats is not null, it receives the statistics (bytes read, cache hits, timings) of the decode.
 */
 error<idx2_err_code>
-Decode(idx2_file* Idx2, params& P, buffer* OutBuf);
+Decode(idx2_file* Idx2, params& P, buffer* OutBuf, decode_stats* Stats = nullptr);
 
 /*
 Deallocate all internal memory used by IDX2.
@@ -13724,6 +14357,51 @@ RemoveDir(cstr Path)
   remove(Path);
 }
 
+/* Move a file or a directory by renaming it if possible, otherwise (e.g., across file systems, or if the directory To
+already exists) entry by entry, copying the files that cannot be renamed. Returns false if some file could not be
+moved. */
+bool
+MovePath(cstr From, cstr To)
+{
+  CreateFullDir(GetDirName(To));
+  if (rename(From, To) == 0)
+    return true;
+
+  DIR* Dir = opendir(From);
+  if (!Dir) // a file on another file system
+  {
+    buffer Buf;
+    idx2_CleanUp(DeallocBuf(&Buf));
+    if (!ReadFile(From, &Buf) || !WriteBuffer(To, Buf))
+      return false;
+    remove(From);
+    return true;
+  }
+  CreateFullDir(To);
+  bool Ok = true;
+  struct dirent* Entry = nullptr;
+  char FromPath[512] = { 0 };
+  char ToPath[512] = { 0 };
+  while ((Entry = readdir(Dir)))
+  {
+    if (*(Entry->d_name) == '.')
+      continue;
+
+    int FromBytes = snprintf(FromPath, sizeof(FromPath), "%s/%s", From, Entry->d_name);
+    int ToBytes = snprintf(ToPath, sizeof(ToPath), "%s/%s", To, Entry->d_name);
+    if (FromBytes >= int(sizeof(FromPath)) || ToBytes >= int(sizeof(ToPath))) // do not move a truncated path
+    {
+      Ok = false;
+      continue;
+    }
+    Ok = MovePath(FromPath, ToPath) && Ok;
+  }
+  closedir(Dir);
+  remove(From);
+
+  return Ok;
+}
+
 stref
 GetExtension(const stref& Path)
 {
@@ -14349,6 +15027,112 @@ CloseFile(mmap_file* MMap)
 
 } // namespace idx2
 
+#if defined(idx2_Trace)
+
+namespace idx2
+{
+
+trace_registry TraceRegistry_;
+
+trace_registry::trace_registry()
+{
+  StartTimer(&Epoch);
+}
+
+/* Give the buffer back when the thread exits */
+struct trace_thread
+{
+  trace_buffer* Buffer = nullptr;
+  ~trace_thread()
+  {
+    if (Buffer)
+    {
+      lock Lock(&TraceRegistry_.Mutex);
+      Buffer->InUse = false;
+    }
+  }
+};
+
+static thread_local trace_thread TraceThread_;
+
+static trace_buffer*
+AcquireTraceBuffer()
+{
+  lock Lock(&TraceRegistry_.Mutex);
+  for (trace_buffer* Buf = TraceRegistry_.Head; Buf; Buf = Buf->Next)
+  {
+    if (!Buf->InUse)
+    {
+      Buf->InUse = true;
+      return Buf;
+    }
+  }
+  auto Buf = (trace_buffer*)calloc(1, sizeof(trace_buffer));
+  Buf->ThreadId = TraceRegistry_.NBuffers++;
+  Buf->InUse = true;
+  Buf->Next = TraceRegistry_.Head;
+  TraceRegistry_.Head = Buf;
+  return Buf;
+}
+
+trace_buffer*
+GetTraceBuffer()
+{
+  if (!TraceThread_.Buffer)
+    TraceThread_.Buffer = AcquireTraceBuffer();
+  return TraceThread_.Buffer;
+}
+
+void
+PrintTrace(printer* Pr)
+{
+  lock Lock(&TraceRegistry_.Mutex);
+  idx2_Print(Pr, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  bool First = true;
+  for (trace_buffer* Buf = TraceRegistry_.Head; Buf; Buf = Buf->Next)
+  {
+    i64 NEvents = Min(Buf->NEvents, (i64)trace_buffer::Capacity);
+    idx2_For (i64, I, Buf->NEvents - NEvents, Buf->NEvents)
+    {
+      const trace_event& Event = Buf->Events[I & (trace_buffer::Capacity - 1)];
+      idx2_Print(Pr,
+                 "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                 First ? "" : ",",
+                 Event.Name,
+                 Buf->ThreadId,
+                 Event.Begin / 1e3,
+                 Event.Duration / 1e3);
+      First = false;
+    }
+  }
+  idx2_Print(Pr, "\n]}\n");
+}
+
+error<>
+DumpTrace(cstr FileName)
+{
+  FILE* Fp = fopen(FileName, "w");
+  idx2_CleanUp(if (Fp) fclose(Fp));
+  if (!Fp)
+    return idx2_Error(err_code::FileCreateFailed, "%s", FileName);
+  printer Pr(Fp);
+  PrintTrace(&Pr);
+
+  return idx2_Error(err_code::NoError);
+}
+
+void
+ResetTrace()
+{
+  lock Lock(&TraceRegistry_.Mutex);
+  for (trace_buffer* Buf = TraceRegistry_.Head; Buf; Buf = Buf->Next)
+    Buf->NEvents = 0;
+}
+
+} // namespace idx2
+
+#endif
+
 #if defined(__CYGWIN__) || defined(_WIN32)
 // Adapted from
 // http://www.rioki.org/2017/01/09/windows_stacktrace.html and
@@ -42912,6 +43696,20 @@ SetNumIterations(idx2_file* Idx2, i8 NLevels)
   Idx2->NLevels = NLevels;
 }
 
+void
+SetWavelet(idx2_file* Idx2, wavelet Wavelet)
+{
+  Idx2->Wavelet = Wavelet;
+}
+
+void
+SetFormatVersion(idx2_file* Idx2)
+{
+  if (Idx2->Version[0] == 1)
+    Idx2->Version[1] =
+      Idx2->Int32Blocks || Idx2->Wavelet != wavelet::Cdf53 ? 1 : 0;
+}
+
 void
 SetAccuracy(idx2_file* Idx2, f64 Accuracy)
 {
@@ -42989,6 +43787,13 @@ Finalize(idx2_file* Idx2, const params& P)
                       idx2_PrV3i(Idx2->BrickDims3));
   if (!(Idx2->NLevels <= idx2_file::MaxLevels))
     return idx2_Error(idx2_err_code::TooManyLevels, "Max # of levels = %d\n", Idx2->MaxLevels);
+  if (P.FastDir && ((P.FastLevels > 0 && Idx2->GroupLevels) || (P.FastBitPlanes > 0 && Idx2->GroupBitPlanes)))
+    return idx2_Error(idx2_err_code::OptionNotSupported,
+                      "the levels (bit planes) can only be placed on the fast tier if they are not grouped\n");
+  if (P.FastDir && P.CoLocate && P.CoLocate[0])
+    return idx2_Error(idx2_err_code::OptionNotSupported, "a co-located field cannot be placed on two tiers\n");
+  if (Idx2->Wavelet == wavelet::__Invalid__)
+    return idx2_Error(idx2_err_code::OptionNotSupported, "unknown wavelet\n");
 
   char TformOrder[8] = {};
   { /* compute the transform order (try to repeat XYZ++) */
@@ -43217,7 +44022,7 @@ Finalize(idx2_file* Idx2, const params& P)
   }
 
   { /* compute the transform details, for both the normal transform and for extrapolation */
-    ComputeTransformDetails(&Idx2->Td, Idx2->BrickDimsExt3, Idx2->NTformPasses, Idx2->TformOrder);
+    ComputeTransformDetails(&Idx2->Td, Idx2->BrickDimsExt3, Idx2->NTformPasses, Idx2->TformOrder, Idx2->Wavelet);
     int NLevels = Log2Floor(Max(Max(Idx2->BrickDims3.X, Idx2->BrickDims3.Y), Idx2->BrickDims3.Z));
     ComputeTransformDetails(&Idx2->TdExtrpolate, Idx2->BrickDims3, NLevels, Idx2->TformOrder);
   }
@@ -43717,6 +44522,7 @@ ReadChunkExponents(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Level, i
 
 static error<idx2_err_code>
 ReadFileRdos(const idx2_file& Idx2,
+             decode_data* D,
              hash_table<u64, file_rdo_cache>::iterator* FileRdoCacheIt,
              const file_id& FileId);
 
@@ -43729,7 +44535,7 @@ ReadFile(decode_data* D, hash_table<u64, file_cache>::iterator* FileCacheIt, con
 static expected<const chunk_cache*, idx2_err_code>
 ReadChunk(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Iter, i8 Level, i16 BitPlane);
 
-static error<idx2_err_code>
+template <typename t> static error<idx2_err_code>
 DecodeSubband(const idx2_file& Idx2,
               decode_data* D,
               f64 Accuracy,
@@ -43752,6 +44558,7 @@ static void
 Dealloc(chunk_exp_cache* ChunkExpCache)
 {
   Dealloc(&ChunkExpCache->BrickExpsStream);
+  Dealloc(&ChunkExpCache->ConstantBricks);
 }
 
 static void
@@ -43790,6 +44597,8 @@ static void
 Dealloc(file_cache* FileCache)
 {
   Dealloc(&FileCache->ChunkSizes);
+  Dealloc(&FileCache->RecordOffsets);
+  Dealloc(&FileCache->RecordSizes);
   idx2_ForEach (ChunkCacheIt, FileCache->ChunkCaches)
     Dealloc(ChunkCacheIt.Val);
   Dealloc(&FileCache->ChunkCaches);
@@ -43817,6 +44626,30 @@ Dealloc(file_cache_table* FileCacheTable)
   Dealloc(&FileCacheTable->FileRdoCaches);
 }
 
+void
+Init(co_located_chunks* CoLocatedChunks)
+{
+  idx2_For (int, F, 0, idx2_file::MaxCoLocatedFields)
+    Init(&CoLocatedChunks->Chunks[F], 7);
+  Init(&CoLocatedChunks->Indexes, 5);
+  CoLocatedChunks->Bytes = 0;
+}
+
+void
+Dealloc(co_located_chunks* CoLocatedChunks)
+{
+  idx2_For (int, F, 0, idx2_file::MaxCoLocatedFields)
+  {
+    idx2_ForEach (ChunkIt, CoLocatedChunks->Chunks[F])
+      Dealloc(ChunkIt.Val);
+    Dealloc(&CoLocatedChunks->Chunks[F]);
+  }
+  idx2_ForEach (IndexIt, CoLocatedChunks->Indexes)
+    DeallocBuf(IndexIt.Val);
+  Dealloc(&CoLocatedChunks->Indexes);
+  CoLocatedChunks->Bytes = 0;
+}
+
 static void
 Init(decode_data* D, allocator* Alloc = nullptr)
 {
@@ -43844,6 +44677,195 @@ Dealloc(decode_data* D)
   //  Dealloc(&D->RequestedChunks);
 }
 
+decode_stats_aggregator DecodeStats_;
+
+void
+Add(decode_stats* Dst, const decode_stats& Src)
+{
+  Dst->NDecodes += Src.NDecodes;
+  Dst->BytesRdos += Src.BytesRdos;
+  Dst->BytesExps += Src.BytesExps;
+  Dst->BytesIndex += Src.BytesIndex;
+  Dst->BytesData += Src.BytesData;
+  Dst->NFilesOpened += Src.NFilesOpened;
+  Dst->NChunksHit += Src.NChunksHit;
+  Dst->NChunksMissed += Src.NChunksMissed;
+  Dst->NChunksCoLocated += Src.NChunksCoLocated;
+  Dst->NChunkExpsHit += Src.NChunkExpsHit;
+  Dst->NChunkExpsMissed += Src.NChunkExpsMissed;
+  Dst->NBricksDecoded += Src.NBricksDecoded;
+  Dst->NConstantBricks += Src.NConstantBricks;
+  Dst->NBlocksDecoded += Src.NBlocksDecoded;
+  Dst->NBitPlanesDecoded += Src.NBitPlanesDecoded;
+  Dst->PeakBrickBytes = Max(Dst->PeakBrickBytes, Src.PeakBrickBytes);
+  Dst->BrickBytesSaved += Src.BrickBytesSaved;
+  Dst->TotalTime += Src.TotalTime;
+  Dst->IOTime += Src.IOTime;
+  Dst->SubbandTime += Src.SubbandTime;
+  Dst->DataMovementTime += Src.DataMovementTime;
+  Dst->InverseTransformTime += Src.InverseTransformTime;
+  Dst->OutputTime += Src.OutputTime;
+}
+
+void
+Add(decode_stats_aggregator* Agg, const decode_stats& Stats)
+{
+  lock Lock(&Agg->Mutex);
+  Add(&Agg->Total, Stats);
+}
+
+decode_stats
+Snapshot(decode_stats_aggregator* Agg)
+{
+  lock Lock(&Agg->Mutex);
+  return Agg->Total;
+}
+
+void
+Reset(decode_stats_aggregator* Agg)
+{
+  lock Lock(&Agg->Mutex);
+  Agg->Total = decode_stats();
+}
+
+void
+PrintJson(printer* Pr, const decode_stats& Stats)
+{
+#define idx2_PrintI64(Name, Sep) idx2_Print(Pr, "\"" #Name "\": %" PRIi64 Sep, Stats.Name);
+#define idx2_PrintSec(Name, Sep) idx2_Print(Pr, "\"" #Name "\": %.9f" Sep, Seconds(Stats.Name));
+  idx2_Print(Pr, "{");
+  idx2_PrintI64(NDecodes, ", ");
+  idx2_PrintI64(BytesRdos, ", ");
+  idx2_PrintI64(BytesExps, ", ");
+  idx2_PrintI64(BytesIndex, ", ");
+  idx2_PrintI64(BytesData, ", ");
+  idx2_PrintI64(NFilesOpened, ", ");
+  idx2_PrintI64(NChunksHit, ", ");
+  idx2_PrintI64(NChunksMissed, ", ");
+  idx2_PrintI64(NChunksCoLocated, ", ");
+  idx2_PrintI64(NChunkExpsHit, ", ");
+  idx2_PrintI64(NChunkExpsMissed, ", ");
+  idx2_PrintI64(NBricksDecoded, ", ");
+  idx2_PrintI64(NConstantBricks, ", ");
+  idx2_PrintI64(NBlocksDecoded, ", ");
+  idx2_PrintI64(NBitPlanesDecoded, ", ");
+  idx2_PrintI64(PeakBrickBytes, ", ");
+  idx2_PrintI64(BrickBytesSaved, ", ");
+  idx2_PrintSec(TotalTime, ", ");
+  idx2_PrintSec(IOTime, ", ");
+  idx2_PrintSec(SubbandTime, ", ");
+  idx2_PrintSec(DataMovementTime, ", ");
+  idx2_PrintSec(InverseTransformTime, ", ");
+  idx2_PrintSec(OutputTime, "");
+  idx2_Print(Pr, "}");
+#undef idx2_PrintI64
+#undef idx2_PrintSec
+}
+
+void
+PrintPrometheus(printer* Pr, const decode_stats& Stats)
+{
+#define idx2_PrintHeader(Metric, Type, Help)                                                       \
+  idx2_Print(Pr, "# HELP idx2_decode_" Metric " " Help "\n# TYPE idx2_decode_" Metric " " Type "\n");
+#define idx2_PrintI64(Metric, Labels, Val)                                                         \
+  idx2_Print(Pr, "idx2_decode_" Metric Labels " %" PRIi64 "\n", Val);
+#define idx2_PrintSec(Metric, Labels, Val)                                                         \
+  idx2_Print(Pr, "idx2_decode_" Metric Labels " %.9f\n", Seconds(Val));
+  idx2_PrintHeader("calls_total", "counter", "Number of decode calls.");
+  idx2_PrintI64("calls_total", "", Stats.NDecodes);
+  idx2_PrintHeader("bytes_read_total", "counter", "Bytes read from disk, per stream type.");
+  idx2_PrintI64("bytes_read_total", "{stream=\"rdo\"}", Stats.BytesRdos);
+  idx2_PrintI64("bytes_read_total", "{stream=\"exp\"}", Stats.BytesExps);
+  idx2_PrintI64("bytes_read_total", "{stream=\"index\"}", Stats.BytesIndex);
+  idx2_PrintI64("bytes_read_total", "{stream=\"data\"}", Stats.BytesData);
+  idx2_PrintHeader("files_opened_total", "counter", "Number of files opened.");
+  idx2_PrintI64("files_opened_total", "", Stats.NFilesOpened);
+  idx2_PrintHeader("chunk_requests_total", "counter", "Chunk requests, by cache outcome.");
+  idx2_PrintI64("chunk_requests_total", "{kind=\"data\",result=\"hit\"}", Stats.NChunksHit);
+  idx2_PrintI64("chunk_requests_total", "{kind=\"data\",result=\"miss\"}", Stats.NChunksMissed);
+  idx2_PrintI64("chunk_requests_total", "{kind=\"exp\",result=\"hit\"}", Stats.NChunkExpsHit);
+  idx2_PrintI64("chunk_requests_total", "{kind=\"exp\",result=\"miss\"}", Stats.NChunkExpsMissed);
+  idx2_PrintHeader("co_located_chunks_total", "counter", "Chunk misses served by the read of another co-located field.");
+  idx2_PrintI64("co_located_chunks_total", "", Stats.NChunksCoLocated);
+  idx2_PrintHeader("bricks_total", "counter", "Number of bricks decoded.");
+  idx2_PrintI64("bricks_total", "", Stats.NBricksDecoded);
+  idx2_PrintHeader("constant_bricks_total", "counter", "Number of constant bricks filled without decoding.");
+  idx2_PrintI64("constant_bricks_total", "", Stats.NConstantBricks);
+  idx2_PrintHeader("blocks_total", "counter", "Number of zfp blocks decoded.");
+  idx2_PrintI64("blocks_total", "", Stats.NBlocksDecoded);
+  idx2_PrintHeader("bit_planes_total", "counter", "Number of bit planes decoded, over all blocks.");
+  idx2_PrintI64("bit_planes_total", "", Stats.NBitPlanesDecoded);
+  idx2_PrintHeader("peak_brick_bytes", "gauge", "Peak bytes held by brick volumes in one decode.");
+  idx2_PrintI64("peak_brick_bytes", "", Stats.PeakBrickBytes);
+  idx2_PrintHeader("brick_bytes_saved_total", "counter", "Bytes released by compacting bricks.");
+  idx2_PrintI64("brick_bytes_saved_total", "", Stats.BrickBytesSaved);
+  idx2_PrintHeader("stage_seconds_total", "counter", "Time spent, per decode stage.");
+  idx2_PrintSec("stage_seconds_total", "{stage=\"total\"}", Stats.TotalTime);
+  idx2_PrintSec("stage_seconds_total", "{stage=\"io\"}", Stats.IOTime);
+  idx2_PrintSec("stage_seconds_total", "{stage=\"subband\"}", Stats.SubbandTime);
+  idx2_PrintSec("stage_seconds_total", "{stage=\"data_movement\"}", Stats.DataMovementTime);
+  idx2_PrintSec("stage_seconds_total", "{stage=\"inverse_transform\"}", Stats.InverseTransformTime);
+  idx2_PrintSec("stage_seconds_total", "{stage=\"output\"}", Stats.OutputTime);
+#undef idx2_PrintHeader
+#undef idx2_PrintI64
+#undef idx2_PrintSec
+}
+
+/* Allocate/free the f64 storage of a brick, keeping track of how many bytes are live.
+NOTE: the brick being decoded is always allocated at BrickDimsExt3, whatever its level: its subbands are scattered
+into it and it is inverse transformed in place, which needs the whole extended brick. A parent is then shrunk to what
+its children copy (see CompactParentBrick), and since the children are decoded right after it (see DecodeLevel), the
+live bytes are bounded by one brick per level. */
+static void
+AllocBrick(decode_data* D, volume* BVol, const v3i& Dims3)
+{
+  Resize(BVol, Dims3, dtype::float64, D->Alloc);
+  D->BrickBytes_ += Prod<i64>(Dims3) * sizeof(f64);
+  D->Stats.PeakBrickBytes = Max(D->Stats.PeakBrickBytes, D->BrickBytes_);
+}
+
+static void
+DeallocBrick(decode_data* D, volume* BVol)
+{
+  D->BrickBytes_ -= Prod<i64>(Dims(*BVol)) * sizeof(f64);
+  Dealloc(BVol);
+}
+
+/* Return the children (in units of bricks at level Level - 1) of a brick that the query touches */
+static extent
+ChildBricksInQuery(const idx2_file& Idx2, const params& P, i8 Level, const v3i& Brick3)
+{
+  idx2_Assert(Level > 0);
+  v3i B3 = Idx2.BrickDims3 * Pow(Idx2.GroupBrick3, Level - 1);
+  v3i Bf3 = From(P.DecodeExtent) / B3;
+  v3i Bl3 = Last(P.DecodeExtent) / B3;
+  extent Children(Brick3 * Idx2.GroupBrick3, Idx2.GroupBrick3);
+  Children = Crop(Children, extent(Idx2.NBricks3s[Level - 1]));
+  return Crop(Children, extent(Bf3, Bl3 - Bf3 + 1));
+}
+
+/* Once a parent brick is fully decoded, keep only the part of it that the children in the query
+will copy from, so that bricks waiting in the pool do not hold on to full (extended) volumes */
+static void
+CompactParentBrick(const idx2_file& Idx2, const params& P, decode_data* D, brick_volume* PBVol)
+{
+  i8 Level = D->Level;
+  v3i Brick3 = D->Bricks3[Level];
+  extent Children = ChildBricksInQuery(Idx2, P, Level, Brick3);
+  PBVol->NChildren = 0;
+  PBVol->NChildrenMax = (i8)Prod(Dims(Children));
+  v3i SbDims3 = Idx2.BrickDims3 / Idx2.GroupBrick3;
+  extent Needed((From(Children) - Brick3 * Idx2.GroupBrick3) * SbDims3, Dims(Children) * SbDims3);
+  i64 OldBytes = Prod<i64>(Dims(PBVol->Vol)) * sizeof(f64);
+  volume Compact;
+  AllocBrick(D, &Compact, Dims(Needed));
+  CopyExtentExtent<f64, f64>(Needed, PBVol->Vol, extent(Dims(Needed)), &Compact);
+  DeallocBrick(D, &PBVol->Vol);
+  PBVol->Vol = Compact;
+  PBVol->ExtentLocal = Needed;
+  D->Stats.BrickBytesSaved += OldBytes - Prod<i64>(Dims(Needed)) * sizeof(f64);
+}
+
 static void
 DecompressBufZstd(const buffer& Input, bitstream* Output)
 {
@@ -43862,9 +44884,12 @@ ReadFileExponents(decode_data* D,
                   hash_table<u64, file_exp_cache>::iterator* FileExpCacheIt,
                   const file_id& FileId)
 {
+  idx2_TraceScope("ReadFileExponents");
   timer IOTimer;
   StartTimer(&IOTimer);
   idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2::idx2_err_code::FileNotFound);
+  ++D->Stats.NFilesOpened;
   idx2_FSeek(Fp, 0, SEEK_END);
   int S = 0; // total bytes of the encoded chunk sizes
   ReadBackwardPOD(Fp, &S);
@@ -43873,8 +44898,8 @@ ReadFileExponents(decode_data* D,
   Rewind(&D->ChunkEMaxSzsStream);
   GrowToAccomodate(&D->ChunkEMaxSzsStream, S - Size(D->ChunkEMaxSzsStream));
   ReadBackwardBuffer(Fp, &D->ChunkEMaxSzsStream.Stream, S);
-  D->BytesExps_ += sizeof(int) + S;
-  D->DecodeIOTime_ += ElapsedTime(&IOTimer);
+  D->Stats.BytesExps += sizeof(int) + S;
+  D->Stats.IOTime += ElapsedTime(&IOTimer);
   InitRead(&D->ChunkEMaxSzsStream, D->ChunkEMaxSzsStream.Stream);
   file_exp_cache FileExpCache;
   Reserve(&FileExpCache.ChunkExpSzs, S);
@@ -43890,23 +44915,27 @@ ReadFileExponents(decode_data* D,
 
 static error<idx2_err_code>
 ReadFileRdos(const idx2_file& Idx2,
+             decode_data* D,
              hash_table<u64, file_rdo_cache>::iterator* FileRdoCacheIt,
              const file_id& FileId)
 {
+  idx2_TraceScope("ReadFileRdos");
   timer IOTimer;
   StartTimer(&IOTimer);
   idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2::idx2_err_code::FileNotFound);
+  ++D->Stats.NFilesOpened;
   idx2_FSeek(Fp, 0, SEEK_END);
   int NumChunks = 0;
   i64 Sz = idx2_FTell(Fp) - sizeof(NumChunks);
   ReadBackwardPOD(Fp, &NumChunks);
-  //BytesRdos_ += sizeof(NumChunks);
+  D->Stats.BytesRdos += sizeof(NumChunks);
   file_rdo_cache FileRdoCache;
   Resize(&FileRdoCache.TileRdoCaches, NumChunks);
   idx2_RAII(buffer, CompresBuf, AllocBuf(&CompresBuf, Sz), DeallocBuf(&CompresBuf));
   ReadBackwardBuffer(Fp, &CompresBuf);
-  //DecodeIOTime_ += ElapsedTime(&IOTimer);
-  //BytesRdos_ += Size(CompresBuf);
+  D->Stats.IOTime += ElapsedTime(&IOTimer);
+  D->Stats.BytesRdos += Size(CompresBuf);
   idx2_RAII(bitstream, Bs, );
   DecompressBufZstd(CompresBuf, &Bs);
   int Pos = 0;
@@ -43928,9 +44957,9 @@ ReadChunkRdos(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Iter)
   auto FileRdoCacheIt = Lookup(&D->FcTable.FileRdoCaches, FileId.Id);
   if (!FileRdoCacheIt)
   {
-    auto ReadFileOk = ReadFileRdos(Idx2, &FileRdoCacheIt, FileId);
+    auto ReadFileOk = ReadFileRdos(Idx2, D, &FileRdoCacheIt, FileId);
     if (!ReadFileOk)
-      idx2_PropagateError(ReadFileOk);
+      return idx2_PropagateError(ReadFileOk);
   }
   if (!FileRdoCacheIt)
     return idx2_Error(idx2_err_code::FileNotFound);
@@ -43942,10 +44971,12 @@ ReadChunkRdos(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Iter)
 static error<idx2_err_code>
 ReadFile(decode_data* D, hash_table<u64, file_cache>::iterator* FileCacheIt, const file_id& FileId)
 {
+  idx2_TraceScope("ReadFile");
   timer IOTimer;
   StartTimer(&IOTimer);
   idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
   idx2_ReturnErrorIf(!Fp, idx2::idx2_err_code::FileNotFound);
+  ++D->Stats.NFilesOpened;
   idx2_FSeek(Fp, 0, SEEK_END);
   int NChunks = 0;
   ReadBackwardPOD(Fp, &NChunks);
@@ -43960,8 +44991,8 @@ ReadFile(decode_data* D, hash_table<u64, file_cache>::iterator* FileCacheIt, con
             AllocBuf(&CpresChunkAddrs, ChunkAddrsSz),
             DeallocBuf(&CpresChunkAddrs)); // TODO: move to decode_data
   ReadBackwardBuffer(Fp, &CpresChunkAddrs, ChunkAddrsSz);
-  D->BytesData_ += ChunkAddrsSz;
-  D->DecodeIOTime_ += ElapsedTime(&IOTimer);
+  D->Stats.BytesIndex += ChunkAddrsSz;
+  D->Stats.IOTime += ElapsedTime(&IOTimer);
   Rewind(&D->ChunkAddrsStream);
   GrowToAccomodate(&D->ChunkAddrsStream, IniChunkAddrsSz - Size(D->ChunkAddrsStream));
   DecompressBufZstd(CpresChunkAddrs, &D->ChunkAddrsStream);
@@ -43973,8 +45004,8 @@ ReadFile(decode_data* D, hash_table<u64, file_cache>::iterator* FileCacheIt, con
   Rewind(&D->ChunkSzsStream);
   GrowToAccomodate(&D->ChunkSzsStream, ChunkSizesSz - Size(D->ChunkSzsStream));
   ReadBackwardBuffer(Fp, &D->ChunkSzsStream.Stream, ChunkSizesSz);
-  D->BytesData_ += ChunkSizesSz;
-  D->DecodeIOTime_ += ElapsedTime(&IOTimer);
+  D->Stats.BytesIndex += ChunkSizesSz;
+  D->Stats.IOTime += ElapsedTime(&IOTimer);
   InitRead(&D->ChunkSzsStream, D->ChunkSzsStream.Stream);
 
   /* parse the chunk addresses and cache in memory */
@@ -43995,18 +45026,189 @@ ReadFile(decode_data* D, hash_table<u64, file_cache>::iterator* FileCacheIt, con
   return idx2_Error(idx2_err_code::NoError);
 }
 
+/* Read the index of a co-located file (see CoLocate), or take it from the decode of another field */
+static error<idx2_err_code>
+ReadCoLocatedFile(const idx2_file& Idx2,
+                  decode_data* D,
+                  hash_table<u64, file_cache>::iterator* FileCacheIt,
+                  const file_id& FileId)
+{
+  idx2_TraceScope("ReadCoLocatedFile");
+  co_located_chunks* Cl = D->CoLocatedChunks;
+  buffer Index; // the end of the file: chunk sizes, their size, chunk addresses, their size, number of chunks
+  idx2_CleanUp(if (!Cl && Index) DeallocBuf(&Index));
+  bool Cached = false;
+  if (Cl)
+  {
+    lock Lck(&Cl->Mutex);
+    auto IndexIt = Lookup(&Cl->Indexes, FileId.Id);
+    if (IndexIt)
+    {
+      Index = *IndexIt.Val; // the indexes stay until Dealloc
+      Cached = true;
+    }
+  }
+  if (!Cached)
+  {
+    timer IOTimer;
+    StartTimer(&IOTimer);
+    idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
+    idx2_ReturnErrorIf(!Fp, idx2::idx2_err_code::FileNotFound);
+    ++D->Stats.NFilesOpened;
+    idx2_FSeek(Fp, 0, SEEK_END);
+    int NChunks = 0, ChunkAddrsSz = 0, ChunkSizesSz = 0;
+    ReadBackwardPOD(Fp, &NChunks);
+    ReadBackwardPOD(Fp, &ChunkAddrsSz);
+    idx2_FSeek(Fp, -(i64)ChunkAddrsSz, SEEK_CUR);
+    ReadBackwardPOD(Fp, &ChunkSizesSz);
+    i64 IndexSize = ChunkSizesSz + ChunkAddrsSz + 3 * (i64)sizeof(int);
+    AllocBuf(&Index, IndexSize);
+    idx2_FSeek(Fp, -IndexSize, SEEK_END);
+    ReadBuffer(Fp, &Index);
+    D->Stats.BytesIndex += IndexSize;
+    D->Stats.IOTime += ElapsedTime(&IOTimer);
+    if (Cl)
+    {
+      lock Lck(&Cl->Mutex);
+      auto IndexIt = Lookup(&Cl->Indexes, FileId.Id);
+      if (IndexIt) // read by another thread in the meantime
+      {
+        DeallocBuf(&Index);
+        Index = *IndexIt.Val;
+      }
+      else
+      {
+        Insert(&Cl->Indexes, FileId.Id, Index);
+      }
+    }
+  }
+  const byte* End = Index.Data + Size(Index);
+  int NChunks = 0, ChunkAddrsSz = 0, ChunkSizesSz = 0;
+  memcpy(&NChunks, End - sizeof(int), sizeof(int));
+  memcpy(&ChunkAddrsSz, End - 2 * sizeof(int), sizeof(int));
+  memcpy(&ChunkSizesSz, Index.Data + Size(Index) - 3 * sizeof(int) - ChunkAddrsSz, sizeof(int));
+  Rewind(&D->ChunkAddrsStream);
+  GrowToAccomodate(&D->ChunkAddrsStream, NChunks * (i64)sizeof(u64) - Size(D->ChunkAddrsStream));
+  DecompressBufZstd(buffer{ Index.Data + ChunkSizesSz + sizeof(int), ChunkAddrsSz }, &D->ChunkAddrsStream);
+  bitstream ChunkSzsStream;
+  InitRead(&ChunkSzsStream, buffer{ Index.Data, ChunkSizesSz });
+
+  /* the chunks of all the fields for the same address follow each other */
+  const i8 NFields = Idx2.NCoLocatedFields;
+  file_cache FileCache;
+  i64 AccumSize = 0;
+  Init(&FileCache.ChunkCaches, 10);
+  idx2_For (int, I, 0, NChunks)
+  {
+    PushBack(&FileCache.RecordOffsets, AccumSize);
+    idx2_For (i8, F, 0, NFields)
+    {
+      i64 ChunkSize = ReadVarByte(&ChunkSzsStream);
+      PushBack(&FileCache.RecordSizes, ChunkSize);
+      AccumSize += ChunkSize;
+    }
+    if (FileCache.RecordSizes[I * NFields + Idx2.CoLocatedField] == 0)
+      continue; // this field has no chunk there
+    u64 ChunkAddr = *((u64*)D->ChunkAddrsStream.Stream.Data + I);
+    chunk_cache ChunkCache;
+    ChunkCache.ChunkPos = I;
+    Insert(&FileCache.ChunkCaches, ChunkAddr, ChunkCache);
+  }
+  Insert(FileCacheIt, FileId.Id, FileCache);
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+/* Read the chunk of a co-located field at a position in its file. With params::CoLocatedChunks, the chunks of all
+the fields at that position are read in one I/O, and those of the other fields kept for their decodes (unless the
+chunk of this field was itself read by the decode of another field). */
+static error<idx2_err_code>
+ReadCoLocatedChunk(const idx2_file& Idx2,
+                   decode_data* D,
+                   const file_id& FileId,
+                   const file_cache& FileCache,
+                   i32 ChunkPos,
+                   u64 ChunkAddress,
+                   bitstream* ChunkStream)
+{
+  idx2_TraceScope("ReadCoLocatedChunk");
+  co_located_chunks* Cl = D->CoLocatedChunks;
+  const i8 NFields = Idx2.NCoLocatedFields;
+  const i8 Field = Idx2.CoLocatedField;
+  if (Cl)
+  {
+    lock Lck(&Cl->Mutex);
+    auto ChunkIt = Lookup(&Cl->Chunks[Field], ChunkAddress);
+    if (ChunkIt)
+    { // read by the decode of another field
+      *ChunkStream = *ChunkIt.Val;
+      Cl->Bytes -= Size(ChunkStream->Stream);
+      Delete(&Cl->Chunks[Field], ChunkAddress);
+      ++D->Stats.NChunksCoLocated;
+      return idx2_Error(idx2_err_code::NoError);
+    }
+  }
+
+  timer IOTimer;
+  StartTimer(&IOTimer);
+  idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2::idx2_err_code::FileNotFound);
+  ++D->Stats.NFilesOpened;
+  const i64* Sizes = &FileCache.RecordSizes[ChunkPos * NFields];
+  i64 Offset = FileCache.RecordOffsets[ChunkPos];
+  i8 First = Cl ? 0 : Field, Last = Cl ? NFields - 1 : Field;
+  i64 Skipped = 0, RecordSize = 0;
+  idx2_For (i8, F, 0, First)
+    Skipped += Sizes[F];
+  idx2_InclusiveFor (i8, F, First, Last)
+    RecordSize += Sizes[F];
+  buffer Record;
+  AllocBuf(&Record, RecordSize);
+  idx2_CleanUp(DeallocBuf(&Record));
+  idx2_FSeek(Fp, Offset + Skipped, SEEK_SET);
+  ReadBuffer(Fp, &Record);
+  D->Stats.BytesData += RecordSize;
+  D->Stats.IOTime += ElapsedTime(&IOTimer);
+  const byte* Chunk = Record.Data;
+  if (Cl)
+    Lock(&Cl->Mutex);
+  idx2_CleanUp(if (Cl) Unlock(&Cl->Mutex));
+  idx2_InclusiveFor (i8, F, First, Last)
+  {
+    i64 Bytes = Sizes[F] + (i64)sizeof(bitstream::BitBuf); // as allocated by InitWrite
+    bool Keep = F != Field && Cl->Bytes + Bytes <= Cl->MaxBytes && !Lookup(&Cl->Chunks[F], ChunkAddress);
+    if (Sizes[F] > 0 && (F == Field || Keep))
+    {
+      bitstream Bs;
+      InitWrite(&Bs, Sizes[F]);
+      memcpy(Bs.Stream.Data, Chunk, Sizes[F]);
+      if (F == Field)
+      {
+        *ChunkStream = Bs;
+      }
+      else
+      {
+        Insert(&Cl->Chunks[F], ChunkAddress, Bs);
+        Cl->Bytes += Size(Bs.Stream);
+      }
+    }
+    Chunk += Sizes[F];
+  }
+  return idx2_Error(idx2_err_code::NoError);
+}
+
 /* Given a brick address, read the exponent chunk associated with the brick and cache it */
 // TODO: remove the last two params (already stored in D)
 static expected<const chunk_exp_cache*, idx2_err_code>
 ReadChunkExponents(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Level, i8 Subband)
 {
+  idx2_TraceScope("ReadChunkExponents");
   file_id FileId = ConstructFilePathExponents(Idx2, Brick, Level, Subband);
   auto FileExpCacheIt = Lookup(&D->FcTable.FileExpCaches, FileId.Id);
   if (!FileExpCacheIt)
   {
     auto ReadFileOk = ReadFileExponents(D, &FileExpCacheIt, FileId);
     if (!ReadFileOk)
-      idx2_PropagateError(ReadFileOk);
+      return idx2_PropagateError(ReadFileOk);
   }
   if (!FileExpCacheIt)
     return idx2_Error(idx2_err_code::FileNotFound);
@@ -44017,10 +45219,12 @@ ReadChunkExponents(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Level, i
   /* find the appropriate chunk */
   if (IsEmpty(FileExpCache->ChunkExpCaches[D->ChunkInFile]))
   {
+    ++D->Stats.NChunkExpsMissed;
     timer IOTimer;
     StartTimer(&IOTimer);
     idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
-    idx2_Assert(Fp); // TODO: return an error
+    idx2_ReturnErrorIf(!Fp, idx2::idx2_err_code::FileNotFound);
+    ++D->Stats.NFilesOpened;
     i32 ChunkExpOffset = D->ChunkInFile == 0 ? 0 : FileExpCache->ChunkExpSzs[D->ChunkInFile - 1];
     i32 ChunkExpSize = FileExpCache->ChunkExpSzs[D->ChunkInFile] - ChunkExpOffset;
     idx2_FSeek(Fp, ChunkExpOffset, SEEK_SET);
@@ -44030,11 +45234,33 @@ ReadChunkExponents(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Level, i
     Resize(&D->CompressedChunkExps, ChunkExpSize);
     ReadBuffer(Fp, &D->CompressedChunkExps, ChunkExpSize);
     DecompressBufZstd(buffer{ D->CompressedChunkExps.Data, ChunkExpSize }, &ChunkExpStream);
-    D->BytesExps_ += ChunkExpSize;
-    D->DecodeIOTime_ += ElapsedTime(&IOTimer);
+    D->Stats.BytesExps += ChunkExpSize;
+    D->Stats.IOTime += ElapsedTime(&IOTimer);
+    if (Idx2.ConstantBricks && Level == 0 && Subband == 0)
+    { // the table of constant bricks at the end of the chunk (see WriteChunkExponents)
+      i64 ChunkExpsSize = (i64)ZSTD_getFrameContentSize(D->CompressedChunkExps.Data, ChunkExpSize);
+      const byte* End = ChunkExpStream.Stream.Data + ChunkExpsSize;
+      u32 N = 0;
+      memcpy(&N, End - 4, sizeof(N));
+      const byte* Entry = End - 4 - 10 * i64(N);
+      idx2_Assert(Entry >= ChunkExpStream.Stream.Data);
+      Reserve(&ChunkExpCache.ConstantBricks, N);
+      idx2_For (u32, I, 0, N)
+      {
+        u16 BrickInChunk = 0;
+        f64 Value = 0;
+        memcpy(&BrickInChunk, Entry + 10 * I, sizeof(BrickInChunk));
+        memcpy(&Value, Entry + 10 * I + 2, sizeof(Value));
+        PushBack(&ChunkExpCache.ConstantBricks, t2<i32, f64>{ BrickInChunk, Value });
+      }
+    }
     InitRead(&ChunkExpStream, ChunkExpStream.Stream);
     FileExpCache->ChunkExpCaches[D->ChunkInFile] = ChunkExpCache;
   }
+  else
+  {
+    ++D->Stats.NChunkExpsHit;
+  }
   return &FileExpCache->ChunkExpCaches[D->ChunkInFile];
 }
 
@@ -44042,13 +45268,15 @@ ReadChunkExponents(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Level, i
 static expected<const chunk_cache*, idx2_err_code>
 ReadChunk(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Iter, i8 Level, i16 BitPlane)
 {
+  idx2_TraceScope("ReadChunk");
   file_id FileId = ConstructFilePath(Idx2, Brick, Iter, Level, BitPlane);
   auto FileCacheIt = Lookup(&D->FcTable.FileCaches, FileId.Id);
   if (!FileCacheIt)
   {
-    auto ReadFileOk = ReadFile(D, &FileCacheIt, FileId);
+    auto ReadFileOk = Idx2.CoLocated[0] ? ReadCoLocatedFile(Idx2, D, &FileCacheIt, FileId)
+                                        : ReadFile(D, &FileCacheIt, FileId);
     if (!ReadFileOk)
-      idx2_PropagateError(ReadFileOk);
+      return idx2_PropagateError(ReadFileOk);
   }
   if (!FileCacheIt)
     return idx2_Error(idx2_err_code::FileNotFound);
@@ -44063,25 +45291,39 @@ ReadChunk(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Iter, i8 Level, i
   chunk_cache* ChunkCache = ChunkCacheIt.Val;
   if (Size(ChunkCache->ChunkStream.Stream) == 0)
   {
-    timer IOTimer;
-    StartTimer(&IOTimer);
-    idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
-    i32 ChunkPos = ChunkCache->ChunkPos;
-    i64 ChunkOffset = ChunkPos > 0 ? FileCache->ChunkSizes[ChunkPos - 1] : 0;
-    i64 ChunkSize = FileCache->ChunkSizes[ChunkPos] - ChunkOffset;
-    idx2_FSeek(Fp, ChunkOffset, SEEK_SET);
-    bitstream ChunkStream;
-    InitWrite(&ChunkStream,
-              ChunkSize); // NOTE: not a memory leak since we will keep track of this in ChunkCache
-    ReadBuffer(Fp, &ChunkStream.Stream);
-    D->BytesData_ += Size(ChunkStream.Stream);
-    D->DecodeIOTime_ += ElapsedTime(&IOTimer);
+    ++D->Stats.NChunksMissed;
+    bitstream ChunkStream; // NOTE: not a memory leak since we will keep track of this in ChunkCache
+    if (Idx2.CoLocated[0])
+    {
+      idx2_PropagateIfError(
+        ReadCoLocatedChunk(Idx2, D, FileId, *FileCache, ChunkCache->ChunkPos, ChunkAddress, &ChunkStream));
+    }
+    else
+    {
+      timer IOTimer;
+      StartTimer(&IOTimer);
+      idx2_RAII(FILE*, Fp = fopen(FileId.Name.ConstPtr, "rb"), , if (Fp) fclose(Fp));
+      idx2_ReturnErrorIf(!Fp, idx2::idx2_err_code::FileNotFound);
+      ++D->Stats.NFilesOpened;
+      i32 ChunkPos = ChunkCache->ChunkPos;
+      i64 ChunkOffset = ChunkPos > 0 ? FileCache->ChunkSizes[ChunkPos - 1] : 0;
+      i64 ChunkSize = FileCache->ChunkSizes[ChunkPos] - ChunkOffset;
+      idx2_FSeek(Fp, ChunkOffset, SEEK_SET);
+      InitWrite(&ChunkStream, ChunkSize);
+      ReadBuffer(Fp, &ChunkStream.Stream);
+      D->Stats.BytesData += Size(ChunkStream.Stream);
+      D->Stats.IOTime += ElapsedTime(&IOTimer);
+    }
     DecompressChunk(&ChunkStream,
                     ChunkCache,
                     ChunkAddress,
                     Log2Ceil(Idx2.BricksPerChunks[Iter])); // TODO: check for error
     //    PushBack(&D->RequestedChunks, t2<u64, u64>{ChunkAddress, FileId.Id});
   }
+  else
+  {
+    ++D->Stats.NChunksHit;
+  }
 
   return ChunkCacheIt.Val;
 }
@@ -44090,9 +45332,12 @@ ReadChunk(const idx2_file& Idx2, decode_data* D, u64 Brick, i8 Iter, i8 Level, i
 // TODO: we can detect the precision and switch to the avx2 version that uses float for better
 // performance
 // TODO: if a block does not decode any bit plane, no need to copy data afterwards
-static error<idx2_err_code>
+/* t is the integer type of the zfp blocks (i64, or i32 for HasInt32Blocks) */
+template <typename t> static error<idx2_err_code>
 DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& SbGrid, volume* BVol)
 {
+  idx2_TraceScope("DecodeSubband");
+  using u = typename traits<t>::unsigned_t;
   u64 Brick = D->Brick[D->Level];
   v3i SbDims3 = Dims(SbGrid);
   v3i NBlocks3 = (SbDims3 + Idx2.BlockDims3 - 1) / Idx2.BlockDims3;
@@ -44108,6 +45353,12 @@ DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& S
     int Ql = Min(D->QualityLevel, (int)Size(Idx2.RdoLevels) - 1);
     MinBitPlane = ChunkRdoCache->TruncationPoints[D->Subband * Size(Idx2.RdoLevels) + Ql];
   }
+  if (D->Truncation)
+  {
+    auto TileIt = Lookup(&D->Truncation->MinBitPlanes, GetChunkAddress(Idx2, Brick, D->Level, D->Subband, 0));
+    if (TileIt)
+      MinBitPlane = Max(MinBitPlane, (int)*TileIt.Val);
+  }
 
   if (MinBitPlane == traits<i16>::Max)
     return idx2_Error(idx2_err_code::NoError);
@@ -44126,6 +45377,8 @@ DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& S
   SeekToByte(&BrickExpsStream, BrickExpOffset);
   u32 LastBlock = EncodeMorton3(v3<u32>(NBlocks3 - 1));
   const i8 NBitPlanes = idx2_BitSizeOf(u64);
+  const i8 NIntBits = idx2_BitSizeOf(t);
+  const i8 BpShift = NBitPlanes - NIntBits; // bit plane Bp is bit Bp - BpShift of the integers
   /* gather the streams (for the different bit planes) */
   auto& Streams = D->Streams;
   Clear(&Streams);
@@ -44137,11 +45390,12 @@ DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& S
     v3i BlockDims3 = Min(Idx2.BlockDims3, SbDims3 - D3);
     const int NDims = NumDims(BlockDims3);
     const int NVals = 1 << (2 * NDims);
-    const int Prec = NBitPlanes - 1 - NDims;
+    const int Prec = NIntBits - 1 - NDims;
     f64 BlockFloats[4 * 4 * 4];
     buffer_t BufFloats(BlockFloats, NVals);
-    buffer_t BufInts((i64*)BlockFloats, NVals);
-    u64 BlockUInts[4 * 4 * 4] = {};
+    t BlockInts[4 * 4 * 4];
+    buffer_t BufInts(BlockInts, NVals);
+    u BlockUInts[4 * 4 * 4] = {};
     buffer_t BufUInts(BlockUInts, Prod(BlockDims3));
     bool CodedInNextIter =
       D->Subband == 0 && D->Level + 1 < Idx2.NLevels && BlockDims3 == Idx2.BlockDims3;
@@ -44152,7 +45406,7 @@ DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& S
                  ? (i16)Read(&BrickExpsStream, 16) - traits<f64>::ExpBias
                  : (i16)Read(&BrickExpsStream, traits<f32>::ExpBits) - traits<f32>::ExpBias;
     i8 N = 0;
-    i8 EndBitPlane = Min(i8(BitSizeOf(Idx2.DType) + (24 + NDims)), NBitPlanes);
+    i8 EndBitPlane = Min(i8(BitSizeOf(Idx2.DType) + (24 + NDims)), NIntBits);
     int NBitPlanesDecoded = Exponent(Accuracy) - 6 - EMax + 1;
     i8 NBps = 0;
     idx2_InclusiveForBackward (i8, Bp, NBitPlanes - 1, NBitPlanes - EndBitPlane)
@@ -44192,7 +45446,11 @@ DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& S
       /* zfp decode */
       ++NBps;
       //      timer Timer; StartTimer(&Timer);
-      if (NBitPlanesDecoded <= 8)
+      if constexpr (sizeof(t) < sizeof(u64))
+      { // the bit planes are added to the (fewer) bits of the integers as they are decoded
+        Decode(BlockUInts, NVals, Bp - BpShift, N, Stream); // use AVX2
+      }
+      else if (NBitPlanesDecoded <= 8)
         Decode(BlockUInts, NVals, Bp, N, Stream); // use AVX2
       else
         DecodeTest(&BlockUInts[NBitPlanes - 1 - Bp],
@@ -44201,17 +45459,19 @@ DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& S
                    Stream); // delay the transpose of bits to later
                             //      DecodeTime_ += Seconds(ElapsedTime(&Timer));
     }                       // end bit plane loop
-    if (NBitPlanesDecoded > 8)
+    if (sizeof(t) == sizeof(u64) && NBitPlanesDecoded > 8)
     {
       //      timer Timer; StartTimer(&Timer);
       TransposeRecursive(BlockUInts, NBps); // transpose using the recursive algorithm
                                             //      DecodeTime_ += Seconds(ElapsedTime(&Timer));
     }
     /* do inverse zfp transform but only if any bit plane is decoded */
+    D->Stats.NBitPlanesDecoded += NBps;
     if (NBps > 0)
     {
-      InverseShuffle(BlockUInts, (i64*)BlockFloats, NDims);
-      InverseZfp((i64*)BlockFloats, NDims);
+      ++D->Stats.NBlocksDecoded;
+      InverseShuffle(BlockUInts, BlockInts, NDims);
+      InverseZfp(BlockInts, NDims);
       Dequantize(EMax, Prec, BufInts, &BufFloats);
       v3i S3;
       int J = 0;
@@ -44224,16 +45484,42 @@ DecodeSubband(const idx2_file& Idx2, decode_data* D, f64 Accuracy, const grid& S
         BVol->At<f64>(From3, Strd3, D3 + S3) = BlockFloats[J++];
       }
       idx2_EndFor3; // end sample loop
-      D->DataMovementTime_ += ElapsedTime(&DataTimer);
+      D->Stats.DataMovementTime += ElapsedTime(&DataTimer);
     }
   }
 
   return idx2_Error(idx2_err_code::NoError);
 }
 
+/* Whether a brick of level 0 is in the table of constant bricks of its chunk (see idx2_file::ConstantBricks) */
+static bool
+IsConstantBrick(const idx2_file& Idx2, decode_data* D, u64 Brick, f64* C)
+{
+  auto ReadChunkExpResult = ReadChunkExponents(Idx2, D, Brick, 0, 0);
+  if (!ReadChunkExpResult)
+    return false; // the brick is decoded as usual, which reports the error
+  /* the table is sorted by brick */
+  const array<t2<i32, f64>>& Table = Value(ReadChunkExpResult)->ConstantBricks;
+  i32 BrickInChunk = i32(Brick & (Idx2.BricksPerChunks[0] - 1));
+  i64 Lo = 0, Hi = Size(Table);
+  while (Lo < Hi)
+  {
+    i64 Mid = (Lo + Hi) / 2;
+    if (Table[Mid].First < BrickInChunk)
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+  if (Lo == Size(Table) || Table[Lo].First != BrickInChunk)
+    return false;
+  *C = Table[Lo].Second;
+  return true;
+}
+
 static error<idx2_err_code>
 DecodeBrick(const idx2_file& Idx2, const params& P, decode_data* D, f64 Accuracy)
 {
+  idx2_TraceScope("DecodeBrick");
   i8 Level = D->Level;
   u64 Brick = D->Brick[Level];
   //  if ((Brick >> Idx2.BricksPerChunks[Iter]) != D->LastTile) {
@@ -44262,6 +45548,10 @@ DecodeBrick(const idx2_file& Idx2, const params& P, decode_data* D, f64 Accuracy
   //      DecodeSbMask = SetBit(DecodeSbMask, S);
   //} // end subband loop
 
+  /* a constant brick is filled with its value, with no other read and no transform */
+  f64 C = 0;
+  bool Constant = Level == 0 && Idx2.ConstantBricks && !P.WaveletOnly && IsConstantBrick(Idx2, D, Brick, &C);
+
   /* recursively decode the brick, one subband at a time */
   idx2_For (i8, Sb, 0, (i8)Size(Idx2.Subbands))
   {
@@ -44282,53 +45572,181 @@ DecodeBrick(const idx2_file& Idx2, const params& P, decode_data* D, f64 Accuracy
       // TODO: problem: here we will need access to D->LinearChunkInFile/D->LinearBrickInChunk for
       // the parent, which won't be computed correctly by the outside code, so for now we have to
       // stick to decoding from higher level down
-      /* copy data from the parent's to my buffer */
-      if (PbIt.Val->NChildren == 0)
-      {
-        v3i From3 = (Brick3 / Idx2.GroupBrick3) * Idx2.GroupBrick3;
-        v3i NChildren3 = Dims(Crop(extent(From3, Idx2.GroupBrick3), extent(Idx2.NBricks3s[Level])));
-        PbIt.Val->NChildrenMax = (i8)Prod(NChildren3);
-      }
+      /* copy data from the parent's to my buffer (the parent only keeps its ExtentLocal part) */
+      idx2_Assert(PbIt.Val->NChildrenMax > 0);
       ++PbIt.Val->NChildren;
       v3i LocalBrickPos3 = Brick3 % Idx2.GroupBrick3;
       grid SbGridNonExt = S.Grid;
       SetDims(&SbGridNonExt, SbDimsNonExt3);
-      extent ToGrid(LocalBrickPos3 * SbDimsNonExt3, SbDimsNonExt3);
+      extent ToGrid(LocalBrickPos3 * SbDimsNonExt3 - From(PbIt.Val->ExtentLocal), SbDimsNonExt3);
       CopyExtentGrid<f64, f64>(ToGrid, PbIt.Val->Vol, SbGridNonExt, &BVol);
       if (PbIt.Val->NChildren == PbIt.Val->NChildrenMax)
       { // last child
-        Dealloc(&PbIt.Val->Vol);
+        DeallocBrick(D, &PbIt.Val->Vol);
         Delete(&D->BrickPool, PKey);
       }
     }
+    if (Constant)
+      break;
     D->Subband = Sb;
     if (Sb == 0 || BitSet(Idx2.DecodeSubbandMasks[Level], Sb))
     { // NOTE: the check for Sb == 0 prevents the output volume from having blocking artifacts
-      if (Idx2.Version == v2i(1, 0))
-        idx2_PropagateIfError(DecodeSubband(Idx2, D, Accuracy, S.Grid, &BVol));
+      if (Idx2.Version[0] == 1)
+      {
+        timer SubbandTimer;
+        StartTimer(&SubbandTimer);
+        if (HasInt32Blocks(Idx2))
+        {
+          idx2_PropagateIfError(DecodeSubband<i32>(Idx2, D, Accuracy, S.Grid, &BVol));
+        }
+        else
+        {
+          idx2_PropagateIfError(DecodeSubband<i64>(Idx2, D, Accuracy, S.Grid, &BVol));
+        }
+        D->Stats.SubbandTime += ElapsedTime(&SubbandTimer);
+      }
     }
   } // end subband loop
+  if (Constant)
+  {
+    Fill(idx2_Range(f64, BVol), C);
+    ++D->Stats.NConstantBricks;
+    return idx2_Error(err_code::NoError);
+  }
   // TODO: inverse transform only to the necessary level
   if (!P.WaveletOnly)
   {
+    timer TformTimer;
+    StartTimer(&TformTimer);
     if (Level + 1 < Idx2.NLevels)
-      InverseCdf53(Idx2.BrickDimsExt3, D->Level, Idx2.Subbands, Idx2.Td, &BVol, false);
+      InverseWavelet(Idx2.BrickDimsExt3, D->Level, Idx2.Subbands, Idx2.Td, &BVol, false);
     else
-      InverseCdf53(Idx2.BrickDimsExt3, D->Level, Idx2.Subbands, Idx2.Td, &BVol, true);
+      InverseWavelet(Idx2.BrickDimsExt3, D->Level, Idx2.Subbands, Idx2.Td, &BVol, true);
+    D->Stats.InverseTransformTime += ElapsedTime(&TformTimer);
   }
 
   return idx2_Error(err_code::NoError);
 }
 
+/*
+Decode the bricks of Level that overlap Ext (in samples). Each brick that is a parent at the next level is followed
+right away by its children (recursively), so the brick pool holds at most one (compacted) parent per level instead
+of all the parents of a level.
+*/
+static error<idx2_err_code>
+DecodeLevel(const idx2_file& Idx2,
+            const params& P,
+            decode_data* D,
+            i8 Level,
+            const extent& Ext,
+            const grid& OutGrid,
+            volume* OutputVol,
+            f64 Accuracy)
+{
+  v3i B3, Bf3, Bl3, C3, Cf3, Cl3, F3, Ff3, Fl3; // Brick dimensions, brick first, brick last
+  B3 = Idx2.BrickDims3 * Pow(Idx2.GroupBrick3, Level);
+  C3 = Idx2.BricksPerChunk3s[Level] * B3;
+  F3 = C3 * Idx2.ChunksPerFile3s[Level];
+
+  Bf3 = From(Ext) / B3;
+  Bl3 = Last(Ext) / B3;
+  Cf3 = From(Ext) / C3;
+  Cl3 = Last(Ext) / C3;
+  Ff3 = From(Ext) / F3;
+  Fl3 = Last(Ext) / F3;
+
+  extent ExtentInBricks(Bf3, Bl3 - Bf3 + 1);
+  extent ExtentInChunks(Cf3, Cl3 - Cf3 + 1);
+  extent ExtentInFiles(Ff3, Fl3 - Ff3 + 1);
+
+  extent VolExt(Idx2.Dims3);
+  v3i Vbf3, Vbl3, Vcf3, Vcl3, Vff3, Vfl3; // VolBrickFirst, VolBrickLast
+  Vbf3 = From(VolExt) / B3;
+  Vbl3 = Last(VolExt) / B3;
+  Vcf3 = From(VolExt) / C3;
+  Vcl3 = Last(VolExt) / C3;
+  Vff3 = From(VolExt) / F3;
+  Vfl3 = Last(VolExt) / F3;
+
+  extent VolExtentInBricks(Vbf3, Vbl3 - Vbf3 + 1);
+  extent VolExtentInChunks(Vcf3, Vcl3 - Vcf3 + 1);
+  extent VolExtentInFiles(Vff3, Vfl3 - Vff3 + 1);
+
+  idx2_FileTraverse(
+    //    u64 FileAddr = FileTop.Address;
+    //    idx2_Assert(FileAddr == GetLinearFile(Idx2, Level, FileTop.FileFrom3));
+    idx2_ChunkTraverse(
+      //      u64 ChunkAddr = (FileAddr * Idx2.ChunksPerFiles[Level]) + ChunkTop.Address;
+      //      idx2_Assert(ChunkAddr == GetLinearChunk(Idx2, Level, ChunkTop.ChunkFrom3));
+      idx2_BrickTraverse(
+        D->ChunkInFile = ChunkTop.ChunkInFile; // the children of the previous brick may have changed it
+        D->BrickInChunk = Top.BrickInChunk;
+        //        u64 BrickAddr = (ChunkAddr * Idx2.BricksPerChunks[Level]) + Top.Address;
+        //        idx2_Assert(BrickAddr == GetLinearBrick(Idx2, Level, Top.BrickFrom3));
+        if (P.OnBrick && !P.OnBrick(P.OnBrickData))
+          return idx2_Error(idx2_err_code::Cancelled);
+        brick_volume BVol;
+        AllocBrick(D, &BVol.Vol, Idx2.BrickDimsExt3);
+        // TODO: for progressive decompression, copy the data from BrickTable to BrickVol
+        Fill(idx2_Range(f64, BVol.Vol), 0.0);
+        D->Level = Level;
+        D->Bricks3[Level] = Top.BrickFrom3;
+        D->Brick[Level] = GetLinearBrick(Idx2, Level, Top.BrickFrom3);
+        u64 BrickKey = GetBrickKey(Level, D->Brick[Level]);
+        Insert(&D->BrickPool, BrickKey, BVol);
+        idx2_PropagateIfError(DecodeBrick(Idx2, P, D, Accuracy));
+        ++D->Stats.NBricksDecoded;
+        if (Level > 0 && Idx2.DecodeSubbandMasks[Level - 1] != 0)
+        { // the brick will be a parent at the next level, shrink it to what its children need and decode them
+          auto BrickIt = Lookup(&D->BrickPool, BrickKey);
+          CompactParentBrick(Idx2, P, D, BrickIt.Val);
+          extent ChildExt = Crop(extent(Top.BrickFrom3 * B3, B3), Ext);
+          idx2_PropagateIfError(DecodeLevel(Idx2, P, D, i8(Level - 1), ChildExt, OutGrid, OutputVol, Accuracy));
+        }
+        else
+        { // Copy the samples out to the output buffer (or file)
+          timer OutputTimer;
+          StartTimer(&OutputTimer);
+          grid BrickGrid(
+            Top.BrickFrom3 * B3,
+            Idx2.BrickDims3,
+            v3i(1 << Level)); // TODO: the 1 << level is only true for 1 transform pass per level
+          grid OutBrickGrid = Crop(OutGrid, BrickGrid);
+          grid BrickGridLocal = Relative(OutBrickGrid, BrickGrid);
+          auto CopyFunc = OutputVol->Type == dtype::float32 ? (CopyGridGrid<f64, f32>)
+                                                            : (CopyGridGrid<f64, f64>);
+          CopyFunc(BrickGridLocal, BVol.Vol, Relative(OutBrickGrid, OutGrid), OutputVol);
+          D->Stats.OutputTime += ElapsedTime(&OutputTimer);
+          DeallocBrick(D, &BVol.Vol);
+          Delete(&D->BrickPool, BrickKey);
+        },
+        64,
+        Idx2.BrickOrderChunks[Level],
+        ChunkTop.ChunkFrom3 * Idx2.BricksPerChunk3s[Level],
+        Idx2.BricksPerChunk3s[Level],
+        ExtentInBricks,
+        VolExtentInBricks);
+      ,
+      64,
+      Idx2.ChunkOrderFiles[Level],
+      FileTop.FileFrom3 * Idx2.ChunksPerFile3s[Level],
+      Idx2.ChunksPerFile3s[Level],
+      ExtentInChunks,
+      VolExtentInChunks);
+    , 64, Idx2.FileOrders[Level], v3i(0), Idx2.NFiles3s[Level], ExtentInFiles, VolExtentInFiles);
+
+  return idx2_Error(err_code::NoError);
+}
+
 /* TODO: dealloc chunks after we are done with them */
 error<idx2_err_code>
-Decode(const idx2_file& Idx2, const params& P, buffer* OutBuf)
+Decode(const idx2_file& Idx2, const params& P, buffer* OutBuf, decode_stats* Stats)
 {
+  idx2_TraceScope("Decode");
   timer DecodeTimer;
   StartTimer(&DecodeTimer);
   // TODO: we should add a --effective-mask
   grid OutGrid = GetGrid(Idx2, P.DecodeExtent);
-  printf("output grid = " idx2_PrStrGrid "\n", idx2_PrGrid(OutGrid));
   mmap_volume OutVol;
   volume OutVolMem;
   idx2_CleanUp(if (P.OutMode == params::out_mode::WriteToFile) { Unmap(&OutVol); });
@@ -44345,7 +45763,6 @@ Decode(const idx2_file& Idx2, const params& P, buffer* OutBuf)
                              : idx2_PrintScratch("%s/%s", P.OutDir, ToRawFileName(Met));
     //    idx2_RAII(mmap_volume, OutVol, (void)OutVol, Unmap(&OutVol));
     MapVolume(OutFile, Met.Dims3, Met.DType, &OutVol, map_mode::Write);
-    printf("writing output volume to %s\n", OutFile);
   }
   else if (P.OutMode == params::out_mode::KeepInMemory)
   {
@@ -44359,105 +45776,26 @@ Decode(const idx2_file& Idx2, const params& P, buffer* OutBuf)
   // TODO: move the decode_data into idx2_file itself
   //idx2_RAII(decode_data, D, Init(&D, &BrickAlloc_));
   idx2_RAII(decode_data, D, Init(&D, &Mallocator()));
+  /* publish the statistics on every exit path, including errors */
+  idx2_CleanUp(
+    D.Stats.NDecodes = 1;
+    D.Stats.TotalTime = ElapsedTime(&DecodeTimer);
+    Add(&DecodeStats_, D.Stats);
+    if (Stats) *Stats = D.Stats;
+  );
   //  D.QualityLevel = Dw->GetQuality();
+  D.Truncation = P.Truncation;
+  D.CoLocatedChunks = P.CoLocatedChunks;
   f64 Accuracy = Max(Idx2.Accuracy, P.DecodeAccuracy);
   //  i64 CountZeroes = 0;
 
-  idx2_InclusiveForBackward (i8, Level, Idx2.NLevels - 1, 0)
+  i8 TopLevel = i8(Idx2.NLevels - 1);
+  if (Idx2.DecodeSubbandMasks[TopLevel] != 0)
   {
-    if (Idx2.DecodeSubbandMasks[Level] == 0)
-      break;
-
-    extent Ext = P.DecodeExtent;                  // this is in unit of samples
-    v3i B3, Bf3, Bl3, C3, Cf3, Cl3, F3, Ff3, Fl3; // Brick dimensions, brick first, brick last
-    B3 = Idx2.BrickDims3 * Pow(Idx2.GroupBrick3, Level);
-    C3 = Idx2.BricksPerChunk3s[Level] * B3;
-    F3 = C3 * Idx2.ChunksPerFile3s[Level];
-
-    Bf3 = From(Ext) / B3;
-    Bl3 = Last(Ext) / B3;
-    Cf3 = From(Ext) / C3;
-    Cl3 = Last(Ext) / C3;
-    Ff3 = From(Ext) / F3;
-    Fl3 = Last(Ext) / F3;
-
-    extent ExtentInBricks(Bf3, Bl3 - Bf3 + 1);
-    extent ExtentInChunks(Cf3, Cl3 - Cf3 + 1);
-    extent ExtentInFiles(Ff3, Fl3 - Ff3 + 1);
-
-    extent VolExt(Idx2.Dims3);
-    v3i Vbf3, Vbl3, Vcf3, Vcl3, Vff3, Vfl3; // VolBrickFirst, VolBrickLast
-    Vbf3 = From(VolExt) / B3;
-    Vbl3 = Last(VolExt) / B3;
-    Vcf3 = From(VolExt) / C3;
-    Vcl3 = Last(VolExt) / C3;
-    Vff3 = From(VolExt) / F3;
-    Vfl3 = Last(VolExt) / F3;
-
-    extent VolExtentInBricks(Vbf3, Vbl3 - Vbf3 + 1);
-    extent VolExtentInChunks(Vcf3, Vcl3 - Vcf3 + 1);
-    extent VolExtentInFiles(Vff3, Vfl3 - Vff3 + 1);
-
-    idx2_FileTraverse(
-      //      u64 FileAddr = FileTop.Address;
-      //      idx2_Assert(FileAddr == GetLinearFile(Idx2, Level, FileTop.FileFrom3));
-      idx2_ChunkTraverse(
-        //        u64 ChunkAddr = (FileAddr * Idx2.ChunksPerFiles[Level]) + ChunkTop.Address;
-        //        idx2_Assert(ChunkAddr == GetLinearChunk(Idx2, Level, ChunkTop.ChunkFrom3));
-        D.ChunkInFile = ChunkTop.ChunkInFile;
-        idx2_BrickTraverse(
-          D.BrickInChunk = Top.BrickInChunk;
-          //          u64 BrickAddr = (ChunkAddr * Idx2.BricksPerChunks[Level]) + Top.Address;
-          //          idx2_Assert(BrickAddr == GetLinearBrick(Idx2, Level, Top.BrickFrom3));
-          brick_volume BVol;
-          Resize(&BVol.Vol, Idx2.BrickDimsExt3, dtype::float64, D.Alloc);
-          // TODO: for progressive decompression, copy the data from BrickTable to BrickVol
-          Fill(idx2_Range(f64, BVol.Vol), 0.0);
-          D.Level = Level;
-          D.Bricks3[Level] = Top.BrickFrom3;
-          D.Brick[Level] = GetLinearBrick(Idx2, Level, Top.BrickFrom3);
-          u64 BrickKey = GetBrickKey(Level, D.Brick[Level]);
-          Insert(&D.BrickPool, BrickKey, BVol);
-          idx2_PropagateIfError(DecodeBrick(Idx2, P, &D, Accuracy));
-          // Copy the samples out to the output buffer (or file)
-          if (Level == 0 || Idx2.DecodeSubbandMasks[Level - 1] == 0)
-          {
-            grid BrickGrid(
-              Top.BrickFrom3 * B3,
-              Idx2.BrickDims3,
-              v3i(1 << Level)); // TODO: the 1 << level is only true for 1 transform pass per level
-            grid OutBrickGrid = Crop(OutGrid, BrickGrid);
-            grid BrickGridLocal = Relative(OutBrickGrid, BrickGrid);
-            auto OutputVol = P.OutMode == params::out_mode::WriteToFile ? &OutVol.Vol : &OutVolMem;
-            auto CopyFunc = OutputVol->Type == dtype::float32 ? (CopyGridGrid<f64, f32>)
-                                                              : (CopyGridGrid<f64, f64>);
-            CopyFunc(BrickGridLocal, BVol.Vol, Relative(OutBrickGrid, OutGrid), OutputVol);
-            Dealloc(&BVol.Vol);
-            Delete(&D.BrickPool, BrickKey); // TODO: also delete the parent bricks once we are done
-          },
-          64,
-          Idx2.BrickOrderChunks[Level],
-          ChunkTop.ChunkFrom3 * Idx2.BricksPerChunk3s[Level],
-          Idx2.BricksPerChunk3s[Level],
-          ExtentInBricks,
-          VolExtentInBricks);
-        ,
-        64,
-        Idx2.ChunkOrderFiles[Level],
-        FileTop.FileFrom3 * Idx2.ChunksPerFile3s[Level],
-        Idx2.ChunksPerFile3s[Level],
-        ExtentInChunks,
-        VolExtentInChunks);
-      , 64, Idx2.FileOrders[Level], v3i(0), Idx2.NFiles3s[Level], ExtentInFiles, VolExtentInFiles);
-  } // end level loop
-    //  printf("count zeroes        = %lld\n", CountZeroes);
-  printf("total decode time   = %f\n", Seconds(ElapsedTime(&DecodeTimer)));
-  printf("io time             = %f\n", Seconds(D.DecodeIOTime_));
-  printf("data movement time  = %f\n", Seconds(D.DataMovementTime_));
-  printf("rdo   bytes read    = %" PRIi64 "\n", D.BytesRdos_);
-  printf("exp   bytes read    = %" PRIi64 "\n", D.BytesExps_);
-  printf("data  bytes read    = %" PRIi64 "\n", D.BytesData_);
-  printf("total bytes read    = %" PRIi64 "\n", D.BytesRdos_ + D.BytesExps_ + D.BytesData_);
+    auto OutputVol = P.OutMode == params::out_mode::WriteToFile ? &OutVol.Vol : &OutVolMem;
+    idx2_PropagateIfError(DecodeLevel(Idx2, P, &D, TopLevel, P.DecodeExtent, OutGrid, OutputVol, Accuracy));
+  }
+  idx2_Assert(D.BrickBytes_ == 0);
 
   return idx2_Error(err_code::NoError);
 }
@@ -44465,6 +45803,7 @@ Decode(const idx2_file& Idx2, const params& P, buffer* OutBuf)
 static void
 DecompressChunk(bitstream* ChunkStream, chunk_cache* ChunkCache, u64 ChunkAddress, int L)
 {
+  idx2_TraceScope("DecompressChunk");
   (void)L;
   u64 Brk = ((ChunkAddress >> 18) & 0x3FFFFFFFFFFull);
   (void)Brk;
@@ -44541,13 +45880,13 @@ ReadMetaFile(idx2_file* Idx2, cstr FileName)
         else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "name"))
         {
           idx2_Assert(Expr->type == SE_STRING);
-          snprintf(Idx2->Name, Expr->s.len + 1, "%s", (cstr)Buf.Data + Expr->s.start);
+          snprintf(Idx2->Name, sizeof(Idx2->Name), "%.*s", Expr->s.len, (cstr)Buf.Data + Expr->s.start);
           //          printf("Name = %s\n", Idx2->Name);
         }
         else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "field"))
         {
           idx2_Assert(Expr->type == SE_STRING);
-          snprintf(Idx2->Field, Expr->s.len + 1, "%s", (cstr)Buf.Data + Expr->s.start);
+          snprintf(Idx2->Field, sizeof(Idx2->Field), "%.*s", Expr->s.len, (cstr)Buf.Data + Expr->s.start);
           //          printf("Field = %s\n", Idx2->Field);
         }
         else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "dimensions"))
@@ -44564,6 +45903,19 @@ ReadMetaFile(idx2_file* Idx2, cstr FileName)
           Idx2->Dims3.Z = Expr->i;
           //          printf("Dims = %d %d %d\n", idx2_PrV3i(Idx2->Dims3));
         }
+        else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "min-downsampling"))
+        {
+          idx2_Assert(Expr->type == SE_INT);
+          Idx2->MinDownsampling3.X = Expr->i;
+          idx2_Assert(Expr->next);
+          Expr = Expr->next;
+          idx2_Assert(Expr->type == SE_INT);
+          Idx2->MinDownsampling3.Y = Expr->i;
+          idx2_Assert(Expr->next);
+          Expr = Expr->next;
+          idx2_Assert(Expr->type == SE_INT);
+          Idx2->MinDownsampling3.Z = Expr->i;
+        }
         if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "accuracy"))
         {
           idx2_Assert(Expr->type == SE_FLOAT);
@@ -44580,11 +45932,11 @@ ReadMetaFile(idx2_file* Idx2, cstr FileName)
         else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "min-max"))
         {
           idx2_Assert(Expr->type == SE_FLOAT || Expr->type == SE_INT);
-          Idx2->ValueRange.Min = Expr->i;
+          Idx2->ValueRange.Min = Expr->type == SE_FLOAT ? Expr->f : Expr->i;
           idx2_Assert(Expr->next);
           Expr = Expr->next;
           idx2_Assert(Expr->type == SE_FLOAT || Expr->type == SE_INT);
-          Idx2->ValueRange.Max = Expr->i;
+          Idx2->ValueRange.Max = Expr->type == SE_FLOAT ? Expr->f : Expr->i;
         }
         else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "brick-size"))
         {
@@ -44650,6 +46002,52 @@ ReadMetaFile(idx2_file* Idx2, cstr FileName)
           idx2_Assert(Expr->type == SE_BOOL);
           Idx2->GroupBitPlanes = Expr->i;
         }
+        else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "fast-tier"))
+        {
+          idx2_Assert(Expr->type == SE_STRING);
+          snprintf(Idx2->FastDir, sizeof(Idx2->FastDir), "%.*s", Expr->s.len, (cstr)Buf.Data + Expr->s.start);
+          idx2_Assert(Expr->next);
+          Expr = Expr->next;
+          idx2_Assert(Expr->type == SE_INT);
+          Idx2->FastMinLevel = i8(Expr->i);
+          idx2_Assert(Expr->next);
+          Expr = Expr->next;
+          idx2_Assert(Expr->type == SE_INT);
+          Idx2->FastMinBitPlane = i16(Expr->i);
+        }
+        else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "constant-bricks"))
+        {
+          idx2_Assert(Expr->type == SE_BOOL);
+          Idx2->ConstantBricks = Expr->i;
+        }
+        else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "wavelet"))
+        {
+          idx2_Assert(Expr->type == SE_STRING);
+          Idx2->Wavelet = StringTo<wavelet>()(stref((cstr)Buf.Data + Expr->s.start, Expr->s.len));
+          idx2_ReturnErrorIf(Idx2->Wavelet == wavelet::__Invalid__,
+                             idx2_err_code::ParseFailed,
+                             "unknown wavelet %.*s\n",
+                             Expr->s.len,
+                             (cstr)Buf.Data + Expr->s.start);
+        }
+        else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "int32-blocks"))
+        {
+          idx2_Assert(Expr->type == SE_BOOL);
+          Idx2->Int32Blocks = Expr->i;
+        }
+        else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "co-located"))
+        {
+          idx2_Assert(Expr->type == SE_STRING);
+          snprintf(Idx2->CoLocated, sizeof(Idx2->CoLocated), "%.*s", Expr->s.len, (cstr)Buf.Data + Expr->s.start);
+          idx2_Assert(Expr->next);
+          Expr = Expr->next;
+          idx2_Assert(Expr->type == SE_INT);
+          Idx2->CoLocatedField = i8(Expr->i);
+          idx2_Assert(Expr->next);
+          Expr = Expr->next;
+          idx2_Assert(Expr->type == SE_INT);
+          Idx2->NCoLocatedFields = i8(Expr->i);
+        }
         else if (SExprStringEqual((cstr)Buf.Data, &(LastExpr->s), "quality-levels"))
         {
           int NumQualityLevels = Expr->i;
@@ -44677,6 +46075,21 @@ ReadMetaFile(idx2_file* Idx2, cstr FileName)
       }
     }
   }
+  if (Idx2->Version[0] == 1 && Idx2->Version[1] > 1)
+    return idx2_Error(idx2_err_code::NotSupportedInVersion, "format version %d.%d\n", Idx2->Version[0], Idx2->Version[1]);
+  bool Version11 = Idx2->Version[0] == 1 && Idx2->Version[1] >= 1;
+  idx2_ReturnErrorIf(Idx2->Int32Blocks && !Version11,
+                     idx2_err_code::NotSupportedInVersion,
+                     "32-bit blocks in format version %d.%d\n",
+                     Idx2->Version[0],
+                     Idx2->Version[1]);
+  idx2_ReturnErrorIf(Idx2->Wavelet != wavelet::Cdf53 && !Version11,
+                     idx2_err_code::NotSupportedInVersion,
+                     "wavelet %.*s in format version %d.%d\n",
+                     ToString(Idx2->Wavelet).Size,
+                     ToString(Idx2->Wavelet).ConstPtr,
+                     Idx2->Version[0],
+                     Idx2->Version[1]);
   return idx2_Error(idx2_err_code::NoError);
 }
 
@@ -44982,6 +46395,31 @@ CompressBufZstd(const buffer& Input, bitstream* Output)
 static void
 WriteChunkExponents(const idx2_file& Idx2, encode_data* E, sub_channel* Sc, i8 Iter, i8 Level)
 {
+  idx2_TraceScope("WriteChunkExponents");
+  /* constant bricks of the chunk: (brick in chunk, value) x N, then N (the exponents of every brick are stored in a
+  whole number of bytes, so this starts on a byte) */
+  if (Idx2.ConstantBricks && Iter == 0 && Level == 0)
+  {
+    u64 Chunk = Sc->LastBrick >> Log2Ceil(Idx2.BricksPerChunks[0]);
+    GrowToAccomodate(&Sc->BrickEMaxesStream, 10 * Size(E->ConstantBricks) + 4);
+    i64 N = 0, K = 0;
+    idx2_For (i64, I, 0, Size(E->ConstantBricks))
+    {
+      const t2<u64, f64>& Cb = E->ConstantBricks[I];
+      if ((Cb.First >> Log2Ceil(Idx2.BricksPerChunks[0])) != Chunk)
+      { // belongs to the next chunk
+        E->ConstantBricks[K++] = Cb;
+        continue;
+      }
+      Write(&Sc->BrickEMaxesStream, Cb.First & (Idx2.BricksPerChunks[0] - 1), 16);
+      u64 Bits;
+      memcpy(&Bits, &Cb.Second, sizeof(Bits));
+      WriteLong(&Sc->BrickEMaxesStream, Bits, 64);
+      ++N;
+    }
+    Write(&Sc->BrickEMaxesStream, N, 32);
+    Resize(&E->ConstantBricks, K);
+  }
   /* brick exponents */
   Flush(&Sc->BrickEMaxesStream);
   BrickEMaxesStat.Add((f64)Size(Sc->BrickEMaxesStream));
@@ -45018,6 +46456,7 @@ WriteChunkExponents(const idx2_file& Idx2, encode_data* E, sub_channel* Sc, i8 I
 error<idx2_err_code>
 FlushChunkExponents(const idx2_file& Idx2, encode_data* E)
 {
+  idx2_TraceScope("FlushChunkExponents");
   idx2_ForEach (ScIt, E->SubChannels)
   {
     i8 Iteration = IterationFromChannelKey(*ScIt.Key);
@@ -45039,6 +46478,70 @@ FlushChunkExponents(const idx2_file& Idx2, encode_data* E)
   return idx2_Error(idx2_err_code::NoError);
 }
 
+/* Write the rate-distortion curves of the tiles (see rd_curves) from the chunk sizes and the errors measured by
+EncodeSubband. This sorts E->ChunkRDOs (by decreasing address, i.e., by tile then by decreasing bit plane). */
+static error<idx2_err_code>
+WriteRdCurves(encode_data* E, cstr FileName)
+{
+  std::sort(Begin(E->ChunkRDOs), End(E->ChunkRDOs));
+  array<u64> Tiles;
+  Reserve(&Tiles, Size(E->TileEnergies));
+  array<f64> LowerTopErrors; // [point] -> max error of the blocks that start below its bit plane
+  idx2_CleanUp(Dealloc(&Tiles); Dealloc(&LowerTopErrors));
+  auto Get = [](hash_table<u64, f64>& Table, u64 Address) {
+    auto It = Lookup(&Table, Address);
+    return It ? *It.Val : 0.0;
+  };
+  idx2_ForEach (It, E->TileEnergies)
+    PushBack(&Tiles, *It.Key);
+  std::sort(Begin(Tiles), End(Tiles), [](u64 A, u64 B) { return A > B; });
+
+  FILE* Fp = fopen(FileName, "wb");
+  idx2_CleanUp(if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2_err_code::FileCreateFailed, "%s", FileName);
+  i64 NTiles = Size(Tiles);
+  bool Ok = fwrite("idx2rdc2", 8, 1, Fp) == 1 && fwrite(&NTiles, sizeof(NTiles), 1, Fp) == 1;
+  i64 C = 0; // the first chunk of the current tile in ChunkRDOs
+  idx2_ForEach (TileIt, Tiles)
+  {
+    u64 Tile = *TileIt;
+    while (C < Size(E->ChunkRDOs) && (E->ChunkRDOs[C].Address >> 12) > (Tile >> 12))
+      ++C;
+    i64 TileEnd = C;
+    while (TileEnd < Size(E->ChunkRDOs) && (E->ChunkRDOs[TileEnd].Address >> 12) == (Tile >> 12))
+      ++TileEnd;
+    f64 Sse = *Lookup(&E->TileEnergies, Tile).Val;
+    i32 NPoints = i32(TileEnd - C);
+    /* decoded down to a bit plane, a block is off by its error at that bit plane, by its error before its first bit
+    plane if it starts below, or by its error after its last bit plane if it ends above */
+    f64 FloorError = Get(E->TileFloorErrors, Tile);
+    Resize(&LowerTopErrors, NPoints + 1);
+    LowerTopErrors[NPoints] = FloorError;
+    idx2_InclusiveForBackward (i32, K, NPoints - 1, 0)
+      LowerTopErrors[K] = Max(LowerTopErrors[K + 1], Get(E->TileTopErrors, E->ChunkRDOs[C + K].Address));
+    f64 MaxError = LowerTopErrors[0];
+    Ok = Ok && fwrite(&Tile, sizeof(Tile), 1, Fp) == 1 && fwrite(&Sse, sizeof(Sse), 1, Fp) == 1 &&
+         fwrite(&MaxError, sizeof(MaxError), 1, Fp) == 1 && fwrite(&NPoints, sizeof(NPoints), 1, Fp) == 1;
+    auto ExpIt = Lookup(&E->ChunkRDOLengths, Tile);
+    i64 Bytes = ExpIt ? *ExpIt.Val : 0; // the exponents are read along with the first bit plane
+    f64 UpperBottomError = 0; // max error of the blocks that end above the current bit plane
+    for (i32 K = 0; C < TileEnd; ++C, ++K)
+    {
+      const rdo_chunk& Chunk = E->ChunkRDOs[C];
+      auto SseIt = Lookup(&E->TileSses, Chunk.Address);
+      Sse = Max(Sse - (SseIt ? *SseIt.Val : 0), 0.0);
+      Bytes += Chunk.Length;
+      i16 BitPlane = i16(Chunk.Address & 0xFFF);
+      MaxError = Max(Max(Get(E->TileMaxErrors, Chunk.Address), LowerTopErrors[K + 1]), UpperBottomError);
+      UpperBottomError = Max(UpperBottomError, Get(E->TileBottomErrors, Chunk.Address));
+      Ok = Ok && fwrite(&BitPlane, sizeof(BitPlane), 1, Fp) == 1 && fwrite(&Bytes, sizeof(Bytes), 1, Fp) == 1 &&
+           fwrite(&Sse, sizeof(Sse), 1, Fp) == 1 && fwrite(&MaxError, sizeof(MaxError), 1, Fp) == 1;
+    }
+  }
+  idx2_ReturnErrorIf(!Ok, idx2_err_code::FileWriteFailed, "%s", FileName);
+  return idx2_Error(idx2_err_code::NoError);
+}
+
 struct rdo_precompute
 {
   u64 Address;
@@ -45295,6 +46798,7 @@ RateDistortionOpt(const idx2_file& Idx2, encode_data* E)
 static void
 WriteChunk(const idx2_file& Idx2, encode_data* E, channel* C, i8 Iter, i8 Level, i16 BitPlane)
 {
+  idx2_TraceScope("WriteChunk");
   BrickDeltasStat.Add((f64)Size(C->BrickDeltasStream)); // brick deltas
   BrickSzsStat.Add((f64)Size(C->BrickSzsStream));       // brick sizes
   BrickStreamStat.Add((f64)Size(C->BrickStream));       // brick data
@@ -45337,15 +46841,116 @@ WriteChunk(const idx2_file& Idx2, encode_data* E, channel* C, i8 Iter, i8 Level,
   Rewind(&E->ChunkStream);
 }
 
+/* The squared error of the first NSamples coefficients of a zfp block decoded down to bit plane Bp, with respect
+to the coefficients before quantization (Coeffs). MaxError gets the largest absolute error of these coefficients. */
+template <typename u> static f64
+TruncationError(const u* BlockUInts, int NDims, int NVals, int NSamples, i16 EMax, i8 Prec, i8 Bp, const f64* Coeffs, f64* MaxError)
+{
+  using t = typename traits<u>::signed_t;
+  u UInts[4 * 4 * 4];
+  t Ints[4 * 4 * 4];
+  f64 Floats[4 * 4 * 4];
+  u Mask = ~((u(1) << Bp) - 1);
+  idx2_For (int, I, 0, NVals)
+    UInts[I] = BlockUInts[I] & Mask;
+  InverseShuffle(UInts, Ints, NDims);
+  InverseZfp(Ints, NDims);
+  buffer_t<t> BufInts(Ints, NVals);
+  buffer_t<f64> BufFloats(Floats, NVals);
+  Dequantize(EMax, Prec, BufInts, &BufFloats);
+  f64 Sse = 0;
+  *MaxError = 0;
+  idx2_For (int, I, 0, NSamples)
+  {
+    Sse += (Floats[I] - Coeffs[I]) * (Floats[I] - Coeffs[I]);
+    *MaxError = Max(*MaxError, fabs(Floats[I] - Coeffs[I]));
+  }
+  return Sse;
+}
+
+/* How much a squared error on the coefficients of a subband grows through the inverse wavelet transform. Per
+transformed dimension and level, the lifting (not normalized) multiplies it by the squared norm of the scaling
+function for a low-pass and of the wavelet for a high-pass coefficient (away from the boundaries), e.g., 1.5 and
+0.71875 for CDF 5/3. */
+static f64
+GetSubbandGain(const idx2_file& Idx2, i8 Iter, i8 Level)
+{
+  const v3i& Lh3 = Idx2.Subbands[Level].LowHigh3;
+  const f64 LowGain = Idx2.Td.BasisNorms.ScalNorms[0] * Idx2.Td.BasisNorms.ScalNorms[0];
+  const f64 HighGain = Idx2.Td.BasisNorms.WaveNorms[0] * Idx2.Td.BasisNorms.WaveNorms[0];
+  f64 Gain = 1;
+  idx2_For (int, D, 0, 3)
+  {
+    if (Idx2.BrickDims3[D] == 1)
+      continue;
+    Gain *= Lh3[D] == 1 ? HighGain : LowGain;
+    idx2_For (i8, I, 0, Iter)
+      Gain *= LowGain;
+  }
+  return Gain;
+}
+
+/* How much an error on the coefficients of a subband can grow, at most, through the inverse wavelet transform: the
+largest sum of the absolute weights of the subband coefficients in one sample. Per transformed dimension, this inverse
+lifts the unit impulses of one line of a brick (as InverseWavelet does), for the subband itself (undoing its
+normalization) and for the low-pass coefficients that it goes through at the Iter finer levels. */
+static f64
+GetSubbandMaxGain(const idx2_file& Idx2, i8 Iter, i8 Level)
+{
+  const subband& S = Idx2.Subbands[Level];
+  const transform_details& Td = Idx2.Td;
+  bool Normalized = Level != 0 || Iter + 1 == Idx2.NLevels;
+  f64 Gain = 1;
+  idx2_For (int, D, 0, 3)
+  {
+    int N = Idx2.BrickDimsExt3[D];
+    if (N == 1)
+      continue;
+    /* sum the absolute weights of the low-pass (even) and high-pass (odd) coefficients per (non-extended) sample */
+    volume Line(v3i(N, 1, 1), dtype::float64);
+    array<f64> Sums;
+    Init(&Sums, 2 * i64(N), 0.0);
+    idx2_CleanUp(Dealloc(&Line); Dealloc(&Sums));
+    f64* F = (f64*)Line.Buffer.Data;
+    idx2_For (int, K, 0, N)
+    {
+      Fill(F, F + N, 0.0);
+      F[K] = 1;
+      DispatchOnWavelet(Td.Wavelet, [&](auto Kernel) {
+        InverseLift<decltype(Kernel), f64>(grid(v3i(N, 1, 1)), v3i(N, 1, 1), 0, &Line);
+      });
+      idx2_For (int, I, 0, Idx2.BrickDims3[D])
+        Sums[(K & 1) * N + I] += fabs(F[I]);
+    }
+    f64 LowGain = 0, HighGain = 0;
+    idx2_For (int, I, 0, Idx2.BrickDims3[D])
+    {
+      LowGain = Max(LowGain, Sums[I]);
+      HighGain = Max(HighGain, Sums[N + I]);
+    }
+    int L = S.LowHigh3[D] == 0 ? Iter * Td.NPasses + S.Level3Rev[D] - 1 : Iter * Td.NPasses + S.Level3Rev[D];
+    f64 Norm = !Normalized ? 1 : (S.LowHigh3[D] == 0 ? Td.BasisNorms.ScalNorms[L] : Td.BasisNorms.WaveNorms[L]);
+    Gain *= (S.LowHigh3[D] == 0 ? LowGain : HighGain) / Norm;
+    idx2_For (i8, I, 0, Iter)
+      Gain *= LowGain;
+  }
+  return Gain;
+}
+
+/* t is the integer type of the zfp blocks (i64, or i32 for HasInt32Blocks) */
 // TODO: return an error code
-static void
+template <typename t> static void
 EncodeSubband(idx2_file* Idx2, encode_data* E, const grid& SbGrid, volume* BrickVol)
 {
+  idx2_TraceScope("EncodeSubband");
+  using u = typename traits<t>::unsigned_t;
   u64 Brick = E->Brick[E->Iter];
   v3i SbDims3 = Dims(SbGrid);
   v3i NBlocks3 = (SbDims3 + Idx2->BlockDims3 - 1) / Idx2->BlockDims3;
   u32 LastBlock = EncodeMorton3(v3<u32>(NBlocks3 - 1));
   const i8 NBitPlanes = idx2_BitSizeOf(u64);
+  const i8 NIntBits = idx2_BitSizeOf(t);
+  const i8 BpShift = NBitPlanes - NIntBits; // bit plane Bp is bit Bp - BpShift of the integers
   Clear(&E->BlockSigs);
   Reserve(&E->BlockSigs, NBitPlanes);
   Clear(&E->EMaxes);
@@ -45362,6 +46967,9 @@ EncodeSubband(idx2_file* Idx2, encode_data* E, const grid& SbGrid, volume* Brick
   }
   idx2_Assert(ScIt);
   sub_channel* Sc = ScIt.Val;
+  const f64 Gain = E->RdCurves ? GetSubbandGain(*Idx2, E->Iter, E->Level) : 0;
+  const f64 MaxGain = E->RdCurves ? GetSubbandMaxGain(*Idx2, E->Iter, E->Level) : 0;
+  const u64 Tile = GetChunkAddress(*Idx2, Brick, E->Iter, E->Level, 0);
 
   /* pass 1: compress the blocks */
   idx2_InclusiveFor (u32, Block, 0, LastBlock)
@@ -45372,11 +46980,12 @@ EncodeSubband(idx2_file* Idx2, encode_data* E, const grid& SbGrid, volume* Brick
     v3i BlockDims3 = Min(Idx2->BlockDims3, SbDims3 - D3);
     const i8 NDims = (i8)NumDims(BlockDims3);
     const int NVals = 1 << (2 * NDims);
-    const i8 Prec = NBitPlanes - 1 - NDims;
+    const i8 Prec = NIntBits - 1 - NDims;
     f64 BlockFloats[4 * 4 * 4];
     buffer_t BufFloats(BlockFloats, NVals);
-    buffer_t BufInts((i64*)BlockFloats, NVals);
-    u64 BlockUInts[4 * 4 * 4];
+    t BlockInts[4 * 4 * 4];
+    buffer_t BufInts(BlockInts, NVals);
+    u BlockUInts[4 * 4 * 4];
     buffer_t BufUInts(BlockUInts, NVals);
     bool CodedInNextIter =
       E->Level == 0 && E->Iter + 1 < Idx2->NLevels && BlockDims3 == Idx2->BlockDims3;
@@ -45392,17 +47001,31 @@ EncodeSubband(idx2_file* Idx2, encode_data* E, const grid& SbGrid, volume* Brick
       BlockFloats[J++] = BrickVol->At<f64>(From3, Strd3, D3 + S3);
     }
     idx2_EndFor3; // end sample loop
+    /* keep the coefficients to measure the error left after each bit plane */
+    f64 Coeffs[4 * 4 * 4];
+    f64 Sse = 0, MaxError = 0;
+    if (E->RdCurves)
+    {
+      idx2_For (int, I, 0, J)
+      {
+        Coeffs[I] = BlockFloats[I];
+        Sse += Coeffs[I] * Coeffs[I];
+        MaxError = Max(MaxError, fabs(Coeffs[I]));
+      }
+      E->TileEnergies[Tile] += Gain * Sse;
+    }
+    i16 LastBp = traits<i16>::Min; // the last bit plane coded for the block
     /* zfp transform and shuffle */
     const i16 EMax = SizeOf(Idx2->DType) > 4 ? (i16)QuantizeF64(Prec, BufFloats, &BufInts)
                                              : (i16)QuantizeF32(Prec, BufFloats, &BufInts);
     PushBack(&E->EMaxes, EMax);
-    ForwardZfp((i64*)BlockFloats, NDims);
-    ForwardShuffle((i64*)BlockFloats, BlockUInts, NDims);
+    ForwardZfp(BlockInts, NDims);
+    ForwardShuffle(BlockInts, BlockUInts, NDims);
     /* zfp encode */
     i8 N = 0; // number of significant coefficients in the block so far
     i8 EndBitPlane = Min(i8(BitSizeOf(Idx2->DType) + (24 + NDims)),
-                         NBitPlanes); // TODO: why 24 (this is only based on empirical experiments
-                                      // with float32, for other types it might be different)?
+                         NIntBits); // TODO: why 24 (this is only based on empirical experiments
+                                    // with float32, for other types it might be different)?
     idx2_InclusiveForBackward (i8, Bp, NBitPlanes - 1, NBitPlanes - EndBitPlane)
     { // bit plane loop
       i16 RealBp = Bp + EMax;
@@ -45451,8 +47074,29 @@ EncodeSubband(idx2_file* Idx2, encode_data* E, const grid& SbGrid, volume* Brick
       }
       /* encode the block */
       GrowIfTooFull(&C->BlockStream);
-      Encode(BlockUInts, NVals, Bp, N, &C->BlockStream);
+      Encode(BlockUInts, NVals, Bp - BpShift, N, &C->BlockStream);
+      if (E->RdCurves)
+      {
+        u64 Address = GetChunkAddress(*Idx2, Brick, E->Iter, E->Level, RealBp);
+        if (LastBp == traits<i16>::Min)
+        { // the first bit plane of the block
+          f64& TopError = E->TileTopErrors[Address];
+          TopError = Max(TopError, MaxGain * MaxError);
+        }
+        LastBp = RealBp;
+        f64 SseBp = TruncationError(BlockUInts, NDims, NVals, J, EMax, Prec, i8(Bp - BpShift), Coeffs, &MaxError);
+        E->TileSses[Address] += Gain * (Sse - SseBp);
+        Sse = SseBp;
+        f64& BpError = E->TileMaxErrors[Address];
+        BpError = Max(BpError, MaxGain * MaxError);
+      }
     } // end bit plane loop
+    if (E->RdCurves)
+    {
+      f64& BlockError = LastBp == traits<i16>::Min ? E->TileFloorErrors[Tile]
+                                                   : E->TileBottomErrors[GetChunkAddress(*Idx2, Brick, E->Iter, E->Level, LastBp)];
+      BlockError = Max(BlockError, MaxGain * MaxError);
+    }
   }   // end zfp block loop
 
   /* write the last chunk exponents if this is the first brick of the new chunk */
@@ -45527,6 +47171,7 @@ EncodeSubband(idx2_file* Idx2, encode_data* E, const grid& SbGrid, volume* Brick
 static void
 EncodeBrick(idx2_file* Idx2, const params& P, encode_data* E, bool IncIter = false)
 {
+  idx2_TraceScope("EncodeBrick");
   idx2_Assert(Idx2->NLevels <= idx2_file::MaxLevels);
 
   i8 Iter = E->Iter += IncIter;
@@ -45539,20 +47184,37 @@ EncodeBrick(idx2_file* Idx2, const params& P, encode_data* E, bool IncIter = fal
   volume& BVol = BIt.Val->Vol;
   idx2_Assert(BVol.Buffer);
 
-  // TODO: we do not need to pre-extrapolate
-  ExtrapolateCdf53(Dims(BIt.Val->ExtentLocal), Idx2->TformOrder, &BVol);
-
-  /* do wavelet transform */
-  if (!P.WaveletOnly)
+  /* the transform of a constant brick is known: its value in the first subband and 0 elsewhere (the last level is
+  transformed differently, so it is never recorded as constant) */
+  bool Constant = Iter == 0 && Size(E->ConstantBricks) > 0 && Back(E->ConstantBricks).First == Brick;
+  if (Constant)
   {
-    if (Iter + 1 < Idx2->NLevels)
-      ForwardCdf53(Idx2->BrickDimsExt3, E->Iter, Idx2->Subbands, Idx2->Td, &BVol, false);
-    else
-      ForwardCdf53(Idx2->BrickDimsExt3, E->Iter, Idx2->Subbands, Idx2->Td, &BVol, true);
+    Fill(idx2_Range(f64, BVol), 0.0);
+    const grid& SbGrid = Idx2->Subbands[0].Grid;
+    v3i From3 = From(SbGrid), Strd3 = Strd(SbGrid), S3;
+    idx2_BeginFor3 (S3, v3i(0), Dims(SbGrid), v3i(1))
+    {
+      BVol.At<f64>(From3, Strd3, S3) = Back(E->ConstantBricks).Second;
+    }
+    idx2_EndFor3;
   }
   else
   {
-    ForwardCdf53(Idx2->BrickDimsExt3, E->Iter, Idx2->Subbands, Idx2->Td, &BVol, false);
+    // TODO: we do not need to pre-extrapolate
+    ExtrapolateCdf53(Dims(BIt.Val->ExtentLocal), Idx2->TformOrder, &BVol);
+
+    /* do wavelet transform */
+    if (!P.WaveletOnly)
+    {
+      if (Iter + 1 < Idx2->NLevels)
+        ForwardWavelet(Idx2->BrickDimsExt3, E->Iter, Idx2->Subbands, Idx2->Td, &BVol, false);
+      else
+        ForwardWavelet(Idx2->BrickDimsExt3, E->Iter, Idx2->Subbands, Idx2->Td, &BVol, true);
+    }
+    else
+    {
+      ForwardWavelet(Idx2->BrickDimsExt3, E->Iter, Idx2->Subbands, Idx2->Td, &BVol, false);
+    }
   }
 
   /* recursively encode the brick, one subband at a time */
@@ -45593,8 +47255,13 @@ EncodeBrick(idx2_file* Idx2, const params& P, encode_data* E, bool IncIter = fal
         EncodeBrick(Idx2, P, E, true);
     } // end Sb == 0 && NextIteration < Idx2->NLevels
     E->Level = Sb;
-    if (Idx2->Version == v2i(1, 0))
-      EncodeSubband(Idx2, E, S.Grid, &BVol);
+    if (Idx2->Version[0] == 1)
+    {
+      if (HasInt32Blocks(*Idx2))
+        EncodeSubband<i32>(Idx2, E, S.Grid, &BVol);
+      else
+        EncodeSubband<i64>(Idx2, E, S.Grid, &BVol);
+    }
   } // end subband loop
   Dealloc(&BVol);
   Delete(&E->BrickPool, GetBrickKey(Iter, Brick));
@@ -45723,6 +47390,7 @@ struct channel_ptr
 static error<idx2_err_code>
 FlushChunks(const idx2_file& Idx2, encode_data* E)
 {
+  idx2_TraceScope("FlushChunks");
   Reserve(&E->SortedChannels, Size(E->Channels));
   Clear(&E->SortedChannels);
   idx2_ForEach (Ch, E->Channels)
@@ -45788,12 +47456,496 @@ brick_copier::Copy(const extent& ExtentGlobal, const extent& ExtentLocal, brick_
   return MinMax;
 }
 
+void
+Init(preview* Preview, const v3i& VolumeDims3, int Level)
+{
+  Preview->Level = Level;
+  Preview->Dims3 = v3i((VolumeDims3.X + (1 << Level) - 1) >> Level, (VolumeDims3.Y + (1 << Level) - 1) >> Level, VolumeDims3.Z);
+  Init(&Preview->Sums, Prod<i64>(Preview->Dims3), 0.0);
+  Init(&Preview->Counts, Prod<i64>(Preview->Dims3), 0);
+}
+
+void
+Dealloc(preview* Preview)
+{
+  Dealloc(&Preview->Sums);
+  Dealloc(&Preview->Counts);
+}
+
+void
+AddBrick(preview* Preview, const extent& ExtentGlobal, const brick_volume& Brick)
+{
+  v3i From3 = From(ExtentGlobal), Dims3 = Dims(ExtentGlobal);
+  v3i Local3 = From(Brick.ExtentLocal), BrickDims3 = Dims(Brick.Vol);
+  const v3i& P3 = Preview->Dims3;
+  const f64* Data = (const f64*)Brick.Vol.Buffer.Data;
+  idx2_For (int, Z, 0, Dims3.Z)
+  {
+    idx2_For (int, Y, 0, Dims3.Y)
+    {
+      const f64* Row = Data + (i64(Local3.Z + Z) * BrickDims3.Y + Local3.Y + Y) * BrickDims3.X + Local3.X;
+      i64 PreviewRow = (i64(From3.Z + Z) * P3.Y + ((From3.Y + Y) >> Preview->Level)) * P3.X;
+      idx2_For (int, X, 0, Dims3.X)
+      {
+        i64 I = PreviewRow + ((From3.X + X) >> Preview->Level);
+        Preview->Sums[I] += Row[X];
+        ++Preview->Counts[I];
+      }
+    }
+  }
+}
+
+error<idx2_err_code>
+WritePreviewFile(const preview& Preview, cstr FileName)
+{
+  FILE* Fp = fopen(FileName, "wb");
+  idx2_CleanUp(if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2_err_code::FileCreateFailed, "%s", FileName);
+  i32 Header[4] = { Preview.Dims3.X, Preview.Dims3.Y, Preview.Dims3.Z, Preview.Level };
+  bool Ok = fwrite("idx2prv1", 8, 1, Fp) == 1 && fwrite(Header, sizeof(Header), 1, Fp) == 1;
+  array<f32> Row;
+  Init(&Row, Preview.Dims3.X);
+  idx2_CleanUp(Dealloc(&Row));
+  for (i64 RowBegin = 0; Ok && RowBegin < Size(Preview.Sums); RowBegin += Preview.Dims3.X)
+  {
+    idx2_For (int, X, 0, Preview.Dims3.X)
+    {
+      i32 Count = Preview.Counts[RowBegin + X];
+      Row[X] = Count > 0 ? f32(Preview.Sums[RowBegin + X] / Count) : 0;
+    }
+    Ok = fwrite(Begin(Row), sizeof(f32) * Preview.Dims3.X, 1, Fp) == 1;
+  }
+  idx2_ReturnErrorIf(!Ok, idx2_err_code::FileWriteFailed, "%s", FileName);
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+error<idx2_err_code>
+ReadPreviewSlice(cstr FileName, int Z, v3i* Dims3, int* Level, buffer* Slice)
+{
+  FILE* Fp = fopen(FileName, "rb");
+  idx2_CleanUp(if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2_err_code::FileOpenFailed, "%s", FileName);
+  char Magic[8];
+  i32 Header[4];
+  bool Ok = fread(Magic, 8, 1, Fp) == 1 && memcmp(Magic, "idx2prv1", 8) == 0 && fread(Header, sizeof(Header), 1, Fp) == 1;
+  idx2_ReturnErrorIf(!Ok, idx2_err_code::ParseFailed, "%s is not a preview file", FileName);
+  *Dims3 = v3i(Header[0], Header[1], Header[2]);
+  *Level = Header[3];
+  idx2_ReturnErrorIf(Z < 0 || Z >= Dims3->Z, idx2_err_code::SizeMismatched, "Slice %d is outside of %s", Z, FileName);
+  i64 SliceBytes = i64(sizeof(f32)) * Dims3->X * Dims3->Y;
+  if (Slice->Bytes < SliceBytes)
+  {
+    DeallocBuf(Slice);
+    AllocBuf(Slice, SliceBytes);
+  }
+  idx2_ReturnErrorIf(idx2_FSeek(Fp, 8 + sizeof(Header) + Z * SliceBytes, SEEK_SET) != 0, idx2_err_code::FileSeekFailed, "%s", FileName);
+  idx2_ReturnErrorIf(fread(Slice->Data, SliceBytes, 1, Fp) != 1, idx2_err_code::FileReadFailed, "%s", FileName);
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+void
+Dealloc(rd_curves* Curves)
+{
+  if (!Curves->Tiles.Alloc) // never read
+    return;
+  idx2_ForEach (It, Curves->Tiles)
+    Dealloc(&It.Val->Points);
+  Dealloc(&Curves->Tiles);
+}
+
+void
+Dealloc(rd_truncation* Truncation)
+{
+  Dealloc(&Truncation->MinBitPlanes);
+}
+
+error<idx2_err_code>
+ReadRdCurves(cstr FileName, rd_curves* Curves)
+{
+  FILE* Fp = fopen(FileName, "rb");
+  idx2_CleanUp(if (Fp) fclose(Fp));
+  idx2_ReturnErrorIf(!Fp, idx2_err_code::FileOpenFailed, "%s", FileName);
+  char Magic[8];
+  i64 NTiles = 0;
+  bool Ok = fread(Magic, 8, 1, Fp) == 1 && (memcmp(Magic, "idx2rdc1", 8) == 0 || memcmp(Magic, "idx2rdc2", 8) == 0) &&
+            fread(&NTiles, sizeof(NTiles), 1, Fp) == 1;
+  idx2_ReturnErrorIf(!Ok || NTiles < 0, idx2_err_code::ParseFailed, "%s is not a rate-distortion file", FileName);
+  Dealloc(Curves);
+  Curves->HasMaxErrors = Magic[7] == '2';
+  Init(&Curves->Tiles, Log2Ceil(Max(NTiles, i64(64))) + 1);
+  for (i64 I = 0; Ok && I < NTiles; ++I)
+  {
+    u64 Address = 0;
+    rd_curve Curve;
+    i32 NPoints = 0;
+    Ok = fread(&Address, sizeof(Address), 1, Fp) == 1 && fread(&Curve.Energy, sizeof(Curve.Energy), 1, Fp) == 1 &&
+         (!Curves->HasMaxErrors || fread(&Curve.MaxError, sizeof(Curve.MaxError), 1, Fp) == 1) &&
+         fread(&NPoints, sizeof(NPoints), 1, Fp) == 1 && NPoints >= 0;
+    if (!Ok)
+      break;
+    Init(&Curve.Points, NPoints);
+    idx2_ForEach (It, Curve.Points)
+    {
+      It->MaxError = -1;
+      Ok = Ok && fread(&It->BitPlane, sizeof(It->BitPlane), 1, Fp) == 1 && fread(&It->Bytes, sizeof(It->Bytes), 1, Fp) == 1 &&
+           fread(&It->Sse, sizeof(It->Sse), 1, Fp) == 1 && (!Curves->HasMaxErrors || fread(&It->MaxError, sizeof(It->MaxError), 1, Fp) == 1);
+    }
+    Insert(&Curves->Tiles, Address, Curve);
+  }
+  idx2_ReturnErrorIf(!Ok, idx2_err_code::FileReadFailed, "%s", FileName);
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+/* A segment of the lower convex hull of the (bytes, squared error) curve of a tile */
+struct rd_segment
+{
+  f64 Slope; // error removed per byte
+  i32 Tile;
+  i32 Point; // decoding the segment moves the tile to this point (0 = nothing decoded)
+  f64 DeltaSse;
+  i64 DeltaBytes;
+};
+
+struct rd_tile
+{
+  u64 Address;
+  const rd_curve* Curve;
+  i32 Point;
+  i32 Term = 0;   // level * 8 + subband (see SelectMaxErrorTruncation)
+  f64 Weight = 1; // the fraction of the tile inside the queried extent
+};
+
+/* Add the segments of the lower convex hull of the curve of a tile, whose squared errors are scaled by Weight (the
+fraction of the tile that is inside the queried extent) */
+static void
+AddHullSegments(const rd_curve& Curve, f64 Weight, i32 Tile, array<i32>* Hull, array<rd_segment>* Segments)
+{
+  auto Bytes = [&Curve](i32 K) { return K == 0 ? i64(0) : Curve.Points[K - 1].Bytes; };
+  auto Sse = [&Curve, Weight](i32 K) { return Weight * (K == 0 ? Curve.Energy : Curve.Points[K - 1].Sse); };
+  auto Slope = [&](i32 A, i32 B) { return (Sse(A) - Sse(B)) / f64(Max(Bytes(B) - Bytes(A), i64(1))); };
+  Clear(Hull);
+  PushBack(Hull, 0);
+  idx2_InclusiveFor (i32, K, 1, (i32)Size(Curve.Points))
+  {
+    if (Sse(K) >= Sse(Back(*Hull)))
+      continue; // more bytes for no less error
+    while (Size(*Hull) >= 2 && Slope((*Hull)[Size(*Hull) - 2], Back(*Hull)) <= Slope(Back(*Hull), K))
+      PopBack(Hull);
+    PushBack(Hull, K);
+  }
+  idx2_For (i64, I, 1, Size(*Hull))
+  {
+    i32 A = (*Hull)[I - 1], B = (*Hull)[I];
+    PushBack(Segments, rd_segment{ Slope(A, B), Tile, B, Sse(A) - Sse(B), Bytes(B) - Bytes(A) });
+  }
+}
+
+/* Call Visit(Level, Subband, Address, Curve, Weight) for each tile of Ext that a decode reads (see Decode), where
+Weight is the fraction of the tile that is inside Ext */
+template <typename visitor> static void
+TraverseTiles(const idx2_file& Idx2, rd_curves* Curves, const extent& Ext, const visitor& Visit)
+{
+  extent VolExt(Idx2.Dims3);
+  idx2_InclusiveForBackward (i8, Level, Idx2.NLevels - 1, 0)
+  {
+    if (Idx2.DecodeSubbandMasks[Level] == 0)
+      break;
+    v3i B3 = Idx2.BrickDims3 * Pow(Idx2.GroupBrick3, Level);
+    v3i C3 = Idx2.BricksPerChunk3s[Level] * B3;
+    v3i F3 = C3 * Idx2.ChunksPerFile3s[Level];
+    extent ExtentInChunks(From(Ext) / C3, Last(Ext) / C3 - From(Ext) / C3 + 1);
+    extent ExtentInFiles(From(Ext) / F3, Last(Ext) / F3 - From(Ext) / F3 + 1);
+    extent VolExtentInChunks(From(VolExt) / C3, Last(VolExt) / C3 - From(VolExt) / C3 + 1);
+    extent VolExtentInFiles(From(VolExt) / F3, Last(VolExt) / F3 - From(VolExt) / F3 + 1);
+    idx2_FileTraverse(
+      u64 FileAddr = FileTop.Address;
+      idx2_ChunkTraverse(
+        u64 ChunkAddr = FileAddr * Idx2.ChunksPerFiles[Level] + ChunkTop.Address;
+        extent ChunkExt = Crop(extent(ChunkTop.ChunkFrom3 * C3, C3), VolExt);
+        f64 Weight = f64(Prod<i64>(Dims(Crop(ChunkExt, Ext)))) / f64(Prod<i64>(Dims(ChunkExt)));
+        idx2_For (i8, Sb, 0, (i8)Size(Idx2.Subbands))
+        {
+          if (!BitSet(Idx2.DecodeSubbandMasks[Level], Sb))
+            continue;
+          u64 Address = (u64(Level) << 60) + (ChunkAddr << 18) + (u64(Sb) << 12);
+          auto CurveIt = Lookup(&Curves->Tiles, Address);
+          if (CurveIt)
+            Visit(Level, Sb, Address, *CurveIt.Val, Weight);
+        },
+        64,
+        Idx2.ChunkOrderFiles[Level],
+        FileTop.FileFrom3 * Idx2.ChunksPerFile3s[Level],
+        Idx2.ChunksPerFile3s[Level],
+        ExtentInChunks,
+        VolExtentInChunks);
+      , 64, Idx2.FileOrders[Level], v3i(0), Idx2.NFiles3s[Level], ExtentInFiles, VolExtentInFiles);
+  }
+}
+
+error<idx2_err_code>
+SelectTruncation(const idx2_file& Idx2, rd_curves* Curves, const extent& Extent, f64 TargetRmse, rd_truncation* Truncation)
+{
+  array<rd_tile> Tiles;
+  array<rd_segment> Segments;
+  array<i32> Hull;
+  idx2_CleanUp(Dealloc(&Tiles); Dealloc(&Segments); Dealloc(&Hull));
+  extent Ext = Crop(Extent, extent(Idx2.Dims3));
+  f64 NSamples = f64(Prod<i64>(Dims(Ext)));
+  f64 Sse = 0;
+
+  /* collect the tiles that a decode of Ext reads */
+  TraverseTiles(Idx2, Curves, Ext, [&](i8, i8, u64 Address, const rd_curve& Curve, f64 Weight) {
+    Sse += Weight * Curve.Energy;
+    AddHullSegments(Curve, Weight, (i32)Size(Tiles), &Hull, &Segments);
+    PushBack(&Tiles, rd_tile{ Address, &Curve, 0 });
+  });
+
+  /* take the segments that remove the most error per byte first (in the order of the hull within a tile) until the
+  error is small enough */
+  std::sort(Begin(Segments), End(Segments), [](const rd_segment& A, const rd_segment& B) {
+    if (A.Slope != B.Slope)
+      return A.Slope > B.Slope;
+    return A.Tile < B.Tile || (A.Tile == B.Tile && A.Point < B.Point);
+  });
+  f64 MaxSse = NSamples * TargetRmse * TargetRmse;
+  i64 Bytes = 0;
+  idx2_ForEach (It, Segments)
+  {
+    if (Sse <= MaxSse)
+      break;
+    Tiles[It->Tile].Point = It->Point;
+    Sse -= It->DeltaSse;
+    Bytes += It->DeltaBytes;
+  }
+
+  Dealloc(Truncation);
+  Init(&Truncation->MinBitPlanes, Log2Ceil(Max(Size(Tiles), i64(64))) + 1);
+  idx2_ForEach (It, Tiles)
+  {
+    i16 MinBitPlane = It->Point == 0 ? traits<i16>::Max : It->Curve->Points[It->Point - 1].BitPlane;
+    Insert(&Truncation->MinBitPlanes, It->Address, MinBitPlane);
+  }
+  Truncation->Rmse = NSamples > 0 ? sqrt(Max(Sse, 0.0) / NSamples) : 0;
+  Truncation->MaxError = -1;
+  Truncation->Bytes = Bytes;
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+/* The tiles of one subband of one level that a query reads, truncated so that none of them is off by more than Error
+(the largest max error of their points) */
+struct rd_max_error_term
+{
+  i64 Begin, End; // of the tiles
+  f64 Error;
+  i64 Bytes;
+  /* the next candidate, with a threshold of half the error (see SelectMaxErrorTruncation) */
+  f64 NextError;
+  i64 NextBytes;
+};
+
+/* The point of the curve of each tile of Term (0 = nothing decoded) that decodes the fewest bytes to get a max error
+of at most Threshold (or the smallest max error there is), returning the largest of their errors and their bytes */
+static t2<f64, i64>
+SelectMaxErrorPoints(array<rd_tile>* Tiles, const rd_max_error_term& Term, f64 Threshold, bool Apply)
+{
+  f64 TermError = 0;
+  i64 TermBytes = 0;
+  idx2_For (i64, T, Term.Begin, Term.End)
+  {
+    const rd_curve& Curve = *(*Tiles)[T].Curve;
+    i32 Best = 0;
+    f64 BestError = Curve.MaxError;
+    idx2_For (i32, K, 0, (i32)Size(Curve.Points))
+    {
+      if (BestError <= Threshold)
+        break;
+      if (Curve.Points[K].MaxError < BestError)
+      {
+        Best = K + 1;
+        BestError = Curve.Points[K].MaxError;
+      }
+    }
+    TermError = Max(TermError, BestError);
+    TermBytes += Best == 0 ? 0 : Curve.Points[Best - 1].Bytes;
+    if (Apply)
+      (*Tiles)[T].Point = Best;
+  }
+  return t2<f64, i64>{ TermError, TermBytes };
+}
+
+error<idx2_err_code>
+SelectMaxErrorTruncation(const idx2_file& Idx2, rd_curves* Curves, const extent& Extent, f64 TargetMaxError, rd_truncation* Truncation)
+{
+  idx2_ReturnErrorIf(!Curves->HasMaxErrors, idx2_err_code::NotSupportedInVersion,
+                     "The rate-distortion curves have no max errors (encode the file again with RdCurves)");
+  array<rd_tile> Tiles;
+  array<rd_max_error_term> Terms;
+  idx2_CleanUp(Dealloc(&Tiles); Dealloc(&Terms));
+  extent Ext = Crop(Extent, extent(Idx2.Dims3));
+
+  /* group the tiles that a decode of Ext reads by level and subband, as a sample depends on one brick per level */
+  TraverseTiles(Idx2, Curves, Ext, [&](i8 Level, i8 Sb, u64 Address, const rd_curve& Curve, f64 Weight) {
+    PushBack(&Tiles, rd_tile{ Address, &Curve, 0, Level * 8 + Sb, Weight });
+  });
+  std::stable_sort(Begin(Tiles), End(Tiles), [](const rd_tile& A, const rd_tile& B) { return A.Term > B.Term; });
+  for (i64 T = 0; T < Size(Tiles);)
+  {
+    rd_max_error_term Term{ T, T, 0, 0, 0, 0 };
+    while (Term.End < Size(Tiles) && Tiles[Term.End].Term == Tiles[T].Term)
+      ++Term.End;
+    t2<f64, i64> Nothing = SelectMaxErrorPoints(&Tiles, Term, traits<f64>::Max, false);
+    Term.Error = Nothing.First;
+    t2<f64, i64> Next = SelectMaxErrorPoints(&Tiles, Term, Term.Error / 2, false);
+    Term.NextError = Next.First;
+    Term.NextBytes = Next.Second;
+    PushBack(&Terms, Term);
+    T = Term.End;
+  }
+
+  /* the decoded samples are also rounded to the type of the field */
+  f64 Magnitude = Idx2.ValueRange.Min <= Idx2.ValueRange.Max ? Max(fabs(Idx2.ValueRange.Min), fabs(Idx2.ValueRange.Max)) : 0;
+  f64 Epsilon = SizeOf(Idx2.DType) > 4 ? ldexp(1.0, -52) : ldexp(1.0, -23);
+  auto Bound = [&](f64 Error) { return Error + (Magnitude + Error) * Epsilon; };
+  f64 Error = 0;
+  idx2_ForEach (It, Terms)
+    Error += It->Error;
+
+  /* halve the error of the term that removes the most error per byte until the sum of the errors is small enough
+  (the last step only removes the excess) */
+  i64 Bytes = 0;
+  while (Bound(Error) > TargetMaxError)
+  {
+    rd_max_error_term* Best = nullptr;
+    f64 BestSlope = 0;
+    idx2_ForEach (It, Terms)
+    {
+      if (It->NextError >= It->Error)
+        continue; // the tiles cannot get more precise
+      f64 Slope = (It->Error - It->NextError) / f64(Max(It->NextBytes - It->Bytes, i64(1)));
+      if (!Best || Slope > BestSlope)
+      {
+        Best = It;
+        BestSlope = Slope;
+      }
+    }
+    if (!Best)
+      break; // the target cannot be reached
+    f64 Threshold = Best->Error / 2;
+    f64 Excess = Bound(Error) - TargetMaxError;
+    if (Best->Error - Excess > Threshold)
+    {
+      t2<f64, i64> Last = SelectMaxErrorPoints(&Tiles, *Best, Best->Error - Excess, false);
+      if (Last.First <= Best->Error - Excess && Last.Second <= Best->NextBytes)
+        Threshold = Best->Error - Excess;
+    }
+    t2<f64, i64> Now = SelectMaxErrorPoints(&Tiles, *Best, Threshold, true);
+    Best->Error = Now.First;
+    Best->Bytes = Now.Second;
+    t2<f64, i64> Next = SelectMaxErrorPoints(&Tiles, *Best, Best->Error / 2, false);
+    Best->NextError = Next.First;
+    Best->NextBytes = Next.Second;
+    Error = Bytes = 0;
+    idx2_ForEach (It, Terms)
+    {
+      Error += It->Error;
+      Bytes += It->Bytes;
+    }
+  }
+
+  Dealloc(Truncation);
+  Init(&Truncation->MinBitPlanes, Log2Ceil(Max(Size(Tiles), i64(64))) + 1);
+  f64 NSamples = f64(Prod<i64>(Dims(Ext)));
+  f64 Sse = 0;
+  idx2_ForEach (It, Tiles)
+  {
+    i16 MinBitPlane = It->Point == 0 ? traits<i16>::Max : It->Curve->Points[It->Point - 1].BitPlane;
+    Insert(&Truncation->MinBitPlanes, It->Address, MinBitPlane);
+    Sse += It->Weight * (It->Point == 0 ? It->Curve->Energy : It->Curve->Points[It->Point - 1].Sse);
+  }
+  Truncation->Rmse = NSamples > 0 ? sqrt(Max(Sse, 0.0) / NSamples) : 0;
+  Truncation->MaxError = Bound(Error);
+  Truncation->Bytes = Bytes;
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+/* Co-locate the field just encoded with the fields already encoded that P.CoLocate lists (see CoLocate), and write
+the metadata of these again */
+static error<idx2_err_code>
+CoLocateWithEncoded(idx2_file* Idx2, const params& P)
+{
+  idx2_file Idx2s[idx2_file::MaxCoLocatedFields];
+  int NFields = 0;
+  char Field[sizeof(Idx2->Field)];
+  char MetaPath[512];
+  for (cstr Begin = P.CoLocate; Begin[0];)
+  {
+    cstr End = strchr(Begin, '+');
+    int Length = End ? int(End - Begin) : (int)strlen(Begin);
+    idx2_ReturnErrorIf(NFields + 1 >= idx2_file::MaxCoLocatedFields || Length >= (int)sizeof(Field),
+                       idx2_err_code::OptionNotSupported,
+                       "cannot co-locate with %s",
+                       P.CoLocate);
+    snprintf(Field, Length + 1, "%s", Begin);
+    int Bytes = snprintf(MetaPath, sizeof(MetaPath), "%s/%s/%s.idx2", P.OutDir, P.Meta.Name, Field);
+    idx2_ReturnErrorIf(Bytes >= int(sizeof(MetaPath)),
+                       idx2_err_code::OptionNotSupported,
+                       "the path %s/%s/%s.idx2 is too long",
+                       P.OutDir,
+                       P.Meta.Name,
+                       Field);
+    idx2_PropagateIfError(ReadMetaFile(&Idx2s[NFields], MetaPath));
+    SetDir(&Idx2s[NFields], Idx2->Dir);
+    ++NFields;
+    Begin += Length + (End != nullptr);
+  }
+  Idx2s[NFields++] = *Idx2;
+  auto Result = CoLocate(Idx2s, NFields);
+  /* Idx2s[NFields - 1] shares its buffers with Idx2: take back only the co-location fields */
+  snprintf(Idx2->CoLocated, sizeof(Idx2->CoLocated), "%s", Idx2s[NFields - 1].CoLocated);
+  Idx2->CoLocatedField = Idx2s[NFields - 1].CoLocatedField;
+  Idx2->NCoLocatedFields = Idx2s[NFields - 1].NCoLocatedFields;
+  if (Result)
+  {
+    idx2_For (int, F, 0, NFields - 1)
+    {
+      params FieldP;
+      bool Fits =
+        snprintf(FieldP.Meta.Name, sizeof(FieldP.Meta.Name), "%s", Idx2s[F].Name) < int(sizeof(FieldP.Meta.Name)) &&
+        snprintf(FieldP.Meta.Field, sizeof(FieldP.Meta.Field), "%s", Idx2s[F].Field) < int(sizeof(FieldP.Meta.Field)) &&
+        snprintf(MetaPath, sizeof(MetaPath), "%s/%s/%s.idx2", P.OutDir, P.Meta.Name, Idx2s[F].Field) < int(sizeof(MetaPath));
+      if (!Fits)
+      {
+        Result = idx2_Error(idx2_err_code::OptionNotSupported,
+                            "the path %s/%s/%s.idx2 is too long",
+                            P.OutDir,
+                            P.Meta.Name,
+                            Idx2s[F].Field);
+        break;
+      }
+      WriteMetaFile(Idx2s[F], FieldP, MetaPath);
+    }
+  }
+  idx2_For (int, F, 0, NFields - 1)
+    Dealloc(&Idx2s[F]);
+  return Result;
+}
+
 error<idx2_err_code>
 Encode(idx2_file* Idx2, const params& P, brick_copier& Copier)
 {
+  idx2_TraceScope("Encode");
   const int BrickBytes = Prod(Idx2->BrickDimsExt3) * sizeof(f64);
   BrickAlloc_ = free_list_allocator(BrickBytes);
   idx2_RAII(encode_data, E, Init(&E));
+  E.RdCurves = P.RdCurves;
+  /* the coarsest level is transformed differently (see EncodeBrick), so it needs at least two levels */
+  Idx2->ConstantBricks = P.ConstantBricks && Idx2->NLevels > 1;
+  Idx2->Int32Blocks = P.Int32Blocks && Idx2->DType == dtype::float32;
+  SetFormatVersion(Idx2);
+  preview Preview;
+  idx2_CleanUp(Dealloc(&Preview));
+  if (P.PreviewLevel >= 0)
+    Init(&Preview, Idx2->Dims3, P.PreviewLevel);
   idx2_BrickTraverse(timer Timer; StartTimer(&Timer);
                      //    idx2_Assert(GetLinearBrick(*Idx2, 0, Top.BrickFrom3) == Top.Address);
                      //    idx2_Assert(GetSpatialBrick(*Idx2, 0, Top.Address) == Top.BrickFrom3);
@@ -45806,6 +47958,8 @@ Encode(idx2_file* Idx2, const params& P, brick_copier& Copier)
                      extent BrickExtentCrop = Crop(BrickExtent, extent(Idx2->Dims3));
                      BVol.ExtentLocal = Relative(BrickExtentCrop, BrickExtent);
                      v2d MinMax = Copier.Copy(BrickExtentCrop, BVol.ExtentLocal, &BVol);
+                     if (P.PreviewLevel >= 0)
+                       AddBrick(&Preview, BrickExtentCrop, BVol);
                      Idx2->ValueRange.Min = Min(Idx2->ValueRange.Min, MinMax.Min);
                      Idx2->ValueRange.Max = Max(Idx2->ValueRange.Max, MinMax.Max);
                      //    Copy(BrickExtentCrop, Vol, BVol.ExtentLocal, &BVol.Vol);
@@ -45813,6 +47967,8 @@ Encode(idx2_file* Idx2, const params& P, brick_copier& Copier)
                      E.Bricks3[E.Iter] = Top.BrickFrom3;
                      E.Brick[E.Iter] = GetLinearBrick(*Idx2, E.Iter, E.Bricks3[E.Iter]);
                      idx2_Assert(E.Brick[E.Iter] == Top.Address);
+                     if (Idx2->ConstantBricks && MinMax.Min == MinMax.Max && Dims(BVol.ExtentLocal) == Idx2->BrickDims3)
+                       PushBack(&E.ConstantBricks, t2<u64, f64>{ E.Brick[E.Iter], MinMax.Min });
                      u64 BrickKey = GetBrickKey(E.Iter, E.Brick[E.Iter]);
                      Insert(&E.BrickPool, BrickKey, BVol);
                      EncodeBrick(Idx2, P, &E);
@@ -45830,13 +47986,21 @@ Encode(idx2_file* Idx2, const params& P, brick_copier& Copier)
   StartTimer(&Timer);
   idx2_PropagateIfError(FlushChunks(*Idx2, &E));
   idx2_PropagateIfError(FlushChunkExponents(*Idx2, &E));
+  if (P.RdCurves)
+    idx2_PropagateIfError(WriteRdCurves(&E, idx2_PrintScratch("%s/%s/%s.rd", P.OutDir, P.Meta.Name, P.Meta.Field)));
   timer RdoTimer;
   StartTimer(&RdoTimer);
   RateDistortionOpt(*Idx2, &E);
   TotalTime_ += Seconds(ElapsedTime(&Timer));
   printf("rdo time                = %f\n", Seconds(ElapsedTime(&RdoTimer)));
+  if (P.FastDir)
+    idx2_PropagateIfError(PlaceTiers(Idx2, P.FastDir, P.FastLevels, P.FastBitPlanes));
+  if (P.CoLocate && P.CoLocate[0])
+    idx2_PropagateIfError(CoLocateWithEncoded(Idx2, P));
 
   WriteMetaFile(*Idx2, P, idx2_PrintScratch("%s/%s/%s.idx2", P.OutDir, P.Meta.Name, P.Meta.Field));
+  if (P.PreviewLevel >= 0)
+    idx2_PropagateIfError(WritePreviewFile(Preview, idx2_PrintScratch("%s/%s/%s.preview", P.OutDir, P.Meta.Name, P.Meta.Field)));
   printf("num channels            = %" PRIi64 "\n", Size(E.Channels));
   printf("num sub channels        = %" PRIi64 "\n", Size(E.SubChannels));
   printf("num chunks              = %" PRIi64 "\n", ChunkStreamStat.Count());
@@ -45921,6 +48085,8 @@ WriteMetaFile(const idx2_file& Idx2, const params& P, cstr FileName)
   fprintf(Fp, "    (data-type \"%s\")\n", idx2_PrintScratchN(Size(DType), "%s", DType.ConstPtr));
   fprintf(Fp, "    (min-max %.20f %.20f)\n", Idx2.ValueRange.Min, Idx2.ValueRange.Max);
   fprintf(Fp, "    (accuracy %.20f)\n", Idx2.Accuracy);
+  if (Idx2.MinDownsampling3 != v3i(0))
+    fprintf(Fp, "    (min-downsampling %d %d %d)\n", idx2_PrV3i(Idx2.MinDownsampling3));
   fprintf(Fp, "  )\n"); // end common)
   fprintf(Fp, "  (format\n");
   fprintf(Fp, "    (version %d %d)\n", Idx2.Version[0], Idx2.Version[1]);
@@ -45930,12 +48096,22 @@ WriteMetaFile(const idx2_file& Idx2, const params& P, cstr FileName)
   fprintf(Fp, "    (transform-order \"%s\")\n", TransformOrder);
   fprintf(Fp, "    (num-levels %d)\n", Idx2.NLevels);
   fprintf(Fp, "    (transform-passes-per-levels %d)\n", Idx2.NTformPasses);
+  if (Idx2.Wavelet != wavelet::Cdf53)
+    fprintf(Fp, "    (wavelet \"%.*s\")\n", ToString(Idx2.Wavelet).Size, ToString(Idx2.Wavelet).ConstPtr);
   fprintf(Fp, "    (bricks-per-tile %d)\n", Idx2.BricksPerChunkIn);
   fprintf(Fp, "    (tiles-per-file %d)\n", Idx2.ChunksPerFileIn);
   fprintf(Fp, "    (files-per-directory %d)\n", Idx2.FilesPerDir);
   fprintf(Fp, "    (group-levels %s)\n", Idx2.GroupLevels ? "true" : "false");
   fprintf(Fp, "    (group-sub-levels %s)\n", Idx2.GroupSubLevels ? "true" : "false");
   fprintf(Fp, "    (group-bit-planes %s)\n", Idx2.GroupBitPlanes ? "true" : "false");
+  if (Idx2.FastDir[0])
+    fprintf(Fp, "    (fast-tier \"%s\" %d %d)\n", Idx2.FastDir, Idx2.FastMinLevel, Idx2.FastMinBitPlane);
+  if (Idx2.ConstantBricks)
+    fprintf(Fp, "    (constant-bricks true)\n");
+  if (Idx2.Int32Blocks)
+    fprintf(Fp, "    (int32-blocks true)\n");
+  if (Idx2.CoLocated[0])
+    fprintf(Fp, "    (co-located \"%s\" %d %d)\n", Idx2.CoLocated, Idx2.CoLocatedField, Idx2.NCoLocatedFields);
   if (Size(Idx2.QualityLevelsIn) > 0)
   {
     fprintf(Fp, "    (quality-levels %d", (int)Size(Idx2.QualityLevelsIn));
@@ -45953,9 +48129,21 @@ WriteMetaFile(const idx2_file& Idx2, const params& P, cstr FileName)
 error<idx2_err_code>
 EncodeWithMinMax(idx2_file* Idx2, const params& P, const volume& Vol)
 {
+  idx2_ReturnErrorIf(Vol.Type != dtype::float32 && Vol.Type != dtype::float64,
+                     idx2_err_code::TypeNotSupported,
+                     "only float32 and float64 volumes can be encoded\n");
   const int BrickBytes = Prod(Idx2->BrickDimsExt3) * sizeof(f64);
   BrickAlloc_ = free_list_allocator(BrickBytes);
   idx2_RAII(encode_data, E, Init(&E));
+  E.RdCurves = P.RdCurves;
+  /* the coarsest level is transformed differently (see EncodeBrick), so it needs at least two levels */
+  Idx2->ConstantBricks = P.ConstantBricks && Idx2->NLevels > 1;
+  Idx2->Int32Blocks = P.Int32Blocks && Idx2->DType == dtype::float32;
+  SetFormatVersion(Idx2);
+  preview Preview;
+  idx2_CleanUp(Dealloc(&Preview));
+  if (P.PreviewLevel >= 0)
+    Init(&Preview, Idx2->Dims3, P.PreviewLevel);
   idx2_BrickTraverse(
     timer Timer; StartTimer(&Timer);
     //    idx2_Assert(GetLinearBrick(*Idx2, 0, Top.BrickFrom3) == Top.Address);
@@ -45966,18 +48154,20 @@ EncodeWithMinMax(idx2_file* Idx2, const params& P, const volume& Vol)
     extent BrickExtent(Top.BrickFrom3 * Idx2->BrickDims3, Idx2->BrickDims3);
     extent BrickExtentCrop = Crop(BrickExtent, extent(Idx2->Dims3));
     BVol.ExtentLocal = Relative(BrickExtentCrop, BrickExtent);
-    v2d MinMax;
-    if (Vol.Type == dtype::float32) MinMax =
-      (CopyExtentExtentMinMax<f32, f64>(BrickExtentCrop, Vol, BVol.ExtentLocal, &BVol.Vol));
-    else if (Vol.Type == dtype::float64) MinMax =
-      (CopyExtentExtentMinMax<f64, f64>(BrickExtentCrop, Vol, BVol.ExtentLocal, &BVol.Vol));
+    v2d MinMax = (Vol.Type == dtype::float32 // the commas are in parentheses, for the macro
+                    ? CopyExtentExtentMinMax<f32, f64>(BrickExtentCrop, Vol, BVol.ExtentLocal, &BVol.Vol)
+                    : CopyExtentExtentMinMax<f64, f64>(BrickExtentCrop, Vol, BVol.ExtentLocal, &BVol.Vol));
     Idx2->ValueRange.Min = Min(Idx2->ValueRange.Min, MinMax.Min);
     Idx2->ValueRange.Max = Max(Idx2->ValueRange.Max, MinMax.Max);
+    if (P.PreviewLevel >= 0)
+      AddBrick(&Preview, BrickExtentCrop, BVol);
     //    Copy(BrickExtentCrop, Vol, BVol.ExtentLocal, &BVol.Vol);
     E.Iter = 0;
     E.Bricks3[E.Iter] = Top.BrickFrom3;
     E.Brick[E.Iter] = GetLinearBrick(*Idx2, E.Iter, E.Bricks3[E.Iter]);
     idx2_Assert(E.Brick[E.Iter] == Top.Address);
+    if (Idx2->ConstantBricks && MinMax.Min == MinMax.Max && Dims(BVol.ExtentLocal) == Idx2->BrickDims3)
+      PushBack(&E.ConstantBricks, t2<u64, f64>{ E.Brick[E.Iter], MinMax.Min });
     u64 BrickKey = GetBrickKey(E.Iter, E.Brick[E.Iter]);
     Insert(&E.BrickPool, BrickKey, BVol);
     EncodeBrick(Idx2, P, &E);
@@ -45995,13 +48185,21 @@ EncodeWithMinMax(idx2_file* Idx2, const params& P, const volume& Vol)
   StartTimer(&Timer);
   idx2_PropagateIfError(FlushChunks(*Idx2, &E));
   idx2_PropagateIfError(FlushChunkExponents(*Idx2, &E));
+  if (P.RdCurves)
+    idx2_PropagateIfError(WriteRdCurves(&E, idx2_PrintScratch("%s/%s/%s.rd", P.OutDir, P.Meta.Name, P.Meta.Field)));
   timer RdoTimer;
   StartTimer(&RdoTimer);
   RateDistortionOpt(*Idx2, &E);
   TotalTime_ += Seconds(ElapsedTime(&Timer));
   printf("rdo time                = %f\n", Seconds(ElapsedTime(&RdoTimer)));
+  if (P.FastDir)
+    idx2_PropagateIfError(PlaceTiers(Idx2, P.FastDir, P.FastLevels, P.FastBitPlanes));
+  if (P.CoLocate && P.CoLocate[0])
+    idx2_PropagateIfError(CoLocateWithEncoded(Idx2, P));
 
   WriteMetaFile(*Idx2, P, idx2_PrintScratch("%s/%s/%s.idx2", P.OutDir, P.Meta.Name, P.Meta.Field));
+  if (P.PreviewLevel >= 0)
+    idx2_PropagateIfError(WritePreviewFile(Preview, idx2_PrintScratch("%s/%s/%s.preview", P.OutDir, P.Meta.Name, P.Meta.Field)));
   printf("num channels            = %" PRIi64 "\n", Size(E.Channels));
   printf("num sub channels        = %" PRIi64 "\n", Size(E.SubChannels));
   printf("num chunks              = %" PRIi64 "\n", ChunkStreamStat.Count());
@@ -46072,6 +48270,12 @@ Init(encode_data* E, allocator* Alloc)
   InitWrite(&E->ChunkStream, 16384);
   InitWrite(&E->ChunkEMaxesStream, 32768);
   Init(&E->ChunkRDOLengths, 10);
+  Init(&E->TileEnergies, 10);
+  Init(&E->TileSses, 10);
+  Init(&E->TileMaxErrors, 10);
+  Init(&E->TileTopErrors, 10);
+  Init(&E->TileBottomErrors, 10);
+  Init(&E->TileFloorErrors, 10);
 }
 
 static void
@@ -46099,6 +48303,13 @@ Dealloc(encode_data* E)
   Dealloc(&E->BlockStream);
   Dealloc(&E->ChunkRDOs);
   Dealloc(&E->ChunkRDOLengths);
+  Dealloc(&E->TileEnergies);
+  Dealloc(&E->TileSses);
+  Dealloc(&E->TileMaxErrors);
+  Dealloc(&E->TileTopErrors);
+  Dealloc(&E->TileBottomErrors);
+  Dealloc(&E->TileFloorErrors);
+  Dealloc(&E->ConstantBricks);
 }
 
 /* ----------- UNUSED: VERSION 0 ----------*/
@@ -46227,7 +48438,7 @@ ConstructFilePathRdos(const idx2_file& Idx2, u64 Brick, i8 Level)
   int Shift = 0;
   thread_local static char FilePath[256];
   printer Pr(FilePath, sizeof(FilePath));
-  idx2_Print(&Pr, "%s/%s/%s/TruncationPoints/", Idx2.Dir, Idx2.Name, Idx2.Field);
+  idx2_Print(&Pr, "%s/%s/%s/TruncationPoints/", GetTierDir(Idx2), Idx2.Name, Idx2.Field);
   idx2_PrintLevel;
   idx2_PrintBrick;
   idx2_PrintExtension;
@@ -46261,7 +48472,7 @@ ConstructFilePath(const idx2_file& Idx2, u64 Brick, i8 Level, i8 SubLevel, i16 B
   int Shift = 0;
   thread_local static char FilePath[256];
   printer Pr(FilePath, sizeof(FilePath));
-  idx2_Print(&Pr, "%s/%s/%s/BrickData/", Idx2.Dir, Idx2.Name, Idx2.Field);
+  idx2_Print(&Pr, "%s/%s/%s/BrickData/", GetTierDir(Idx2, Level, BitPlane), Idx2.Name, GetDataField(Idx2));
   if (!Idx2.GroupBitPlanes)
     idx2_PrintBitPlane;
   if (!Idx2.GroupLevels)
@@ -46298,7 +48509,7 @@ ConstructFilePathExponents(const idx2_file& Idx2, u64 Brick, i8 Level, i8 SubLev
   int Shift = 0;
   thread_local static char FilePath[256];
   printer Pr(FilePath, sizeof(FilePath));
-  idx2_Print(&Pr, "%s/%s/%s/BrickExponents/", Idx2.Dir, Idx2.Name, Idx2.Field);
+  idx2_Print(&Pr, "%s/%s/%s/BrickExponents/", GetTierDir(Idx2), Idx2.Name, Idx2.Field);
   idx2_PrintLevel;
   idx2_PrintSubLevel;
   idx2_PrintBrick;
@@ -46311,6 +48522,397 @@ ConstructFilePathExponents(const idx2_file& Idx2, u64 Brick, i8 Level, i8 SubLev
 #undef idx2_PrintExtension
 }
 
+error<idx2_err_code>
+PlaceTiers(idx2_file* Idx2, cstr FastDir, int FastLevels, int FastBitPlanes)
+{
+  bool Tiered = FastDir && FastDir[0];
+  idx2_ReturnErrorIf(Idx2->CoLocated[0],
+                     idx2_err_code::OptionNotSupported,
+                     "a co-located field cannot be placed on two tiers");
+  idx2_ReturnErrorIf(Tiered && FastLevels > 0 && Idx2->GroupLevels,
+                     idx2_err_code::OptionNotSupported,
+                     "placing levels on the fast tier requires ungrouped levels");
+  idx2_ReturnErrorIf(Tiered && FastBitPlanes > 0 && Idx2->GroupBitPlanes,
+                     idx2_err_code::OptionNotSupported,
+                     "placing bit planes on the fast tier requires ungrouped bit planes");
+  idx2_ReturnErrorIf(Tiered && strlen(FastDir) >= sizeof(Idx2->FastDir),
+                     idx2_err_code::OptionNotSupported,
+                     "the path of the fast tier is too long: %s",
+                     FastDir);
+
+  /* the files are now either under Dir or under the current fast tier */
+  char OldFastDir[sizeof(Idx2->FastDir)];
+  snprintf(OldFastDir, sizeof(OldFastDir), "%s", Idx2->FastDir[0] ? Idx2->FastDir : Idx2->Dir);
+  cstr Roots[2] = { Idx2->Dir, OldFastDir };
+  int NRoots = strcmp(Roots[0], Roots[1]) == 0 ? 1 : 2;
+  char Path[512];
+  char FromPath[512];
+  char ToPath[512];
+  /* every path below is a root followed by at most the file of a level in a bit plane: check them all before
+  moving anything, rather than stop halfway */
+  int MaxSuffix = snprintf(nullptr, 0, "/%s/%s/BrickData/P%04hx/L%02x.bin", Idx2->Name, Idx2->Field, i16(0xFFF), 0xFF);
+  idx2_For (int, R, 0, NRoots + Tiered)
+  {
+    cstr Root = R < NRoots ? Roots[R] : FastDir;
+    idx2_ReturnErrorIf(strlen(Root) + MaxSuffix >= sizeof(ToPath),
+                       idx2_err_code::OptionNotSupported,
+                       "the paths of %s/%s under %s are too long",
+                       Idx2->Name,
+                       Idx2->Field,
+                       Root);
+  }
+
+  /* list the bit planes that are stored (the P%04hx directories) */
+  bool Stored[0x1000] = {}; // a bit plane takes 12 bits in the file addresses
+  if (!Idx2->GroupBitPlanes)
+  {
+    idx2_For (int, R, 0, NRoots)
+    {
+      snprintf(Path, sizeof(Path), "%s/%s/%s/BrickData", Roots[R], Idx2->Name, Idx2->Field);
+      DIR* Dir = opendir(Path);
+      if (!Dir)
+        continue;
+      while (struct dirent* Entry = readdir(Dir))
+      {
+        unsigned int BitPlane = 0;
+        if (sscanf(Entry->d_name, "P%x", &BitPlane) == 1 && BitPlane < 0x1000)
+          Stored[BitPlane] = true;
+      }
+      closedir(Dir);
+    }
+  }
+
+  /* the new placement */
+  i16 FastMinBitPlane = traits<i16>::Max;
+  for (int BitPlane = 0xFFF, N = 0; Tiered && BitPlane >= 0 && N < FastBitPlanes; --BitPlane)
+  {
+    if (Stored[BitPlane])
+    {
+      FastMinBitPlane = i16(BitPlane);
+      ++N;
+    }
+  }
+  snprintf(Idx2->FastDir, sizeof(Idx2->FastDir), "%s", Tiered ? FastDir : "");
+  Idx2->FastMinLevel =
+    Tiered && FastLevels > 0 ? i8(Max(Idx2->NLevels - FastLevels, 0)) : i8(idx2_file::MaxLevels);
+  Idx2->FastMinBitPlane = FastMinBitPlane;
+
+  /* move the brick data to its tier, one bit plane (P%04hx) or level (L%02x) at a time (a directory, or a file
+  if there is nothing else in the path) */
+  bool Ok = true;
+  int NBitPlanes = Idx2->GroupBitPlanes ? 1 : 0x1000;
+  int NLevels = Idx2->GroupLevels ? 1 : Idx2->NLevels;
+  idx2_For (int, R, 0, NRoots)
+  {
+    idx2_For (int, BitPlane, 0, NBitPlanes)
+    {
+      if (!Idx2->GroupBitPlanes && !Stored[BitPlane])
+        continue;
+      idx2_For (int, Level, 0, NLevels)
+      {
+        cstr To = GetTierDir(*Idx2, i8(Level), i16(BitPlane));
+        if (strcmp(Roots[R], To) == 0)
+          continue;
+        printer Pr(Path, sizeof(Path));
+        idx2_Print(&Pr, "/%s/%s/BrickData", Idx2->Name, Idx2->Field);
+        if (!Idx2->GroupBitPlanes)
+          idx2_Print(&Pr, "/P%04hx", i16(BitPlane));
+        if (!Idx2->GroupLevels)
+          idx2_Print(&Pr, "/L%02x", Level);
+        for (cstr Extension : { "", ".bin" })
+        {
+          int FromBytes = snprintf(FromPath, sizeof(FromPath), "%s%s%s", Roots[R], Path, Extension);
+          int ToBytes = snprintf(ToPath, sizeof(ToPath), "%s%s%s", To, Path, Extension);
+          idx2_ReturnErrorIf(FromBytes >= int(sizeof(FromPath)) || ToBytes >= int(sizeof(ToPath)),
+                             idx2_err_code::OptionNotSupported,
+                             "the path %s%s%s is too long",
+                             To,
+                             Path,
+                             Extension);
+          if (DirExists(FromPath)) // (or file)
+            Ok = MovePath(FromPath, ToPath) && Ok;
+        }
+      }
+      if (!Idx2->GroupBitPlanes && !Idx2->GroupLevels) // the bit plane directory, if now empty
+        remove(idx2_PrintScratch("%s/%s/%s/BrickData/P%04hx", Roots[R], Idx2->Name, Idx2->Field, i16(BitPlane)));
+    }
+  }
+
+  /* the exponents and the truncation points are read by every decode */
+  cstr SharedDirs[] = { "BrickExponents", "TruncationPoints" };
+  idx2_For (int, R, 0, NRoots)
+  {
+    cstr To = GetTierDir(*Idx2);
+    if (strcmp(Roots[R], To) == 0)
+      continue;
+    for (cstr SharedDir : SharedDirs)
+    {
+      int FromBytes = snprintf(Path, sizeof(Path), "%s/%s/%s/%s", Roots[R], Idx2->Name, Idx2->Field, SharedDir);
+      int ToBytes = snprintf(ToPath, sizeof(ToPath), "%s/%s/%s/%s", To, Idx2->Name, Idx2->Field, SharedDir);
+      idx2_ReturnErrorIf(FromBytes >= int(sizeof(Path)) || ToBytes >= int(sizeof(ToPath)),
+                         idx2_err_code::OptionNotSupported,
+                         "the path %s/%s/%s/%s is too long",
+                         To,
+                         Idx2->Name,
+                         Idx2->Field,
+                         SharedDir);
+      if (DirExists(Path))
+        Ok = MovePath(Path, ToPath) && Ok;
+    }
+  }
+
+  /* remove the directories left empty (the metadata stays under Dir) */
+  idx2_For (int, R, 0, NRoots)
+  {
+    remove(idx2_PrintScratch("%s/%s/%s/BrickData", Roots[R], Idx2->Name, Idx2->Field));
+    remove(idx2_PrintScratch("%s/%s/%s", Roots[R], Idx2->Name, Idx2->Field));
+    if (R > 0)
+      remove(idx2_PrintScratch("%s/%s", Roots[R], Idx2->Name));
+  }
+  idx2_ReturnErrorIf(!Ok,
+                     idx2_err_code::FileCreateFailed,
+                     "some files of %s/%s could not be moved to their tier",
+                     Idx2->Name,
+                     Idx2->Field);
+
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+/* A chunk of one of the fields merged into a co-located file */
+struct co_located_chunk
+{
+  u64 Address;
+  i8 Field;
+  i64 Offset; // in the file of the field
+  i64 Size;
+  bool
+  operator<(const co_located_chunk& Other) const
+  {
+    return Address != Other.Address ? Address < Other.Address : Field < Other.Field;
+  }
+};
+
+/* Merge the files of brick data at the path Rel (relative to the directories of the fields) into one co-located
+file, whose chunk index is that of FlushChunks with NFields chunk sizes per chunk address */
+static error<idx2_err_code>
+CoLocateFile(const idx2_file* Idx2s, int NFields, cstr Group, cstr Rel)
+{
+  buffer Files[idx2_file::MaxCoLocatedFields] = {};
+  array<co_located_chunk> Chunks;
+  bitstream ChunkAddrsStream;
+  idx2_CleanUp(for (buffer& File : Files) if (File) DeallocBuf(&File);
+               Dealloc(&Chunks);
+               if (ChunkAddrsStream.Stream) Dealloc(&ChunkAddrsStream));
+  char Path[512];
+  idx2_For (int, F, 0, NFields)
+  {
+    const idx2_file& Idx2 = Idx2s[F];
+    int Bytes = snprintf(Path, sizeof(Path), "%s/%s/%s/%s", Idx2.Dir, Idx2.Name, Idx2.Field, Rel);
+    idx2_ReturnErrorIf(Bytes >= int(sizeof(Path)),
+                       idx2_err_code::OptionNotSupported,
+                       "the path %s/%s/%s/%s is too long",
+                       Idx2.Dir,
+                       Idx2.Name,
+                       Idx2.Field,
+                       Rel);
+    if (!DirExists(Path)) // (or file)
+      continue;
+    idx2_PropagateIfError(ReadFile(Path, &Files[F]));
+    const byte* End = Files[F].Data + Size(Files[F]);
+    int NChunks = 0, ChunkAddrsSz = 0, ChunkSizesSz = 0;
+    idx2_ReturnErrorIf(Size(Files[F]) < 3 * (i64)sizeof(int), idx2_err_code::ParseFailed, "%s", Path);
+    memcpy(&NChunks, End - sizeof(int), sizeof(int));
+    memcpy(&ChunkAddrsSz, End - 2 * sizeof(int), sizeof(int));
+    idx2_ReturnErrorIf(NChunks <= 0 || ChunkAddrsSz <= 0 || ChunkAddrsSz + 3 * (i64)sizeof(int) > Size(Files[F]),
+                       idx2_err_code::ParseFailed,
+                       "%s",
+                       Path);
+    const byte* ChunkAddrs = End - 2 * sizeof(int) - ChunkAddrsSz;
+    memcpy(&ChunkSizesSz, ChunkAddrs - sizeof(int), sizeof(int));
+    const byte* ChunkSizes = ChunkAddrs - sizeof(int) - ChunkSizesSz;
+    idx2_ReturnErrorIf(ChunkSizesSz <= 0 || ChunkSizes < Files[F].Data, idx2_err_code::ParseFailed, "%s", Path);
+    Rewind(&ChunkAddrsStream);
+    GrowToAccomodate(&ChunkAddrsStream, NChunks * (i64)sizeof(u64) - Size(ChunkAddrsStream));
+    DecompressBufZstd(buffer{ (byte*)ChunkAddrs, ChunkAddrsSz }, &ChunkAddrsStream);
+    bitstream ChunkSzsStream;
+    InitRead(&ChunkSzsStream, buffer{ (byte*)ChunkSizes, ChunkSizesSz });
+    i64 Offset = 0;
+    idx2_For (int, I, 0, NChunks)
+    {
+      i64 ChunkSize = ReadVarByte(&ChunkSzsStream);
+      u64 Address = *((u64*)ChunkAddrsStream.Stream.Data + I);
+      PushBack(&Chunks, co_located_chunk{ Address, i8(F), Offset, ChunkSize });
+      Offset += ChunkSize;
+    }
+    idx2_ReturnErrorIf(Files[F].Data + Offset > ChunkSizes, idx2_err_code::ParseFailed, "%s", Path);
+  }
+  std::sort(Begin(Chunks), End(Chunks));
+
+  /* write the chunks of each address, then the chunk index */
+  const idx2_file& Idx2 = Idx2s[0];
+  int Bytes = snprintf(Path, sizeof(Path), "%s/%s/%s/%s", Idx2.Dir, Idx2.Name, Group, Rel);
+  idx2_ReturnErrorIf(Bytes >= int(sizeof(Path)),
+                     idx2_err_code::OptionNotSupported,
+                     "the path %s/%s/%s/%s is too long",
+                     Idx2.Dir,
+                     Idx2.Name,
+                     Group,
+                     Rel);
+  idx2_OpenMaybeExistingFile(Fp, Path, "wb");
+  bitstream ChunkSzs;
+  InitWrite(&ChunkSzs, 128);
+  array<u64> ChunkAddrs;
+  bitstream CpresChunkAddrs;
+  idx2_CleanUp(Dealloc(&ChunkSzs); Dealloc(&ChunkAddrs); if (CpresChunkAddrs.Stream) Dealloc(&CpresChunkAddrs));
+  for (i64 I = 0; I < Size(Chunks);)
+  {
+    u64 Address = Chunks[I].Address;
+    PushBack(&ChunkAddrs, Address);
+    GrowToAccomodate(&ChunkSzs, 8 * NFields);
+    idx2_For (int, F, 0, NFields)
+    {
+      if (I < Size(Chunks) && Chunks[I].Address == Address && Chunks[I].Field == F)
+      {
+        const co_located_chunk& Chunk = Chunks[I++];
+        WriteBuffer(Fp, buffer{ Files[F].Data + Chunk.Offset, Chunk.Size });
+        WriteVarByte(&ChunkSzs, Chunk.Size);
+      }
+      else
+      {
+        WriteVarByte(&ChunkSzs, 0);
+      }
+    }
+  }
+  Flush(&ChunkSzs);
+  WriteBuffer(Fp, ToBuffer(ChunkSzs));
+  WritePOD(Fp, (int)Size(ChunkSzs));
+  CompressBufZstd(ToBuffer(ChunkAddrs), &CpresChunkAddrs);
+  WriteBuffer(Fp, ToBuffer(CpresChunkAddrs));
+  WritePOD(Fp, (int)Size(CpresChunkAddrs));
+  WritePOD(Fp, (int)Size(ChunkAddrs));
+  idx2_ReturnErrorIf(ferror(Fp), idx2_err_code::FileCreateFailed, "%s", Path);
+
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+/* Co-locate the files of brick data under the relative directory Rel of every field (see CoLocate) */
+static error<idx2_err_code>
+CoLocateDir(const idx2_file* Idx2s, int NFields, cstr Group, cstr Rel)
+{
+  char Path[512];
+  char EntryRel[512];
+  idx2_For (int, F, 0, NFields)
+  {
+    const idx2_file& Idx2 = Idx2s[F];
+    int Bytes = snprintf(Path, sizeof(Path), "%s/%s/%s/%s", Idx2.Dir, Idx2.Name, Idx2.Field, Rel);
+    idx2_ReturnErrorIf(Bytes >= int(sizeof(Path)),
+                       idx2_err_code::OptionNotSupported,
+                       "the path %s/%s/%s/%s is too long",
+                       Idx2.Dir,
+                       Idx2.Name,
+                       Idx2.Field,
+                       Rel);
+    DIR* Dir = opendir(Path);
+    if (!Dir)
+      continue;
+    idx2_CleanUp(closedir(Dir));
+    while (struct dirent* Entry = readdir(Dir))
+    {
+      if (*(Entry->d_name) == '.')
+        continue;
+      int RelBytes = snprintf(EntryRel, sizeof(EntryRel), "%s/%s", Rel, Entry->d_name);
+      Bytes = snprintf(Path, sizeof(Path), "%s/%s/%s/%s", Idx2.Dir, Idx2.Name, Idx2.Field, EntryRel);
+      idx2_ReturnErrorIf(RelBytes >= int(sizeof(EntryRel)) || Bytes >= int(sizeof(Path)),
+                         idx2_err_code::OptionNotSupported,
+                         "the path %s/%s/%s/%s/%s is too long",
+                         Idx2.Dir,
+                         Idx2.Name,
+                         Idx2.Field,
+                         Rel,
+                         Entry->d_name);
+      if (DIR* SubDir = opendir(Path))
+      {
+        closedir(SubDir);
+        idx2_PropagateIfError(CoLocateDir(Idx2s, NFields, Group, EntryRel));
+        continue;
+      }
+      Bytes = snprintf(Path, sizeof(Path), "%s/%s/%s/%s", Idx2.Dir, Idx2.Name, Group, EntryRel);
+      idx2_ReturnErrorIf(Bytes >= int(sizeof(Path)),
+                         idx2_err_code::OptionNotSupported,
+                         "the path %s/%s/%s/%s is too long",
+                         Idx2.Dir,
+                         Idx2.Name,
+                         Group,
+                         EntryRel);
+      if (!DirExists(Path)) // (or file) not merged yet, from the files of an earlier field
+        idx2_PropagateIfError(CoLocateFile(Idx2s, NFields, Group, EntryRel));
+    }
+  }
+
+  return idx2_Error(idx2_err_code::NoError);
+}
+
+error<idx2_err_code>
+CoLocate(idx2_file* Idx2s, int NFields)
+{
+  idx2_ReturnErrorIf(NFields < 2 || NFields > idx2_file::MaxCoLocatedFields,
+                     idx2_err_code::OptionNotSupported,
+                     "only 2 to %d fields can be co-located",
+                     idx2_file::MaxCoLocatedFields);
+  const idx2_file& First = Idx2s[0];
+  char Group[sizeof(First.CoLocated)];
+  printer Pr(Group, sizeof(Group));
+  int GroupLength = 0;
+  idx2_For (int, F, 0, NFields)
+  {
+    const idx2_file& Idx2 = Idx2s[F];
+    idx2_ReturnErrorIf(Idx2.CoLocated[0] || Idx2.FastDir[0],
+                       idx2_err_code::OptionNotSupported,
+                       "%s is already co-located or on two tiers",
+                       Idx2.Field);
+    bool SameLayout = strcmp(Idx2.Dir, First.Dir) == 0 && strcmp(Idx2.Name, First.Name) == 0 &&
+                      Idx2.Dims3 == First.Dims3 && Idx2.BrickDims3 == First.BrickDims3 &&
+                      Idx2.NLevels == First.NLevels && Idx2.TformOrder == First.TformOrder &&
+                      Idx2.BricksPerChunkIn == First.BricksPerChunkIn &&
+                      Idx2.ChunksPerFileIn == First.ChunksPerFileIn && Idx2.FilesPerDir == First.FilesPerDir &&
+                      Idx2.GroupLevels == First.GroupLevels && Idx2.GroupSubLevels == First.GroupSubLevels &&
+                      Idx2.GroupBitPlanes == First.GroupBitPlanes;
+    idx2_ReturnErrorIf(!SameLayout,
+                       idx2_err_code::OptionNotSupported,
+                       "%s and %s do not have the same layout",
+                       First.Field,
+                       Idx2.Field);
+    GroupLength += (F > 0) + (int)strlen(Idx2.Field);
+    idx2_Print(&Pr, F == 0 ? "%s" : "+%s", Idx2.Field);
+  }
+  idx2_ReturnErrorIf(GroupLength >= (int)sizeof(Group),
+                     idx2_err_code::OptionNotSupported,
+                     "the names of the fields are too long to be co-located");
+  char Path[512];
+  int Bytes = snprintf(Path, sizeof(Path), "%s/%s/%s/BrickData", First.Dir, First.Name, Group);
+  idx2_ReturnErrorIf(Bytes >= int(sizeof(Path)),
+                     idx2_err_code::OptionNotSupported,
+                     "the path %s/%s/%s/BrickData is too long",
+                     First.Dir,
+                     First.Name,
+                     Group);
+  idx2_ReturnErrorIf(DirExists(Path), idx2_err_code::OptionNotSupported, "%s already exists", Path);
+
+  idx2_PropagateIfError(CoLocateDir(Idx2s, NFields, Group, "BrickData"));
+  idx2_For (int, F, 0, NFields)
+  {
+    idx2_file* Idx2 = &Idx2s[F];
+    snprintf(Path, sizeof(Path), "%s/%s/%s/BrickData", Idx2->Dir, Idx2->Name, Idx2->Field); // shorter than the group's
+    if (DirExists(Path))
+      RemoveDir(Path);
+    snprintf(Idx2->CoLocated, sizeof(Idx2->CoLocated), "%s", Group);
+    Idx2->CoLocatedField = i8(F);
+    Idx2->NCoLocatedFields = i8(NFields);
+  }
+
+  return idx2_Error(idx2_err_code::NoError);
+}
+
 // file_id
 // ConstructFilePathRdos(const idx2_file& Idx2, u64 Brick, i8 Level) {
 //   #define idx2_PrintLevel idx2_Print(&Pr, "/L%02x", Level);
@@ -46754,8 +49356,85 @@ Dealloc(wav_basis_norms* WbN)
   Dealloc(&WbN->WaveNorms);
 }
 
+/* The norms of the scaling and wavelet functions of a kernel at each level, as the norms of the responses of the
+inverse lifting to a unit low-pass and a unit high-pass coefficient, which the finer levels then upsample and smooth
+with the low-pass response (the recurrence of GetCdf53Norms) */
+template <typename kernel> static wav_basis_norms_static<16>
+ComputeWaveletNorms()
+{
+  constexpr int N = 33; // long enough for the responses at one level not to see the ends of the line
+  volume Line(v3i(N, 1, 1), dtype::float64);
+  idx2_CleanUp(Dealloc(&Line));
+  f64* F = (f64*)Line.Buffer.Data;
+  array<f64> Responses[2]; // low pass, high pass (their non-zero part)
+  idx2_For (int, H, 0, 2)
+  {
+    Fill(F, F + N, 0.0);
+    F[N / 2 + H] = 1; // N / 2 is even
+    InverseLift<kernel, f64>(grid(v3i(N, 1, 1)), v3i(N, 1, 1), 0, &Line);
+    int First = 0, Last = N - 1;
+    while (F[First] == 0)
+      ++First;
+    while (F[Last] == 0)
+      --Last;
+    Init(&Responses[H], Last - First + 1, 0.0);
+    idx2_InclusiveFor (int, I, First, Last)
+      Responses[H][I - First] = F[I];
+  }
+  wav_basis_norms_static<16> Result;
+  array<f64> Funcs[2], Next;
+  Clone(Responses[0], &Funcs[0]);
+  Clone(Responses[1], &Funcs[1]);
+  idx2_For (int, L, 0, 16)
+  {
+    idx2_For (int, H, 0, 2)
+    {
+      f64 Sum = 0;
+      idx2_For (i64, I, 0, Size(Funcs[H]))
+        Sum += Funcs[H][I] * Funcs[H][I];
+      (H == 0 ? Result.ScalNorms : Result.WaveNorms)[L] = sqrt(Sum);
+      if (L + 1 == 16)
+        continue;
+      /* the function at the next level: its coefficients become low-pass coefficients one level finer */
+      Init(&Next, 2 * (Size(Funcs[H]) - 1) + Size(Responses[0]), 0.0);
+      idx2_For (i64, J, 0, Size(Funcs[H]))
+      {
+        idx2_For (i64, I, 0, Size(Responses[0]))
+          Next[2 * J + I] += Funcs[H][J] * Responses[0][I];
+      }
+      Dealloc(&Funcs[H]);
+      Funcs[H] = Next;
+      Next = array<f64>();
+    }
+  }
+  idx2_For (int, H, 0, 2)
+  {
+    Dealloc(&Responses[H]);
+    Dealloc(&Funcs[H]);
+  }
+  return Result;
+}
+
+const wav_basis_norms_static<16>&
+GetWaveletNorms(wavelet Wavelet)
+{
+  if (Wavelet == wavelet::Haar)
+  {
+    static const wav_basis_norms_static<16> HaarNorms = ComputeWaveletNorms<haar_kernel>();
+    return HaarNorms;
+  }
+  if (Wavelet == wavelet::Cdf97)
+  {
+    static const wav_basis_norms_static<16> Cdf97Norms = ComputeWaveletNorms<cdf97_kernel>();
+    return Cdf97Norms;
+  }
+  idx2_AbortIf(Wavelet != wavelet::Cdf53, "unknown wavelet %d\n", int(Wavelet));
+  static const wav_basis_norms_static<16> Cdf53Norms = GetCdf53NormsFast<16>();
+  return Cdf53Norms;
+}
+
 void
-ComputeTransformDetails(transform_details* Td, const v3i& Dims3, int NPasses, u64 TformOrder)
+ComputeTransformDetails(transform_details* Td, const v3i& Dims3, int NPasses, u64 TformOrder, wavelet Wavelet)
 {
   int Pass = 0;
   u64 PrevOrder = TformOrder;
@@ -46792,8 +49471,9 @@ ComputeTransformDetails(transform_details* Td, const v3i& Dims3, int NPasses, u6
   }
   Td->TformOrder = TformOrder;
   Td->StackSize = StackSize;
-  Td->BasisNorms = GetCdf53NormsFast<16>();
+  Td->BasisNorms = GetWaveletNorms(Wavelet);
   Td->NPasses = NPasses;
+  Td->Wavelet = Wavelet;
 }
 
 // TODO: this won't work for a general (sub)volume
@@ -47513,35 +50193,24 @@ ForwardCdf53(const v3i& Dims3,
 }
 
 void
-ForwardCdf53(const v3i& M3,
-             int Iter,
-             const array<subband>& Subbands,
-             const transform_details& Td,
-             volume* Vol,
-             bool LastIter)
-{
-  idx2_For (int, I, 0, Td.StackSize)
-  {
-    int D = Td.StackAxes[I];
-#define Body(type)                                                                                 \
-  switch (D)                                                                                       \
-  {                                                                                                \
-    case 0:                                                                                        \
-      FLiftCdf53X<type>(Td.StackGrids[I], M3, lift_option::Normal, Vol);                           \
-      break;                                                                                       \
-    case 1:                                                                                        \
-      FLiftCdf53Y<type>(Td.StackGrids[I], M3, lift_option::Normal, Vol);                           \
-      break;                                                                                       \
-    case 2:                                                                                        \
-      FLiftCdf53Z<type>(Td.StackGrids[I], M3, lift_option::Normal, Vol);                           \
-      break;                                                                                       \
-    default:                                                                                       \
-      idx2_Assert(false);                                                                          \
-      break;                                                                                       \
-  };
-    idx2_DispatchOnType(Vol->Type);
+ForwardWavelet(const v3i& M3,
+               int Iter,
+               const array<subband>& Subbands,
+               const transform_details& Td,
+               volume* Vol,
+               bool LastIter)
+{
+  idx2_TraceScope("ForwardWavelet");
+  DispatchOnWavelet(Td.Wavelet, [&](auto Kernel) {
+    using kernel = decltype(Kernel);
+    idx2_For (int, I, 0, Td.StackSize)
+    {
+      idx2_Assert(Td.StackAxes[I] >= 0 && Td.StackAxes[I] < 3);
+#define Body(type) ForwardLift<kernel, type>(Td.StackGrids[I], M3, Td.StackAxes[I], Vol);
+      idx2_DispatchOnType(Vol->Type);
 #undef Body
-  }
+    }
+  });
 
   /* Optionally normalize */
   idx2_Assert(IsFloatingPoint(Vol->Type));
@@ -47573,13 +50242,14 @@ ForwardCdf53(const v3i& M3,
 }
 
 void
-InverseCdf53(const v3i& M3,
-             int Iter,
-             const array<subband>& Subbands,
-             const transform_details& Td,
-             volume* Vol,
-             bool LastIter)
-{
+InverseWavelet(const v3i& M3,
+               int Iter,
+               const array<subband>& Subbands,
+               const transform_details& Td,
+               volume* Vol,
+               bool LastIter)
+{
+  idx2_TraceScope("InverseWavelet");
   /* inverse normalize if required */
   idx2_Assert(IsFloatingPoint(Vol->Type));
   for (int I = 0; I < Size(Subbands); ++I)
@@ -47609,29 +50279,15 @@ InverseCdf53(const v3i& M3,
   }
 
   /* perform the inverse transform */
-  int I = Td.StackSize;
-  while (I-- > 0)
-  {
-    int D = Td.StackAxes[I];
-#define Body(type)                                                                                 \
-  switch (D)                                                                                       \
-  {                                                                                                \
-    case 0:                                                                                        \
-      ILiftCdf53X<f64>(Td.StackGrids[I], M3, lift_option::Normal, Vol);                            \
-      break;                                                                                       \
-    case 1:                                                                                        \
-      ILiftCdf53Y<f64>(Td.StackGrids[I], M3, lift_option::Normal, Vol);                            \
-      break;                                                                                       \
-    case 2:                                                                                        \
-      ILiftCdf53Z<f64>(Td.StackGrids[I], M3, lift_option::Normal, Vol);                            \
-      break;                                                                                       \
-    default:                                                                                       \
-      idx2_Assert(false);                                                                          \
-      break;                                                                                       \
-  };
-    idx2_DispatchOnType(Vol->Type);
-#undef Body
-  }
+  DispatchOnWavelet(Td.Wavelet, [&](auto Kernel) {
+    using kernel = decltype(Kernel);
+    int I = Td.StackSize;
+    while (I-- > 0)
+    {
+      idx2_Assert(Td.StackAxes[I] >= 0 && Td.StackAxes[I] < 3);
+      InverseLift<kernel, f64>(Td.StackGrids[I], M3, Td.StackAxes[I], Vol);
+    }
+  });
 }
 
 void
@@ -48630,8 +51286,17 @@ error<idx2_err_code>
 Init(idx2_file* Idx2, params& P)
 {
   SetDir(Idx2, P.InDir);
-  SetDownsamplingFactor(Idx2, P.DownsamplingFactor3);
   idx2_PropagateIfError(ReadMetaFile(Idx2, idx2_PrintScratch("%s", P.InputFile)));
+  /* past the coarsest level of the file, there is nothing more to leave out */
+  P.DownsamplingFactor3 = Min(P.DownsamplingFactor3, v3i(Idx2->NLevels));
+  SetDownsamplingFactor(Idx2, P.DownsamplingFactor3);
+  idx2_ReturnErrorIf(!(P.DownsamplingFactor3 >= Idx2->MinDownsampling3),
+                     idx2_err_code::DownsamplingTooLow,
+                     "%s only stores the data for a downsampling factor of at least %d %d %d",
+                     P.InputFile,
+                     idx2_PrV3i(Idx2->MinDownsampling3));
+  if (P.FastDir && Idx2->FastDir[0]) // the fast tier is mounted somewhere else than when it was written
+    snprintf(Idx2->FastDir, sizeof(Idx2->FastDir), "%s", P.FastDir);
   idx2_PropagateIfError(Finalize(Idx2, P));
   if (Dims(P.DecodeExtent) == v3i(0)) // TODO: this could conflate with the user wanting to decode a single sample (very unlikely though)
     P.DecodeExtent = extent(Idx2->Dims3);
@@ -48645,10 +51310,9 @@ GetOutputGrid(const idx2_file& Idx2, const params& P)
 }
 
 error<idx2_err_code>
-Decode(idx2_file* Idx2, params& P, buffer* OutBuf)
+Decode(idx2_file* Idx2, params& P, buffer* OutBuf, decode_stats* Stats)
 {
-  Decode(*Idx2, P, OutBuf);
-  return idx2_Error(idx2_err_code::NoError);
+  return Decode(*Idx2, P, OutBuf, Stats);
 }
 
 error<idx2_err_code>